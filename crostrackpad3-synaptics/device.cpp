@@ -1,7 +1,7 @@
 #include "internal.h"
 #include "device.h"
 #include "hiddevice.h"
-#include "spb.h"
+#include "spbtarget.h"
 
 static ULONG SynaPrintDebugLevel = 100;
 static ULONG SynaPrintDebugCatagories = DBG_INIT || DBG_PNP || DBG_IOCTL;
@@ -179,6 +179,53 @@ bool IsSynaLoaded(){
 }
 
 int rmi_populate(PDEVICE_CONTEXT pDevice);
+int rmi_resume(PDEVICE_CONTEXT pDevice);
+bool rmi_save_capabilities(PDEVICE_CONTEXT pDevice, struct rmi_capabilities *caps);
+int rmi_populate_from_capabilities(PDEVICE_CONTEXT pDevice, const struct rmi_capabilities *caps);
+
+DECLARE_CONST_UNICODE_STRING(capabilitiesValueName, L"RmiCapabilities");
+
+//
+// The capability snapshot lives in the device's hardware key, next to
+// the settings the INF puts there
+//
+
+static bool SynaLoadCapabilities(PDEVICE_CONTEXT pDevice, struct rmi_capabilities *caps) {
+	WDFKEY deviceKey;
+	ULONG length = 0;
+	ULONG type = 0;
+	NTSTATUS status;
+
+	status = WdfDeviceOpenRegistryKey(pDevice->FxDevice, PLUGPLAY_REGKEY_DEVICE,
+		KEY_READ, WDF_NO_OBJECT_ATTRIBUTES, &deviceKey);
+	if (!NT_SUCCESS(status))
+		return false;
+
+	status = WdfRegistryQueryValue(deviceKey, &capabilitiesValueName, sizeof(*caps),
+		caps, &length, &type);
+	WdfRegistryClose(deviceKey);
+
+	return NT_SUCCESS(status) && type == REG_BINARY && length == sizeof(*caps);
+}
+
+static void SynaStoreCapabilities(PDEVICE_CONTEXT pDevice, struct rmi_capabilities *caps) {
+	WDFKEY deviceKey;
+	NTSTATUS status;
+
+	status = WdfDeviceOpenRegistryKey(pDevice->FxDevice, PLUGPLAY_REGKEY_DEVICE,
+		KEY_WRITE, WDF_NO_OBJECT_ATTRIBUTES, &deviceKey);
+	if (!NT_SUCCESS(status)) {
+		SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP, "Can not open the device key to store capabilities: %x\n", status);
+		return;
+	}
+
+	status = WdfRegistryAssignValue(deviceKey, &capabilitiesValueName, REG_BINARY,
+		sizeof(*caps), caps);
+	if (!NT_SUCCESS(status))
+		SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP, "Can not store capabilities: %x\n", status);
+	WdfRegistryClose(deviceKey);
+}
+void rmi_f11_set_scale(PDEVICE_CONTEXT pDevice, unsigned int resx, unsigned int resy);
 
 NTSTATUS BOOTTRACKPAD(
 	_In_  PDEVICE_CONTEXT  pDevice
@@ -191,7 +238,17 @@ NTSTATUS BOOTTRACKPAD(
 
 	FuncEntry(TRACE_FLAG_WDFLOADING);
 
-	rmi_populate(pDevice);
+	//
+	// What the PDT scan and the queries find only changes with the
+	// firmware, a snapshot from an earlier start spares both as long as
+	// the sensor still reports the same build id
+	//
+	struct rmi_capabilities caps;
+	if (!SynaLoadCapabilities(pDevice, &caps) ||
+		rmi_populate_from_capabilities(pDevice, &caps)) {
+		if (!rmi_populate(pDevice) && rmi_save_capabilities(pDevice, &caps))
+			SynaStoreCapabilities(pDevice, &caps);
+	}
 
 	csgesture_softc *sc = &pDevice->sc;
 	sprintf(sc->product_id, "unknown");
@@ -203,6 +260,11 @@ NTSTATUS BOOTTRACKPAD(
 	sc->phyx = pDevice->max_x;
 	sc->phyy = pDevice->max_y;
 
+	rmi_f11_set_scale(pDevice, sc->resx, sc->resy);
+	SynaBuildReportDescriptor(pDevice);
+
+	sc->maxcontacts = min((int)pDevice->max_fingers, GESTURE_MAX_CONTACTS);
+
 	deviceLoaded = true;
 
 	FuncExit(TRACE_FLAG_WDFLOADING);
@@ -238,13 +300,47 @@ Status
 	PDEVICE_CONTEXT pDevice = GetDeviceContext(FxDevice);
 	NTSTATUS status = STATUS_SUCCESS;
 
-	WdfTimerStart(pDevice->Timer, WDF_REL_TIMEOUT_IN_MS(10));
+	//
+	// Whatever was sent or queued before the power down is stale for
+	// the class driver, start the change tracking over
+	//
+	pDevice->LastReport.mouse_valid = false;
+	pDevice->LastReport.keyboard_valid = false;
+
+	WdfSpinLockAcquire(pDevice->ReportLock);
+	report_fifo_init(&pDevice->ReportFifo);
+	WdfSpinLockRelease(pDevice->ReportLock);
+
+	//
+	// Neither is the gesture state or any frame still queued, the
+	// fingers that were down are long gone. Nothing runs the gesture
+	// engine until the interrupt is connected again, so no lock is
+	// needed.
+	//
+	ResetGestureState(&pDevice->sc);
+	RtlZeroMemory(&pDevice->MouseBatch, sizeof(pDevice->MouseBatch));
+	pDevice->PtpUnsentReleased = 0;
+	frame_ring_init(&pDevice->FrameRing);
+
+	//
+	// Coming back from a low power state the sensor is already
+	// populated, it only needs the control registers the driver set
+	//
+	if (IsSynaLoaded())
+		rmi_resume(pDevice);
 
 	BOOTTRACKPAD(pDevice);
 
 	pDevice->RegsSet = false;
 	pDevice->ConnectInterrupt = true;
 
+	//
+	// The polling timer is one-shot and only re-arms itself while the
+	// interrupt is connected, so it may only start from here
+	//
+	if (!pDevice->EventDrivenInput)
+		WdfTimerStart(pDevice->Timer, WDF_REL_TIMEOUT_IN_MS(10));
+
 	FuncExit(TRACE_FLAG_WDFLOADING);
 
 	return status;
@@ -282,6 +378,15 @@ Status
 
 	pDevice->ConnectInterrupt = false;
 
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Frames: %d, bus bytes: %lld, empty: %d, short: %d\n",
+		pDevice->FrameStats.frames, pDevice->FrameStats.bus_bytes,
+		pDevice->FrameStats.empty_reads, pDevice->FrameStats.short_reads);
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Reports sent: %d, unchanged and suppressed: %d\n",
+		pDevice->LastReport.sent, pDevice->LastReport.suppressed);
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Reports queued: %d, merged: %d, dropped: %d, refused: %d\n",
+		pDevice->ReportFifo.queued, pDevice->ReportFifo.merged,
+		pDevice->ReportFifo.dropped, pDevice->ReportFifo.refused);
+
 	FuncExit(TRACE_FLAG_WDFLOADING);
 
 	return STATUS_SUCCESS;
@@ -473,6 +578,15 @@ VOID
 		//
 		status = SynaGetFeature(pDevice, FxRequest, &fSync);
 		break;
+
+	case IOCTL_HID_SET_FEATURE:
+		//
+		// sets a feature report, only the wheel resolution multiplier
+		// is writable
+		//
+		status = SynaSetFeature(pDevice, FxRequest);
+		fSync = TRUE;
+		break;
 	case IOCTL_HID_ACTIVATE_DEVICE:
 		//
 		// Makes the device ready for I/O operations.
@@ -21,5 +21,7 @@ EVT_WDF_INTERRUPT_ISR                OnInterruptIsr;
 EVT_WDF_TIMER OnPollTimerFunc;
 
 void ProcessSetting(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, int settingRegister, int settingValue);
+void ResetGestureState(struct csgesture_softc *sc);
+void SynaPostSetting(PDEVICE_CONTEXT pDevice, int settingRegister, int settingValue);
 
 #endif
\ No newline at end of file
@@ -8,14 +8,20 @@
 static ULONG SynaPrintDebugLevel = 100;
 static ULONG SynaPrintDebugCatagories = DBG_INIT || DBG_PNP || DBG_IOCTL;
 
-void TrackpadRawInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t *report, int tickinc);
+void TrackpadRawInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t *report, int reportSize, uint64_t timestamp);
+void TrackpadIdleInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint64_t timestamp);
 void SetDefaultSettings(struct csgesture_softc *sc);
 void SynaTimerFunc(_In_ WDFTIMER hTimer);
+static void SynaArmDeadline(PDEVICE_CONTEXT pDevice);
+static int SynaDrainFrames(PDEVICE_CONTEXT pDevice);
+static void flush_relative_mouse(PDEVICE_CONTEXT pDevice);
+static void SynaApplyMailbox(PDEVICE_CONTEXT pDevice);
 
 #define NT_DEVICE_NAME      L"\\Device\\SYNATP"
 #define DOS_DEVICE_NAME     L"\\DosDevices\\SYNATP"
 
-#define MAX_FINGERS 5
+#define SYNA_POLL_INTERVAL_MS 10
+#define SYNA_DEADLINE_SLACK_US 1000
 
 //#include "driver.tmh"
 
@@ -89,6 +95,68 @@ _In_ WDFOBJECT Object
 	FuncExit(TRACE_FLAG_WDFLOADING);
 }
 
+//
+// Options an administrator can set under the device's Settings key,
+// anything missing keeps its default
+//
+
+static void SynaReadDeviceSettings(PDEVICE_CONTEXT pDevice) {
+	DECLARE_CONST_UNICODE_STRING(settingsKeyName, L"Settings");
+	DECLARE_CONST_UNICODE_STRING(ptpValueName, L"PrecisionTouchpad");
+	DECLARE_CONST_UNICODE_STRING(eventDrivenValueName, L"EventDrivenInput");
+	DECLARE_CONST_UNICODE_STRING(batchValueName, L"BatchInput");
+	DECLARE_CONST_UNICODE_STRING(atomicReadsValueName, L"AtomicRmiReads");
+	DECLARE_CONST_UNICODE_STRING(certificationValueName, L"PtpCertification");
+	WDFKEY deviceKey;
+	WDFKEY settingsKey;
+	ULONG value;
+	ULONG length = 0;
+	ULONG type = 0;
+	bool certified = false;
+	NTSTATUS status;
+
+	status = WdfDeviceOpenRegistryKey(pDevice->FxDevice, PLUGPLAY_REGKEY_DEVICE,
+		KEY_READ, WDF_NO_OBJECT_ATTRIBUTES, &deviceKey);
+	if (!NT_SUCCESS(status))
+		return;
+
+	status = WdfRegistryOpenKey(deviceKey, &settingsKeyName, KEY_READ,
+		WDF_NO_OBJECT_ATTRIBUTES, &settingsKey);
+	if (NT_SUCCESS(status)) {
+		if (NT_SUCCESS(WdfRegistryQueryULong(settingsKey, &ptpValueName, &value)))
+			pDevice->PtpEnabled = value != 0;
+		if (NT_SUCCESS(WdfRegistryQueryULong(settingsKey, &eventDrivenValueName, &value)))
+			pDevice->EventDrivenInput = value != 0;
+		if (NT_SUCCESS(WdfRegistryQueryULong(settingsKey, &batchValueName, &value)))
+			pDevice->BatchInput = value != 0;
+		if (NT_SUCCESS(WdfRegistryQueryULong(settingsKey, &atomicReadsValueName, &value)))
+			pDevice->AtomicRmiReads = value != 0;
+		status = WdfRegistryQueryValue(settingsKey, &certificationValueName,
+			sizeof(pDevice->PtpCertification), pDevice->PtpCertification, &length, &type);
+		certified = NT_SUCCESS(status) && type == REG_BINARY && length == sizeof(pDevice->PtpCertification);
+		WdfRegistryClose(settingsKey);
+	}
+	WdfRegistryClose(deviceKey);
+
+	//
+	// Without the certification blob Windows would never take the
+	// touchpad collection, it would only sit in the descriptor
+	//
+	if (pDevice->PtpEnabled && !certified) {
+		SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP, "PrecisionTouchpad is set but PtpCertification is missing or not %d bytes\n",
+			PTP_CERTIFICATION_SIZE);
+		pDevice->PtpEnabled = FALSE;
+	}
+
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Precision Touchpad reports %s\n",
+		pDevice->PtpEnabled ? "enabled" : "disabled");
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "%s input, %s\n",
+		pDevice->EventDrivenInput ? "Event-driven" : "Polled",
+		pDevice->BatchInput ? "batched" : "not batched");
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "RMI registers read with %s\n",
+		pDevice->AtomicRmiReads ? "one write-read sequence" : "a write and a read");
+}
+
 NTSTATUS
 OnDeviceAdd(
 _In_    WDFDRIVER       FxDriver,
@@ -314,10 +382,16 @@ Status
 	WDFTIMER                      hTimer;
 	WDF_OBJECT_ATTRIBUTES         attributes;
 
-	WDF_TIMER_CONFIG_INIT_PERIODIC(&timerConfig, SynaTimerFunc, 10);
+	//
+	// One-shot timer, re-armed by SynaTimerFunc in polled mode or by
+	// SynaArmDeadline when the gesture engine has a timeout pending.
+	// It runs at passive level so it can take the interrupt lock.
+	//
+	WDF_TIMER_CONFIG_INIT(&timerConfig, SynaTimerFunc);
 
 	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
 	attributes.ParentObject = fxDevice;
+	attributes.ExecutionLevel = WdfExecutionLevelPassive;
 	status = WdfTimerCreate(&timerConfig, &attributes, &hTimer);
 	pDevice->Timer = hTimer;
 	if (!NT_SUCCESS(status))
@@ -326,10 +400,38 @@ Status
 		return status;
 	}
 
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = fxDevice;
+	status = WdfSpinLockCreate(&attributes, &pDevice->SettingsLock);
+	if (!NT_SUCCESS(status))
+	{
+		SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP, "(%!FUNC!) WdfSpinLockCreate failed status:%!STATUS!\n", status);
+		return status;
+	}
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = fxDevice;
+	status = WdfSpinLockCreate(&attributes, &pDevice->ReportLock);
+	if (!NT_SUCCESS(status))
+	{
+		SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP, "(%!FUNC!) WdfSpinLockCreate failed status:%!STATUS!\n", status);
+		return status;
+	}
+
 	SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP,
 		"Success! 0x%x\n", status);
 
 	pDevice->DeviceMode = DEVICE_MODE_MOUSE;
+	pDevice->EventDrivenInput = TRUE;
+	pDevice->BatchInput = TRUE;
+	pDevice->AtomicRmiReads = FALSE;
+
+	pDevice->PtpInputMode = PTP_INPUT_MODE_MOUSE;
+	pDevice->PtpSwitches = PTP_SWITCH_SURFACE | PTP_SWITCH_BUTTON;
+	SynaReadDeviceSettings(pDevice);
+
+	frame_ring_init(&pDevice->FrameRing);
+	report_fifo_init(&pDevice->ReportFifo);
 
 exit:
 
@@ -339,6 +441,41 @@ exit:
 }
 
 
+static uint64_t SynaQueryTimeUs() {
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter = KeQueryPerformanceCounter(&frequency);
+
+	return (counter.QuadPart / frequency.QuadPart) * 1000000 +
+		(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
+static uint16_t SynaReadInputReport(PDEVICE_CONTEXT pDevice, uint8_t *buffer) {
+	uint16_t length;
+
+	if (!NT_SUCCESS(SpbOnlyReadIntoBufferSynchronously(&pDevice->I2CContext, buffer, pDevice->attn_read_size)))
+		return 0;
+	pDevice->FrameStats.bus_bytes += pDevice->attn_read_size;
+
+	//
+	// HID-I2C has no way to learn the length without consuming the
+	// report, so the whole report is always read in one transaction and
+	// the prefix only tells how much of it is real. Reports still queued
+	// on the device keep ATTN asserted, and the level triggered
+	// interrupt brings us back here for them.
+	//
+	length = frame_input_length(buffer);
+	if (length == 0) {
+		pDevice->FrameStats.empty_reads++;
+		return 0;
+	}
+
+	if (length > pDevice->attn_report_size) {
+		SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP, "Input report truncated from %d to %d bytes\n", length, pDevice->attn_report_size);
+		length = (uint16_t)pDevice->attn_report_size;
+	}
+	return length;
+}
+
 BOOLEAN OnInterruptIsr(
 	WDFINTERRUPT Interrupt,
 	ULONG MessageID){
@@ -351,14 +488,26 @@ BOOLEAN OnInterruptIsr(
 		return false;
 	}
 
-	uint8_t i2cInput[42];
-	SpbOnlyReadDataSynchronously(&pDevice->I2CContext, &i2cInput, sizeof(i2cInput));
+	//
+	// Read straight into the next ring slot; the frame is only
+	// published if it turns out to be an ATTN report, otherwise the
+	// slot is simply reused by the next interrupt.
+	//
+	struct syna_frame *frame = frame_ring_reserve(&pDevice->FrameRing);
+	if (!frame) {
+		uint8_t discard[SYNA_FRAME_BUFFER_SIZE];
 
-	uint8_t rmiInput[40];
-	for (int i = 0; i < 40; i++) {
-		rmiInput[i] = i2cInput[i + 2];
+		SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP, "Frame ring full, %d frames dropped\n", pDevice->FrameRing.overruns);
+		SynaReadInputReport(pDevice, discard);
+		return true;
 	}
 
+	uint16_t length = SynaReadInputReport(pDevice, frame->buffer);
+	if (length == 0)
+		return true;
+
+	uint8_t *rmiInput = frame_report(frame);
+
 	if (rmiInput[0] == 0x00)
 		return true;
 
@@ -367,12 +516,145 @@ BOOLEAN OnInterruptIsr(
 		return true;
 	}
 
-	for (int i = 0; i < 40; i++)
-		pDevice->lastreport[i] = rmiInput[i];
+	if (length < RMI_ATTN_HEADER_SIZE + rmi_plan_data_size(&pDevice->decode_plan, rmiInput[1])) {
+		pDevice->FrameStats.short_reads++;
+		return true;
+	}
+
+	frame->length = length;
+	frame_ring_commit(&pDevice->FrameRing, SynaQueryTimeUs());
+
+	if (pDevice->EventDrivenInput) {
+		//
+		// The framework holds the passive interrupt lock for us,
+		// so the frame can go straight to the gesture engine.
+		//
+		SynaDrainFrames(pDevice);
+		SynaArmDeadline(pDevice);
+	}
 
 	return true;
 }
 
+static int SynaDrainFrames(PDEVICE_CONTEXT pDevice) {
+	struct syna_frame *frame;
+	uint32_t expected;
+	int count = 0;
+
+	frame = frame_ring_peek(&pDevice->FrameRing);
+	if (!frame)
+		return 0;
+
+	pDevice->MouseBatch.active = pDevice->BatchInput;
+	expected = frame->sequence;
+	do {
+		if (frame->sequence != expected)
+			SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP, "Lost %d frames\n", frame->sequence - expected);
+		expected = frame->sequence + 1;
+
+		SynaApplyMailbox(pDevice);
+
+		//
+		// Parse the slot in place and only hand it back to the ISR
+		// once the gesture engine is done with it.
+		//
+		TrackpadRawInput(pDevice, &pDevice->sc, frame_report(frame), frame->length, frame->timestamp);
+		frame_ring_pop(&pDevice->FrameRing);
+		pDevice->FrameStats.frames++;
+		count++;
+	} while (count < SYNA_FRAME_RING_SIZE &&
+		(frame = frame_ring_peek(&pDevice->FrameRing)) != NULL);
+	flush_relative_mouse(pDevice);
+	pDevice->MouseBatch.active = false;
+
+	return count;
+}
+
+static uint64_t GestureNextDeadline(csgesture_softc *sc) {
+	//
+	// The sensor stops sending ATTN frames once every finger is lifted,
+	// so anything that expires while no finger is down needs the timer
+	// to run the gesture engine once more when it is due.
+	//
+	uint64_t deadline = 0;
+
+	if (sc->mouseDownDueToTap && sc->idForMouseDown == -1)
+		deadline = sc->clicktime + GESTURE_TAP_DRAG_US; //tap drag expiry
+	if (sc->scrollingActive) {
+		uint64_t scrollend = sc->lastscrolltime + GESTURE_SCROLL_LINGER_US;
+		if (!deadline || scrollend < deadline)
+			deadline = scrollend;
+	}
+	if (sc->scrollInertiaActive) {
+		uint64_t step = sc->timestamp + GESTURE_TICK_US; //next coasting step
+		if (!deadline || step < deadline)
+			deadline = step;
+	}
+	return deadline;
+}
+
+static void SynaArmDeadline(PDEVICE_CONTEXT pDevice) {
+	uint64_t deadline = GestureNextDeadline(&pDevice->sc);
+	uint64_t now;
+	LONGLONG delay = 0;
+
+	if (!deadline) {
+		WdfTimerStop(pDevice->Timer, FALSE);
+		return;
+	}
+
+	now = SynaQueryTimeUs();
+	if (deadline > now)
+		delay = deadline - now;
+	WdfTimerStart(pDevice->Timer, WDF_REL_TIMEOUT_IN_US(delay + SYNA_DEADLINE_SLACK_US));
+}
+
+void SynaPostSetting(PDEVICE_CONTEXT pDevice, int settingRegister, int settingValue) {
+	struct syna_settings_mailbox *mailbox = &pDevice->Mailbox;
+
+	if (settingRegister < 0 || settingRegister >= SYNA_SETTINGS_REGISTERS) {
+		//info requests only read immutable state, answer them right away
+		ProcessSetting(pDevice, &pDevice->sc, settingRegister, settingValue);
+		return;
+	}
+
+	WdfSpinLockAcquire(pDevice->SettingsLock);
+	mailbox->value[settingRegister] = settingValue;
+	mailbox->dirty |= 1 << settingRegister;
+	mailbox->pending = true;
+	WdfSpinLockRelease(pDevice->SettingsLock);
+
+	//make sure it gets applied even if no finger is down
+	if (pDevice->EventDrivenInput)
+		WdfTimerStart(pDevice->Timer, WDF_REL_TIMEOUT_IN_MS(0));
+}
+
+//
+// Called by the gesture consumer between frames, so the engine never
+// sees its settings change halfway through one.
+//
+static void SynaApplyMailbox(PDEVICE_CONTEXT pDevice) {
+	struct syna_settings_mailbox *mailbox = &pDevice->Mailbox;
+	int value[SYNA_SETTINGS_REGISTERS];
+	uint32_t dirty;
+
+	if (!mailbox->pending)
+		return;
+
+	WdfSpinLockAcquire(pDevice->SettingsLock);
+	dirty = mailbox->dirty;
+	for (int i = 0; i < SYNA_SETTINGS_REGISTERS; i++)
+		value[i] = mailbox->value[i];
+	mailbox->dirty = 0;
+	mailbox->pending = false;
+	WdfSpinLockRelease(pDevice->SettingsLock);
+
+	for (int i = 0; i < SYNA_SETTINGS_REGISTERS; i++) {
+		if (dirty & (1 << i))
+			ProcessSetting(pDevice, &pDevice->sc, i, value[i]);
+	}
+}
+
 void SynaTimerFunc(_In_ WDFTIMER hTimer){
 	WDFDEVICE Device = (WDFDEVICE)WdfTimerGetParentObject(hTimer);
 	PDEVICE_CONTEXT pDevice = GetDeviceContext(Device);
@@ -380,14 +662,32 @@ void SynaTimerFunc(_In_ WDFTIMER hTimer){
 	if (!pDevice->ConnectInterrupt)
 		return;
 
-	uint8_t *report = pDevice->lastreport;
+	//
+	// In polled mode the ISR never touches the gesture state, and the
+	// frame ring needs no lock, so only event-driven mode has to
+	// serialize against the ISR.
+	//
+	if (pDevice->EventDrivenInput)
+		WdfInterruptAcquireLock(pDevice->Interrupt);
 
-	if (report[0] != 0xff) {
-		csgesture_softc sc = pDevice->sc;
-		TrackpadRawInput(pDevice, &sc, report, 1);
-		pDevice->sc = sc;
+	if (SynaDrainFrames(pDevice) == 0) {
+		//
+		// No new frame since the last tick, let the time-based
+		// gesture state catch up with the contacts last decoded.
+		//
+		SynaApplyMailbox(pDevice);
+		if (pDevice->sc.timestamp != 0)
+			TrackpadIdleInput(pDevice, &pDevice->sc, SynaQueryTimeUs());
 	}
 
+	if (pDevice->EventDrivenInput)
+		WdfInterruptReleaseLock(pDevice->Interrupt);
+
+	if (pDevice->EventDrivenInput)
+		SynaArmDeadline(pDevice);
+	else
+		WdfTimerStart(hTimer, WDF_REL_TIMEOUT_IN_MS(SYNA_POLL_INTERVAL_MS));
+
 	return;
 }
 
@@ -395,85 +695,190 @@ static int distancesq(int delta_x, int delta_y) {
 	return (delta_x * delta_x) + (delta_y*delta_y);
 }
 
-_SYNA_RELATIVE_MOUSE_REPORT lastreport;
+static uint64_t contact_age(csgesture_softc *sc, int i) {
+	if (sc->contact[i].touchdown == 0)
+		return 0;
+	return sc->timestamp - sc->contact[i].touchdown;
+}
+
+static int contact_count(uint32_t mask) {
+	mask = mask - ((mask >> 1) & 0x55555555);
+	mask = (mask & 0x33333333) + ((mask >> 2) & 0x33333333);
+	return (((mask + (mask >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+//pop the lowest slot off the mask, slots come out in ascending order
+static int next_contact(uint32_t *mask) {
+	unsigned long slot;
+
+	BitScanForward(&slot, *mask);
+	*mask &= *mask - 1;
+	return (int)slot;
+}
+
+//hand a report to the HID class driver, remember it only once it was taken
+static bool emit_report(PDEVICE_CONTEXT pDevice, PVOID report, ULONG size, PVOID last, bool *valid) {
+	size_t bytesWritten;
+
+	if (!NT_SUCCESS(SynaProcessVendorReport(pDevice, report, size, &bytesWritten)))
+		return false;
+	RtlCopyMemory(last, report, size);
+	*valid = true;
+	pDevice->LastReport.sent++;
+	return true;
+}
+
+//state reports that repeat the last one of their type carry nothing new
+static bool emit_report_changed(PDEVICE_CONTEXT pDevice, PVOID report, ULONG size, PVOID last, bool *valid) {
+	if (*valid && RtlEqualMemory(report, last, size)) {
+		pDevice->LastReport.suppressed++;
+		return false;
+	}
+	return emit_report(pDevice, report, size, last, valid);
+}
+
+static void send_relative_mouse(PDEVICE_CONTEXT pDevice, BYTE button,
+	int x, int y, int wheelPosition, int wheelHPosition) {
+	struct syna_report_state *last = &pDevice->LastReport;
 
-static void update_relative_mouse(PDEVICE_CONTEXT pDevice, BYTE button,
-	BYTE x, BYTE y, BYTE wheelPosition, BYTE wheelHPosition) {
 	_SYNA_RELATIVE_MOUSE_REPORT report;
 	report.ReportID = REPORTID_RELATIVE_MOUSE;
 	report.Button = button;
-	report.XValue = x;
-	report.YValue = y;
-	report.WheelPosition = wheelPosition;
-	report.HWheelPosition = wheelHPosition;
-	if (report.Button == lastreport.Button &&
-		report.XValue == lastreport.XValue &&
-		report.YValue == lastreport.YValue &&
-		report.WheelPosition == lastreport.WheelPosition &&
-		report.HWheelPosition == lastreport.HWheelPosition)
+	report.XValue = (SHORT)x;
+	report.YValue = (SHORT)y;
+	report.WheelPosition = (SHORT)wheelPosition;
+	report.HWheelPosition = (SHORT)wheelHPosition;
+
+	//motion is always new, an empty report only matters when the buttons changed
+	if (!x && !y && !wheelPosition && !wheelHPosition &&
+		last->mouse_valid && last->mouse.Button == button) {
+		last->suppressed++;
 		return;
-	lastreport = report;
+	}
+	emit_report(pDevice, &report, sizeof(report), &last->mouse, &last->mouse_valid);
+}
 
-	size_t bytesWritten;
-	SynaProcessVendorReport(pDevice, &report, sizeof(report), &bytesWritten);
+//take as much of the delta as fits a report, leave the rest behind
+static int take_mouse_delta(int *delta) {
+	int value = *delta;
+
+	if (value > RELATIVE_MOUSE_MAX_COORDINATE)
+		value = RELATIVE_MOUSE_MAX_COORDINATE;
+	else if (value < RELATIVE_MOUSE_MIN_COORDINATE)
+		value = RELATIVE_MOUSE_MIN_COORDINATE;
+	*delta -= value;
+	return value;
+}
+
+//the host gets whole detents until it sets the resolution multiplier, the rest waits for more
+static int take_wheel_delta(int *delta, int *remainder, bool hires) {
+	int units = *delta;
+	int detents;
+
+	*delta = 0;
+	if (hires)
+		return units;
+	if (!units)
+		return 0;
+
+	//turning around drops the partial detent left from the other way
+	if ((units < 0) != (*remainder < 0))
+		*remainder = 0;
+	*remainder += units;
+	detents = *remainder / WHEEL_DETENT;
+	*remainder -= detents * WHEEL_DETENT;
+	return detents;
+}
+
+static void flush_relative_mouse(PDEVICE_CONTEXT pDevice) {
+	struct syna_mouse_batch *batch = &pDevice->MouseBatch;
+
+	if (!batch->pending)
+		return;
+
+	//partial detents kept for the old resolution mean nothing in a new one
+	BYTE multiplier = pDevice->WheelMultiplier;
+	if (multiplier != batch->multiplier) {
+		batch->multiplier = multiplier;
+		batch->wheel_remainder = 0;
+		batch->hwheel_remainder = 0;
+	}
+
+	batch->wheel = take_wheel_delta(&batch->wheel, &batch->wheel_remainder,
+		(multiplier & MULTIPLIER_WHEEL_MASK) != 0);
+	batch->hwheel = take_wheel_delta(&batch->hwheel, &batch->hwheel_remainder,
+		(multiplier & MULTIPLIER_HWHEEL_MASK) != 0);
+
+	do {
+		int x = take_mouse_delta(&batch->x);
+		int y = take_mouse_delta(&batch->y);
+		int wheel = take_mouse_delta(&batch->wheel);
+		int hwheel = take_mouse_delta(&batch->hwheel);
+
+		send_relative_mouse(pDevice, batch->button, x, y, wheel, hwheel);
+	} while (batch->x || batch->y || batch->wheel || batch->hwheel);
+	batch->pending = false;
+}
+
+//wheel and pan are in WHEEL_DETENT units, whatever the host resolution
+static void update_relative_mouse(PDEVICE_CONTEXT pDevice, BYTE button,
+	int x, int y, int wheelPosition, int wheelHPosition) {
+	struct syna_mouse_batch *batch = &pDevice->MouseBatch;
+
+	//never merge across a button change so transitions keep their order
+	if (batch->pending && batch->button != button)
+		flush_relative_mouse(pDevice);
+
+	batch->pending = true;
+	batch->button = button;
+	batch->x += x;
+	batch->y += y;
+	batch->wheel += wheelPosition;
+	batch->hwheel += wheelHPosition;
+
+	if (!batch->active)
+		flush_relative_mouse(pDevice);
 }
 
 static void update_keyboard(PDEVICE_CONTEXT pDevice, BYTE shiftKeys, BYTE keyCodes[KBD_KEY_CODES]) {
+	flush_relative_mouse(pDevice);
+
 	_SYNA_KEYBOARD_REPORT report;
 	report.ReportID = REPORTID_KEYBOARD;
 	report.ShiftKeyFlags = shiftKeys;
+	report.Reserved = 0;
 	for (int i = 0; i < KBD_KEY_CODES; i++) {
 		report.KeyCodes[i] = keyCodes[i];
 	}
 
-	size_t bytesWritten;
-	SynaProcessVendorReport(pDevice, &report, sizeof(report), &bytesWritten);
-}
-
-static void stop_scroll(PDEVICE_CONTEXT pDevice) {
-	_SYNA_SCROLL_REPORT report;
-	report.ReportID = REPORTID_SCROLL;
-	report.Flag = 1;
-	report.Touch1XValue = 65535;
-	report.Touch1YValue = 65535;
-	report.Touch2XValue = 65535;
-	report.Touch2YValue = 65535;
-
-	size_t bytesWritten;
-	SynaProcessVendorReport(pDevice, &report, sizeof(report), &bytesWritten);
-}
-
-USHORT filterNegative(int val) {
-	if (val > 0)
-		return val;
-	return 65535;
+	emit_report_changed(pDevice, &report, sizeof(report),
+		&pDevice->LastReport.keyboard, &pDevice->LastReport.keyboard_valid);
 }
 
 bool ProcessMove(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int abovethreshold, int iToUse[3]) {
 	if (abovethreshold == 1 || sc->panningActive) {
 		int i = iToUse[0];
-		if (!sc->panningActive && sc->tick[i] < 5)
+		if (!sc->panningActive && contact_age(sc, i) < GESTURE_MOVE_DELAY_US)
 			return false;
 
-		stop_scroll(pDevice);
-
 		if (sc->panningActive && i == -1)
 			i = sc->idForPanning;
 
-		int delta_x = sc->x[i] - sc->lastx[i];
-		int delta_y = sc->y[i] - sc->lasty[i];
+		int delta_x = sc->contact[i].x - sc->contact[i].lastx;
+		int delta_y = sc->contact[i].y - sc->contact[i].lasty;
 
-		if (abs(delta_x) > 75 || abs(delta_y) > 75) {
+		if (abs(normalize_delta(sc, delta_x)) > 75 || abs(normalize_delta(sc, delta_y)) > 75) {
 			delta_x = 0;
 			delta_y = 0;
 		}
 
-		for (int j = 0;j < MAX_FINGERS;j++) {
+		for (uint32_t m = sc->active; m;) {
+			int j = next_contact(&m);
 			if (j != i) {
-				if (sc->blacklistedids[j] != 1) {
-					if (sc->y[j] > sc->y[i]) {
-						if (sc->truetick[j] > sc->truetick[i] + 15) {
-							sc->blacklistedids[j] = 1;
+				if (sc->contact[j].blacklisted != 1) {
+					if (sc->contact[j].y > sc->contact[i].y) {
+						if (contact_age(sc, j) > contact_age(sc, i) + GESTURE_PALM_DELAY_US) {
+							sc->contact[j].blacklisted = 1;
 						}
 					}
 				}
@@ -496,18 +901,107 @@ bool ProcessMove(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int abovethreshol
 	return false;
 }
 
+//
+// Q8 gain for a finger speed in 0.1mm per tick. It grows with the speed
+// so a flick covers a page while a slow drag stays precise.
+//
+static int scroll_gain(int speed) {
+	int gain = 256;
+
+	speed = abs(speed);
+	if (speed > GESTURE_SCROLL_ACCEL_START)
+		gain += (speed - GESTURE_SCROLL_ACCEL_START) * GESTURE_SCROLL_ACCEL_SLOPE;
+	if (gain > GESTURE_SCROLL_GAIN_MAX)
+		gain = GESTURE_SCROLL_GAIN_MAX;
+	return gain;
+}
+
+//
+// Adds Q8 WHEEL_DETENT units to the remainder and takes the whole units
+// out, the fractions carry into the next frame instead of being lost
+// to rounding.
+//
+static int scroll_take_units(int units_q8, int *remainder) {
+	//turning around drops what was left from the other way
+	if (units_q8 && (units_q8 < 0) != (*remainder < 0))
+		*remainder = 0;
+
+	int total = *remainder + units_q8;
+	int units = total / 256;
+	*remainder = total - units * 256;
+	return units;
+}
+
+//finger travel on the locked axis to the wheel or pan field of the report
+static void scroll_emit(csgesture_softc *sc, int units_q8) {
+	if (sc->scrollAxis == GESTURE_SCROLL_AXIS_Y)
+		sc->scrolly = scroll_take_units(units_q8, &sc->scrollRemainderY);
+	else
+		sc->scrollx = -scroll_take_units(units_q8, &sc->scrollRemainderX);
+}
+
+//
+// Starts coasting at the speed the scroll fingers left the pad with,
+// as the history window saw it on the last frame both were down.
+//
+static void StartInertia(csgesture_softc *sc) {
+	int speed = sc->scrollSpeed;
+
+	sc->scrollSpeed = 0;
+	if (abs(speed) < GESTURE_INERTIA_MIN_SPEED)
+		return;
+
+	sc->inertiaVelocity = speed * GESTURE_SCROLL_UNITS * scroll_gain(speed);
+	sc->scrollInertiaActive = true;
+}
+
+static void StopInertia(csgesture_softc *sc) {
+	sc->scrollInertiaActive = false;
+	sc->inertiaVelocity = 0;
+}
+
+//
+// One coasting step over the last frame interval. The speed decays by
+// GESTURE_INERTIA_DECAY_Q16 per reference tick, a partial tick takes
+// its share of the decay linearly. Any touch catches the scroll.
+//
+bool ProcessInertia(PDEVICE_CONTEXT pDevice, csgesture_softc *sc) {
+	UNREFERENCED_PARAMETER(pDevice);
+
+	if (!sc->scrollInertiaActive)
+		return false;
+
+	if (sc->active || sc->added) {
+		StopInertia(sc);
+		sc->inertiaCaught = true;
+		return false;
+	}
+
+	int64_t velocity = sc->inertiaVelocity;
+	int elapsed = sc->stepinterval;
+
+	scroll_emit(sc, (int)(velocity * elapsed / GESTURE_TICK_US));
+
+	for (; elapsed >= GESTURE_TICK_US; elapsed -= GESTURE_TICK_US)
+		velocity = velocity * GESTURE_INERTIA_DECAY_Q16 / 65536;
+	velocity -= velocity * (65536 - GESTURE_INERTIA_DECAY_Q16) / 65536 * elapsed / GESTURE_TICK_US;
+
+	sc->inertiaVelocity = (int)velocity;
+	if (abs(sc->inertiaVelocity) < GESTURE_INERTIA_STOP)
+		StopInertia(sc);
+	return true;
+}
+
 bool ProcessScroll(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int abovethreshold, int iToUse[3]) {
 	if (!sc->settings.scrollEnabled)
 		return false;
 
-	sc->scrollx = 0;
-	sc->scrolly = 0;
 	if (abovethreshold == 2 || sc->scrollingActive) {
 		int i1 = iToUse[0];
 		int i2 = iToUse[1];
 
-		if (!sc->scrollingActive && !sc->scrollInertiaActive) {
-			if (sc->truetick[i1] < 4 && sc->truetick[i2] < 4)
+		if (!sc->scrollingActive && !sc->inertiaCaught) {
+			if (contact_age(sc, i1) < GESTURE_SCROLL_DELAY_US && contact_age(sc, i2) < GESTURE_SCROLL_DELAY_US)
 				return false; 
 		}
 
@@ -526,92 +1020,63 @@ bool ProcessScroll(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int abovethresh
 			}
 		}
 
-		int delta_x1 = sc->x[i1] - sc->lastx[i1];
-		int delta_y1 = sc->y[i1] - sc->lasty[i1];
-
-		int delta_x2 = sc->x[i2] - sc->lastx[i2];
-		int delta_y2 = sc->y[i2] - sc->lasty[i2];
-
-		/*
-		if ((abs(delta_y1) + abs(delta_y2)) > (abs(delta_x1) + abs(delta_x2))) {
-			int avgy = (delta_y1 + delta_y2) / 2;
-			sc->scrolly = avgy;
+		//a finger lifted this frame has no position to move from
+		int ids[2] = { i1, i2 };
+		int sumx = 0, sumy = 0, travelx = 0, travely = 0, moving = 0;
+		for (int k = 0; k < 2; k++) {
+			int i = ids[k];
+			if (sc->contact[i].x == -1 || sc->contact[i].lastx == -1)
+				continue;
+			int dx = sc->contact[i].x - sc->contact[i].lastx;
+			int dy = sc->contact[i].y - sc->contact[i].lasty;
+			sumx += dx;
+			sumy += dy;
+			travelx += abs(dx);
+			travely += abs(dy);
+			moving++;
 		}
-		else {
-			int avgx = (delta_x1 + delta_x2) / 2;
-			sc->scrollx = avgx;
-		}
-		if (abs(sc->scrollx) > 100)
-			sc->scrollx = 0;
-		if (abs(sc->scrolly) > 100)
-			sc->scrolly = 0;
-		if (sc->scrolly > 8)
-			sc->scrolly = sc->scrolly / 8;
-		else if (sc->scrolly > 5)
-			sc->scrolly = 1;
-		else if (sc->scrolly < -8)
-			sc->scrolly = sc->scrolly / 8;
-		else if (sc->scrolly < -5)
-			sc->scrolly = -1;
-		else
-			sc->scrolly = 0;
 
-		if (sc->scrollx > 8) {
-			sc->scrollx = sc->scrollx / 8;
-			sc->scrollx = -sc->scrollx;
-		}
-		else if (sc->scrollx > 5)
-			sc->scrollx = -1;
-		else if (sc->scrollx < -8) {
-			sc->scrollx = sc->scrollx / 8;
-			sc->scrollx = -sc->scrollx;
+		if (!sc->scrollingActive) {
+			//the axis with more travel wins and keeps the scroll until it ends
+			if (travely > travelx)
+				sc->scrollAxis = GESTURE_SCROLL_AXIS_Y;
+			else
+				sc->scrollAxis = GESTURE_SCROLL_AXIS_X;
+			sc->scrollRemainderX = 0;
+			sc->scrollRemainderY = 0;
 		}
-		else if (sc->scrollx < -5)
-			sc->scrollx = 1;
-		else
-			sc->scrollx = 0;*/
 
-		int scrollx = 0;
-		int scrolly = 0;
-
-		if ((abs(delta_y1) + abs(delta_y2)) > (abs(delta_x1) + abs(delta_x2))) {
-			int avgy = (delta_y1 + delta_y2) / 2;
-			scrolly = avgy;
-		}
-		else {
-			int avgx = (delta_x1 + delta_x2) / 2;
-			scrollx = avgx;
-		}
+		int delta = 0;
+		if (moving)
+			delta = (sc->scrollAxis == GESTURE_SCROLL_AXIS_Y ? sumy : sumx) / moving;
 
-		if (abs(scrollx) < 5 && abs(scrolly) < 5 && !sc->scrollingActive)
+		if (abs(normalize_delta(sc, delta)) < 5 && !sc->scrollingActive)
 			return false;
 
-		_SYNA_SCROLL_REPORT report;
-		report.ReportID = REPORTID_SCROLL;
-		report.Flag = 0;
-		report.Touch1XValue = filterNegative(sc->x[i1]);
-		report.Touch1YValue = filterNegative(sc->y[i1]);
-		report.Touch2XValue = filterNegative(sc->x[i2]);
-		report.Touch2YValue = filterNegative(sc->y[i2]);
-
-		size_t bytesWritten;
-		SynaProcessVendorReport(pDevice, &report, sizeof(report), &bytesWritten);
+		scroll_emit(sc, delta * GESTURE_SCROLL_UNITS * scroll_gain(normalize_delta(sc, delta)));
 
 		int fngrcount = 0;
-		int totfingers = 0;
-		for (int i = 0; i < MAX_FINGERS; i++) {
-			if (sc->x[i] != -1) {
-				totfingers++;
-				if (i == i1 || i == i2)
-					fngrcount++;
-			}
+		for (uint32_t m = sc->active; m;) {
+			int i = next_contact(&m);
+			if (i == i1 || i == i2)
+				fngrcount++;
 		}
 
-		if (fngrcount == 2)
-			sc->ticksSinceScrolling = 0;
-		else
-			sc->ticksSinceScrolling++;
-		if (fngrcount == 2 || sc->ticksSinceScrolling <= 5) {
+		if (fngrcount == 2) {
+			sc->lastscrolltime = sc->timestamp;
+			if (sc->scrollAxis == GESTURE_SCROLL_AXIS_Y)
+				sc->scrollSpeed = (sc->history[i1].vy + sc->history[i2].vy) / 2;
+			else
+				sc->scrollSpeed = (sc->history[i1].vx + sc->history[i2].vx) / 2;
+		}
+		if (!sc->active) {
+			//every finger is off, coast from here rather than after the linger
+			sc->scrollingActive = false;
+			sc->idsForScrolling[0] = -1;
+			sc->idsForScrolling[1] = -1;
+			StartInertia(sc);
+		}
+		else if (fngrcount == 2 || sc->timestamp - sc->lastscrolltime <= GESTURE_SCROLL_LINGER_US) {
 			sc->scrollingActive = true;
 			if (abovethreshold == 2){
 				sc->idsForScrolling[0] = iToUse[0];
@@ -622,6 +1087,7 @@ bool ProcessScroll(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int abovethresh
 			sc->scrollingActive = false;
 			sc->idsForScrolling[0] = -1;
 			sc->idsForScrolling[1] = -1;
+			sc->scrollSpeed = 0;
 		}
 		return true;
 	}
@@ -635,28 +1101,28 @@ bool ProcessThreeFingerSwipe(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int a
 		update_keyboard(pDevice, shiftKeys, keyCodes);
 	}
 	if (abovethreshold == 3 || abovethreshold == 4) {
-		stop_scroll(pDevice);
-
 		int i1 = iToUse[0];
-		int delta_x1 = sc->x[i1] - sc->lastx[i1];
-		int delta_y1 = sc->y[i1] - sc->lasty[i1];
+		int delta_x1 = sc->contact[i1].x - sc->contact[i1].lastx;
+		int delta_y1 = sc->contact[i1].y - sc->contact[i1].lasty;
 
 		int i2 = iToUse[1];
-		int delta_x2 = sc->x[i2] - sc->lastx[i2];
-		int delta_y2 = sc->y[i2] - sc->lasty[i2];
+		int delta_x2 = sc->contact[i2].x - sc->contact[i2].lastx;
+		int delta_y2 = sc->contact[i2].y - sc->contact[i2].lasty;
 
 		int i3 = iToUse[2];
-		int delta_x3 = sc->x[i3] - sc->lastx[i3];
-		int delta_y3 = sc->y[i3] - sc->lasty[i3];
+		int delta_x3 = sc->contact[i3].x - sc->contact[i3].lastx;
+		int delta_y3 = sc->contact[i3].y - sc->contact[i3].lasty;
 
 		int avgx = (delta_x1 + delta_x2 + delta_x3) / 3;
 		int avgy = (delta_y1 + delta_y2 + delta_y3) / 3;
 
 		sc->multitaskingx += avgx;
 		sc->multitaskingy += avgy;
-		sc->multitaskinggesturetick++;
+		if (sc->multitaskingstart == 0)
+			sc->multitaskingstart = sc->timestamp;
+		uint64_t swipetime = sc->timestamp - sc->multitaskingstart;
 
-		if (sc->multitaskinggesturetick > 5 && !sc->multitaskingdone) {
+		if (swipetime >= GESTURE_SWIPE_DELAY_US && !sc->multitaskingdone) {
 			if ((abs(delta_y1) + abs(delta_y2) + abs(delta_y3)) > (abs(delta_x1) + abs(delta_x2) + abs(delta_x3))) {
 				if (abs(sc->multitaskingy) > 15) {
 					if (sc->multitaskingy < 0) {
@@ -830,10 +1296,10 @@ bool ProcessThreeFingerSwipe(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int a
 				}
 			}
 		}
-		else if (sc->multitaskinggesturetick > 25) {
+		else if (swipetime >= GESTURE_SWIPE_RESET_US) {
 			sc->multitaskingx = 0;
 			sc->multitaskingy = 0;
-			sc->multitaskinggesturetick = 0;
+			sc->multitaskingstart = 0;
 			sc->multitaskingdone = false;
 		}
 		return true;
@@ -841,10 +1307,10 @@ bool ProcessThreeFingerSwipe(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int a
 	else {
 		if (sc->alttabswitchershowing) {
 			bool foundTouch = false;
-			for (int i = 0; i < MAX_FINGERS; i++) {
+			for (int i = 0; i < sc->maxcontacts; i++) {
 				if (foundTouch)
 					break;
-				if (sc->x[i] == -1)
+				if (sc->contact[i].x == -1)
 					continue;
 				for (int j = 0; j < 3; j++) {
 					if (i = sc->idsforalttab[j]) {
@@ -866,7 +1332,7 @@ bool ProcessThreeFingerSwipe(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int a
 		}
 		sc->multitaskingx = 0;
 		sc->multitaskingy = 0;
-		sc->multitaskinggesturetick = 0;
+		sc->multitaskingstart = 0;
 		sc->multitaskingdone = false;
 		return false;
 	}
@@ -875,9 +1341,8 @@ bool ProcessThreeFingerSwipe(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int a
 void TapToClickOrDrag(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int button) {
 	if (!sc->settings.tapToClickEnabled)
 		return;
-	sc->tickssinceclick++;
 	if (sc->mouseDownDueToTap && sc->idForMouseDown == -1) {
-		if (sc->tickssinceclick > 10) {
+		if (sc->timestamp - sc->clicktime > GESTURE_TAP_DRAG_US) {
 			sc->mouseDownDueToTap = false;
 			sc->mousedown = false;
 			sc->buttonmask = 0;
@@ -886,12 +1351,17 @@ void TapToClickOrDrag(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int button)
 		return;
 	}
 	if (sc->mousedown) {
-		sc->tickssinceclick = 0;
+		sc->clicktime = sc->timestamp;
 		return;
 	}
 
-	for (int i = 0; i < MAX_FINGERS; i++) {
-		if (sc->truetick[i] < 10 && sc->truetick[i] > 0)
+	//a tap happens when a finger lifts, fingers still down only add to it
+	if (button == 0)
+		return;
+
+	for (uint32_t m = sc->active; m;) {
+		int i = next_contact(&m);
+		if (sc->contact[i].touchdown != 0 && contact_age(sc, i) < GESTURE_TAP_US)
 			button++;
 	}
 
@@ -900,10 +1370,9 @@ void TapToClickOrDrag(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int button)
 
 	int buttonmask = 0;
 
-	if (sc->scrollInertiaActive) {
-		stop_scroll(pDevice);
+	//a tap that caught a coasting scroll only stops it
+	if (sc->inertiaCaught)
 		return;
-	}
 
 	switch (button) {
 	case 1:
@@ -951,19 +1420,19 @@ void TapToClickOrDrag(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int button)
 		}
 		break;
 	}
-	if (buttonmask != 0 && sc->tickssinceclick > 10 && sc->ticksincelastrelease == 0) {
+	if (buttonmask != 0 && sc->timestamp - sc->clicktime > GESTURE_TAP_DRAG_US && sc->lastreleasetime == sc->timestamp) {
 		sc->idForMouseDown = -1;
 		sc->mouseDownDueToTap = true;
 		sc->buttonmask = buttonmask;
 		sc->mousebutton = button;
 		sc->mousedown = true;
-		sc->tickssinceclick = 0;
+		sc->clicktime = sc->timestamp;
 	}
 }
 
 void ClearTapDrag(PDEVICE_CONTEXT pDevice, csgesture_softc *sc, int i) {
 	if (i == sc->idForMouseDown && sc->mouseDownDueToTap == true) {
-		if (sc->tick[i] < 10) {
+		if (contact_age(sc, i) < GESTURE_TAP_US) {
 			//Double Tap
 			update_relative_mouse(pDevice, 0, 0, 0, 0, 0);
 			update_relative_mouse(pDevice, sc->buttonmask, 0, 0, 0, 0);
@@ -980,10 +1449,12 @@ void ProcessGesture(PDEVICE_CONTEXT pDevice, csgesture_softc *sc) {
 #pragma mark reset inputs
 	sc->dx = 0;
 	sc->dy = 0;
+	sc->scrollx = 0;
+	sc->scrolly = 0;
 
 #pragma mark process touch thresholds
-	int avgx[MAX_FINGERS];
-	int avgy[MAX_FINGERS];
+	int avgx[GESTURE_MAX_CONTACTS];
+	int avgy[GESTURE_MAX_CONTACTS];
 
 	int abovethreshold = 0;
 	int recentlyadded = 0;
@@ -991,27 +1462,28 @@ void ProcessGesture(PDEVICE_CONTEXT pDevice, csgesture_softc *sc) {
 	int iToUse[3] = { -1,-1,-1 };
 	int a = 0;
 
-	int nfingers = 0;
-	for (int i = 0;i < MAX_FINGERS;i++) {
-		if (sc->x[i] != -1)
-			nfingers++;
-	}
+	int nfingers = contact_count(sc->active);
+
+	//contacts lifted this frame still count until the shift below
+	uint32_t touched = sc->active | sc->released;
 
-	for (int i = 0;i < MAX_FINGERS;i++) {
-		if (sc->truetick[i] < 30 && sc->truetick[i] != 0) {
+	for (uint32_t m = touched; m;) {
+		int i = next_contact(&m);
+		if (sc->contact[i].touchdown != 0 && contact_age(sc, i) < GESTURE_RECENT_US) {
 			recentlyadded++;
 			lastrecentlyadded = i;
 		}
-		if (sc->tick[i] == 0)
+		if (sc->contact[i].tick == 0)
 			continue;
-		if (sc->blacklistedids[i] == 1)
+		if (sc->contact[i].blacklisted == 1)
 			continue;
-		avgx[i] = sc->flextotalx[i] / sc->tick[i];
-		avgy[i] = sc->flextotaly[i] / sc->tick[i];
+		avgx[i] = sc->contact[i].flextotalx / sc->contact[i].tick;
+		avgy[i] = sc->contact[i].flextotaly / sc->contact[i].tick;
 		if (distancesq(avgx[i], avgy[i]) > 2) {
 			abovethreshold++;
-			iToUse[a] = i;
-			a++;
+			//the gestures only ever follow the first three
+			if (a < 3)
+				iToUse[a++] = i;
 		}
 	}
 
@@ -1019,6 +1491,8 @@ void ProcessGesture(PDEVICE_CONTEXT pDevice, csgesture_softc *sc) {
 	bool handled = false;
 	bool handledByScroll = false;
 
+	if (!handled)
+		handledByScroll = handled = ProcessInertia(pDevice, sc);
 	if (!handled)
 		handled = ProcessThreeFingerSwipe(pDevice, sc, abovethreshold, iToUse);
 	if (!handled)
@@ -1033,7 +1507,7 @@ void ProcessGesture(PDEVICE_CONTEXT pDevice, csgesture_softc *sc) {
 
 	if (sc->settings.rightClickBottomRight) {
 		if (sc->mousebutton == 1 && lastrecentlyadded != -1) {
-			if (sc->x[lastrecentlyadded] > sc->resx / 2 && sc->y[lastrecentlyadded] > (sc->resy - 60))
+			if (sc->contact[lastrecentlyadded].x > sc->resx / 2 && sc->contact[lastrecentlyadded].y > (sc->resy - 60))
 				sc->mousebutton = 2;
 		}
 	}
@@ -1055,7 +1529,7 @@ void ProcessGesture(PDEVICE_CONTEXT pDevice, csgesture_softc *sc) {
 	if (!sc->mouseDownDueToTap) {
 		if (sc->buttondown && !sc->mousedown) {
 			sc->mousedown = true;
-			sc->tickssinceclick = 0;
+			sc->clicktime = sc->timestamp;
 
 			switch (sc->mousebutton) {
 			case 1:
@@ -1089,203 +1563,259 @@ void ProcessGesture(PDEVICE_CONTEXT pDevice, csgesture_softc *sc) {
 
 #pragma mark shift to last
 	int releasedfingers = 0;
-
-	for (int i = 0;i < MAX_FINGERS;i++) {
-		if (sc->x[i] != -1) {
-			if (sc->lastx[i] == -1) {
-				if (sc->ticksincelastrelease < 10 && sc->mouseDownDueToTap && sc->idForMouseDown == -1) {
+	//an idle step has no new positions, a zero sample would slow the history down
+	bool newframe = sc->timestamp == sc->lastframetime;
+
+	for (uint32_t m = touched; m;) {
+		int i = next_contact(&m);
+		if (sc->contact[i].x != -1 && newframe) {
+			if (sc->added & (1 << i)) {
+				if (sc->timestamp - sc->lastreleasetime < GESTURE_TAP_DRAG_US && sc->mouseDownDueToTap && sc->idForMouseDown == -1) {
 					if (sc->settings.tapDragEnabled)
 						sc->idForMouseDown = i; //Associate Tap Drag
 				}
 			}
-			sc->truetick[i]++;
-			if (sc->tick[i] < 10) {
-				if (sc->lastx[i] != -1) {
-					sc->totalx[i] += abs(sc->x[i] - sc->lastx[i]);
-					sc->totaly[i] += abs(sc->y[i] - sc->lasty[i]);
-					sc->totalp[i] += sc->p[i];
-
-					sc->flextotalx[i] = sc->totalx[i];
-					sc->flextotaly[i] = sc->totaly[i];
-
-					int j = sc->tick[i];
-					sc->xhistory[i][j] = abs(sc->x[i] - sc->lastx[i]);
-					sc->yhistory[i][j] = abs(sc->y[i] - sc->lasty[i]);
-				}
-				sc->tick[i]++;
-			}
-			else if (sc->lastx[i] != -1) {
-				int absx = abs(sc->x[i] - sc->lastx[i]);
-				int absy = abs(sc->y[i] - sc->lasty[i]);
+			if (sc->contact[i].touchdown == 0)
+				sc->contact[i].touchdown = sc->timestamp;
+			if (sc->contact[i].tick < GESTURE_HISTORY) {
+				if (sc->contact[i].lastx != -1) {
+					int dx = normalize_delta(sc, sc->contact[i].x - sc->contact[i].lastx);
+					int dy = normalize_delta(sc, sc->contact[i].y - sc->contact[i].lasty);
 
-				int newtotalx = sc->flextotalx[i] - sc->xhistory[i][0] + absx;
-				int newtotaly = sc->flextotaly[i] - sc->yhistory[i][0] + absy;
+					sc->history[i].totalx += abs(dx);
+					sc->history[i].totaly += abs(dy);
+					sc->history[i].totalp += sc->contact[i].p;
 
-				sc->totalx[i] += absx;
-				sc->totaly[i] += absy;
+					sc->contact[i].flextotalx = sc->history[i].totalx;
+					sc->contact[i].flextotaly = sc->history[i].totaly;
 
-				sc->flextotalx[i] -= sc->xhistory[i][0];
-				sc->flextotaly[i] -= sc->yhistory[i][0];
-				for (int j = 1;j < 10;j++) {
-					sc->xhistory[i][j - 1] = sc->xhistory[i][j];
-					sc->yhistory[i][j - 1] = sc->yhistory[i][j];
+					history_push(&sc->history[i], sc->contact[i].tick, dx, dy);
 				}
-				sc->flextotalx[i] += absx;
-				sc->flextotaly[i] += absy;
-
-				int j = 9;
-				sc->xhistory[i][j] = absx;
-				sc->yhistory[i][j] = absy;
+				sc->contact[i].tick++;
+			}
+			else if (sc->contact[i].lastx != -1) {
+				int dx = normalize_delta(sc, sc->contact[i].x - sc->contact[i].lastx);
+				int dy = normalize_delta(sc, sc->contact[i].y - sc->contact[i].lasty);
+				struct csgesture_history *history = &sc->history[i];
+
+				sc->history[i].totalx += abs(dx);
+				sc->history[i].totaly += abs(dy);
+
+				//window is full, the oldest sample makes room for this one
+				sc->contact[i].flextotalx += abs(dx) - abs(history->x[history->head]);
+				sc->contact[i].flextotaly += abs(dy) - abs(history->y[history->head]);
+				history_push(history, history->head, dx, dy);
+				if (++history->head == GESTURE_HISTORY)
+					history->head = 0;
 			}
+			history_update_velocity(&sc->history[i]);
 		}
-		if (sc->x[i] == -1) {
+		if (sc->contact[i].x == -1) {
 			ClearTapDrag(pDevice, sc, i);
-			if (sc->lastx[i] != -1)
-				sc->ticksincelastrelease = -1;
-			for (int j = 0;j < 10;j++) {
-				sc->xhistory[i][j] = 0;
-				sc->yhistory[i][j] = 0;
+			if (sc->contact[i].lastx != -1)
+				sc->lastreleasetime = sc->timestamp;
+			for (int j = 0;j < GESTURE_HISTORY;j++) {
+				sc->history[i].x[j] = 0;
+				sc->history[i].y[j] = 0;
 			}
-			if (sc->tick[i] < 10 && sc->tick[i] != 0) {
-				int avgp = sc->totalp[i] / sc->tick[i];
+			sc->history[i].head = 0;
+			sc->history[i].samples = 0;
+			sc->history[i].sumx = 0;
+			sc->history[i].sumy = 0;
+			sc->history[i].vx = 0;
+			sc->history[i].vy = 0;
+			sc->history[i].ax = 0;
+			sc->history[i].ay = 0;
+			if (sc->contact[i].tick != 0 && contact_age(sc, i) < GESTURE_TAP_US) {
+				int avgp = sc->history[i].totalp / sc->contact[i].tick;
 				if (avgp > 7)
 					releasedfingers++;
 			}
-			sc->totalx[i] = 0;
-			sc->totaly[i] = 0;
-			sc->totalp[i] = 0;
-			sc->tick[i] = 0;
-			sc->truetick[i] = 0;
+			sc->history[i].totalx = 0;
+			sc->history[i].totaly = 0;
+			sc->history[i].totalp = 0;
+			sc->contact[i].tick = 0;
+			sc->contact[i].touchdown = 0;
 
-			sc->blacklistedids[i] = 0;
+			sc->contact[i].blacklisted = 0;
 
 			if (sc->idForPanning == i) {
 				sc->panningActive = false;
 				sc->idForPanning = -1;
 			}
 		}
-		sc->lastx[i] = sc->x[i];
-		sc->lasty[i] = sc->y[i];
-		sc->lastp[i] = sc->p[i];
+		sc->contact[i].lastx = sc->contact[i].x;
+		sc->contact[i].lasty = sc->contact[i].y;
+		sc->contact[i].lastp = sc->contact[i].p;
 	}
-	sc->ticksincelastrelease++;
 
 #pragma mark process tap to click
 	if (!handledByScroll)
 		TapToClickOrDrag(pDevice, sc, releasedfingers);
+	if (!sc->active)
+		sc->inertiaCaught = false;
 
 #pragma mark send to system
 	update_relative_mouse(pDevice, sc->buttonmask, sc->dx, sc->dy, sc->scrolly, sc->scrollx);
 }
 
 static void rmi_f11_process_touch(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, int slot,
-	uint8_t finger_state, uint8_t *touch_data)
+	struct f11_fingers *fingers)
 {
-	int x, y, wx, wy;
-	int wide, major, minor;
-	int z;
-
-	if (finger_state == 0x01) {
-		x = (touch_data[0] << 4) | (touch_data[2] & 0x0F);
-		y = (touch_data[1] << 4) | (touch_data[2] >> 4);
-		wx = touch_data[3] & 0x0F;
-		wy = touch_data[3] >> 4;
-		wide = (wx > wy);
-		major = max(wx, wy);
-		minor = min(wx, wy);
-		z = touch_data[4];
-
-		y = pDevice->max_y - y;
-
-		x *= sc->resx;
-		x /= pDevice->max_x;
-
-		y *= sc->resy;
-		y /= pDevice->max_y;
-
-		sc->x[slot] = x;
-		sc->y[slot] = y;
-		sc->p[slot] = z;
-		/* y is inverted */
-		//y = hdata->max_y - y;
-		//printf("Touch %d: X: %d Y: %d Z: %d\n", slot, x, y, z);
+	int x = fingers->x[slot];
+	int y = fingers->y[slot];
+
+	/* clamp so the folded Y inversion cannot go negative */
+	y = min(y, (int)pDevice->max_y);
+	x = (int)(((uint64_t)x * pDevice->x_scale) >> 32);
+	y = (int)((pDevice->y_offset - (uint64_t)y * pDevice->y_scale) >> 32);
+
+	sc->contact[slot].x = (int16_t)x;
+	sc->contact[slot].y = (int16_t)y;
+	sc->contact[slot].p = fingers->z[slot];
+	//printf("Touch %d: X: %d Y: %d Z: %d\n", slot, x, y, fingers->z[slot]);
+}
+
+//slots that were lifted go back to -1, everything else already is
+static void rmi_f11_update_contacts(struct csgesture_softc *sc, uint32_t active) {
+	sc->added = (uint16_t)(active & ~sc->active);
+	sc->released = (uint16_t)(sc->active & ~active);
+	sc->active = (uint16_t)active;
+
+	for (uint32_t m = sc->released; m;) {
+		int slot = next_contact(&m);
+		sc->contact[slot].x = -1;
+		sc->contact[slot].y = -1;
+		sc->contact[slot].p = -1;
 	}
 }
 
-int rmi_f11_input(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t *rmiInput) {
+static void rmi_f11_input(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t *rmiInput, int size) {
 	//begin rmi parse
-	int offset;
-	int i;
-
-	int max_fingers = pDevice->max_fingers;
-
-	offset = (max_fingers >> 2) + 1;
-	for (i = 0; i < max_fingers; i++) {
-		int fs_byte_position = i >> 2;
-		int fs_bit_position = (i & 0x3) << 1;
-		int finger_state = (rmiInput[fs_byte_position] >> fs_bit_position) &
-			0x03;
-		int position = offset + 5 * i;
-		rmi_f11_process_touch(pDevice, sc, i, finger_state, &rmiInput[position]);
-	}
-	return pDevice->f11.report_size;
+	struct f11_fingers fingers;
+
+	f11_decode(rmiInput, pDevice->max_fingers, size, pDevice->f11_simd, &fingers);
+	for (uint32_t m = fingers.mask; m;)
+		rmi_f11_process_touch(pDevice, sc, next_contact(&m), &fingers);
+	rmi_f11_update_contacts(sc, fingers.mask);
 }
 
-static int rmi_f30_input(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t irq, uint8_t *rmiInput, int size)
+static void rmi_f30_input(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t *rmiInput, int length)
 {
-	int i;
-	int button = 0;
-	bool value;
+	struct rmi_decode_plan *plan = &pDevice->decode_plan;
+	uint32_t gpio = 0;
 
-	if (!(irq & pDevice->f30.irq_mask))
-		return 0;
+	for (int i = 0; i < length && i < (int)sizeof(gpio); i++)
+		gpio |= (uint32_t)rmiInput[i] << (i * 8);
 
-	if (size < (int)pDevice->f30.report_size) {
-		SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP, "Click Button pressed, but the click data is missing\n");
-		return 0;
+	if (plan->button_mask)
+		sc->buttondown = ((gpio ^ plan->button_invert) & plan->button_mask) != 0;
+}
+
+static int TrackpadClampInterval(uint64_t interval) {
+	if (interval < GESTURE_MIN_FRAME_US)
+		interval = GESTURE_MIN_FRAME_US;
+	else if (interval > GESTURE_MAX_FRAME_US)
+		interval = GESTURE_MAX_FRAME_US;
+	return (int)interval;
+}
+
+//
+// Deltas span the time since the last frame, an idle step in between
+// must not shorten it or the next frame's motion looks that much faster
+//
+static void TrackpadSetTime(struct csgesture_softc *sc, uint64_t timestamp, bool frame) {
+	sc->lasttimestamp = sc->timestamp;
+	sc->timestamp = timestamp;
+	sc->stepinterval = TrackpadClampInterval(timestamp - sc->lasttimestamp);
+
+	if (frame) {
+		sc->frameinterval = TrackpadClampInterval(timestamp - sc->lastframetime);
+		sc->lastframetime = timestamp;
 	}
+}
 
-	for (i = 0; i < pDevice->gpio_led_count; i++) {
-		if (i == 0)
-			continue;
-		if (test_bit(i, &pDevice->button_mask)) {
-			value = (rmiInput[i / 8] >> (i & 0x07)) & BIT(0);
-			if (test_bit(i, &pDevice->button_state_mask))
-				value = !value;
-			sc->buttondown = value;
-		}
+//the host took the touchpad collection, it gets the contacts and does the gestures itself
+static bool SynaPtpActive(PDEVICE_CONTEXT pDevice) {
+	return pDevice->PtpEnabled && pDevice->PtpInputMode == PTP_INPUT_MODE_TOUCHPAD;
+}
+
+static void SynaSendPtpReport(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc) {
+	struct ptp_report report;
+	size_t bytesWritten;
+	uint32_t released;
+	NTSTATUS status;
+
+	for (uint32_t m = sc->active; m;) {
+		int slot = next_contact(&m);
+		ptp_contact_set(&pDevice->PtpState, slot, sc->contact[slot].x, sc->contact[slot].y);
+	}
+
+	//a lift the host never saw would leave the contact down for it
+	released = (sc->released | pDevice->PtpUnsentReleased) & ~sc->active;
+
+	ptp_build_report(&pDevice->PtpState, sc->active, released, sc->buttondown,
+		sc->timestamp, pDevice->PtpSwitches, &report);
+	status = SynaProcessVendorReport(pDevice, &report, sizeof(report), &bytesWritten);
+	if (!NT_SUCCESS(status)) {
+		SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP, "Touchpad report not taken: %x\n", status);
+		pDevice->PtpUnsentReleased = released;
+		return;
 	}
-	return pDevice->f30.report_size;
+	pDevice->PtpUnsentReleased = 0;
 }
 
-void TrackpadRawInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t report[40], int tickinc) {
+void TrackpadRawInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t *report, int reportSize, uint64_t timestamp) {
 	if (report[0] != RMI_ATTN_REPORT_ID)
 		return;
 
-	int nfingers = 0;
+	TrackpadSetTime(sc, timestamp, true);
 
-	for (int i = 0;i < 5; i++) {
-		sc->x[i] = -1;
-		sc->y[i] = -1;
-		sc->p[i] = -1;
-	}
-	
-	int index = 2;
+	struct rmi_decode_plan *plan = &pDevice->decode_plan;
+	uint8_t irq = report[1];
+	int index = RMI_ATTN_HEADER_SIZE;
+
+	//a frame without F11 data leaves the contacts where they were
+	sc->added = 0;
+	sc->released = 0;
+
+	for (unsigned int i = 0; i < plan->count; i++) {
+		struct rmi_decode_segment *seg = &plan->segment[i];
+
+		if (!(irq & seg->irq_mask))
+			continue;
 
-	int reportSize = 40;
+		if (index + seg->length > reportSize) {
+			SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP, "ATTN report too short for segment %d\n", i);
+			break;
+		}
 
-	if (pDevice->f11.interrupt_base < pDevice->f30.interrupt_base) {
-		index += rmi_f11_input(pDevice, sc, &report[index]);
-		index += rmi_f30_input(pDevice, sc, report[1], &report[index], reportSize - index);
+		if (seg->type == RMI_SEGMENT_F11)
+			rmi_f11_input(pDevice, sc, &report[index], reportSize - index);
+		else
+			rmi_f30_input(pDevice, sc, &report[index], seg->length);
+		index += seg->length;
 	}
-	else {
-		index += rmi_f30_input(pDevice, sc, report[1], &report[index], reportSize - index);
-		index += rmi_f11_input(pDevice, sc, &report[index]);
+
+	if (SynaPtpActive(pDevice)) {
+		SynaSendPtpReport(pDevice, sc);
+		return;
 	}
 
 	ProcessGesture(pDevice, sc);
 }
 
+//run the gesture engine without a new frame, the decoded contacts are still current
+void TrackpadIdleInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint64_t timestamp) {
+	if (SynaPtpActive(pDevice))
+		return;
+
+	TrackpadSetTime(sc, timestamp, false);
+	sc->added = 0;
+	sc->released = 0;
+	ProcessGesture(pDevice, sc);
+}
+
 void SetDefaultSettings(struct csgesture_softc *sc) {
 	sc->settings.pointerMultiplier = 10; //done
 
@@ -1318,6 +1848,69 @@ void SetDefaultSettings(struct csgesture_softc *sc) {
 	sc->settings.fourFingerSwipeLeftRightGesture = SwipeGestureSwitchWorkspace;
 }
 
+//forget every contact and gesture in progress, settings and hardware info stay
+void ResetGestureState(struct csgesture_softc *sc) {
+	for (int i = 0; i < GESTURE_MAX_CONTACTS; i++) {
+		RtlZeroMemory(&sc->contact[i], sizeof(sc->contact[i]));
+		sc->contact[i].x = -1;
+		sc->contact[i].y = -1;
+		sc->contact[i].p = -1;
+		sc->contact[i].lastx = -1;
+		sc->contact[i].lasty = -1;
+		sc->contact[i].lastp = -1;
+	}
+	RtlZeroMemory(sc->history, sizeof(sc->history));
+
+	sc->active = 0;
+	sc->added = 0;
+	sc->released = 0;
+	sc->buttondown = false;
+
+	sc->dx = 0;
+	sc->dy = 0;
+	sc->scrollx = 0;
+	sc->scrolly = 0;
+	sc->buttonmask = 0;
+
+	sc->panningActive = 0;
+	sc->idForPanning = -1;
+
+	sc->scrollingActive = 0;
+	sc->idsForScrolling[0] = -1;
+	sc->idsForScrolling[1] = -1;
+	sc->lastscrolltime = 0;
+	sc->scrollRemainderX = 0;
+	sc->scrollRemainderY = 0;
+	sc->scrollSpeed = 0;
+
+	//a scroll coasting when the pad powered down does not pick up again
+	sc->scrollInertiaActive = 0;
+	sc->inertiaVelocity = 0;
+	sc->inertiaCaught = false;
+
+	sc->mouseDownDueToTap = false;
+	sc->idForMouseDown = -1;
+	sc->mousedown = false;
+	sc->mousebutton = 0;
+
+	sc->multitaskingx = 0;
+	sc->multitaskingy = 0;
+	sc->multitaskingstart = 0;
+	sc->multitaskingdone = false;
+
+	sc->alttabswitchershowing = false;
+	for (int i = 0; i < 3; i++)
+		sc->idsforalttab[i] = -1;
+
+	sc->timestamp = 0;
+	sc->lasttimestamp = 0;
+	sc->lastframetime = 0;
+	sc->frameinterval = GESTURE_TICK_US;
+	sc->stepinterval = GESTURE_TICK_US;
+	sc->lastreleasetime = 0;
+	sc->clicktime = 0;
+}
+
 void ProcessInfo(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, int infoValue) {
 	_SYNA_INFO_REPORT report;
 	report.ReportID = REPORTID_SETTINGS;
@@ -0,0 +1,118 @@
+#if !defined(_F11DECODE_H_)
+#define _F11DECODE_H_
+
+#include "stdint.h"
+
+//
+// Unpacks the F11 2D finger data of a frame into per-field arrays.
+// Each finger has a 2-bit state in the status bytes and a 5-byte block:
+// X[11:4], Y[11:4], Y[3:0]X[3:0], Wy/Wx nibbles and Z.
+//
+
+#define F11_DECODE_FINGERS	10
+#define F11_DECODE_SLOTS	16	/* room for the vector stores to spill over */
+
+#if defined(_M_AMD64) || defined(_M_X64)
+#define F11_DECODE_SSE	1	/* XMM use is free in x64 kernel code, unlike AVX */
+#include <tmmintrin.h>
+#endif
+
+struct f11_fingers {
+	uint16_t x[F11_DECODE_SLOTS];
+	uint16_t y[F11_DECODE_SLOTS];
+	uint8_t z[F11_DECODE_SLOTS];
+	uint8_t wx[F11_DECODE_SLOTS];
+	uint8_t wy[F11_DECODE_SLOTS];
+	uint32_t mask;			/* fingers whose state is 1 (present) */
+};
+
+/* the status bytes come first, the blocks start after them */
+static inline int f11_data_offset(int fingers)
+{
+	return (fingers >> 2) + 1;
+}
+
+static inline uint32_t f11_decode_mask(const uint8_t *data, int fingers)
+{
+	uint32_t mask = 0;
+
+	for (int i = 0; i < fingers; i++) {
+		int state = (data[i >> 2] >> ((i & 0x3) << 1)) & 0x03;
+
+		if (state == 0x01)
+			mask |= 1 << i;
+	}
+	return mask;
+}
+
+static inline void f11_decode_block(const uint8_t *block, struct f11_fingers *out, int i)
+{
+	out->x[i] = (block[0] << 4) | (block[2] & 0x0F);
+	out->y[i] = (block[1] << 4) | (block[2] >> 4);
+	out->wx[i] = block[3] & 0x0F;
+	out->wy[i] = block[3] >> 4;
+	out->z[i] = block[4];
+}
+
+static inline void f11_decode_scalar(const uint8_t *data, int fingers, struct f11_fingers *out)
+{
+	const uint8_t *block = data + f11_data_offset(fingers);
+
+	for (int i = 0; i < fingers; i++, block += 5)
+		f11_decode_block(block, out, i);
+	out->mask = f11_decode_mask(data, fingers);
+}
+
+#ifdef F11_DECODE_SSE
+/*
+ * Three 5-byte blocks fit one 16-byte load; a shuffle gathers each field
+ * of the three fingers into its own lanes. Only groups whose load stays
+ * inside size bytes are vectorized, the rest go through the scalar path.
+ * Needs SSSE3 for the byte shuffle.
+ */
+static inline void f11_decode_sse(const uint8_t *data, int fingers, int size, struct f11_fingers *out)
+{
+	const int offset = f11_data_offset(fingers);
+	const __m128i hi_x = _mm_setr_epi8(0, -1, 5, -1, 10, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i hi_y = _mm_setr_epi8(1, -1, 6, -1, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i lo_xy = _mm_setr_epi8(2, -1, 7, -1, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i w = _mm_setr_epi8(3, 8, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i z = _mm_setr_epi8(4, 9, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+	const __m128i nibble16 = _mm_set1_epi16(0x0F);
+	const __m128i nibble8 = _mm_set1_epi8(0x0F);
+	int i = 0;
+
+	for (; i + 3 <= fingers && offset + 5 * i + 16 <= size; i += 3) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(data + offset + 5 * i));
+		__m128i lo = _mm_shuffle_epi8(v, lo_xy);
+		__m128i x = _mm_or_si128(_mm_slli_epi16(_mm_shuffle_epi8(v, hi_x), 4),
+			_mm_and_si128(lo, nibble16));
+		__m128i y = _mm_or_si128(_mm_slli_epi16(_mm_shuffle_epi8(v, hi_y), 4),
+			_mm_srli_epi16(lo, 4));
+		__m128i wxy = _mm_shuffle_epi8(v, w);
+
+		_mm_storel_epi64((__m128i *)&out->x[i], x);
+		_mm_storel_epi64((__m128i *)&out->y[i], y);
+		*(int *)&out->z[i] = _mm_cvtsi128_si32(_mm_shuffle_epi8(v, z));
+		*(int *)&out->wx[i] = _mm_cvtsi128_si32(_mm_and_si128(wxy, nibble8));
+		*(int *)&out->wy[i] = _mm_cvtsi128_si32(_mm_and_si128(_mm_srli_epi16(wxy, 4), nibble8));
+	}
+
+	for (; i < fingers; i++)
+		f11_decode_block(data + offset + 5 * i, out, i);
+	out->mask = f11_decode_mask(data, fingers);
+}
+#endif
+
+static inline void f11_decode(const uint8_t *data, int fingers, int size, bool simd, struct f11_fingers *out)
+{
+#ifdef F11_DECODE_SSE
+	if (simd) {
+		f11_decode_sse(data, fingers, size, out);
+		return;
+	}
+#endif
+	f11_decode_scalar(data, fingers, out);
+}
+
+#endif
@@ -0,0 +1,134 @@
+#if !defined(_FRAMERING_H_)
+#define _FRAMERING_H_
+
+#include "stdint.h"
+
+//
+// Fixed-capacity single-producer/single-consumer ring of ATTN frames.
+// The ISR is the only producer and the gesture consumer the only reader,
+// so each index has exactly one writer and no lock is needed; the
+// barriers only order the slot contents against the index updates.
+//
+
+#define SYNA_FRAME_RING_SIZE	16	/* must be a power of 2 */
+#define SYNA_FRAME_HEADER_SIZE	2	/* HID-I2C input length prefix */
+#define SYNA_FRAME_SIZE		80	/* largest ATTN report: 10 fingers with data40, F30 */
+#define SYNA_FRAME_BUFFER_SIZE	(SYNA_FRAME_HEADER_SIZE + SYNA_FRAME_SIZE)
+
+#ifndef FRAME_RING_BARRIER
+#define FRAME_RING_BARRIER() KeMemoryBarrier()
+#endif
+
+struct syna_frame {
+	uint64_t timestamp;		/* arrival time in microseconds */
+	uint32_t sequence;		/* producer sequence number */
+	uint16_t length;		/* report bytes after the length prefix */
+	uint8_t buffer[SYNA_FRAME_BUFFER_SIZE];	/* SPB read lands here as-is */
+};
+
+struct syna_frame_ring {
+	struct syna_frame slots[SYNA_FRAME_RING_SIZE];
+
+	volatile uint32_t head;		/* written by the producer only */
+	volatile uint32_t tail;		/* written by the consumer only */
+
+	uint32_t sequence;		/* next sequence number to hand out */
+	volatile uint32_t overruns;	/* frames dropped because the ring was full */
+};
+
+/*
+ * Per-frame cost of getting a frame from the bus to the gesture engine.
+ * The slots are read into directly and parsed in place, nothing is
+ * copied or allocated on the way.
+ */
+struct syna_frame_stats {
+	uint32_t frames;		/* frames handed to the gesture engine */
+	uint64_t bus_bytes;		/* bytes read from the SPB target */
+	uint32_t empty_reads;		/* reads whose length prefix said no data */
+	uint32_t short_reads;		/* reports too short for the functions that fired */
+};
+
+/* The RMI report starts right after the HID-I2C length prefix. */
+static inline uint8_t *frame_report(struct syna_frame *frame)
+{
+	return &frame->buffer[SYNA_FRAME_HEADER_SIZE];
+}
+
+/*
+ * The HID-I2C length prefix is little endian and counts itself, a value
+ * of 0 (or just the prefix) means the device had no report to give.
+ */
+static inline uint16_t frame_input_length(const uint8_t *buffer)
+{
+	uint16_t length = buffer[0] | (buffer[1] << 8);
+
+	if (length <= SYNA_FRAME_HEADER_SIZE)
+		return 0;
+	return length - SYNA_FRAME_HEADER_SIZE;
+}
+
+static inline void frame_ring_init(struct syna_frame_ring *ring)
+{
+	ring->head = 0;
+	ring->tail = 0;
+	ring->sequence = 0;
+	ring->overruns = 0;
+}
+
+static inline uint32_t frame_ring_count(struct syna_frame_ring *ring)
+{
+	return ring->head - ring->tail;
+}
+
+/*
+ * Producer side. Returns the slot the next frame should be written to,
+ * or NULL (and counts an overrun) when the consumer has fallen behind.
+ * A frame dropped that way still uses up its sequence number, so the
+ * consumer sees the gap. Nothing is visible to the consumer until
+ * frame_ring_commit().
+ */
+static inline struct syna_frame *frame_ring_reserve(struct syna_frame_ring *ring)
+{
+	uint32_t head = ring->head;
+
+	FRAME_RING_BARRIER();
+	if (head - ring->tail >= SYNA_FRAME_RING_SIZE) {
+		ring->overruns++;
+		ring->sequence++;
+		return NULL;
+	}
+	return &ring->slots[head & (SYNA_FRAME_RING_SIZE - 1)];
+}
+
+static inline void frame_ring_commit(struct syna_frame_ring *ring, uint64_t timestamp)
+{
+	struct syna_frame *frame = &ring->slots[ring->head & (SYNA_FRAME_RING_SIZE - 1)];
+
+	frame->timestamp = timestamp;
+	frame->sequence = ring->sequence++;
+
+	FRAME_RING_BARRIER();
+	ring->head = ring->head + 1;
+}
+
+/*
+ * Consumer side. Returns the oldest queued frame without removing it,
+ * or NULL when the ring is empty.
+ */
+static inline struct syna_frame *frame_ring_peek(struct syna_frame_ring *ring)
+{
+	uint32_t tail = ring->tail;
+
+	if (ring->head == tail)
+		return NULL;
+	FRAME_RING_BARRIER();
+	return &ring->slots[tail & (SYNA_FRAME_RING_SIZE - 1)];
+}
+
+static inline void frame_ring_pop(struct syna_frame_ring *ring)
+{
+	FRAME_RING_BARRIER();
+	ring->tail = ring->tail + 1;
+}
+
+#endif
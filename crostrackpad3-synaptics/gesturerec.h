@@ -1,5 +1,41 @@
 #include "stdint.h"
 
+//gesture timing, in microseconds. These were tuned as counts of 10 ms
+//timer ticks, which is kept as the reference frame interval that
+//per-frame deltas get normalized to.
+#define GESTURE_TICK_US			10000
+#define GESTURE_MIN_FRAME_US		2000
+#define GESTURE_MAX_FRAME_US		100000
+
+#define GESTURE_MOVE_DELAY_US		50000	//finger must rest before pointing
+#define GESTURE_PALM_DELAY_US		150000	//older contacts below the pointer are palms
+#define GESTURE_SCROLL_DELAY_US		40000	//two fingers must rest before scrolling
+#define GESTURE_SCROLL_LINGER_US	50000	//scroll survives losing a finger this long
+#define GESTURE_SWIPE_DELAY_US		50000	//swipe must last before triggering
+#define GESTURE_SWIPE_RESET_US		250000	//swipe re-arms after this long
+#define GESTURE_TAP_US			100000	//max contact length of a tap
+#define GESTURE_TAP_DRAG_US		100000	//tap drag window after a tap
+#define GESTURE_RECENT_US		300000	//contact counts as just placed for clicks
+
+//two finger scroll, distances in 0.1mm and speeds per reference tick.
+//Gains are Q8, a slow scroll moves one detent per 3mm of finger travel
+//and a fast flick up to four times that.
+#define GESTURE_SCROLL_UNITS		4	//WHEEL_DETENT units per 0.1mm
+#define GESTURE_SCROLL_ACCEL_START	10	//1mm per tick before any speedup
+#define GESTURE_SCROLL_ACCEL_SLOPE	32	//Q8 gain added per 0.1mm/tick above it
+#define GESTURE_SCROLL_GAIN_MAX		1024
+
+#define GESTURE_SCROLL_AXIS_Y		0
+#define GESTURE_SCROLL_AXIS_X		1
+
+//scroll inertia, velocities in Q8 WHEEL_DETENT units per reference tick
+#define GESTURE_INERTIA_MIN_SPEED	3	//0.1mm per tick the fingers must leave at
+#define GESTURE_INERTIA_DECAY_Q16	62259	//0.95 of the speed kept each tick
+#define GESTURE_INERTIA_STOP		256	//coasting ends below 1 unit per tick
+
+#define GESTURE_MAX_CONTACTS		10	//F11 reports at most 10 fingers
+#define GESTURE_HISTORY			10	//samples in the motion window, any size up to 255
+
 typedef enum {
 	ThreeFingerTapActionCortana,
 	ThreeFingerTapActionWheelClick,
@@ -54,13 +90,66 @@ struct csgesture_settings {
 	SwipeGesture fourFingerSwipeLeftRightGesture;
 };
 
+//
+// Per-contact state read on every frame. Fields are ordered so there is
+// no padding, two contacts share a cache line.
+//
+struct csgesture_contact {
+	uint64_t touchdown;
+	int32_t flextotalx;
+	int32_t flextotaly;
+
+	//hardware input, -1 when the slot has no contact
+	int16_t x;
+	int16_t y;
+	int16_t p;
+
+	int16_t lastx;
+	int16_t lasty;
+	int16_t lastp;
+
+	uint8_t tick; //samples in the motion window
+	uint8_t blacklisted;
+	uint8_t reserved[2];
+};
+
+//
+// Per-contact motion history, only touched for contacts that are down.
+// x/y is a ring of signed per-frame deltas (normalized to the reference
+// tick) starting at head once the window is full; the contact's
+// flextotal and sumx/sumy are kept as running sums over it.
+//
+struct csgesture_history {
+	int16_t x[GESTURE_HISTORY];
+	int16_t y[GESTURE_HISTORY];
+	uint8_t head;
+	uint8_t samples; //deltas in the window, the first frame of a contact has none
+
+	int32_t sumx;
+	int32_t sumy;
+
+	//windowed velocity (per tick) and its change since the last frame
+	int32_t vx;
+	int32_t vy;
+	int32_t ax;
+	int32_t ay;
+
+	int32_t totalx;
+	int32_t totaly;
+	int32_t totalp;
+};
+
 struct csgesture_softc {
-	struct csgesture_settings settings;
+	DECLSPEC_ALIGN(64) struct csgesture_contact contact[GESTURE_MAX_CONTACTS];
+
+	int maxcontacts; //slots in use, from the sensor's max_fingers
 
-	//hardware input
-	int x[15];
-	int y[15];
-	int p[15];
+	//one bit per slot, updated as the F11 data is decoded
+	uint16_t active;
+	uint16_t added;
+	uint16_t released;
+
+	struct csgesture_settings settings;
 
 	bool buttondown;
 
@@ -79,7 +168,7 @@ struct csgesture_softc {
 	int dx;
 	int dy;
 
-	int scrollx;
+	int scrollx;	//in WHEEL_DETENT units, 120 per detent
 	int scrolly;
 
 	int buttonmask;
@@ -90,42 +179,70 @@ struct csgesture_softc {
 
 	int scrollingActive;
 	int idsForScrolling[2];
-	int ticksSinceScrolling;
+	uint64_t lastscrolltime;
+	int scrollAxis;		//axis the scroll locked to when it started
+	int scrollRemainderX;	//Q8 fractions of a WHEEL_DETENT unit
+	int scrollRemainderY;
+	int scrollSpeed;	//windowed finger speed on scrollAxis, 0.1mm per tick
 
 	int scrollInertiaActive;
-
-	int blacklistedids[15];
+	int inertiaVelocity;	//Q8 WHEEL_DETENT units per tick, finger direction
+	bool inertiaCaught;	//a touch stopped the coasting and is still down
 
 	bool mouseDownDueToTap;
 	int idForMouseDown;
 	bool mousedown;
 	int mousebutton;
 
-	int lastx[15];
-	int lasty[15];
-	int lastp[15];
-
-	int xhistory[15][10];
-	int yhistory[15][10];
-
-	int flextotalx[15];
-	int flextotaly[15];
-
-	int totalx[15];
-	int totaly[15];
-	int totalp[15];
-
 	int multitaskingx;
 	int multitaskingy;
-	int multitaskinggesturetick;
+	uint64_t multitaskingstart;
 	bool multitaskingdone;
 
 	bool alttabswitchershowing;
 
 	int idsforalttab[3];
 
-	int tick[15];
-	int truetick[15];
-	int ticksincelastrelease;
-	int tickssinceclick;
-};
\ No newline at end of file
+	//frame timing, a step without a new frame only moves the step clock
+	uint64_t timestamp;
+	uint64_t lasttimestamp;
+	uint64_t lastframetime;
+	int frameinterval;		//since the last frame, what the deltas span
+	int stepinterval;		//since the last step, frame or not
+
+	uint64_t lastreleasetime;
+	uint64_t clicktime;
+
+	struct csgesture_history history[GESTURE_MAX_CONTACTS];
+};
+
+//scale a per-frame delta to what it would have been over one reference tick
+static inline int normalize_delta(struct csgesture_softc *sc, int delta) {
+	return delta * GESTURE_TICK_US / sc->frameinterval;
+}
+
+//replace the sample at slot, keeping the signed window sums current
+static inline void history_push(struct csgesture_history *history, int slot, int dx, int dy) {
+	history->sumx += dx - history->x[slot];
+	history->sumy += dy - history->y[slot];
+	history->x[slot] = (int16_t)dx;
+	history->y[slot] = (int16_t)dy;
+	if (history->samples < GESTURE_HISTORY)
+		history->samples++;
+}
+
+//average over the deltas actually in the window, not the frames seen
+static inline void history_update_velocity(struct csgesture_history *history) {
+	int vx = 0;
+	int vy = 0;
+
+	if (history->samples) {
+		vx = history->sumx / history->samples;
+		vy = history->sumy / history->samples;
+	}
+
+	history->ax = vx - history->vx;
+	history->ay = vy - history->vy;
+	history->vx = vx;
+	history->vy = vy;
+}
@@ -21,6 +21,7 @@
 #define REPORTID_KEYBOARD       0x07
 #define REPORTID_SCROLLCTRL		0x08
 #define REPORTID_SETTINGS		0x09
+#define REPORTID_MULTIPLIER		0x0A
 
 //
 // Keyboard specific report infomation
@@ -61,15 +62,22 @@ typedef struct _SYNA_KEYBOARD_REPORT
 #define MOUSE_BUTTON_2     0x02
 #define MOUSE_BUTTON_3     0x04
 
-#define MIN_WHEEL_POS   -127
-#define MAX_WHEEL_POS    127
+#define MIN_WHEEL_POS   -32767
+#define MAX_WHEEL_POS    32767
+
+//
+// One wheel detent, the resolution the wheel and AC Pan report in once
+// the host has set the resolution multiplier
+//
+
+#define WHEEL_DETENT     120
 
 //
 // Relative mouse specific report information
 //
 
-#define RELATIVE_MOUSE_MIN_COORDINATE   -127
-#define RELATIVE_MOUSE_MAX_COORDINATE   127
+#define RELATIVE_MOUSE_MIN_COORDINATE   -32767
+#define RELATIVE_MOUSE_MAX_COORDINATE   32767
 
 #pragma pack(1)
 typedef struct _SYNA_RELATIVE_MOUSE_REPORT
@@ -79,17 +87,37 @@ typedef struct _SYNA_RELATIVE_MOUSE_REPORT
 
 	BYTE        Button;
 
-	BYTE        XValue;
+	SHORT       XValue;
 
-	BYTE        YValue;
+	SHORT       YValue;
 
-	BYTE        WheelPosition;
+	SHORT       WheelPosition;
 
-	BYTE		HWheelPosition;
+	SHORT       HWheelPosition;
 
 } SynaRelativeMouseReport;
 #pragma pack()
 
+//
+// Resolution multiplier feature report, two bits each for the wheel
+// and AC Pan, 0 for whole detents and 1 for WHEEL_DETENT steps
+//
+
+#define MULTIPLIER_WHEEL_MASK    0x03
+#define MULTIPLIER_HWHEEL_SHIFT  2
+#define MULTIPLIER_HWHEEL_MASK   0x0C
+
+#pragma pack(1)
+typedef struct _SYNA_MULTIPLIER_REPORT
+{
+
+	BYTE        ReportID;
+
+	BYTE        Multipliers;
+
+} SynaMultiplierReport;
+#pragma pack()
+
 //
 // Scroll specific report information
 //
@@ -20,7 +20,6 @@ IN WDFREQUEST Request
 	size_t              bytesToCopy = 0;
 	WDFMEMORY           memory;
 
-	UNREFERENCED_PARAMETER(Device);
 
 	SynaPrint(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
 		"SynaGetHidDescriptor Entry\n");
@@ -45,9 +44,16 @@ IN WDFREQUEST Request
 	}
 
 	//
-	// Use hardcoded "HID Descriptor" 
+	// Use hardcoded "HID Descriptor", with the length of the report
+	// descriptor built for this sensor
 	//
-	bytesToCopy = DefaultHidDescriptor.bLength;
+	HID_DESCRIPTOR hidDescriptor = DefaultHidDescriptor;
+	PDEVICE_CONTEXT pDevice = GetDeviceContext(Device);
+
+	if (pDevice->ReportDescriptorLength)
+		hidDescriptor.DescriptorList[0].wReportLength = pDevice->ReportDescriptorLength;
+
+	bytesToCopy = hidDescriptor.bLength;
 
 	if (bytesToCopy == 0)
 	{
@@ -61,7 +67,7 @@ IN WDFREQUEST Request
 
 	status = WdfMemoryCopyFromBuffer(memory,
 		0, // Offset
-		(PVOID)&DefaultHidDescriptor,
+		(PVOID)&hidDescriptor,
 		bytesToCopy);
 
 	if (!NT_SUCCESS(status))
@@ -93,7 +99,6 @@ IN WDFREQUEST Request
 	ULONG_PTR           bytesToCopy;
 	WDFMEMORY           memory;
 
-	UNREFERENCED_PARAMETER(Device);
 
 	SynaPrint(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
 		"SynaGetReportDescriptor Entry\n");
@@ -117,9 +122,18 @@ IN WDFREQUEST Request
 	}
 
 	//
-	// Use hardcoded Report descriptor
+	// Use the report descriptor built at boot, or the hardcoded one
+	// if the sensor never came up
 	//
+	PDEVICE_CONTEXT pDevice = GetDeviceContext(Device);
+	PVOID descriptor = (PVOID)DefaultReportDescriptor;
+
 	bytesToCopy = DefaultHidDescriptor.DescriptorList[0].wReportLength;
+	if (pDevice->ReportDescriptorLength)
+	{
+		descriptor = pDevice->ReportDescriptor;
+		bytesToCopy = pDevice->ReportDescriptorLength;
+	}
 
 	if (bytesToCopy == 0)
 	{
@@ -133,7 +147,7 @@ IN WDFREQUEST Request
 
 	status = WdfMemoryCopyFromBuffer(memory,
 		0,
-		(PVOID)DefaultReportDescriptor,
+		descriptor,
 		bytesToCopy);
 	if (!NT_SUCCESS(status))
 	{
@@ -155,6 +169,51 @@ IN WDFREQUEST Request
 }
 
 
+VOID
+SynaBuildReportDescriptor(
+IN PDEVICE_CONTEXT DevContext
+)
+{
+	struct ptp_geometry *geometry = &DevContext->PtpGeometry;
+	ULONG length = sizeof(DefaultReportDescriptor);
+	unsigned int ptpLength;
+
+	RtlCopyMemory(DevContext->ReportDescriptor, DefaultReportDescriptor, length);
+
+	if (DevContext->PtpEnabled)
+	{
+		//
+		// The contacts go out in the gesture engine's coordinates,
+		// 0.1mm steps with Y growing downwards
+		//
+
+		geometry->contacts = DevContext->max_fingers;
+		geometry->logical_x = DevContext->sc.resx;
+		geometry->logical_y = DevContext->sc.resy;
+		geometry->physical_x = DevContext->sc.resx;
+		geometry->physical_y = DevContext->sc.resy;
+		geometry->clickpad = DevContext->button_count > 0;
+
+		ptpLength = ptp_build_descriptor(geometry,
+			DevContext->ReportDescriptor + length,
+			sizeof(DevContext->ReportDescriptor) - length);
+		if (ptpLength == 0 || !geometry->logical_x || !geometry->logical_y)
+		{
+			SynaPrint(DEBUG_LEVEL_ERROR, DBG_IOCTL,
+				"Precision Touchpad descriptor could not be built, mouse only\n");
+
+			DevContext->PtpEnabled = FALSE;
+			ptpLength = 0;
+		}
+		length += ptpLength;
+	}
+
+	DevContext->ReportDescriptorLength = (USHORT)length;
+
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_IOCTL,
+		"Report descriptor is %d bytes\n", length);
+}
+
 NTSTATUS
 SynaGetDeviceAttributes(
 IN WDFREQUEST Request
@@ -281,82 +340,194 @@ IN WDFREQUEST Request
 	return status;
 }
 
-NTSTATUS
-SynaProcessVendorReport(
+static NTSTATUS
+SynaCompleteReadReport(
 IN PDEVICE_CONTEXT DevContext,
+IN WDFREQUEST ReqRead,
 IN PVOID ReportBuffer,
 IN ULONG ReportBufferLen,
 OUT size_t* BytesWritten
 )
 {
-	NTSTATUS status = STATUS_SUCCESS;
-	WDFREQUEST reqRead;
+	NTSTATUS status;
 	PVOID pReadReport = NULL;
 	size_t bytesReturned = 0;
 
-	SynaPrint(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
-		"SynaProcessVendorReport Entry\n");
+	status = WdfRequestRetrieveOutputBuffer(ReqRead,
+		ReportBufferLen,
+		&pReadReport,
+		&bytesReturned);
 
-	status = WdfIoQueueRetrieveNextRequest(DevContext->ReportQueue,
-		&reqRead);
+	if (!NT_SUCCESS(status))
+	{
+		SynaPrint(DEBUG_LEVEL_ERROR, DBG_IOCTL,
+			"WdfRequestRetrieveOutputBuffer failed Status 0x%x\n", status);
+
+		WdfRequestComplete(ReqRead, status);
+		return status;
+	}
 
-	if (NT_SUCCESS(status))
+	//
+	// Copy ReportBuffer into read request
+	//
+
+	if (bytesReturned > ReportBufferLen)
 	{
-		status = WdfRequestRetrieveOutputBuffer(reqRead,
-			ReportBufferLen,
-			&pReadReport,
-			&bytesReturned);
+		bytesReturned = ReportBufferLen;
+	}
 
-		if (NT_SUCCESS(status))
-		{
-			//
-			// Copy ReportBuffer into read request
-			//
+	RtlCopyMemory(pReadReport,
+		ReportBuffer,
+		bytesReturned);
 
-			if (bytesReturned > ReportBufferLen)
-			{
-				bytesReturned = ReportBufferLen;
-			}
+	//
+	// Complete read with the number of bytes returned as info
+	//
 
-			RtlCopyMemory(pReadReport,
-				ReportBuffer,
-				bytesReturned);
+	WdfRequestCompleteWithInformation(ReqRead,
+		status,
+		bytesReturned);
 
-			//
-			// Complete read with the number of bytes returned as info
-			//
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_IOCTL,
+		"SynaProcessVendorReport %d bytes returned\n", bytesReturned);
 
-			WdfRequestCompleteWithInformation(reqRead,
-				status,
-				bytesReturned);
+	//
+	// Return the number of bytes written for the write request completion
+	//
 
-			SynaPrint(DEBUG_LEVEL_INFO, DBG_IOCTL,
-				"SynaProcessVendorReport %d bytes returned\n", bytesReturned);
+	*BytesWritten = bytesReturned;
 
-			//
-			// Return the number of bytes written for the write request completion
-			//
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_IOCTL,
+		"%s completed, Queue:0x%p, Request:0x%p\n",
+		DbgHidInternalIoctlString(IOCTL_HID_READ_REPORT),
+		DevContext->ReportQueue,
+		ReqRead);
 
-			*BytesWritten = bytesReturned;
+	return status;
+}
+
+//
+// Hand queued reports to whatever reads are pending, oldest first. The
+// reports are paired with reads under the ReportLock, but completed
+// after it is dropped, the class driver's completion routine runs
+// right there. They stay held at the head of the FIFO until then, so a
+// read that fails leaves its report and everything behind it queued
+// for the next read, and the reads not used yet go back to the queue.
+// Only one caller drains at a time, anyone coming in meanwhile leaves
+// the FIFO to it. Called without the ReportLock held.
+//
+
+#define SYNA_REPORT_DRAIN_BATCH 8
+
+static VOID
+SynaDrainReportFifo(
+IN PDEVICE_CONTEXT DevContext
+)
+{
+	struct syna_report_entry batch[SYNA_REPORT_DRAIN_BATCH];
+	WDFREQUEST reqRead[SYNA_REPORT_DRAIN_BATCH];
+	struct syna_report_entry *entry;
+	size_t bytesWritten;
+	uint32_t count;
+	uint32_t delivered;
 
-			SynaPrint(DEBUG_LEVEL_INFO, DBG_IOCTL,
-				"%s completed, Queue:0x%p, Request:0x%p\n",
-				DbgHidInternalIoctlString(IOCTL_HID_READ_REPORT),
-				DevContext->ReportQueue,
-				reqRead);
+	WdfSpinLockAcquire(DevContext->ReportLock);
+
+	while (DevContext->ReportFifo.held == 0)
+	{
+		count = 0;
+		while (count < SYNA_REPORT_DRAIN_BATCH &&
+			(entry = report_fifo_next(&DevContext->ReportFifo, count)) != NULL &&
+			NT_SUCCESS(WdfIoQueueRetrieveNextRequest(DevContext->ReportQueue, &reqRead[count])))
+		{
+			batch[count++] = *entry;
 		}
-		else
+
+		if (count == 0)
+			break;
+
+		report_fifo_hold(&DevContext->ReportFifo, count);
+		WdfSpinLockRelease(DevContext->ReportLock);
+
+		for (delivered = 0; delivered < count; delivered++)
 		{
-			SynaPrint(DEBUG_LEVEL_ERROR, DBG_IOCTL,
-				"WdfRequestRetrieveOutputBuffer failed Status 0x%x\n", status);
+			if (!NT_SUCCESS(SynaCompleteReadReport(DevContext, reqRead[delivered],
+				batch[delivered].data, batch[delivered].length, &bytesWritten)))
+			{
+				break;
+			}
+		}
+
+		//
+		// The failed read was completed with the error, the ones
+		// after it never saw their report
+		//
+
+		for (uint32_t i = count; i > delivered + 1; i--)
+		{
+			WdfRequestRequeue(reqRead[i - 1]);
 		}
+
+		WdfSpinLockAcquire(DevContext->ReportLock);
+		report_fifo_release(&DevContext->ReportFifo, delivered);
+
+		if (delivered < count)
+			break;
+	}
+
+	WdfSpinLockRelease(DevContext->ReportLock);
+}
+
+NTSTATUS
+SynaProcessVendorReport(
+IN PDEVICE_CONTEXT DevContext,
+IN PVOID ReportBuffer,
+IN ULONG ReportBufferLen,
+OUT size_t* BytesWritten
+)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+
+	SynaPrint(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
+		"SynaProcessVendorReport Entry\n");
+
+	*BytesWritten = 0;
+
+	if (ReportBufferLen > SYNA_REPORT_MAX_SIZE)
+	{
+		SynaPrint(DEBUG_LEVEL_ERROR, DBG_IOCTL,
+			"Report of %d bytes does not fit the report FIFO\n", ReportBufferLen);
+
+		WdfSpinLockAcquire(DevContext->ReportLock);
+		DevContext->ReportFifo.dropped++;
+		WdfSpinLockRelease(DevContext->ReportLock);
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	//
+	// Every report goes through the FIFO, so it can't overtake the
+	// ones still waiting or being completed. Whatever is queued
+	// reaches the host eventually, a report that can't be is failed
+	// so the caller doesn't count it sent and reports it again.
+	//
+
+	WdfSpinLockAcquire(DevContext->ReportLock);
+
+	if (report_fifo_push(&DevContext->ReportFifo, ReportBuffer, (uint8_t)ReportBufferLen))
+	{
+		*BytesWritten = ReportBufferLen;
 	}
 	else
 	{
 		SynaPrint(DEBUG_LEVEL_ERROR, DBG_IOCTL,
-			"WdfIoQueueRetrieveNextRequest failed Status 0x%x\n", status);
+			"Report FIFO full of button and key changes\n");
+		status = STATUS_INSUFFICIENT_RESOURCES;
 	}
 
+	WdfSpinLockRelease(DevContext->ReportLock);
+
+	SynaDrainReportFifo(DevContext);
+
 	SynaPrint(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
 		"SynaProcessVendorReport Exit = 0x%x\n", status);
 
@@ -392,6 +563,12 @@ OUT BOOLEAN* CompleteRequest
 	else
 	{
 		*CompleteRequest = FALSE;
+
+		//
+		// Reports made while no read was pending go out first
+		//
+
+		SynaDrainReportFifo(DevContext);
 	}
 
 	SynaPrint(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
@@ -409,8 +586,8 @@ SynaWriteReport(
 	NTSTATUS status = STATUS_SUCCESS;
 	WDF_REQUEST_PARAMETERS params;
 	PHID_XFER_PACKET transferPacket = NULL;
-	SynaScrollControlReport *pScrollCtrlReport = NULL;
 	SynaSettingsReport *pSettingsReport = NULL;
+	SynaScrollControlReport *pScrollControlReport = NULL;
 	size_t bytesWritten = 0;
 
 	SynaPrint(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
@@ -448,20 +625,19 @@ SynaWriteReport(
 			{
 			case REPORTID_SCROLLCTRL:
 
-				pScrollCtrlReport = (SynaScrollControlReport *)transferPacket->reportBuffer;
-
-				if (pScrollCtrlReport->Flag == 1) {
-					DevContext->sc.scrollInertiaActive = 1;
-				}
-				else {
-					DevContext->sc.scrollInertiaActive = 0;
-				}
+				//
+				// The driver coasts on its own now, accept the writes of
+				// helpers that still report their inertia and drop them
+				//
 
+				pScrollControlReport = (SynaScrollControlReport *)transferPacket->reportBuffer;
+				SynaPrint(DEBUG_LEVEL_INFO, DBG_IOCTL,
+					"SynaWriteReport Scroll control flag %d ignored, the driver coasts itself\n", pScrollControlReport->Flag);
 				break;
 
 			case REPORTID_SETTINGS:
 				pSettingsReport = (SynaSettingsReport *)transferPacket->reportBuffer;
-				ProcessSetting(DevContext, &DevContext->sc, pSettingsReport->SettingsRegister, pSettingsReport->SettingsValue);
+				SynaPostSetting(DevContext, pSettingsReport->SettingsRegister, pSettingsReport->SettingsValue);
 				break;
 			default:
 
@@ -489,7 +665,6 @@ IN WDFREQUEST Request,
 OUT BOOLEAN* CompleteRequest
 )
 {
-	UNREFERENCED_PARAMETER(CompleteRequest);
 	NTSTATUS status = STATUS_SUCCESS;
 	WDF_REQUEST_PARAMETERS params;
 	PHID_XFER_PACKET transferPacket = NULL;
@@ -497,6 +672,12 @@ OUT BOOLEAN* CompleteRequest
 	SynaPrint(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
 		"SynaGetFeature Entry\n");
 
+	//
+	// Every feature is answered from the device context, the request
+	// completes here whatever the outcome
+	//
+	*CompleteRequest = TRUE;
+
 	WDF_REQUEST_PARAMETERS_INIT(&params);
 	WdfRequestGetParameters(Request, &params);
 
@@ -556,6 +737,97 @@ OUT BOOLEAN* CompleteRequest
 				break;
 			}
 
+			case REPORTID_PTP_CAPS:
+			case REPORTID_PTP_INPUT_MODE:
+			case REPORTID_PTP_SWITCHES:
+			{
+
+				//
+				// These all share the id + one byte layout
+				//
+
+				struct ptp_caps_report* pReport = NULL;
+
+				if (!DevContext->PtpEnabled)
+				{
+					status = STATUS_INVALID_PARAMETER;
+				}
+				else if (transferPacket->reportBufferLen == sizeof(struct ptp_caps_report))
+				{
+					pReport = (struct ptp_caps_report*)transferPacket->reportBuffer;
+
+					if (transferPacket->reportId == REPORTID_PTP_CAPS)
+						pReport->caps = ptp_caps(&DevContext->PtpGeometry);
+					else if (transferPacket->reportId == REPORTID_PTP_INPUT_MODE)
+						pReport->caps = DevContext->PtpInputMode;
+					else
+						pReport->caps = DevContext->PtpSwitches;
+				}
+				else
+				{
+					status = STATUS_INVALID_PARAMETER;
+
+					SynaPrint(DEBUG_LEVEL_ERROR, DBG_IOCTL,
+						"SynaGetFeature Error transferPacket->reportBufferLen (%d) is different from sizeof(struct ptp_caps_report) (%d)\n",
+						transferPacket->reportBufferLen,
+						sizeof(struct ptp_caps_report));
+				}
+
+				break;
+			}
+
+			case REPORTID_PTP_CERTIFICATION:
+			{
+
+				struct ptp_certification_report* pReport = NULL;
+
+				if (!DevContext->PtpEnabled)
+				{
+					status = STATUS_INVALID_PARAMETER;
+				}
+				else if (transferPacket->reportBufferLen == sizeof(struct ptp_certification_report))
+				{
+					pReport = (struct ptp_certification_report*)transferPacket->reportBuffer;
+
+					RtlCopyMemory(pReport->blob, DevContext->PtpCertification, sizeof(pReport->blob));
+				}
+				else
+				{
+					status = STATUS_INVALID_PARAMETER;
+
+					SynaPrint(DEBUG_LEVEL_ERROR, DBG_IOCTL,
+						"SynaGetFeature Error transferPacket->reportBufferLen (%d) is different from sizeof(struct ptp_certification_report) (%d)\n",
+						transferPacket->reportBufferLen,
+						sizeof(struct ptp_certification_report));
+				}
+
+				break;
+			}
+
+			case REPORTID_MULTIPLIER:
+			{
+
+				SynaMultiplierReport* pReport = NULL;
+
+				if (transferPacket->reportBufferLen == sizeof(SynaMultiplierReport))
+				{
+					pReport = (SynaMultiplierReport*)transferPacket->reportBuffer;
+
+					pReport->Multipliers = DevContext->WheelMultiplier;
+				}
+				else
+				{
+					status = STATUS_INVALID_PARAMETER;
+
+					SynaPrint(DEBUG_LEVEL_ERROR, DBG_IOCTL,
+						"SynaGetFeature Error transferPacket->reportBufferLen (%d) is different from sizeof(SynaMultiplierReport) (%d)\n",
+						transferPacket->reportBufferLen,
+						sizeof(SynaMultiplierReport));
+				}
+
+				break;
+			}
+
 			default:
 
 				SynaPrint(DEBUG_LEVEL_ERROR, DBG_IOCTL,
@@ -574,6 +846,124 @@ OUT BOOLEAN* CompleteRequest
 	return status;
 }
 
+NTSTATUS
+SynaSetFeature(
+IN PDEVICE_CONTEXT DevContext,
+IN WDFREQUEST Request
+)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+	WDF_REQUEST_PARAMETERS params;
+	PHID_XFER_PACKET transferPacket = NULL;
+	SynaMultiplierReport *pMultiplierReport = NULL;
+
+	SynaPrint(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
+		"SynaSetFeature Entry\n");
+
+	WDF_REQUEST_PARAMETERS_INIT(&params);
+	WdfRequestGetParameters(Request, &params);
+
+	if (params.Parameters.DeviceIoControl.InputBufferLength < sizeof(HID_XFER_PACKET))
+	{
+		SynaPrint(DEBUG_LEVEL_ERROR, DBG_IOCTL,
+			"SynaSetFeature Xfer packet too small\n");
+
+		status = STATUS_BUFFER_TOO_SMALL;
+	}
+	else
+	{
+
+		transferPacket = (PHID_XFER_PACKET)WdfRequestWdmGetIrp(Request)->UserBuffer;
+
+		if (transferPacket == NULL)
+		{
+			SynaPrint(DEBUG_LEVEL_ERROR, DBG_IOCTL,
+				"SynaSetFeature No xfer packet\n");
+
+			status = STATUS_INVALID_DEVICE_REQUEST;
+		}
+		else
+		{
+			//
+			// switch on the report id
+			//
+
+			switch (transferPacket->reportId)
+			{
+			case REPORTID_MULTIPLIER:
+
+				if (transferPacket->reportBufferLen < sizeof(SynaMultiplierReport))
+				{
+					status = STATUS_INVALID_PARAMETER;
+					break;
+				}
+
+				pMultiplierReport = (SynaMultiplierReport *)transferPacket->reportBuffer;
+
+				//
+				// A single byte store, the mouse path picks it up on
+				// its next flush
+				//
+
+				DevContext->WheelMultiplier = pMultiplierReport->Multipliers &
+					(MULTIPLIER_WHEEL_MASK | MULTIPLIER_HWHEEL_MASK);
+
+				SynaPrint(DEBUG_LEVEL_INFO, DBG_IOCTL,
+					"SynaSetFeature Multipliers = 0x%x\n", DevContext->WheelMultiplier);
+
+				break;
+
+			case REPORTID_PTP_INPUT_MODE:
+
+				if (!DevContext->PtpEnabled ||
+					transferPacket->reportBufferLen < sizeof(struct ptp_input_mode_report))
+				{
+					status = STATUS_INVALID_PARAMETER;
+					break;
+				}
+
+				DevContext->PtpInputMode = ((struct ptp_input_mode_report *)transferPacket->reportBuffer)->mode;
+
+				SynaPrint(DEBUG_LEVEL_INFO, DBG_IOCTL,
+					"SynaSetFeature Input Mode = 0x%x\n", DevContext->PtpInputMode);
+
+				break;
+
+			case REPORTID_PTP_SWITCHES:
+
+				if (!DevContext->PtpEnabled ||
+					transferPacket->reportBufferLen < sizeof(struct ptp_switches_report))
+				{
+					status = STATUS_INVALID_PARAMETER;
+					break;
+				}
+
+				DevContext->PtpSwitches = ((struct ptp_switches_report *)transferPacket->reportBuffer)->switches &
+					(PTP_SWITCH_SURFACE | PTP_SWITCH_BUTTON);
+
+				SynaPrint(DEBUG_LEVEL_INFO, DBG_IOCTL,
+					"SynaSetFeature Switches = 0x%x\n", DevContext->PtpSwitches);
+
+				break;
+
+			default:
+
+				SynaPrint(DEBUG_LEVEL_ERROR, DBG_IOCTL,
+					"SynaSetFeature Unhandled report type %d\n", transferPacket->reportId);
+
+				status = STATUS_INVALID_PARAMETER;
+
+				break;
+			}
+		}
+	}
+
+	SynaPrint(DEBUG_LEVEL_VERBOSE, DBG_IOCTL,
+		"SynaSetFeature Exit = 0x%x\n", status);
+
+	return status;
+}
+
 PCHAR
 DbgHidInternalIoctlString(
 IN ULONG IoControlCode
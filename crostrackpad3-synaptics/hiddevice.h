@@ -62,26 +62,53 @@ HID_REPORT_DESCRIPTOR DefaultReportDescriptor[] = {
 	0x05, 0x01,                         //     USAGE_PAGE (Generic Desktop)
 	0x09, 0x30,                         //     USAGE (X)
 	0x09, 0x31,                         //     USAGE (Y)
-	0x15, 0x81,                         //     Logical Minimum (-127)
-	0x25, 0x7F,                         //     Logical Maximum (127)
-	0x75, 0x08,                         //     REPORT_SIZE (8)
+	0x16, 0x01, 0x80,                   //     LOGICAL_MINIMUM (-32767)
+	0x26, 0xff, 0x7f,                   //     LOGICAL_MAXIMUM (32767)
+	0x75, 0x10,                         //     REPORT_SIZE (16)
 	0x95, 0x02,                         //     REPORT_COUNT (2)
 	0x81, 0x06,                         //     INPUT (Data,Var,Rel)
-	0x05, 0x01,                         //     Usage Page (Generic Desktop)
-	0x09, 0x38,                         //     Usage (Wheel)
-	0x15, 0x81,                         //     Logical Minimum (-127)
-	0x25, 0x7F,                         //     Logical Maximum (127)
-	0x75, 0x08,                         //     Report Size (8)
-	0x95, 0x01,                         //     Report Count (1)
-	0x81, 0x06,                         //     Input (Data, Variable, Relative)
+										// ------------------------------  Vertical wheel
+	0xa1, 0x02,                         //     COLLECTION (Logical)
+	0x85, REPORTID_MULTIPLIER,          //       REPORT_ID (Multiplier)
+	0x09, 0x48,                         //       USAGE (Resolution Multiplier)
+	0x15, 0x00,                         //       LOGICAL_MINIMUM (0)
+	0x25, 0x01,                         //       LOGICAL_MAXIMUM (1)
+	0x35, 0x01,                         //       PHYSICAL_MINIMUM (1)
+	0x45, WHEEL_DETENT,                 //       PHYSICAL_MAXIMUM (120)
+	0x75, 0x02,                         //       REPORT_SIZE (2)
+	0x95, 0x01,                         //       REPORT_COUNT (1)
+	0xb1, 0x02,                         //       FEATURE (Data,Var,Abs)
+	0x85, REPORTID_RELATIVE_MOUSE,      //       REPORT_ID (Mouse)
+	0x09, 0x38,                         //       USAGE (Wheel)
+	0x35, 0x00,                         //       PHYSICAL_MINIMUM (0)
+	0x45, 0x00,                         //       PHYSICAL_MAXIMUM (0)
+	0x16, 0x01, 0x80,                   //       LOGICAL_MINIMUM (-32767)
+	0x26, 0xff, 0x7f,                   //       LOGICAL_MAXIMUM (32767)
+	0x75, 0x10,                         //       REPORT_SIZE (16)
+	0x81, 0x06,                         //       INPUT (Data,Var,Rel)
+	0xc0,                               //     END_COLLECTION
 										// ------------------------------  Horizontal wheel
-	0x05, 0x0c,                         //     USAGE_PAGE (Consumer Devices)
-	0x0a, 0x38, 0x02,                   //     USAGE (AC Pan)
-	0x15, 0x81,                         //     LOGICAL_MINIMUM (-127)
-	0x25, 0x7f,                         //     LOGICAL_MAXIMUM (127)
-	0x75, 0x08,                         //     REPORT_SIZE (8)
-	0x95, 0x01,                         //     Report Count (1)
-	0x81, 0x06,                         //     Input (Data, Variable, Relative)
+	0xa1, 0x02,                         //     COLLECTION (Logical)
+	0x85, REPORTID_MULTIPLIER,          //       REPORT_ID (Multiplier)
+	0x09, 0x48,                         //       USAGE (Resolution Multiplier)
+	0x15, 0x00,                         //       LOGICAL_MINIMUM (0)
+	0x25, 0x01,                         //       LOGICAL_MAXIMUM (1)
+	0x35, 0x01,                         //       PHYSICAL_MINIMUM (1)
+	0x45, WHEEL_DETENT,                 //       PHYSICAL_MAXIMUM (120)
+	0x75, 0x02,                         //       REPORT_SIZE (2)
+	0xb1, 0x02,                         //       FEATURE (Data,Var,Abs)
+	0x35, 0x00,                         //       PHYSICAL_MINIMUM (0)
+	0x45, 0x00,                         //       PHYSICAL_MAXIMUM (0)
+	0x75, 0x04,                         //       REPORT_SIZE (4)
+	0xb1, 0x03,                         //       FEATURE (Cnst,Var,Abs)
+	0x85, REPORTID_RELATIVE_MOUSE,      //       REPORT_ID (Mouse)
+	0x05, 0x0c,                         //       USAGE_PAGE (Consumer Devices)
+	0x0a, 0x38, 0x02,                   //       USAGE (AC Pan)
+	0x16, 0x01, 0x80,                   //       LOGICAL_MINIMUM (-32767)
+	0x26, 0xff, 0x7f,                   //       LOGICAL_MAXIMUM (32767)
+	0x75, 0x10,                         //       REPORT_SIZE (16)
+	0x81, 0x06,                         //       INPUT (Data,Var,Rel)
+	0xc0,                               //     END_COLLECTION
 	0xc0,                               //   END_COLLECTION
 	0xc0,                               // END_COLLECTION
 
@@ -192,6 +219,11 @@ CONST HID_DESCRIPTOR DefaultHidDescriptor = {
 // Function definitions
 //
 
+VOID
+SynaBuildReportDescriptor(
+IN PDEVICE_CONTEXT DevContext
+);
+
 NTSTATUS
 SynaGetHidDescriptor(
 IN WDFDEVICE Device,
@@ -242,6 +274,12 @@ IN WDFREQUEST Request,
 OUT BOOLEAN* CompleteRequest
 );
 
+NTSTATUS
+SynaSetFeature(
+IN PDEVICE_CONTEXT DevContext,
+IN WDFREQUEST Request
+);
+
 PCHAR
 DbgHidInternalIoctlString(
 IN ULONG        IoControlCode
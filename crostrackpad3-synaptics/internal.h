@@ -18,7 +18,7 @@
 #include <wdf.h>
 #include <ntstrsafe.h>
 
-#include "spb.h"
+#include "spbtarget.h"
 
 #define RESHUB_USE_HELPER_ROUTINES
 #include "reshub.h"
@@ -26,7 +26,14 @@
 #include "trace.h"
 
 #include "rmi.h"
+#include "rmitransport.h"
 #include "gesturerec.h"
+#include "framering.h"
+#include "rmicache.h"
+#include "f11decode.h"
+#include "hidcommon.h"
+#include "reportfifo.h"
+#include "ptp.h"
 
 //
 // Forward Declarations
@@ -35,6 +42,52 @@
 typedef struct _DEVICE_CONTEXT  DEVICE_CONTEXT,  *PDEVICE_CONTEXT;
 typedef struct _REQUEST_CONTEXT  REQUEST_CONTEXT,  *PREQUEST_CONTEXT;
 
+//
+// Settings writes waiting for the next frame boundary, only the last
+// value written to each register is kept
+//
+
+#define SYNA_SETTINGS_REGISTERS 17
+
+struct syna_settings_mailbox {
+	volatile bool pending;
+	uint32_t dirty;			/* one bit per settings register */
+	int value[SYNA_SETTINGS_REGISTERS];
+};
+
+//
+// Relative mouse motion merged across a batch of frames
+//
+
+struct syna_mouse_batch {
+	bool active;
+	bool pending;
+	BYTE button;
+	int x;
+	int y;
+	int wheel;			/* in WHEEL_DETENT units */
+	int hwheel;
+	int wheel_remainder;		/* partial detents while the host wants whole ones */
+	int hwheel_remainder;
+	BYTE multiplier;		/* WheelMultiplier the remainders were kept for */
+};
+
+//
+// Last report of each vendor report type handed to the HID class driver,
+// state reports only go out again when they change
+//
+
+struct syna_report_state {
+	bool mouse_valid;
+	bool keyboard_valid;
+	SynaRelativeMouseReport mouse;
+	SynaKeyboardReport keyboard;
+	uint32_t sent;
+	uint32_t suppressed;
+};
+
+#define SYNA_REPORT_DESCRIPTOR_MAX (512 + PTP_DESCRIPTOR_MAX)
+
 struct _DEVICE_CONTEXT 
 {
     //
@@ -91,8 +144,75 @@ struct _DEVICE_CONTEXT
 
 	WDFQUEUE ReportQueue;
 
+	//
+	// Process ATTN frames from the ISR as they arrive instead of
+	// polling for them; Timer then only serves gesture deadlines
+	//
+
+	BOOLEAN EventDrivenInput;
+
+	//
+	// Merge the mouse reports of frames drained together into one,
+	// only button changes and other report types force them out early
+	//
+
+	BOOLEAN BatchInput;
+
+	//
+	// Read RMI registers with one write-read sequence instead of a
+	// write and a separate read, only for sensors known to answer it
+	//
+
+	BOOLEAN AtomicRmiReads;
+
 	BYTE DeviceMode;
 
+	//
+	// Resolution multiplier feature as last set by the host,
+	// see MULTIPLIER_WHEEL_MASK
+	//
+
+	BYTE WheelMultiplier;
+
+	//
+	// Precision Touchpad collections, only in the descriptor when the
+	// PrecisionTouchpad setting is on. The gesture engine keeps driving
+	// the mouse until the host switches the Input Mode to touchpad.
+	//
+
+	BOOLEAN PtpEnabled;
+
+	BYTE PtpInputMode;
+
+	BYTE PtpSwitches;
+
+	struct ptp_geometry PtpGeometry;
+
+	struct ptp_state PtpState;
+
+	//
+	// Contacts lifted in a touchpad report the class driver did not
+	// take, they go out lifted again with the next one
+	//
+
+	uint32_t PtpUnsentReleased;
+
+	//
+	// Device Certification Status blob from the PtpCertification
+	// setting, the collections are left out without one
+	//
+
+	UCHAR PtpCertification[PTP_CERTIFICATION_SIZE];
+
+	//
+	// Report descriptor handed to the class driver, the fixed
+	// collections plus whatever was built for this sensor
+	//
+
+	UCHAR ReportDescriptor[SYNA_REPORT_DESCRIPTOR_MAX];
+
+	USHORT ReportDescriptorLength;
+
 	ULONGLONG LastInterruptTime;
 
 	csgesture_softc sc;
@@ -104,14 +224,19 @@ struct _DEVICE_CONTEXT
 	struct rmi_function f01;
 	struct rmi_function f11;
 	struct rmi_function f30;
+	struct rmi_decode_plan decode_plan;
 
 	unsigned int max_fingers;
+	unsigned int attn_report_size;
+	unsigned int attn_read_size;
 	unsigned int max_x;
 	unsigned int max_y;
 	unsigned int x_size_mm;
 	unsigned int y_size_mm;
-	bool read_f11_ctrl_regs;
-	uint8_t f11_ctrl_regs[RMI_F11_CTRL_REG_COUNT];
+	uint64_t x_scale;
+	uint64_t y_scale;
+	uint64_t y_offset;
+	bool f11_simd;
 
 	unsigned int gpio_led_count;
 	unsigned int button_count;
@@ -120,12 +245,48 @@ struct _DEVICE_CONTEXT
 
 	unsigned long device_flags;
 	unsigned long firmware_id;
+	uint16_t firmware_id_addr;	/* F01 build id query, 0 without one */
+	uint8_t f11_fixups;		/* RMI_F11_FIXUP_* */
 
-	uint8_t f01_ctrl0;
 	uint8_t interrupt_enable_mask;
-	bool restore_interrupt_mask;
 
-	uint8_t lastreport[40];
+	//
+	// Query and control registers read or written since the last
+	// populate, so they need not cross the bus again
+	//
+
+	struct rmi_register_cache RegisterCache;
+
+	//
+	// How register reads and writes reach the sensor
+	//
+
+	struct rmi_transport RmiTransport;
+
+	//
+	// ATTN frames queued by the ISR for the gesture consumer, and what
+	// it cost to get them there
+	//
+
+	struct syna_frame_ring FrameRing;
+
+	struct syna_frame_stats FrameStats;
+
+	struct syna_mouse_batch MouseBatch;
+
+	struct syna_report_state LastReport;
+
+	//
+	// Reports waiting for the HID class driver to post a read
+	//
+
+	WDFSPINLOCK ReportLock;
+
+	struct syna_report_fifo ReportFifo;
+
+	WDFSPINLOCK SettingsLock;
+
+	struct syna_settings_mailbox Mailbox;
 };
 
 struct _REQUEST_CONTEXT
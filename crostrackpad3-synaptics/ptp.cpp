@@ -0,0 +1,280 @@
+#include "ptp.h"
+
+//
+// HID short items, the size bits are filled in by ptp_item
+//
+
+#define HID_INPUT		0x80
+#define HID_FEATURE		0xB0
+#define HID_COLLECTION		0xA0
+#define HID_END_COLLECTION	0xC0
+#define HID_USAGE_PAGE		0x04
+#define HID_LOGICAL_MIN		0x14
+#define HID_LOGICAL_MAX		0x24
+#define HID_PHYSICAL_MIN	0x34
+#define HID_PHYSICAL_MAX	0x44
+#define HID_UNIT_EXPONENT	0x54
+#define HID_UNIT		0x64
+#define HID_REPORT_SIZE		0x74
+#define HID_REPORT_ID		0x84
+#define HID_REPORT_COUNT	0x94
+#define HID_USAGE		0x08
+
+#define HID_DATA_VAR_ABS	0x02
+#define HID_CNST_VAR_ABS	0x03
+
+#define HID_PAGE_GENERIC	0x01
+#define HID_PAGE_BUTTON		0x09
+#define HID_PAGE_DIGITIZER	0x0D
+#define HID_PAGE_VENDOR		0xFF00
+
+#define HID_UNIT_CM		0x11
+#define HID_UNIT_SECONDS	0x1001
+
+struct ptp_writer {
+	uint8_t *buffer;
+	unsigned int size;
+	unsigned int length;
+	bool overflow;
+};
+
+static void ptp_byte(struct ptp_writer *w, uint8_t value)
+{
+	if (w->length >= w->size) {
+		w->overflow = true;
+		return;
+	}
+	w->buffer[w->length++] = value;
+}
+
+/* the smallest data size that keeps the value as a signed number */
+static void ptp_item(struct ptp_writer *w, uint8_t tag, int32_t value)
+{
+	if (value >= -128 && value <= 127) {
+		ptp_byte(w, tag | 1);
+		ptp_byte(w, (uint8_t)value);
+	}
+	else if (value >= -32768 && value <= 32767) {
+		ptp_byte(w, tag | 2);
+		ptp_byte(w, (uint8_t)value);
+		ptp_byte(w, (uint8_t)(value >> 8));
+	}
+	else {
+		ptp_byte(w, tag | 3);
+		ptp_byte(w, (uint8_t)value);
+		ptp_byte(w, (uint8_t)(value >> 8));
+		ptp_byte(w, (uint8_t)(value >> 16));
+		ptp_byte(w, (uint8_t)(value >> 24));
+	}
+}
+
+static void ptp_end_collection(struct ptp_writer *w)
+{
+	ptp_byte(w, HID_END_COLLECTION);
+}
+
+static void ptp_finger(struct ptp_writer *w, const struct ptp_geometry *geometry)
+{
+	ptp_item(w, HID_USAGE_PAGE, HID_PAGE_DIGITIZER);
+	ptp_item(w, HID_USAGE, 0x22);			// Finger
+	ptp_item(w, HID_COLLECTION, 0x02);		// Logical
+
+	ptp_item(w, HID_LOGICAL_MIN, 0);
+	ptp_item(w, HID_LOGICAL_MAX, 1);
+	ptp_item(w, HID_PHYSICAL_MIN, 0);
+	ptp_item(w, HID_PHYSICAL_MAX, 0);
+	ptp_item(w, HID_UNIT_EXPONENT, 0);
+	ptp_item(w, HID_UNIT, 0);
+	ptp_item(w, HID_USAGE, 0x47);			// Confidence
+	ptp_item(w, HID_USAGE, 0x42);			// Tip Switch
+	ptp_item(w, HID_REPORT_COUNT, 2);
+	ptp_item(w, HID_REPORT_SIZE, 1);
+	ptp_item(w, HID_INPUT, HID_DATA_VAR_ABS);
+
+	ptp_item(w, HID_LOGICAL_MAX, PTP_MAX_SLOTS - 1);
+	ptp_item(w, HID_USAGE, 0x51);			// Contact Identifier
+	ptp_item(w, HID_REPORT_COUNT, 1);
+	ptp_item(w, HID_REPORT_SIZE, 4);
+	ptp_item(w, HID_INPUT, HID_DATA_VAR_ABS);
+	ptp_item(w, HID_REPORT_SIZE, 2);
+	ptp_item(w, HID_INPUT, HID_CNST_VAR_ABS);
+
+	ptp_item(w, HID_USAGE_PAGE, HID_PAGE_GENERIC);
+	ptp_item(w, HID_REPORT_SIZE, 16);
+	ptp_item(w, HID_UNIT_EXPONENT, 0x0E);		// 10^-2
+	ptp_item(w, HID_UNIT, HID_UNIT_CM);
+	ptp_item(w, HID_LOGICAL_MAX, geometry->logical_x);
+	ptp_item(w, HID_PHYSICAL_MAX, geometry->physical_x);
+	ptp_item(w, HID_USAGE, 0x30);			// X
+	ptp_item(w, HID_INPUT, HID_DATA_VAR_ABS);
+	ptp_item(w, HID_LOGICAL_MAX, geometry->logical_y);
+	ptp_item(w, HID_PHYSICAL_MAX, geometry->physical_y);
+	ptp_item(w, HID_USAGE, 0x31);			// Y
+	ptp_item(w, HID_INPUT, HID_DATA_VAR_ABS);
+
+	ptp_end_collection(w);
+}
+
+/*
+ * Lays out the touchpad and configuration collections in buffer, the
+ * input report matches struct ptp_report. Returns the descriptor length,
+ * or 0 when it does not fit.
+ */
+unsigned int ptp_build_descriptor(const struct ptp_geometry *geometry, uint8_t *buffer, unsigned int size)
+{
+	struct ptp_writer w = { buffer, size, 0, false };
+	int i;
+
+	//
+	// Touch pad collection, the contacts and the button
+	//
+
+	ptp_item(&w, HID_USAGE_PAGE, HID_PAGE_DIGITIZER);
+	ptp_item(&w, HID_USAGE, 0x05);			// Touch Pad
+	ptp_item(&w, HID_COLLECTION, 0x01);		// Application
+	ptp_item(&w, HID_REPORT_ID, REPORTID_PTP);
+
+	for (i = 0; i < PTP_MAX_CONTACTS; i++)
+		ptp_finger(&w, geometry);
+
+	ptp_item(&w, HID_USAGE_PAGE, HID_PAGE_DIGITIZER);
+	ptp_item(&w, HID_UNIT_EXPONENT, 0x0C);		// 10^-4
+	ptp_item(&w, HID_UNIT, HID_UNIT_SECONDS);
+	ptp_item(&w, HID_LOGICAL_MAX, 0xFFFF);
+	ptp_item(&w, HID_PHYSICAL_MAX, 0xFFFF);
+	ptp_item(&w, HID_REPORT_SIZE, 16);
+	ptp_item(&w, HID_REPORT_COUNT, 1);
+	ptp_item(&w, HID_USAGE, 0x56);			// Scan Time
+	ptp_item(&w, HID_INPUT, HID_DATA_VAR_ABS);
+
+	ptp_item(&w, HID_UNIT_EXPONENT, 0);
+	ptp_item(&w, HID_UNIT, 0);
+	ptp_item(&w, HID_PHYSICAL_MAX, 0);
+	ptp_item(&w, HID_LOGICAL_MAX, 127);
+	ptp_item(&w, HID_REPORT_SIZE, 8);
+	ptp_item(&w, HID_USAGE, 0x54);			// Contact Count
+	ptp_item(&w, HID_INPUT, HID_DATA_VAR_ABS);
+
+	ptp_item(&w, HID_USAGE_PAGE, HID_PAGE_BUTTON);
+	ptp_item(&w, HID_USAGE, 0x01);			// Button 1
+	ptp_item(&w, HID_LOGICAL_MAX, 1);
+	ptp_item(&w, HID_REPORT_SIZE, 1);
+	ptp_item(&w, HID_INPUT, HID_DATA_VAR_ABS);
+	ptp_item(&w, HID_REPORT_COUNT, 7);
+	ptp_item(&w, HID_INPUT, HID_CNST_VAR_ABS);
+
+	ptp_item(&w, HID_USAGE_PAGE, HID_PAGE_DIGITIZER);
+	ptp_item(&w, HID_REPORT_ID, REPORTID_PTP_CAPS);
+	ptp_item(&w, HID_USAGE, 0x55);			// Contact Count Maximum
+	ptp_item(&w, HID_USAGE, 0x59);			// Pad Type
+	ptp_item(&w, HID_LOGICAL_MAX, 0x0F);
+	ptp_item(&w, HID_REPORT_SIZE, 4);
+	ptp_item(&w, HID_REPORT_COUNT, 2);
+	ptp_item(&w, HID_FEATURE, HID_DATA_VAR_ABS);
+
+	ptp_item(&w, HID_USAGE_PAGE, HID_PAGE_VENDOR);
+	ptp_item(&w, HID_REPORT_ID, REPORTID_PTP_CERTIFICATION);
+	ptp_item(&w, HID_USAGE, 0xC5);			// Device Certification Status
+	ptp_item(&w, HID_LOGICAL_MIN, 0);
+	ptp_item(&w, HID_LOGICAL_MAX, 0xFF);
+	ptp_item(&w, HID_REPORT_SIZE, 8);
+	ptp_item(&w, HID_REPORT_COUNT, PTP_CERTIFICATION_SIZE);
+	ptp_item(&w, HID_FEATURE, HID_DATA_VAR_ABS);
+
+	ptp_end_collection(&w);
+
+	//
+	// Configuration collection, the host switches between mouse and
+	// touchpad reports and turns the surface or the button off here
+	//
+
+	ptp_item(&w, HID_USAGE_PAGE, HID_PAGE_DIGITIZER);
+	ptp_item(&w, HID_USAGE, 0x0E);			// Device Configuration
+	ptp_item(&w, HID_COLLECTION, 0x01);		// Application
+
+	ptp_item(&w, HID_REPORT_ID, REPORTID_PTP_INPUT_MODE);
+	ptp_item(&w, HID_USAGE, 0x22);			// Finger
+	ptp_item(&w, HID_COLLECTION, 0x02);		// Logical
+	ptp_item(&w, HID_USAGE, 0x52);			// Input Mode
+	ptp_item(&w, HID_LOGICAL_MAX, 10);
+	ptp_item(&w, HID_REPORT_SIZE, 8);
+	ptp_item(&w, HID_REPORT_COUNT, 1);
+	ptp_item(&w, HID_FEATURE, HID_DATA_VAR_ABS);
+	ptp_end_collection(&w);
+
+	ptp_item(&w, HID_USAGE, 0x22);			// Finger
+	ptp_item(&w, HID_COLLECTION, 0x00);		// Physical
+	ptp_item(&w, HID_REPORT_ID, REPORTID_PTP_SWITCHES);
+	ptp_item(&w, HID_USAGE, 0x57);			// Surface Switch
+	ptp_item(&w, HID_USAGE, 0x58);			// Button Switch
+	ptp_item(&w, HID_LOGICAL_MAX, 1);
+	ptp_item(&w, HID_REPORT_SIZE, 1);
+	ptp_item(&w, HID_REPORT_COUNT, 2);
+	ptp_item(&w, HID_FEATURE, HID_DATA_VAR_ABS);
+	ptp_item(&w, HID_REPORT_COUNT, 6);
+	ptp_item(&w, HID_FEATURE, HID_CNST_VAR_ABS);
+	ptp_end_collection(&w);
+
+	ptp_end_collection(&w);
+
+	return w.overflow ? 0 : w.length;
+}
+
+uint8_t ptp_caps(const struct ptp_geometry *geometry)
+{
+	unsigned int contacts = geometry->contacts;
+	uint8_t pad = geometry->clickpad ? PTP_PAD_DEPRESSIBLE : PTP_PAD_NON_CLICKABLE;
+
+	if (contacts > PTP_MAX_CONTACTS)
+		contacts = PTP_MAX_CONTACTS;
+	return (uint8_t)(contacts | (pad << 4));
+}
+
+void ptp_contact_set(struct ptp_state *state, int slot, uint16_t x, uint16_t y)
+{
+	state->x[slot] = x;
+	state->y[slot] = y;
+}
+
+static int ptp_add_contacts(struct ptp_state *state, uint32_t mask, uint8_t flags,
+	struct ptp_report *report, int count)
+{
+	for (int slot = 0; slot < PTP_MAX_SLOTS && count < PTP_MAX_CONTACTS; slot++) {
+		struct ptp_contact *contact = &report->contact[count];
+
+		if (!(mask & (1 << slot)))
+			continue;
+
+		contact->flags = (uint8_t)(flags | (slot << PTP_CONTACT_ID_SHIFT));
+		contact->x = state->x[slot];
+		contact->y = state->y[slot];
+		count++;
+	}
+	return count;
+}
+
+/*
+ * One frame of contacts. Contacts lifted this frame go first, tip switch
+ * clear, so the host lets go of them before their slot can come back.
+ */
+void ptp_build_report(struct ptp_state *state, uint32_t active, uint32_t released,
+	bool button, uint64_t timestamp, uint8_t switches, struct ptp_report *report)
+{
+	int count = 0;
+
+	report->report_id = REPORTID_PTP;
+	for (int i = 0; i < PTP_MAX_CONTACTS; i++) {
+		report->contact[i].flags = 0;
+		report->contact[i].x = 0;
+		report->contact[i].y = 0;
+	}
+
+	if (switches & PTP_SWITCH_SURFACE) {
+		count = ptp_add_contacts(state, released, PTP_CONTACT_CONFIDENCE, report, count);
+		count = ptp_add_contacts(state, active, PTP_CONTACT_CONFIDENCE | PTP_CONTACT_TIP, report, count);
+	}
+
+	report->scan_time = (uint16_t)(timestamp / 100);
+	report->contact_count = (uint8_t)count;
+	report->buttons = (button && (switches & PTP_SWITCH_BUTTON)) ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+#if !defined(_PTP_H_)
+#define _PTP_H_
+
+#include "stdint.h"
+
+//
+// Windows Precision Touchpad collections. The descriptor is laid out
+// for the sensor found at boot and appended to the fixed mouse, vendor
+// and keyboard collections; the reports carry the decoded contacts as
+// they are instead of what the gesture engine made of them.
+//
+// Nothing in here depends on WDF, so it builds and runs on any host.
+//
+
+#define REPORTID_PTP			0x0B
+#define REPORTID_PTP_CAPS		0x0C
+#define REPORTID_PTP_INPUT_MODE		0x0D
+#define REPORTID_PTP_SWITCHES		0x0E
+#define REPORTID_PTP_CERTIFICATION	0x0F
+
+#define PTP_MAX_CONTACTS		5	/* per report, all Windows tracks */
+#define PTP_MAX_SLOTS			16	/* contact ids are 4 bits */
+#define PTP_DESCRIPTOR_MAX		640
+
+/*
+ * Device Certification Status feature. Windows only treats the
+ * collection as a Precision Touchpad when it can read this blob, which
+ * comes out of the device's certification and is not the driver's to
+ * make up.
+ */
+#define PTP_CERTIFICATION_SIZE		256
+
+/* Input Mode feature values */
+#define PTP_INPUT_MODE_MOUSE		0x00
+#define PTP_INPUT_MODE_TOUCHPAD		0x03
+
+/* Surface and button switch feature bits */
+#define PTP_SWITCH_SURFACE		0x01
+#define PTP_SWITCH_BUTTON		0x02
+
+/* Pad Type in the capabilities feature */
+#define PTP_PAD_DEPRESSIBLE		0x00
+#define PTP_PAD_NON_CLICKABLE		0x02
+
+#define PTP_CONTACT_CONFIDENCE		0x01
+#define PTP_CONTACT_TIP			0x02
+#define PTP_CONTACT_ID_SHIFT		2
+
+#pragma pack(push, 1)
+struct ptp_contact {
+	uint8_t flags;			/* confidence, tip switch, contact id */
+	uint16_t x;
+	uint16_t y;
+};
+
+struct ptp_report {
+	uint8_t report_id;
+	struct ptp_contact contact[PTP_MAX_CONTACTS];
+	uint16_t scan_time;		/* 100us units, wraps */
+	uint8_t contact_count;
+	uint8_t buttons;
+};
+
+struct ptp_caps_report {
+	uint8_t report_id;
+	uint8_t caps;			/* contact count maximum, pad type << 4 */
+};
+
+struct ptp_input_mode_report {
+	uint8_t report_id;
+	uint8_t mode;
+};
+
+struct ptp_switches_report {
+	uint8_t report_id;
+	uint8_t switches;
+};
+
+struct ptp_certification_report {
+	uint8_t report_id;
+	uint8_t blob[PTP_CERTIFICATION_SIZE];
+};
+#pragma pack(pop)
+
+struct ptp_geometry {
+	unsigned int contacts;		/* most contacts the sensor tracks */
+	unsigned int logical_x;		/* largest X in the reports */
+	unsigned int logical_y;
+	unsigned int physical_x;	/* surface size in 0.1mm */
+	unsigned int physical_y;
+	bool clickpad;			/* the surface is the button */
+};
+
+/*
+ * Where the contacts were last seen, a lifted contact goes out once
+ * more with its tip switch clear at the spot it left from.
+ */
+struct ptp_state {
+	uint16_t x[PTP_MAX_SLOTS];
+	uint16_t y[PTP_MAX_SLOTS];
+};
+
+unsigned int ptp_build_descriptor(const struct ptp_geometry *geometry, uint8_t *buffer, unsigned int size);
+
+uint8_t ptp_caps(const struct ptp_geometry *geometry);
+
+void ptp_contact_set(struct ptp_state *state, int slot, uint16_t x, uint16_t y);
+
+void ptp_build_report(struct ptp_state *state, uint32_t active, uint32_t released,
+	bool button, uint64_t timestamp, uint8_t switches, struct ptp_report *report);
+
+#endif
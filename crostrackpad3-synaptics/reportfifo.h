@@ -0,0 +1,214 @@
+#if !defined(_REPORTFIFO_H_)
+#define _REPORTFIFO_H_
+
+#include "stdint.h"
+#include "hidcommon.h"
+
+//
+// Vendor reports waiting for the HID class driver to post a read.
+// Everything goes through one FIFO so the host sees the reports in the
+// order they were made. Mouse motion and wheel travel with unchanged
+// buttons fold into the mouse report queued right before it, so a slow
+// reader costs resolution rather than events. Button and key changes
+// are never merged or evicted: when only they are left and the FIFO is
+// full, the push fails and the producer keeps its state to report again.
+//
+// The oldest reports may be held for reads being completed outside the
+// lock; they stay queued until the completions are known, so a failed
+// one keeps its place at the head.
+//
+
+#define SYNA_REPORT_FIFO_SIZE	32	/* must be a power of 2 */
+#define SYNA_REPORT_MAX_SIZE	sizeof(SynaInfoReport)
+
+struct syna_report_entry {
+	uint8_t length;
+	uint8_t data[SYNA_REPORT_MAX_SIZE];
+};
+
+struct syna_report_fifo {
+	struct syna_report_entry entries[SYNA_REPORT_FIFO_SIZE];
+	uint32_t head;
+	uint32_t tail;
+
+	uint32_t held;			/* oldest reports handed to reads being completed */
+
+	uint8_t last_button;		/* buttons of the last mouse report delivered */
+
+	uint32_t queued;		/* reports that went through the FIFO */
+	uint32_t merged;		/* reports folded into the one queued before */
+	uint32_t dropped;		/* motion reports evicted or turned away for room */
+	uint32_t refused;		/* button or key changes pushed back to the producer */
+};
+
+static inline void report_fifo_init(struct syna_report_fifo *fifo)
+{
+	fifo->head = 0;
+	fifo->tail = 0;
+	fifo->held = 0;
+	fifo->last_button = 0;
+}
+
+static inline uint32_t report_fifo_count(struct syna_report_fifo *fifo)
+{
+	return fifo->head - fifo->tail;
+}
+
+/* n-th queued report, 0 being the oldest */
+static inline struct syna_report_entry *report_fifo_entry(struct syna_report_fifo *fifo, uint32_t n)
+{
+	return &fifo->entries[(fifo->tail + n) & (SYNA_REPORT_FIFO_SIZE - 1)];
+}
+
+static inline bool report_fifo_merge_axis(SHORT *queued, SHORT value)
+{
+	int sum = *queued + value;
+
+	if (sum > RELATIVE_MOUSE_MAX_COORDINATE || sum < RELATIVE_MOUSE_MIN_COORDINATE)
+		return false;
+	*queued = (SHORT)sum;
+	return true;
+}
+
+static inline bool report_fifo_merge(struct syna_report_entry *entry, const uint8_t *report, uint8_t length)
+{
+	if (entry->length != length || entry->data[0] != report[0])
+		return false;
+
+	if (report[0] == REPORTID_RELATIVE_MOUSE) {
+		SynaRelativeMouseReport *queued = (SynaRelativeMouseReport *)entry->data;
+		const SynaRelativeMouseReport *mouse = (const SynaRelativeMouseReport *)report;
+		SynaRelativeMouseReport merged = *queued;
+
+		if (queued->Button != mouse->Button)
+			return false;
+		if (!report_fifo_merge_axis(&merged.XValue, mouse->XValue) ||
+			!report_fifo_merge_axis(&merged.YValue, mouse->YValue) ||
+			!report_fifo_merge_axis(&merged.WheelPosition, mouse->WheelPosition) ||
+			!report_fifo_merge_axis(&merged.HWheelPosition, mouse->HWheelPosition))
+			return false;
+		*queued = merged;
+		return true;
+	}
+
+	return false;
+}
+
+/* oldest queued mouse motion not held for a read whose buttons match the mouse report before it */
+static inline int report_fifo_find_motion(struct syna_report_fifo *fifo)
+{
+	uint32_t count = report_fifo_count(fifo);
+	uint8_t button = fifo->last_button;
+
+	for (uint32_t i = 0; i < count; i++) {
+		struct syna_report_entry *entry = report_fifo_entry(fifo, i);
+
+		if (entry->data[0] == REPORTID_RELATIVE_MOUSE) {
+			if (entry->data[1] == button && i >= fifo->held)
+				return (int)i;
+			button = entry->data[1];
+		}
+	}
+	return -1;
+}
+
+/* would go out as motion only after everything queued */
+static inline bool report_fifo_motion_only(struct syna_report_fifo *fifo, const uint8_t *report)
+{
+	uint32_t count = report_fifo_count(fifo);
+	uint8_t button = fifo->last_button;
+
+	if (report[0] != REPORTID_RELATIVE_MOUSE)
+		return false;
+	for (uint32_t i = 0; i < count; i++) {
+		struct syna_report_entry *entry = report_fifo_entry(fifo, i);
+
+		if (entry->data[0] == REPORTID_RELATIVE_MOUSE)
+			button = entry->data[1];
+	}
+	return report[1] == button;
+}
+
+static inline void report_fifo_remove(struct syna_report_fifo *fifo, uint32_t n)
+{
+	uint32_t count = report_fifo_count(fifo);
+
+	for (uint32_t i = n; i + 1 < count; i++)
+		*report_fifo_entry(fifo, i) = *report_fifo_entry(fifo, i + 1);
+	fifo->head--;
+}
+
+/*
+ * Queues a report, making room when the FIFO is full. Queued motion
+ * goes first, then motion that comes in while only edges are queued.
+ * Edges are never given up once queued; returns false when an edge
+ * finds no room, the producer has to report that state again later.
+ */
+static inline bool report_fifo_push(struct syna_report_fifo *fifo, const void *report, uint8_t length)
+{
+	uint32_t count = report_fifo_count(fifo);
+	struct syna_report_entry *entry;
+	int victim;
+
+	if (count > fifo->held &&
+		report_fifo_merge(report_fifo_entry(fifo, count - 1), (const uint8_t *)report, length)) {
+		fifo->merged++;
+		return true;
+	}
+
+	if (count >= SYNA_REPORT_FIFO_SIZE) {
+		victim = report_fifo_find_motion(fifo);
+		if (victim >= 0) {
+			fifo->dropped++;
+		}
+		else if (report_fifo_motion_only(fifo, (const uint8_t *)report)) {
+			fifo->dropped++;
+			return true;
+		}
+		else {
+			fifo->refused++;
+			return false;
+		}
+		report_fifo_remove(fifo, (uint32_t)victim);
+	}
+
+	entry = &fifo->entries[fifo->head & (SYNA_REPORT_FIFO_SIZE - 1)];
+	entry->length = length;
+	memcpy(entry->data, report, length);
+	fifo->head++;
+	fifo->queued++;
+	return true;
+}
+
+/* the n-th report not yet held for a read, NULL if there is none */
+static inline struct syna_report_entry *report_fifo_next(struct syna_report_fifo *fifo, uint32_t n)
+{
+	if (fifo->held + n >= report_fifo_count(fifo))
+		return NULL;
+	return report_fifo_entry(fifo, fifo->held + n);
+}
+
+/* the oldest n reports are being completed, nothing may merge into or evict them */
+static inline void report_fifo_hold(struct syna_report_fifo *fifo, uint32_t n)
+{
+	fifo->held += n;
+}
+
+/*
+ * The held reads are done, the first 'delivered' of them reached the
+ * host and leave the FIFO, the rest are queued at the head again.
+ */
+static inline void report_fifo_release(struct syna_report_fifo *fifo, uint32_t delivered)
+{
+	for (uint32_t i = 0; i < delivered; i++) {
+		struct syna_report_entry *entry = report_fifo_entry(fifo, 0);
+
+		/* edges are judged against what the host last saw */
+		if (entry->data[0] == REPORTID_RELATIVE_MOUSE)
+			fifo->last_button = entry->data[1];
+		fifo->tail++;
+	}
+	fifo->held = 0;
+}
+
+#endif
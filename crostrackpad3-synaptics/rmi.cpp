@@ -4,30 +4,42 @@
 static ULONG SynaPrintDebugLevel = 100;
 static ULONG SynaPrintDebugCatagories = DBG_INIT || DBG_PNP || DBG_IOCTL;
 
-static int rmi_set_mode(PDEVICE_CONTEXT pDevice, uint8_t mode) {
-	uint8_t command[] = { 0x00, 0x3f, 0x03, 0x0f, 0x23, 0x00, 0x04, 0x00, RMI_SET_RMI_MODE_REPORT_ID, mode }; //magic bytes from Linux
-	SpbWriteDataSynchronously(&pDevice->I2CContext, 0x22, command, sizeof(command));
-	return 0;
+//
+// The SPB helpers under the RMI transport. Each call is one transaction
+// that takes SpbLock on its own.
+//
+
+static int rmi_spb_write(void *context, uint8_t reg, const uint8_t *data, uint32_t length) {
+	NTSTATUS status = SpbWriteDataSynchronously((SPB_CONTEXT *)context, reg, (PVOID)data, length);
+	return NT_SUCCESS(status) ? 0 : -EIO;
 }
 
-static int rmi_write_report(PDEVICE_CONTEXT pDevice, uint8_t *report, size_t report_size) {
-	uint8_t command[24];
-	command[0] = 0x00;
-	command[1] = 0x17;
-	command[2] = 0x00;
-	//SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "RMI Write Report: ");
-	for (int i = 0; i < report_size; i++) {
-		//SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "0x%x ", report[i]);
-		command[i + 3] = report[i];
-	}
-	//SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "\n");
-	SpbWriteDataSynchronously(&pDevice->I2CContext, 0x25, command, sizeof(command));
-	return 0;
+static int rmi_spb_read(void *context, uint8_t *data, uint32_t length) {
+	NTSTATUS status = SpbOnlyReadDataSynchronously((SPB_CONTEXT *)context, data, length);
+	return NT_SUCCESS(status) ? 0 : -EIO;
+}
+
+static int rmi_spb_write_read(void *context, uint8_t reg, const uint8_t *data, uint32_t length,
+	uint8_t *reply, uint32_t reply_length) {
+	NTSTATUS status = SpbWriteReadSynchronously((SPB_CONTEXT *)context, reg, (PVOID)data, length,
+		reply, reply_length);
+	return NT_SUCCESS(status) ? 0 : -EIO;
+}
+
+static const struct rmi_transport_ops rmi_spb_ops = {
+	rmi_spb_write,
+	rmi_spb_read,
+	rmi_spb_write_read,
+};
+
+static int rmi_set_mode(PDEVICE_CONTEXT pDevice, uint8_t mode) {
+	uint8_t command[] = { 0x00, 0x3f, 0x03, 0x0f, 0x23, 0x00, 0x04, 0x00, RMI_SET_RMI_MODE_REPORT_ID, mode }; //magic bytes from Linux
+	return rmi_transport_write(&pDevice->RmiTransport, RMI_MODE_REGISTER, command, sizeof(command));
 }
 
 static int rmi_set_page(PDEVICE_CONTEXT pDevice, uint8_t page)
 {
-	uint8_t writeReport[21];
+	uint8_t writeReport[RMI_OUTPUT_REPORT_SIZE] = { 0 };
 	int retval;
 
 	writeReport[0] = RMI_WRITE_REPORT_ID;
@@ -37,74 +49,82 @@ static int rmi_set_page(PDEVICE_CONTEXT pDevice, uint8_t page)
 
 	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Set Page\n");
 
-	retval = rmi_write_report(pDevice, writeReport,
-		sizeof(writeReport));
+	retval = rmi_transport_write_report(&pDevice->RmiTransport, writeReport);
 	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Report Written\n");
 
-	pDevice->page = page;
+	/* on failure the sensor may be on either page, select it again next time */
+	pDevice->page = retval ? -1 : page;
 	return retval;
 }
 
-static int rmi_read_block(PDEVICE_CONTEXT pDevice, uint16_t addr, uint8_t *buf,
+static int rmi_bus_read_block(PDEVICE_CONTEXT pDevice, uint16_t addr, uint8_t *buf,
 	const int len)
 {
 	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Read Block: 0x%x\n", addr);
 	int ret = 0;
-	int bytes_read;
-	int bytes_needed;
-	int retries;
-	int read_input_count;
+
+	pDevice->RegisterCache.bus_reads++;
 
 	if (RMI_PAGE(addr) != pDevice->page) {
 		ret = rmi_set_page(pDevice, RMI_PAGE(addr));
 		if (ret < 0)
-			goto exit;
+			return ret;
 	}
 
-	uint8_t writeReport[21];
-	for (int i = 0; i < 21; i++) {
-		writeReport[i] = 0;
-	}
-	writeReport[0] = RMI_READ_ADDR_REPORT_ID;
-	writeReport[1] = 0;
-	writeReport[2] = addr & 0xFF;
-	writeReport[3] = (addr >> 8) & 0xFF;
-	writeReport[4] = len & 0xFF;
-	writeReport[5] = (len >> 8) & 0xFF;
-	rmi_write_report(pDevice, writeReport, sizeof(writeReport));
-
-	uint8_t i2cInput[42];
-	SpbOnlyReadDataSynchronously(&pDevice->I2CContext, i2cInput, sizeof(i2cInput));
-
-	uint8_t rmiInput[40];
-	for (int i = 0; i < 40; i++) {
-		rmiInput[i] = i2cInput[i + 2];
-	}
-	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "RMI Input ID: 0x%x\n", rmiInput[0]);
-	if (rmiInput[0] == RMI_READ_DATA_REPORT_ID) {
-		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "RMI Read: ");
-		for (int i = 0; i < len; i++) {
-			SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "0x%x ", rmiInput[i + 2]);
-			buf[i] = rmiInput[i + 2];
-		}
-		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "\n");
-	}
-exit:
+	//
+	// Only populate and resume read registers, and both run before the
+	// interrupt is connected, so no ATTN read can come between the
+	// request and its reply on the split path either. A reply other
+	// than READ_DATA fails the read, buf is left as it was and nothing
+	// goes into the register cache.
+	//
+	ret = rmi_transport_read_block(&pDevice->RmiTransport, addr, buf, len);
+	if (ret)
+		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "RMI read of %d registers at 0x%x failed: %d\n",
+			len, addr, ret);
+	return ret;
+}
+
+/* a block read through the register cache, flags says what to keep it as */
+static int rmi_cached_read_block(PDEVICE_CONTEXT pDevice, uint16_t addr, uint8_t *buf,
+	const int len, uint8_t flags)
+{
+	int ret;
+
+	if (rmi_cache_lookup(&pDevice->RegisterCache, addr, buf, len))
+		return 0;
+
+	ret = rmi_bus_read_block(pDevice, addr, buf, len);
+	if (!ret)
+		rmi_cache_fill(&pDevice->RegisterCache, addr, buf, len, flags);
 	return ret;
 }
 
+/* PDT entries and query registers, fixed until the firmware changes */
+static int rmi_read_block(PDEVICE_CONTEXT pDevice, uint16_t addr, uint8_t *buf,
+	const int len)
+{
+	return rmi_cached_read_block(pDevice, addr, buf, len, RMI_CACHE_QUERY);
+}
+
 static int rmi_read(PDEVICE_CONTEXT pDevice, uint16_t addr, uint8_t *buf) {
 	return rmi_read_block(pDevice, addr, buf, 1);
 }
 
-static int rmi_write_block(PDEVICE_CONTEXT pDevice, uint16_t addr, uint8_t *buf, const int len)
+/* control registers, only the driver changes them once they are read */
+static int rmi_read_control_block(PDEVICE_CONTEXT pDevice, uint16_t addr, uint8_t *buf,
+	const int len)
+{
+	return rmi_cached_read_block(pDevice, addr, buf, len, RMI_CACHE_CONTROL);
+}
+
+static int rmi_bus_write_block(PDEVICE_CONTEXT pDevice, uint16_t addr, uint8_t *buf, const int len)
 {
 	int ret;
 
-	uint8_t writeReport[21];
-	for (int i = 0; i < 21; i++) {
-		writeReport[i] = 0;
-	}
+	pDevice->RegisterCache.bus_writes++;
+
+	uint8_t writeReport[RMI_OUTPUT_REPORT_SIZE] = { 0 };
 
 	if (RMI_PAGE(addr) != pDevice->page) {
 		ret = rmi_set_page(pDevice, RMI_PAGE(addr));
@@ -120,7 +140,7 @@ static int rmi_write_block(PDEVICE_CONTEXT pDevice, uint16_t addr, uint8_t *buf,
 		writeReport[i + 4] = buf[i];
 	}
 
-	ret = rmi_write_report(pDevice, writeReport, sizeof(writeReport));
+	ret = rmi_transport_write_report(&pDevice->RmiTransport, writeReport);
 	if (ret < 0) {
 		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "failed to write request output report (%d)\n",
 			ret);
@@ -132,6 +152,14 @@ exit:
 	return ret;
 }
 
+/* control registers are written through, unless they already hold the value */
+static int rmi_write_block(PDEVICE_CONTEXT pDevice, uint16_t addr, uint8_t *buf, const int len)
+{
+	if (!rmi_cache_write(&pDevice->RegisterCache, addr, buf, len))
+		return 0;
+	return rmi_bus_write_block(pDevice, addr, buf, len);
+}
+
 static int rmi_write(PDEVICE_CONTEXT pDevice, uint16_t addr, uint8_t *buf)
 {
 	return rmi_write_block(pDevice, addr, buf, 1);
@@ -173,11 +201,51 @@ static void rmi_register_function(PDEVICE_CONTEXT pDevice, struct pdt_entry *pdt
 	}
 }
 
+/*
+ * Nothing says how many query registers a function has, but they end
+ * where the next register block on the page starts, or at the PDT. That
+ * bounds how much can be read ahead without touching a data register,
+ * which may clear on read.
+ */
+static void rmi_set_query_size(struct rmi_function *f, const uint16_t *bounds, int nbounds)
+{
+	unsigned int size = RMI_QUERY_PREFETCH_MAX;
+
+	if (!f->query_base_addr)
+		return;
+
+	for (int i = 0; i < nbounds; i++) {
+		if (bounds[i] > f->query_base_addr && RMI_PAGE(bounds[i]) == f->page &&
+			bounds[i] - f->query_base_addr < size)
+			size = bounds[i] - f->query_base_addr;
+	}
+	f->query_size = size;
+}
+
+/*
+ * Reads up to count PDT entries from addr down without going below low.
+ * Entries are stored at descending addresses, so the one at addr ends
+ * up last in the chunk and chunk_low is where the chunk starts.
+ */
+static int rmi_read_pdt_chunk(PDEVICE_CONTEXT pDevice, int addr, int low, int count, uint8_t *chunk, int *chunk_low)
+{
+	count = min(count, (addr - low) / (int)sizeof(struct pdt_entry) + 1);
+
+	*chunk_low = addr - (count - 1) * sizeof(struct pdt_entry);
+	return rmi_bus_read_block(pDevice, (uint16_t)*chunk_low, chunk,
+		count * sizeof(struct pdt_entry));
+}
+
 int rmi_scan_pdt(PDEVICE_CONTEXT pDevice)
 {
+	uint16_t bounds[128];
+	int nbounds = 0;
+	uint8_t chunk[RMI_PDT_CHUNK_ENTRIES * sizeof(struct pdt_entry)];
+	int chunk_low;
 	struct pdt_entry entry;
 	int page;
 	bool page_has_function;
+	int page_functions;
 	int i;
 	int retval;
 	int interrupt = 0;
@@ -191,20 +259,45 @@ int rmi_scan_pdt(PDEVICE_CONTEXT pDevice)
 		pdt_end = page_start + PDT_END_SCAN_LOCATION;
 
 		page_has_function = false;
+		page_functions = 0;
+		chunk_low = pdt_start + 1;
 		for (i = pdt_start; i >= pdt_end; i -= sizeof(entry)) {
-			SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Read PDT Entry...\n");
-			retval = rmi_read_block(pDevice, i, (uint8_t *)&entry, sizeof(entry));
-			SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Read PDT Entry done\n");
-			if (retval) {
-				SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Read of PDT entry at %#06x failed.\n",
-					i);
-				goto error_exit;
+			if (i < chunk_low) {
+				//
+				// Below the terminator may be registers that clear on
+				// read. Start with the top entries, and only read
+				// further ahead once that many valid functions were
+				// found above, doubling the chunk each time.
+				//
+				int count = page_functions ? min(page_functions, (int)RMI_PDT_CHUNK_ENTRIES) :
+					RMI_PDT_FIRST_CHUNK_ENTRIES;
+
+				SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Read PDT Entries...\n");
+				retval = rmi_read_pdt_chunk(pDevice, i, pdt_end, count, chunk, &chunk_low);
+				if (retval) {
+					SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Read of PDT entries at %#06x failed.\n",
+						i);
+					goto error_exit;
+				}
 			}
+			memcpy(&entry, &chunk[i - chunk_low], sizeof(entry));
+
+			/* the PDT reaches down to the entry that ends it */
+			if (nbounds < ARRAYSIZE(bounds))
+				bounds[nbounds++] = (uint16_t)i;
 
 			if (RMI4_END_OF_PDT(entry.function_number))
 				break;
 
 			page_has_function = true;
+			page_functions++;
+
+			if (nbounds + 4 <= ARRAYSIZE(bounds)) {
+				bounds[nbounds++] = (uint16_t)(page_start | entry.query_base_addr);
+				bounds[nbounds++] = (uint16_t)(page_start | entry.command_base_addr);
+				bounds[nbounds++] = (uint16_t)(page_start | entry.control_base_addr);
+				bounds[nbounds++] = (uint16_t)(page_start | entry.data_base_addr);
+			}
 
 			SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Found F%02X on page %#04x\n",
 				entry.function_number, page);
@@ -218,12 +311,86 @@ int rmi_scan_pdt(PDEVICE_CONTEXT pDevice)
 	}
 
 	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Done with PDT scan.\n");
+
+	rmi_set_query_size(&pDevice->f01, bounds, nbounds);
+	rmi_set_query_size(&pDevice->f11, bounds, nbounds);
+	rmi_set_query_size(&pDevice->f30, bounds, nbounds);
 	retval = 0;
 
 error_exit:
 	return retval;
 }
 
+/*
+ * Reads all of a function's query registers into the cache in as few
+ * read reports as they fit in, the has_queryN walk of the populate
+ * functions then runs on the cached copy instead of paying a round trip
+ * for every byte it looks at.
+ */
+static int rmi_prefetch_queries(PDEVICE_CONTEXT pDevice, struct rmi_function *f)
+{
+	uint8_t buf[RMI_READ_DATA_MAX];
+	uint16_t addr = f->query_base_addr;
+	unsigned int left = f->query_size;
+	int ret;
+
+	while (left) {
+		int len = min(left, RMI_READ_DATA_MAX);
+
+		ret = rmi_cached_read_block(pDevice, addr, buf, len, RMI_CACHE_QUERY);
+		if (ret) {
+			SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not prefetch queries at %#06x: %d.\n", addr, ret);
+			return ret;
+		}
+		addr += len;
+		left -= len;
+	}
+	return 0;
+}
+
+static unsigned long rmi_build_id(const uint8_t *info)
+{
+	return (info[1] << 8 | info[0]) + info[2] * 65536;
+}
+
+/*
+ * F01 control setup, shared by a full populate and one from a snapshot
+ */
+static int rmi_setup_f01_controls(PDEVICE_CONTEXT pDevice)
+{
+	uint8_t info[2];
+	int ret;
+
+	ret = rmi_read_control_block(pDevice, pDevice->f01.control_base_addr, info,
+		2);
+
+	if (ret) {
+		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not read f01 ctrl registers\n");
+		return ret;
+	}
+
+	if (!info[1]) {
+		/*
+		* Do to a firmware bug in some touchpads the F01 interrupt
+		* enable control register will be cleared on reset.
+		* This will stop the touchpad from reporting data, so
+		* if F01 CTRL1 is 0 then we need to explicitly enable
+		* interrupts for the functions we want data for. The write
+		* leaves the register dirty in the cache, so it is put back
+		* on resume as well.
+		*/
+		ret = rmi_write(pDevice, pDevice->f01.control_base_addr + 1,
+		&pDevice->interrupt_enable_mask);
+		if (ret) {
+			SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not write to control reg 1: %d.\n", ret);
+			return ret;
+		}
+		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Firmware bug fix needed!!! :/\n");
+	}
+
+	return 0;
+}
+
 static int rmi_populate_f01(PDEVICE_CONTEXT pDevice)
 {
 	uint8_t basic_queries[RMI_DEVICE_F01_BASIC_QUERY_LEN];
@@ -239,6 +406,15 @@ static int rmi_populate_f01(PDEVICE_CONTEXT pDevice)
 	uint16_t prod_info_addr;
 	uint8_t ds4_query_len;
 
+	if (!pDevice->f01.query_base_addr) {
+		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "No device control function found, giving up.\n");
+		return -ENODEV;
+	}
+
+	ret = rmi_prefetch_queries(pDevice, &pDevice->f01);
+	if (ret)
+		return ret;
+
 	ret = rmi_read_block(pDevice, query_offset, basic_queries,
 		RMI_DEVICE_F01_BASIC_QUERY_LEN);
 	if (ret) {
@@ -300,37 +476,57 @@ static int rmi_populate_f01(PDEVICE_CONTEXT pDevice)
 			return ret;
 		}
 
-		pDevice->firmware_id = info[1] << 8 | info[0];
-		pDevice->firmware_id += info[2] * 65536;
+		pDevice->firmware_id = rmi_build_id(info);
+		pDevice->firmware_id_addr = prod_info_addr;
 	}
 
-	ret = rmi_read_block(pDevice, pDevice->f01.control_base_addr, info,
-		2);
+	return rmi_setup_f01_controls(pDevice);
+}
 
+/*
+ * F11 control setup, shared by a full populate and one from a snapshot:
+ * the resolution comes from the control block, and the features the
+ * queries found are switched off
+ */
+static int rmi_setup_f11_controls(PDEVICE_CONTEXT pDevice)
+{
+	uint8_t ctrl_regs[RMI_F11_CTRL_REG_COUNT];
+	int ret;
+
+	ret = rmi_read_control_block(pDevice, pDevice->f11.control_base_addr,
+		ctrl_regs, RMI_F11_CTRL_REG_COUNT);
 	if (ret) {
-		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not read f01 ctrl registers\n");
+		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not read ctrl block of size 11: %d.\n", ret);
 		return ret;
 	}
 
-	pDevice->f01_ctrl0 = info[0];
+	pDevice->max_x = ctrl_regs[6] | (ctrl_regs[7] << 8);
+	pDevice->max_y = ctrl_regs[8] | (ctrl_regs[9] << 8);
 
-	if (!info[1]) {
-		/*
-		* Do to a firmware bug in some touchpads the F01 interrupt
-		* enable control register will be cleared on reset.
-		* This will stop the touchpad from reporting data, so
-		* if F01 CTRL1 is 0 then we need to explicitly enable
-		* interrupts for the functions we want data for.
-		*/
-		pDevice->restore_interrupt_mask = true;
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Trackpad Resolution: %d x %d\n", pDevice->max_x, pDevice->max_y);
 
-		ret = rmi_write(pDevice, pDevice->f01.control_base_addr + 1,
-		&pDevice->interrupt_enable_mask);
+	if (pDevice->f11_fixups & RMI_F11_FIXUP_DRIBBLE) {
+		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Has Dribble\n");
+		ctrl_regs[0] = ctrl_regs[0] & ~BIT(6);
+		ret = rmi_write(pDevice, pDevice->f11.control_base_addr,
+			ctrl_regs);
 		if (ret) {
-			SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not write to control reg 1: %d.\n", ret);
+			SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not write to control reg 0: %d.\n",
+				ret);
+			return ret;
+		}
+	}
+
+	if (pDevice->f11_fixups & RMI_F11_FIXUP_PALM_DETECT) {
+		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Has Palm Detect\n");
+		ctrl_regs[11] = ctrl_regs[11] & ~BIT(0);
+		ret = rmi_write(pDevice, pDevice->f11.control_base_addr + 11,
+			&ctrl_regs[11]);
+		if (ret) {
+			SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not write to control reg 11: %d.\n",
+				ret);
 			return ret;
 		}
-		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Firmware bug fix needed!!! :/\n");
 	}
 
 	return 0;
@@ -361,6 +557,10 @@ static int rmi_populate_f11(PDEVICE_CONTEXT pDevice)
 		return -ENODEV;
 	}
 
+	ret = rmi_prefetch_queries(pDevice, &pDevice->f11);
+	if (ret)
+		return ret;
+
 	/* query 0 contains some useful information */
 	ret = rmi_read(pDevice, pDevice->f11.query_base_addr, buf);
 	if (ret) {
@@ -381,10 +581,9 @@ static int rmi_populate_f11(PDEVICE_CONTEXT pDevice)
 	}
 	pDevice->max_fingers = (buf[0] & 0x07) + 1;
 	if (pDevice->max_fingers > 5)
-		pDevice->max_fingers = 10;
+		pDevice->max_fingers = RMI_F11_MAX_FINGERS;
 
-	pDevice->f11.report_size = pDevice->max_fingers * 5 +
-		DIV_ROUND_UP(pDevice->max_fingers, 4);
+	pDevice->f11.report_size = rmi_f11_report_size(pDevice->max_fingers, false);
 
 	if (!(buf[0] & BIT(4))) {
 		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "No absolute events, giving up.\n");
@@ -500,48 +699,14 @@ static int rmi_populate_f11(PDEVICE_CONTEXT pDevice)
 
 
 	if (has_data40)
-		pDevice->f11.report_size += pDevice->max_fingers * 2;
-
-	ret = rmi_read_block(pDevice, pDevice->f11.control_base_addr,
-		pDevice->f11_ctrl_regs, RMI_F11_CTRL_REG_COUNT);
-	if (ret) {
-		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not read ctrl block of size 11: %d.\n", ret);
-		return ret;
-	}
-
-	/* data->f11_ctrl_regs now contains valid register data */
-	pDevice->read_f11_ctrl_regs = true;
-
-	pDevice->max_x = pDevice->f11_ctrl_regs[6] | (pDevice->f11_ctrl_regs[7] << 8);
-	pDevice->max_y = pDevice->f11_ctrl_regs[8] | (pDevice->f11_ctrl_regs[9] << 8);
-
-	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Trackpad Resolution: %d x %d\n", pDevice->max_x, pDevice->max_y);
-
-	if (has_dribble) {
-		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Has Dribble\n");
-		pDevice->f11_ctrl_regs[0] = pDevice->f11_ctrl_regs[0] & ~BIT(6);
-		ret = rmi_write(pDevice, pDevice->f11.control_base_addr,
-			pDevice->f11_ctrl_regs);
-		if (ret) {
-			SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not write to control reg 0: %d.\n",
-				ret);
-			return ret;
-		}
-	}
+		pDevice->f11.report_size = rmi_f11_report_size(pDevice->max_fingers, true);
 
-	if (has_palm_detect) {
-		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Has Palm Detect\n");
-		pDevice->f11_ctrl_regs[11] = pDevice->f11_ctrl_regs[11] & ~BIT(0);
-		ret = rmi_write(pDevice, pDevice->f11.control_base_addr + 11,
-			&pDevice->f11_ctrl_regs[11]);
-		if (ret) {
-			SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not write to control reg 11: %d.\n",
-				ret);
-			return ret;
-		}
-	}
+	if (has_dribble)
+		pDevice->f11_fixups |= RMI_F11_FIXUP_DRIBBLE;
+	if (has_palm_detect)
+		pDevice->f11_fixups |= RMI_F11_FIXUP_PALM_DETECT;
 
-	return 0;
+	return rmi_setup_f11_controls(pDevice);
 }
 
 static int rmi_populate_f30(PDEVICE_CONTEXT pDevice)
@@ -555,11 +720,6 @@ static int rmi_populate_f30(PDEVICE_CONTEXT pDevice)
 	int i;
 
 	/* function F30 is for physical buttons */
-	if (!pDevice->f30.query_base_addr) {
-		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "No GPIO/LEDs found, giving up.\n");
-		return -ENODEV;
-	}
-
 	ret = rmi_read_block(pDevice, pDevice->f30.query_base_addr, buf, 2);
 	if (ret) {
 		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not get F30 query registers: %d.\n", ret);
@@ -568,7 +728,7 @@ static int rmi_populate_f30(PDEVICE_CONTEXT pDevice)
 
 	has_gpio = !!(buf[0] & BIT(3));
 	has_led = !!(buf[0] & BIT(2));
-	pDevice->gpio_led_count = buf[1] & 0x1f;
+	pDevice->gpio_led_count = buf[1] & RMI_F30_MAX_GPIOS;
 
 	/* retrieve ctrl 2 & 3 registers */
 	bytes_per_ctrl = (pDevice->gpio_led_count + 7) / 8;
@@ -580,7 +740,7 @@ static int rmi_populate_f30(PDEVICE_CONTEXT pDevice)
 
 	pDevice->f30.report_size = bytes_per_ctrl;
 
-	ret = rmi_read_block(pDevice, pDevice->f30.control_base_addr + ctrl2_addr,
+	ret = rmi_read_control_block(pDevice, pDevice->f30.control_base_addr + ctrl2_addr,
 		buf, ctrl2_3_length);
 	if (ret) {
 		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not read ctrl 2&3 block of size %d: %d.\n",
@@ -612,14 +772,157 @@ static int rmi_populate_f30(PDEVICE_CONTEXT pDevice)
 	return 0;
 }
 
-int rmi_populate(PDEVICE_CONTEXT pDevice) {
+/*
+ * Precompute the sensor to gesture coordinate transform as Q32
+ * reciprocals, with the Y inversion folded into y_offset. For the 12-bit
+ * F11 coordinates, (v * scale) >> 32 is exactly v * res / max, so the
+ * per-touch conversion needs no division.
+ */
+void rmi_f11_set_scale(PDEVICE_CONTEXT pDevice, unsigned int resx, unsigned int resy)
+{
+	pDevice->x_scale = 0;
+	pDevice->y_scale = 0;
+	if (pDevice->max_x)
+		pDevice->x_scale = (((uint64_t)resx << 32) + pDevice->max_x - 1) / pDevice->max_x;
+	if (pDevice->max_y)
+		pDevice->y_scale = (((uint64_t)resy << 32) + pDevice->max_y - 1) / pDevice->max_y;
+	pDevice->y_offset = (uint64_t)pDevice->max_y * pDevice->y_scale;
+}
+
+static void rmi_plan_add(struct rmi_decode_plan *plan, enum rmi_segment_type type,
+	struct rmi_function *f)
+{
+	struct rmi_decode_segment *seg;
+	unsigned int i;
+
+	if (!f->irq_mask || !f->report_size)
+		return;
+
+	/* keep the segments in interrupt number order */
+	for (i = plan->count; i > 0; i--) {
+		if (plan->segment[i - 1].irq_mask < f->irq_mask)
+			break;
+		plan->segment[i] = plan->segment[i - 1];
+	}
+
+	seg = &plan->segment[i];
+	seg->type = (uint8_t)type;
+	seg->irq_mask = (uint8_t)f->irq_mask;
+	seg->length = (uint16_t)f->report_size;
+	plan->count++;
+}
+
+/* forgets an F30 that could not be populated, it gets no plan segment */
+static void rmi_drop_f30(PDEVICE_CONTEXT pDevice)
+{
+	memset(&pDevice->f30, 0, sizeof(pDevice->f30));
+	pDevice->gpio_led_count = 0;
+	pDevice->button_count = 0;
+	pDevice->button_mask = 0;
+	pDevice->button_state_mask = 0;
+}
+
+/*
+ * Lay out the ATTN report once from what the PDT scan found, instead of
+ * comparing interrupt bases and walking the GPIO bits on every frame.
+ */
+static void rmi_build_decode_plan(PDEVICE_CONTEXT pDevice)
+{
+	struct rmi_decode_plan *plan = &pDevice->decode_plan;
+	unsigned int offset = RMI_ATTN_HEADER_SIZE;
+	unsigned int i;
+
+	RtlZeroMemory(plan, sizeof(*plan));
+	rmi_plan_add(plan, RMI_SEGMENT_F11, &pDevice->f11);
+	rmi_plan_add(plan, RMI_SEGMENT_F30, &pDevice->f30);
+
+	for (i = 0; i < plan->count; i++) {
+		plan->segment[i].offset = (uint16_t)offset;
+		offset += plan->segment[i].length;
+		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "ATTN segment %d: F%x, irq 0x%x, offset %d, length %d\n",
+			i, plan->segment[i].type == RMI_SEGMENT_F11 ? 0x11 : 0x30, plan->segment[i].irq_mask,
+			plan->segment[i].offset, plan->segment[i].length);
+	}
+
+	/* GPIO 0 is never a button, the rest are active low with pull ups */
+	plan->button_mask = (uint32_t)pDevice->button_mask & ~BIT(0);
+	plan->button_invert = (uint32_t)pDevice->button_state_mask & plan->button_mask;
+}
+
+static void rmi_set_attn_size(PDEVICE_CONTEXT pDevice, unsigned int report_size)
+{
+	if (report_size > SYNA_FRAME_SIZE) {
+		SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP, "ATTN report of %d bytes does not fit a frame, truncating\n", report_size);
+		report_size = SYNA_FRAME_SIZE;
+	}
+
+	/* the HID-I2C input report is the ATTN report behind its length prefix */
+	pDevice->attn_report_size = report_size;
+	pDevice->attn_read_size = SYNA_FRAME_HEADER_SIZE + report_size;
+}
+
+/* the first steps of every populate, full or from a snapshot */
+static int rmi_start_populate(PDEVICE_CONTEXT pDevice)
+{
 	int ret;
 
+	/* the firmware may have been updated since the last populate */
+	rmi_cache_init(&pDevice->RegisterCache);
+	rmi_transport_init(&pDevice->RmiTransport, &rmi_spb_ops, &pDevice->I2CContext,
+		!!pDevice->AtomicRmiReads);
+	pDevice->page = -1;
+
+	//
+	// Until the functions are known nothing is decoded, and a populate
+	// that fails must not leave the last plan sized against a default
+	// read size.
+	//
+	RtlZeroMemory(&pDevice->decode_plan, sizeof(pDevice->decode_plan));
+	rmi_set_attn_size(pDevice, RMI_ATTN_DEFAULT_SIZE);
+
 	ret = rmi_set_mode(pDevice, 0);
-	if (ret) {
+	if (ret)
 		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "PDT set mode failed with code %d\n", ret);
+	return ret;
+}
+
+static void rmi_finish_populate(PDEVICE_CONTEXT pDevice)
+{
+#ifdef F11_DECODE_SSE
+	pDevice->f11_simd = !!ExIsProcessorFeaturePresent(PF_SSSE3_INSTRUCTIONS_AVAILABLE);
+#endif
+
+	rmi_build_decode_plan(pDevice);
+	rmi_set_attn_size(pDevice, RMI_ATTN_HEADER_SIZE +
+		rmi_plan_data_size(&pDevice->decode_plan, 0xff));
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "ATTN report size %d, read size %d\n",
+		pDevice->attn_report_size, pDevice->attn_read_size);
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "RMI cache: %d registers, %d hits, %d bus reads, %d bus writes\n",
+		pDevice->RegisterCache.count, pDevice->RegisterCache.hits,
+		pDevice->RegisterCache.bus_reads, pDevice->RegisterCache.bus_writes);
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "RMI transport: %s reads, %d transactions, %d reads unanswered\n",
+		pDevice->RmiTransport.atomic_reads ? "write-read" : "split",
+		pDevice->RmiTransport.transactions, pDevice->RmiTransport.unanswered);
+}
+
+int rmi_populate(PDEVICE_CONTEXT pDevice) {
+	int ret;
+
+	ret = rmi_start_populate(pDevice);
+	if (ret)
 		return ret;
-	}
+
+	/* the scan and the queries add to these, start them over */
+	memset(&pDevice->f01, 0, sizeof(pDevice->f01));
+	memset(&pDevice->f11, 0, sizeof(pDevice->f11));
+	memset(&pDevice->f30, 0, sizeof(pDevice->f30));
+	pDevice->interrupt_enable_mask = 0;
+	pDevice->firmware_id = 0;
+	pDevice->firmware_id_addr = 0;
+	pDevice->f11_fixups = 0;
+	pDevice->button_count = 0;
+	pDevice->button_mask = 0;
+	pDevice->button_state_mask = 0;
 
 	ret = rmi_scan_pdt(pDevice);
 	if (ret) {
@@ -639,10 +942,140 @@ int rmi_populate(PDEVICE_CONTEXT pDevice) {
 		return ret;
 	}
 
-	ret = rmi_populate_f30(pDevice);
+	//
+	// Clickpads have no GPIOs, and a sensor whose buttons cannot be
+	// read still tracks fingers. The plan is built from what did
+	// populate, so F11 is decoded either way.
+	//
+	if (pDevice->f30.query_base_addr) {
+		ret = rmi_populate_f30(pDevice);
+		if (ret) {
+			SynaPrint(DEBUG_LEVEL_ERROR, DBG_PNP, "Error while initializing F30 (%d), buttons disabled\n", ret);
+			rmi_drop_f30(pDevice);
+		}
+	}
+
+	rmi_finish_populate(pDevice);
+	return 0;
+}
+
+/*
+ * Fills in a snapshot of what the last full populate found. Returns
+ * false if there is nothing to check a later start against, firmware
+ * without a build id query could change under the snapshot unnoticed.
+ */
+bool rmi_save_capabilities(PDEVICE_CONTEXT pDevice, struct rmi_capabilities *caps)
+{
+	if (!pDevice->firmware_id_addr)
+		return false;
+
+	memset(caps, 0, sizeof(*caps));
+	caps->version = RMI_CAPABILITIES_VERSION;
+	caps->size = sizeof(*caps);
+	caps->firmware_id = pDevice->firmware_id;
+	caps->firmware_id_addr = pDevice->firmware_id_addr;
+	caps->interrupt_enable_mask = pDevice->interrupt_enable_mask;
+	caps->f11_fixups = pDevice->f11_fixups;
+	caps->f01 = pDevice->f01;
+	caps->f11 = pDevice->f11;
+	caps->f30 = pDevice->f30;
+	caps->max_fingers = pDevice->max_fingers;
+	caps->x_size_mm = pDevice->x_size_mm;
+	caps->y_size_mm = pDevice->y_size_mm;
+	caps->gpio_led_count = pDevice->gpio_led_count;
+	caps->button_count = pDevice->button_count;
+	caps->button_mask = pDevice->button_mask;
+	caps->button_state_mask = pDevice->button_state_mask;
+	caps->checksum = rmi_capabilities_checksum(caps);
+	return true;
+}
+
+/*
+ * Populates from a snapshot instead of the PDT and the queries, after
+ * reading the build id back from where the snapshot found it. Any
+ * error, a mismatch included, means the caller does a full populate.
+ */
+int rmi_populate_from_capabilities(PDEVICE_CONTEXT pDevice, const struct rmi_capabilities *caps)
+{
+	uint8_t info[3];
+	int ret;
+
+	if (!rmi_capabilities_valid(caps)) {
+		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "RMI capability snapshot is invalid\n");
+		return -ENOENT;
+	}
+
+	ret = rmi_start_populate(pDevice);
+	if (ret)
+		return ret;
+
+	ret = rmi_read_block(pDevice, caps->firmware_id_addr, info, 3);
+	if (ret)
+		return ret;
+	if (rmi_build_id(info) != caps->firmware_id) {
+		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Firmware %ld is not the snapshot's %ld\n",
+			rmi_build_id(info), (unsigned long)caps->firmware_id);
+		return -ENODEV;
+	}
+
+	pDevice->firmware_id = caps->firmware_id;
+	pDevice->firmware_id_addr = caps->firmware_id_addr;
+	pDevice->interrupt_enable_mask = caps->interrupt_enable_mask;
+	pDevice->f11_fixups = caps->f11_fixups;
+	pDevice->f01 = caps->f01;
+	pDevice->f11 = caps->f11;
+	pDevice->f30 = caps->f30;
+	pDevice->max_fingers = caps->max_fingers;
+	pDevice->x_size_mm = caps->x_size_mm;
+	pDevice->y_size_mm = caps->y_size_mm;
+	pDevice->gpio_led_count = caps->gpio_led_count;
+	pDevice->button_count = caps->button_count;
+	pDevice->button_mask = caps->button_mask;
+	pDevice->button_state_mask = caps->button_state_mask;
+
+	/* the control registers are not part of the snapshot, the sensor resets them */
+	ret = rmi_setup_f01_controls(pDevice);
+	if (ret)
+		return ret;
+	ret = rmi_setup_f11_controls(pDevice);
+	if (ret)
+		return ret;
+
+	SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Populated from the capability snapshot of firmware %ld\n",
+		pDevice->firmware_id);
+	rmi_finish_populate(pDevice);
+	return 0;
+}
+
+/*
+ * A sensor that lost power comes back with its control registers at
+ * their defaults and page 0 selected. Only the registers the driver
+ * changed are written again, everything else the cache holds is still
+ * what the sensor has.
+ */
+int rmi_resume(PDEVICE_CONTEXT pDevice) {
+	uint8_t buf[16];
+	uint16_t addr;
+	int after = -1;
+	int len;
+	int ret;
+
+	pDevice->page = -1;
+
+	ret = rmi_set_mode(pDevice, 0);
 	if (ret) {
-		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Error while initializing F30 (%d)\n", ret);
+		SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "Resume set mode failed with code %d\n", ret);
 		return ret;
 	}
+
+	while ((len = rmi_cache_dirty_run(&pDevice->RegisterCache, after, &addr, buf, sizeof(buf))) > 0) {
+		ret = rmi_bus_write_block(pDevice, addr, buf, len);
+		if (ret) {
+			SynaPrint(DEBUG_LEVEL_INFO, DBG_PNP, "can not restore %d control registers at %#06x: %d.\n",
+				len, addr, ret);
+			return ret;
+		}
+		after = addr + len - 1;
+	}
 	return 0;
-}
\ No newline at end of file
+}
@@ -12,6 +12,16 @@
 #define RMI_ATTN_REPORT_ID		0x0c /* Input Report */
 #define RMI_SET_RMI_MODE_REPORT_ID	0x0f /* Feature Report */
 
+/* read data reports carry the report id and a reserved byte before the data */
+#define RMI_READ_DATA_MAX		38
+
+/* queries read ahead per function, F01 and F11 use fewer than this */
+#define RMI_QUERY_PREFETCH_MAX		64
+
+/* ATTN reports carry the report id and interrupt status before the F11/F30 data */
+#define RMI_ATTN_HEADER_SIZE		2
+#define RMI_ATTN_DEFAULT_SIZE		40 /* used until the functions are populated */
+
 /* flags */
 #define RMI_READ_REQUEST_PENDING	0
 #define RMI_READ_DATA_PENDING		1
@@ -50,13 +60,167 @@ struct rmi_function {
 	unsigned int report_size;	/* size of a report */
 	unsigned long irq_mask;		/* mask of the interrupts
 								* (to be applied against ATTN IRQ) */
+	unsigned int query_size;	/* query bytes before the next register
+								* block or the PDT on the page */
+};
+
+/*
+ * ATTN reports are packed: after the header come the data blocks of the
+ * functions whose interrupt fired, in interrupt number order. The decode
+ * plan is that order worked out once from the PDT, so the per-frame
+ * parser only walks the segments and skips the ones that did not fire.
+ */
+enum rmi_segment_type {
+	RMI_SEGMENT_F11 = 0,
+	RMI_SEGMENT_F30 = 1,
+};
+
+#define RMI_DECODE_MAX_SEGMENTS		2
+
+struct rmi_decode_segment {
+	uint8_t type;			/* RMI_SEGMENT_* */
+	uint8_t irq_mask;		/* interrupt bits of the function */
+	uint16_t offset;		/* offset when every earlier segment fired */
+	uint16_t length;		/* data block size */
 };
 
+struct rmi_decode_plan {
+	struct rmi_decode_segment segment[RMI_DECODE_MAX_SEGMENTS];
+	unsigned int count;
+	uint32_t button_mask;		/* F30 GPIOs wired to buttons */
+	uint32_t button_invert;		/* buttons that read 0 when pressed */
+};
+
+/* bytes a report with this interrupt status carries after its header */
+static inline unsigned int rmi_plan_data_size(const struct rmi_decode_plan *plan, uint8_t irq)
+{
+	unsigned int size = 0;
+
+	for (unsigned int i = 0; i < plan->count; i++) {
+		if (irq & plan->segment[i].irq_mask)
+			size += plan->segment[i].length;
+	}
+	return size;
+}
+
+/* F11 query 1 counts up to 5 fingers, anything more means 10 */
+#define RMI_F11_MAX_FINGERS		10
+
+/* F30 query 1 has 5 bits for the GPIO/LED count */
+#define RMI_F30_MAX_GPIOS		31
+
+/* F11 data block: 5 bytes per finger after the finger states, 2 more each with data 40 */
+static inline unsigned int rmi_f11_report_size(unsigned int fingers, bool has_data40)
+{
+	return fingers * 5 + DIV_ROUND_UP(fingers, 4) + (has_data40 ? fingers * 2 : 0);
+}
+
+/* F11 control bits the driver clears at bring-up */
+#define RMI_F11_FIXUP_DRIBBLE		BIT(0)	/* ctrl 0 bit 6 */
+#define RMI_F11_FIXUP_PALM_DETECT	BIT(1)	/* ctrl 11 bit 0 */
+
+/*
+ * What a full populate learns from the PDT and the query registers. It
+ * only changes with the firmware, so it is kept in the registry and a
+ * later start that reads the same build id back skips the scan. The
+ * layout is the driver's own, version and size catch a driver that
+ * changed it, the checksum a value that got damaged.
+ */
+#define RMI_CAPABILITIES_VERSION	1
+
+struct rmi_capabilities {
+	uint32_t version;
+	uint32_t size;
+
+	uint32_t firmware_id;
+	uint16_t firmware_id_addr;	/* F01 build id query it was read from */
+	uint8_t interrupt_enable_mask;
+	uint8_t f11_fixups;		/* RMI_F11_FIXUP_* */
+
+	struct rmi_function f01;
+	struct rmi_function f11;
+	struct rmi_function f30;
+
+	uint32_t max_fingers;
+	uint32_t x_size_mm;
+	uint32_t y_size_mm;
+	uint32_t gpio_led_count;
+	uint32_t button_count;
+	uint32_t button_mask;
+	uint32_t button_state_mask;
+
+	uint32_t checksum;		/* CRC-32 of everything before it */
+};
+
+static inline uint32_t rmi_capabilities_checksum(const struct rmi_capabilities *caps)
+{
+	const uint8_t *data = (const uint8_t *)caps;
+	uint32_t crc = 0xffffffff;
+
+	for (size_t i = 0; i < FIELD_OFFSET(struct rmi_capabilities, checksum); i++) {
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+	}
+	return ~crc;
+}
+
+/*
+ * The checksum only catches damage, not a value written to the registry
+ * by hand or by an older build, so the snapshot is held to what a full
+ * populate could have come up with before the decoder trusts it.
+ */
+static inline bool rmi_capabilities_in_range(const struct rmi_capabilities *caps)
+{
+	uint32_t fingers = caps->max_fingers;
+	uint32_t gpio_mask;
+	uint32_t buttons = 0;
+
+	if (!caps->f01.query_base_addr || !caps->f11.query_base_addr)
+		return false;
+
+	if (fingers < 1 || (fingers > 5 && fingers != RMI_F11_MAX_FINGERS))
+		return false;
+	if (caps->f11.report_size != rmi_f11_report_size(fingers, false) &&
+		caps->f11.report_size != rmi_f11_report_size(fingers, true))
+		return false;
+
+	/* the plan and the ATTN header only have 8 interrupt bits */
+	if (!caps->f11.irq_mask || caps->f11.irq_mask > 0xff || caps->f30.irq_mask > 0xff)
+		return false;
+	if (caps->f11_fixups & ~(RMI_F11_FIXUP_DRIBBLE | RMI_F11_FIXUP_PALM_DETECT))
+		return false;
+
+	if (caps->gpio_led_count > RMI_F30_MAX_GPIOS ||
+		caps->f30.report_size != DIV_ROUND_UP(caps->gpio_led_count, 8))
+		return false;
+	gpio_mask = (uint32_t)BIT(caps->gpio_led_count) - 1;
+	if ((caps->button_mask & ~gpio_mask) || caps->button_state_mask != caps->button_mask)
+		return false;
+	for (uint32_t m = caps->button_mask; m; m &= m - 1)
+		buttons++;
+	return caps->button_count == buttons;
+}
+
+static inline bool rmi_capabilities_valid(const struct rmi_capabilities *caps)
+{
+	return caps->version == RMI_CAPABILITIES_VERSION &&
+		caps->size == sizeof(*caps) &&
+		caps->firmware_id_addr != 0 &&
+		caps->checksum == rmi_capabilities_checksum(caps) &&
+		rmi_capabilities_in_range(caps);
+}
+
 #define RMI_PAGE(addr) (((addr) >> 8) & 0xff)
 
 #define RMI4_MAX_PAGE 0xff
 #define RMI4_PAGE_SIZE 0x0100
 
+/* PDT entries fetched per read report, at most */
+#define RMI_PDT_CHUNK_ENTRIES	(RMI_READ_DATA_MAX / sizeof(struct pdt_entry))
+/* PDT entries fetched by the first read on a page */
+#define RMI_PDT_FIRST_CHUNK_ENTRIES	2
+
 #define PDT_START_SCAN_LOCATION 0x00e9
 #define PDT_END_SCAN_LOCATION	0x0005
 #define RMI4_END_OF_PDT(id) ((id) == 0x00 || (id) == 0xff)
@@ -0,0 +1,176 @@
+#if !defined(_RMICACHE_H_)
+#define _RMICACHE_H_
+
+#include "stdint.h"
+
+//
+// Shadow of the RMI registers the driver has read or written, one byte
+// per entry keyed by the 16-bit RMI address. Every access goes over the
+// HID-over-I2C tunnel as a write report plus a read, so anything that can
+// be answered from here saves a bus round trip.
+//
+// Query registers and PDT entries never change while the firmware runs
+// and stay valid until the next populate. Control registers are written
+// through: a write only goes to the bus when it changes something, and
+// the bytes the driver changed are marked dirty so they can be put back
+// after the sensor lost power.
+//
+
+#define RMI_CACHE_SIZE		256	/* must be a power of 2 */
+
+#define RMI_CACHE_VALID		0x01
+#define RMI_CACHE_QUERY		0x02	/* immutable while the firmware runs */
+#define RMI_CACHE_CONTROL	0x04	/* written through */
+#define RMI_CACHE_DIRTY		0x08	/* changed by the driver, restore on resume */
+
+struct rmi_cache_entry {
+	uint16_t addr;
+	uint8_t value;
+	uint8_t flags;			/* 0 for an empty slot */
+};
+
+struct rmi_register_cache {
+	struct rmi_cache_entry entries[RMI_CACHE_SIZE];
+	uint32_t count;
+
+	uint32_t hits;			/* reads answered without the bus */
+	uint32_t bus_reads;		/* read transactions that went to the bus */
+	uint32_t bus_writes;		/* write transactions that went to the bus */
+	uint32_t writes_skipped;	/* writes that would not change a register */
+	uint32_t overflows;		/* bytes that found no free slot */
+};
+
+static inline void rmi_cache_init(struct rmi_register_cache *cache)
+{
+	memset(cache, 0, sizeof(*cache));
+}
+
+static inline uint32_t rmi_cache_hash(uint16_t addr)
+{
+	/* registers of one function sit next to each other on one page */
+	return (addr + (addr >> 8) * 37) & (RMI_CACHE_SIZE - 1);
+}
+
+/* slot holding addr, or the empty slot it would go in; NULL when full */
+static inline struct rmi_cache_entry *rmi_cache_slot(struct rmi_register_cache *cache, uint16_t addr)
+{
+	uint32_t index = rmi_cache_hash(addr);
+
+	for (uint32_t probe = 0; probe < RMI_CACHE_SIZE; probe++) {
+		struct rmi_cache_entry *entry = &cache->entries[(index + probe) & (RMI_CACHE_SIZE - 1)];
+
+		if (!entry->flags || entry->addr == addr)
+			return entry;
+	}
+	return NULL;
+}
+
+static inline struct rmi_cache_entry *rmi_cache_find(struct rmi_register_cache *cache, uint16_t addr)
+{
+	struct rmi_cache_entry *entry = rmi_cache_slot(cache, addr);
+
+	if (!entry || !entry->flags)
+		return NULL;
+	return entry;
+}
+
+static inline struct rmi_cache_entry *rmi_cache_insert(struct rmi_register_cache *cache, uint16_t addr)
+{
+	struct rmi_cache_entry *entry = rmi_cache_slot(cache, addr);
+
+	/* keep a slot free so lookups of missing addresses terminate */
+	if (!entry || (!entry->flags && cache->count >= RMI_CACHE_SIZE - 1)) {
+		cache->overflows++;
+		return NULL;
+	}
+	if (!entry->flags) {
+		entry->addr = addr;
+		cache->count++;
+	}
+	return entry;
+}
+
+/* copies the block out if every byte of it is cached */
+static inline bool rmi_cache_lookup(struct rmi_register_cache *cache, uint16_t addr, uint8_t *buf, int len)
+{
+	for (int i = 0; i < len; i++) {
+		if (!rmi_cache_find(cache, (uint16_t)(addr + i)))
+			return false;
+	}
+	for (int i = 0; i < len; i++)
+		buf[i] = rmi_cache_find(cache, (uint16_t)(addr + i))->value;
+	cache->hits++;
+	return true;
+}
+
+/* records what the bus returned, dirty bytes keep the value the driver wrote */
+static inline void rmi_cache_fill(struct rmi_register_cache *cache, uint16_t addr, const uint8_t *buf, int len, uint8_t flags)
+{
+	for (int i = 0; i < len; i++) {
+		struct rmi_cache_entry *entry = rmi_cache_insert(cache, (uint16_t)(addr + i));
+
+		if (!entry || (entry->flags & RMI_CACHE_DIRTY))
+			continue;
+		entry->value = buf[i];
+		entry->flags = RMI_CACHE_VALID | flags;
+	}
+}
+
+/*
+ * Shadows a control write. Returns false when every byte is already
+ * known to hold the value, the bus write can then be skipped.
+ */
+static inline bool rmi_cache_write(struct rmi_register_cache *cache, uint16_t addr, const uint8_t *buf, int len)
+{
+	bool changed = false;
+
+	for (int i = 0; i < len; i++) {
+		struct rmi_cache_entry *entry = rmi_cache_insert(cache, (uint16_t)(addr + i));
+
+		if (!entry) {
+			changed = true;
+			continue;
+		}
+		if (!entry->flags || entry->value != buf[i])
+			changed = true;
+		entry->value = buf[i];
+		entry->flags = RMI_CACHE_VALID | RMI_CACHE_CONTROL | RMI_CACHE_DIRTY;
+	}
+
+	if (!changed)
+		cache->writes_skipped++;
+	return changed;
+}
+
+/*
+ * The lowest run of consecutive dirty registers starting above 'after'
+ * (-1 to start from the bottom), at most max bytes. Returns the run
+ * length, 0 once there are no more.
+ */
+static inline int rmi_cache_dirty_run(struct rmi_register_cache *cache, int after, uint16_t *addr, uint8_t *buf, int max)
+{
+	int start = -1;
+	int len = 0;
+
+	for (uint32_t i = 0; i < RMI_CACHE_SIZE; i++) {
+		struct rmi_cache_entry *entry = &cache->entries[i];
+
+		if ((entry->flags & RMI_CACHE_DIRTY) && entry->addr > after &&
+			(start == -1 || entry->addr < start))
+			start = entry->addr;
+	}
+	if (start == -1)
+		return 0;
+
+	while (len < max && start + len <= 0xffff) {
+		struct rmi_cache_entry *entry = rmi_cache_find(cache, (uint16_t)(start + len));
+
+		if (!entry || !(entry->flags & RMI_CACHE_DIRTY))
+			break;
+		buf[len++] = entry->value;
+	}
+	*addr = (uint16_t)start;
+	return len;
+}
+
+#endif
@@ -0,0 +1,132 @@
+#if !defined(_RMITRANSPORT_H_)
+#define _RMITRANSPORT_H_
+
+#include "stdint.h"
+
+//
+// How RMI register access reaches the sensor. Everything is tunnelled
+// through HID-over-I2C: a write is an RMI output report written to the
+// HID output register, a read is a READ_ADDR output report answered by
+// a READ_DATA input report. The bus itself sits behind ops, so the
+// framing here is the same whether it talks to SPB or to a test double.
+//
+// A read can go out as a write and a separate read, two transactions,
+// or as one write-read sequence when ops has one and atomic_reads is
+// set. Either way a reply that is not READ_DATA fails the read, the
+// caller's buffer is then left alone.
+//
+// Needs rmi.h for the report ids. Nothing in here depends on WDF, so it
+// builds and runs on any host.
+//
+
+#define RMI_OUTPUT_REGISTER		0x25	/* HID-I2C output register */
+#define RMI_MODE_REGISTER		0x22	/* HID-I2C command register */
+#define RMI_OUTPUT_REPORT_SIZE		21
+#define RMI_OUTPUT_COMMAND_SIZE		(RMI_OUTPUT_REPORT_SIZE + 3)
+#define RMI_INPUT_HEADER_SIZE		2	/* HID-I2C input length prefix */
+#define RMI_INPUT_REPORT_SIZE		40
+
+struct rmi_transport_ops {
+	/* each is one bus transaction, returning 0 or a negative error */
+	int (*write)(void *context, uint8_t reg, const uint8_t *data, uint32_t length);
+	int (*read)(void *context, uint8_t *data, uint32_t length);
+
+	/* a write and a read in one transaction, NULL if the bus has none */
+	int (*write_read)(void *context, uint8_t reg, const uint8_t *data, uint32_t length,
+		uint8_t *reply, uint32_t reply_length);
+};
+
+struct rmi_transport {
+	const struct rmi_transport_ops *ops;
+	void *context;
+	bool atomic_reads;		/* reads go out through write_read */
+
+	uint32_t transactions;		/* bus transactions handed to ops */
+	uint32_t unanswered;		/* reads whose reply was not READ_DATA */
+};
+
+static inline void rmi_transport_init(struct rmi_transport *transport,
+	const struct rmi_transport_ops *ops, void *context, bool atomic_reads)
+{
+	transport->ops = ops;
+	transport->context = context;
+	transport->atomic_reads = atomic_reads && ops->write_read;
+	transport->transactions = 0;
+	transport->unanswered = 0;
+}
+
+/* raw write to a HID-I2C register */
+static inline int rmi_transport_write(struct rmi_transport *transport, uint8_t reg,
+	const uint8_t *data, uint32_t length)
+{
+	transport->transactions++;
+	return transport->ops->write(transport->context, reg, data, length);
+}
+
+/* wraps an RMI output report in the HID-I2C output register write */
+static inline void rmi_transport_build_command(uint8_t *command, const uint8_t *report)
+{
+	command[0] = 0x00;
+	command[1] = 0x17;
+	command[2] = 0x00;
+	for (int i = 0; i < RMI_OUTPUT_REPORT_SIZE; i++)
+		command[i + 3] = report[i];
+}
+
+static inline int rmi_transport_write_report(struct rmi_transport *transport, const uint8_t *report)
+{
+	uint8_t command[RMI_OUTPUT_COMMAND_SIZE];
+
+	rmi_transport_build_command(command, report);
+	return rmi_transport_write(transport, RMI_OUTPUT_REGISTER, command, sizeof(command));
+}
+
+/*
+ * Reads len registers from addr, on the page already selected. Returns
+ * 0 with buf filled in, or a negative error with buf untouched.
+ */
+static inline int rmi_transport_read_block(struct rmi_transport *transport, uint16_t addr,
+	uint8_t *buf, int len)
+{
+	uint8_t report[RMI_OUTPUT_REPORT_SIZE] = { 0 };
+	uint8_t command[RMI_OUTPUT_COMMAND_SIZE];
+	uint8_t input[RMI_INPUT_HEADER_SIZE + RMI_INPUT_REPORT_SIZE];
+	uint8_t *reply = &input[RMI_INPUT_HEADER_SIZE];
+	int ret;
+
+	if (len < 0 || len > RMI_READ_DATA_MAX)
+		return -E2BIG;
+
+	report[0] = RMI_READ_ADDR_REPORT_ID;
+	report[2] = addr & 0xFF;
+	report[3] = (addr >> 8) & 0xFF;
+	report[4] = len & 0xFF;
+	report[5] = (len >> 8) & 0xFF;
+	rmi_transport_build_command(command, report);
+
+	if (transport->atomic_reads) {
+		transport->transactions++;
+		ret = transport->ops->write_read(transport->context, RMI_OUTPUT_REGISTER,
+			command, sizeof(command), input, sizeof(input));
+	}
+	else {
+		ret = rmi_transport_write(transport, RMI_OUTPUT_REGISTER, command, sizeof(command));
+		if (!ret) {
+			transport->transactions++;
+			ret = transport->ops->read(transport->context, input, sizeof(input));
+		}
+	}
+	if (ret)
+		return ret;
+
+	/* READ_DATA carries a reserved byte before the registers */
+	if (reply[0] != RMI_READ_DATA_REPORT_ID) {
+		transport->unanswered++;
+		return -EIO;
+	}
+	for (int i = 0; i < len; i++)
+		buf[i] = reply[i + 2];
+	return 0;
+}
+
+#endif
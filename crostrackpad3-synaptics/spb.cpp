@@ -20,7 +20,12 @@ Revision History:
 
 #include "internal.h"
 #include "hiddevice.h"
-#include "spb.h"
+#include "spbtarget.h"
+
+//
+// The WDK's spb.h, for the transfer lists of IOCTL_SPB_EXECUTE_SEQUENCE
+//
+#include <spb.h>
 
 static ULONG SynaPrintDebugLevel = 100;
 static ULONG SynaPrintDebugCatagories = DBG_INIT || DBG_PNP || DBG_IOCTL;
@@ -443,6 +448,172 @@ exit:
 	return status;
 }
 
+NTSTATUS
+SpbOnlyReadIntoBufferSynchronously(
+	_In_ SPB_CONTEXT *SpbContext,
+	_Out_writes_bytes_(Length) PVOID Data,
+	_In_ ULONG Length
+)
+/*++
+Routine Description:
+This helper routine sends an I2C Read to the Spb I/O target
+straight into the caller's buffer, without going through the
+shared ReadMemory bounce buffer. The buffer must be nonpaged.
+Arguments:
+SpbContext - Pointer to the current device context
+Data       - A nonpaged buffer to receive the data
+Length     - The amount of data to be read
+Return Value:
+NTSTATUS Status indicating success or failure
+--*/
+{
+	WDF_MEMORY_DESCRIPTOR memoryDescriptor;
+	NTSTATUS status;
+	ULONG_PTR bytesRead = 0;
+
+	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+		&memoryDescriptor,
+		Data,
+		Length);
+
+	WdfWaitLockAcquire(SpbContext->SpbLock, NULL);
+
+	status = WdfIoTargetSendReadSynchronously(
+		SpbContext->SpbIoTarget,
+		NULL,
+		&memoryDescriptor,
+		NULL,
+		NULL,
+		&bytesRead);
+
+	WdfWaitLockRelease(SpbContext->SpbLock);
+
+	if (NT_SUCCESS(status) &&
+		bytesRead != Length)
+	{
+		status = STATUS_DEVICE_PROTOCOL_ERROR;
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		SynaPrint(
+			DEBUG_LEVEL_ERROR,
+			DBG_IOCTL,
+			"Error reading from Spb - %!STATUS!",
+			status);
+	}
+
+	return status;
+}
+
+NTSTATUS
+SpbWriteReadSynchronously(
+	_In_ SPB_CONTEXT *SpbContext,
+	_In_ UCHAR Address,
+	_In_reads_bytes_(WriteLength) PVOID WriteData,
+	_In_ ULONG WriteLength,
+	_Out_writes_bytes_(ReadLength) PVOID ReadData,
+	_In_ ULONG ReadLength
+)
+/*++
+Routine Description:
+This helper routine sends an I2C Write followed by an I2C Read to the
+Spb I/O target as one IOCTL_SPB_EXECUTE_SEQUENCE. The controller runs
+both with a repeated start in between, so nothing else on the bus, the
+interrupt handler reading input reports included, can get between the
+request and its reply. Both transfers go through the default buffers.
+Arguments:
+SpbContext  - Pointer to the current device context
+Address     - The I2C register address to write to
+WriteData   - The data payload written after the address
+WriteLength - The amount of data to write
+ReadData    - A buffer to receive the data read back
+ReadLength  - The amount of data to be read
+Return Value:
+NTSTATUS Status indicating success or failure
+--*/
+{
+	SPB_TRANSFER_LIST_AND_ENTRIES(2) sequence;
+	WDF_MEMORY_DESCRIPTOR memoryDescriptor;
+	PUCHAR writeBuffer;
+	PUCHAR readBuffer;
+	NTSTATUS status;
+	ULONG_PTR bytesTransferred = 0;
+
+	if (WriteLength + sizeof(Address) > DEFAULT_SPB_BUFFER_SIZE ||
+		ReadLength > DEFAULT_SPB_BUFFER_SIZE)
+	{
+		SynaPrint(
+			DEBUG_LEVEL_ERROR,
+			DBG_IOCTL,
+			"Spb write-read of %d/%d bytes does not fit the default buffers",
+			WriteLength,
+			ReadLength);
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	WdfWaitLockAcquire(SpbContext->SpbLock, NULL);
+
+	writeBuffer = (PUCHAR)WdfMemoryGetBuffer(SpbContext->WriteMemory, NULL);
+	readBuffer = (PUCHAR)WdfMemoryGetBuffer(SpbContext->ReadMemory, NULL);
+
+	//
+	// The write starts with the address byte, followed by the payload
+	//
+	writeBuffer[0] = Address;
+	RtlCopyMemory(writeBuffer + sizeof(Address), WriteData, WriteLength);
+
+	SPB_TRANSFER_LIST_INIT(&(sequence.List), 2);
+	sequence.List.Transfers[0] = SPB_TRANSFER_LIST_ENTRY_INIT_SIMPLE(
+		SpbTransferDirectionToDevice,
+		0,
+		writeBuffer,
+		WriteLength + sizeof(Address));
+	sequence.List.Transfers[1] = SPB_TRANSFER_LIST_ENTRY_INIT_SIMPLE(
+		SpbTransferDirectionFromDevice,
+		0,
+		readBuffer,
+		ReadLength);
+
+	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+		&memoryDescriptor,
+		(PVOID)&sequence,
+		sizeof(sequence));
+
+	status = WdfIoTargetSendIoctlSynchronously(
+		SpbContext->SpbIoTarget,
+		NULL,
+		IOCTL_SPB_EXECUTE_SEQUENCE,
+		&memoryDescriptor,
+		NULL,
+		NULL,
+		&bytesTransferred);
+
+	if (NT_SUCCESS(status) &&
+		bytesTransferred != WriteLength + sizeof(Address) + ReadLength)
+	{
+		status = STATUS_DEVICE_PROTOCOL_ERROR;
+	}
+
+	if (NT_SUCCESS(status))
+	{
+		RtlCopyMemory(ReadData, readBuffer, ReadLength);
+	}
+
+	WdfWaitLockRelease(SpbContext->SpbLock);
+
+	if (!NT_SUCCESS(status))
+	{
+		SynaPrint(
+			DEBUG_LEVEL_ERROR,
+			DBG_IOCTL,
+			"Error in Spb write-read sequence - %!STATUS!",
+			status);
+	}
+
+	return status;
+}
+
 NTSTATUS
 SpbReadDataSynchronously(
 _In_ SPB_CONTEXT *SpbContext,
@@ -4,7 +4,7 @@ Sample code. Dealpoint ID #843729.
 
 Module Name:
 
-spb.h
+spbtarget.h
 
 Abstract:
 
@@ -45,6 +45,23 @@ SpbOnlyReadDataSynchronously(
 	_In_ ULONG Length
 );
 
+NTSTATUS
+SpbOnlyReadIntoBufferSynchronously(
+	_In_ SPB_CONTEXT *SpbContext,
+	_Out_writes_bytes_(Length) PVOID Data,
+	_In_ ULONG Length
+);
+
+NTSTATUS
+SpbWriteReadSynchronously(
+	_In_ SPB_CONTEXT *SpbContext,
+	_In_ UCHAR Address,
+	_In_reads_bytes_(WriteLength) PVOID WriteData,
+	_In_ ULONG WriteLength,
+	_Out_writes_bytes_(ReadLength) PVOID ReadData,
+	_In_ ULONG ReadLength
+);
+
 NTSTATUS
 SpbReadDataSynchronously(
 _In_ SPB_CONTEXT *SpbContext,
@@ -0,0 +1,158 @@
+//
+// Counts what the ISR costs on the bus, with the simulated sensor
+// standing in for the HID-over-I2C transport: every read is one
+// transaction of the populated ATTN size, not the 42 bytes of a full
+// input report, and the length prefix decides what reaches the gesture
+// engine. Empty reports (the one a device sends after reset, or just
+// the prefix) and reports too short for the data their interrupt bits
+// announce are counted and dropped without touching the gesture state.
+// Reports the device still has queued keep ATTN asserted, each costs
+// one more read and nothing else.
+//
+
+#include "simdevice.h"
+
+#define FULL_READ_SIZE	(RMI_INPUT_HEADER_SIZE + RMI_INPUT_REPORT_SIZE)
+
+static std::vector<uint8_t> with_prefix(const std::vector<uint8_t> &report, uint16_t length)
+{
+	std::vector<uint8_t> in(RMI_INPUT_HEADER_SIZE + report.size());
+
+	in[0] = length & 0xff;
+	in[1] = length >> 8;
+	memcpy(&in[RMI_INPUT_HEADER_SIZE], report.data(), report.size());
+	return in;
+}
+
+/* the gesture engine's state, to see that a read left it alone */
+static std::vector<uint8_t> gesture_state(sim::host &h)
+{
+	const uint8_t *sc = (const uint8_t *)&h.context()->sc;
+
+	return std::vector<uint8_t>(sc, sc + sizeof(h.context()->sc));
+}
+
+/* whole frames: one transaction each, exactly the populated size */
+static void test_frames(sim::host &h)
+{
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	const unsigned int read_size = pDevice->attn_read_size;
+	const uint32_t frames = pDevice->FrameStats.frames;
+	const uint64_t bus_bytes = pDevice->FrameStats.bus_bytes;
+	std::vector<sim::frame> trace = sim::swipe(2, 1000, 800, 20, 10, 30);
+
+	CHECK(read_size == RMI_INPUT_HEADER_SIZE + h.device.attn(sim::frame()).size());
+	CHECK(read_size < FULL_READ_SIZE);
+
+	h.device.reset_counters();
+	for (const sim::frame &f : trace) {
+		h.touch(f);
+		h.run_for(12500);
+	}
+
+	CHECK(pDevice->FrameStats.frames - frames == trace.size());
+	CHECK(h.device.transactions == trace.size() && h.device.reads == trace.size());
+	CHECK(h.device.bytes == trace.size() * read_size);
+	CHECK(pDevice->FrameStats.bus_bytes - bus_bytes == h.device.bytes);
+	CHECK(h.device.empty_reads == 0);
+
+	printf("frames: %zu reads, %llu bytes, %u per frame (a full report is %d)\n",
+		trace.size(), (unsigned long long)h.device.bytes, read_size, FULL_READ_SIZE);
+}
+
+/* frames queued together are drained by the level-triggered ISR */
+static void test_queued(sim::host &h)
+{
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	const uint32_t frames = pDevice->FrameStats.frames;
+	const uint32_t interrupts = h.interrupts;
+	std::vector<sim::frame> trace = sim::swipe(1, 1500, 900, 15, 0, 4);
+
+	h.device.reset_counters();
+	for (const sim::frame &f : trace)
+		h.device.push_attn(f);
+	h.raise_attn();
+
+	CHECK(pDevice->FrameStats.frames - frames == trace.size());
+	CHECK(h.interrupts - interrupts == trace.size());
+	CHECK(h.device.reads == trace.size() && h.device.empty_reads == 0);
+	h.run_for(1000000);
+}
+
+/* no data: a read each, nothing for the gesture engine */
+static void test_empty(sim::host &h)
+{
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	const uint32_t frames = pDevice->FrameStats.frames;
+	const uint32_t empty = pDevice->FrameStats.empty_reads;
+	const size_t reports = h.reports.size();
+	std::vector<uint8_t> sc = gesture_state(h);
+	sim::frame f = {};
+
+	f.slot[0] = sim::finger(1000, 800);
+	std::vector<uint8_t> attn = h.device.attn(f);
+
+	h.device.reset_counters();
+	h.device.push_input(with_prefix(std::vector<uint8_t>(), 0));		/* after reset */
+	h.device.push_input(with_prefix(std::vector<uint8_t>(), RMI_INPUT_HEADER_SIZE));
+	h.device.push_input(with_prefix(attn, 0));				/* stale bytes */
+	h.raise_attn();
+
+	CHECK(h.device.reads == 3 && h.device.transactions == 3);
+	CHECK(pDevice->FrameStats.empty_reads - empty == 3);
+	CHECK(pDevice->FrameStats.frames - frames == 0);
+	CHECK(h.reports.size() == reports);
+	CHECK(gesture_state(h) == sc);
+}
+
+/* shorter than the data its interrupt bits announce */
+static void test_short(sim::host &h)
+{
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	const uint32_t frames = pDevice->FrameStats.frames;
+	const uint32_t shorts = pDevice->FrameStats.short_reads;
+	sim::frame f = {};
+
+	f.slot[0] = sim::finger(1000, 800);
+	std::vector<uint8_t> attn = h.device.attn(f);
+	std::vector<uint8_t> sc = gesture_state(h);
+
+	h.device.reset_counters();
+	for (size_t cut = 1; cut <= 3; cut++) {
+		std::vector<uint8_t> truncated(attn.begin(), attn.end() - cut);
+
+		h.device.push_input(with_prefix(truncated, (uint16_t)(RMI_INPUT_HEADER_SIZE + truncated.size())));
+	}
+	h.raise_attn();
+
+	CHECK(h.device.reads == 3);
+	CHECK(pDevice->FrameStats.short_reads - shorts == 3);
+	CHECK(pDevice->FrameStats.frames - frames == 0);
+	CHECK(gesture_state(h) == sc);
+
+	/* a whole one still goes through */
+	h.device.reset_counters();
+	h.touch(f);
+	h.run_for(0);
+	CHECK(pDevice->FrameStats.frames - frames == 1);
+	CHECK(pDevice->FrameStats.short_reads - shorts == 3);
+	h.touch(sim::frame());
+	h.run_for(1000000);
+}
+
+int main()
+{
+	sim::sensor_config config;
+	sim::host h(config);
+
+	h.start();
+	h.run_for(100000);
+
+	test_frames(h);
+	test_queued(h);
+	test_empty(h);
+	test_short(h);
+
+	h.stop();
+	return 0;
+}
@@ -0,0 +1,131 @@
+//
+// Replays the same strokes through the whole driver on the simulated
+// device with BatchInput off and on, and compares what the HID class
+// driver read: how many relative mouse reports it took to deliver the
+// motion, whether all of the motion arrived, and whether the button
+// changes came in the same order.
+//
+// Batches only form when several frames are drained together, so the
+// runs use the polled consumer, where the 10ms timer drains whatever
+// queued since the last tick, at the sensor's usual rate and at a rate
+// that queues several frames per tick. A last run keeps a single read
+// pending and has the class driver stall for a while, the way a busy
+// system would.
+//
+// Usage: batch_replay
+//
+
+#include "simdevice.h"
+
+#define STROKE_FRAMES	120
+#define SETTLE_US	2000000
+
+struct scenario {
+	const char *name;
+	int rate;
+	bool event_driven;
+	int reads;
+	bool stall;
+};
+
+struct result {
+	size_t mouse_reports;
+	size_t frames;
+	long x;
+	long y;
+	std::vector<int> buttons;
+};
+
+//
+// A pointer move, then a press of the physical button with the finger
+// still moving, a drag, and a release before the finger lifts
+//
+static std::vector<sim::frame> script()
+{
+	std::vector<sim::frame> trace;
+
+	for (int i = 0; i < STROKE_FRAMES; i++) {
+		sim::frame f = {};
+
+		f.slot[0] = sim::finger((uint16_t)(600 + 15 * i), (uint16_t)(500 + 6 * i));
+		f.button = i >= STROKE_FRAMES / 3 && i < 2 * STROKE_FRAMES / 3;
+		trace.push_back(f);
+	}
+	trace.push_back(sim::frame());
+	return trace;
+}
+
+static result replay(const scenario &s, bool batch)
+{
+	const uint64_t period = 1000000 / s.rate;
+	sim::sensor_config config;
+	sim::options opts;
+	std::vector<sim::frame> trace = script();
+	result r = {};
+
+	opts.event_driven = s.event_driven;
+	opts.batch = batch;
+	opts.reads = s.reads;
+	sim::host h(config, opts);
+	h.start();
+
+	uint64_t start = h.now();
+	for (size_t i = 0; i < trace.size(); i++)
+		h.schedule(start + i * period, trace[i]);
+
+	if (s.stall) {
+		/* the class driver stops reading for 100ms in the middle of the drag */
+		h.run_until(start + trace.size() / 2 * period);
+		h.hold_reads(true);
+		h.run_for(100000);
+		h.hold_reads(false);
+	}
+	h.run_until(start + trace.size() * period + SETTLE_US);
+
+	int button = 0;
+	for (const sim::report &rep : h.reports) {
+		if (rep.id() != REPORTID_RELATIVE_MOUSE)
+			continue;
+		const syna::SynaRelativeMouseReport *m = (const syna::SynaRelativeMouseReport *)rep.data.data();
+
+		r.mouse_reports++;
+		r.x += m->XValue;
+		r.y += m->YValue;
+		if (m->Button != button) {
+			button = m->Button;
+			r.buttons.push_back(button);
+		}
+	}
+	r.frames = h.context()->FrameStats.frames;
+	h.stop();
+	return r;
+}
+
+int main()
+{
+	static const scenario scenarios[] = {
+		{ "polled 80Hz",		80, false, 2, false },
+		{ "polled 125Hz",		125, false, 2, false },
+		{ "polled 400Hz",		400, false, 2, false },
+		{ "event 125Hz, stall",		125, true, 1, true },
+		{ "polled 400Hz, stall",	400, false, 1, true },
+	};
+
+	for (const scenario &s : scenarios) {
+		result single = replay(s, false);
+		result batch = replay(s, true);
+
+		printf("%-20s frames %4zu  per-frame: %4zu reports, motion %5ld,%5ld  "
+			"batch: %4zu reports, motion %5ld,%5ld\n",
+			s.name, batch.frames,
+			single.mouse_reports, single.x, single.y,
+			batch.mouse_reports, batch.x, batch.y);
+
+		/* the same frames, every delta delivered, buttons in order */
+		CHECK(single.frames == batch.frames);
+		CHECK(batch.x == single.x && batch.y == single.y);
+		CHECK(batch.buttons == single.buttons && single.buttons.size() == 2);
+		CHECK(batch.mouse_reports <= single.mouse_reports);
+	}
+	return 0;
+}
@@ -0,0 +1,200 @@
+//
+// Cold against warm bring-up. The first start on a machine runs the
+// whole populate and stores the capability snapshot in the device's
+// hardware key, a second start on the same machine checks the firmware
+// id with one read and takes the rest from the snapshot. Both have to
+// leave the driver the same: functions, geometry, ATTN layout and the
+// control registers on the sensor.
+//
+// A snapshot of other firmware, a damaged one and one whose checksum is
+// right but whose values a populate could not have come up with all
+// have to fall back to the full scan.
+//
+// The cost is the bus transactions and bytes of the start, the bus
+// time at 400kHz with nine clocks to a byte and an address byte to
+// each transaction, and the host time of the whole simulated start,
+// best of a few runs.
+//
+// Usage: capability_bench
+//
+
+#include "simdevice.h"
+
+#include <algorithm>
+#include <chrono>
+
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+#define I2C_HZ		400000
+#define BENCH_RUNS	20
+
+struct bringup {
+	uint32_t transactions;
+	uint32_t register_reads;
+	uint64_t bytes;
+	uint64_t host_ns;
+};
+
+static uint64_t bus_us(const bringup &b)
+{
+	return (b.bytes + b.transactions) * 9 * 1000000 / I2C_HZ;
+}
+
+/* what a start leaves behind that the snapshot has to reproduce */
+struct state {
+	syna::rmi_function f01, f11, f30;
+	unsigned long max_fingers, x_size_mm, y_size_mm;
+	uint16_t max_x, max_y;
+	uint8_t interrupt_enable_mask;
+	syna::rmi_decode_plan plan;
+	int attn_read_size;
+	std::vector<uint8_t> registers;
+};
+
+static state snapshot_of(sim::host &h)
+{
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	state s;
+
+	s.f01 = pDevice->f01;
+	s.f11 = pDevice->f11;
+	s.f30 = pDevice->f30;
+	s.max_fingers = pDevice->max_fingers;
+	s.x_size_mm = pDevice->x_size_mm;
+	s.y_size_mm = pDevice->y_size_mm;
+	s.max_x = pDevice->max_x;
+	s.max_y = pDevice->max_y;
+	s.interrupt_enable_mask = pDevice->interrupt_enable_mask;
+	s.plan = pDevice->decode_plan;
+	s.attn_read_size = pDevice->attn_read_size;
+	s.registers.assign(h.device.registers, h.device.registers + sizeof(h.device.registers));
+	return s;
+}
+
+static void compare(const state &a, const state &b)
+{
+	CHECK(memcmp(&a.f01, &b.f01, sizeof(a.f01)) == 0);
+	CHECK(memcmp(&a.f11, &b.f11, sizeof(a.f11)) == 0);
+	CHECK(memcmp(&a.f30, &b.f30, sizeof(a.f30)) == 0);
+	CHECK(a.max_fingers == b.max_fingers);
+	CHECK(a.x_size_mm == b.x_size_mm && a.y_size_mm == b.y_size_mm);
+	CHECK(a.max_x == b.max_x && a.max_y == b.max_y);
+	CHECK(a.interrupt_enable_mask == b.interrupt_enable_mask);
+	CHECK(memcmp(&a.plan, &b.plan, sizeof(a.plan)) == 0);
+	CHECK(a.attn_read_size == b.attn_read_size);
+	CHECK(a.registers == b.registers);
+}
+
+/* starts a device on the machine, and checks it scans */
+static bringup start(const sim::sensor_config &config, sim::registry *machine, state *out = nullptr)
+{
+	bringup b;
+	sim::host h(config, sim::options(), machine);
+
+	h.device.reset_counters();
+	steady_clock::time_point begin = steady_clock::now();
+	h.start();
+	b.host_ns = std::chrono::duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+	b.transactions = h.device.transactions;
+	b.register_reads = h.device.register_reads;
+	b.bytes = h.device.bytes;
+
+	sim::frame f = {};
+	f.slot[0] = sim::finger(1000, 800);
+	h.touch(f);
+	h.run_for(20000);
+	h.touch(sim::frame());
+	h.run_for(200000);
+	CHECK(!h.reports.empty());
+
+	if (out)
+		*out = snapshot_of(h);
+	h.stop();
+	return b;
+}
+
+static void print(const char *what, const bringup &b)
+{
+	printf("%-28s %3u transactions %3u register reads %5llu bytes %6llu us on the bus %7.1f us host\n",
+		what, b.transactions, b.register_reads, (unsigned long long)b.bytes,
+		(unsigned long long)bus_us(b), b.host_ns / 1000.0);
+}
+
+static syna::rmi_capabilities *stored(sim::registry &machine)
+{
+	sim::registry::value &v = machine.device[L"RmiCapabilities"];
+
+	CHECK(v.type == REG_BINARY && v.data.size() == sizeof(syna::rmi_capabilities));
+	return (syna::rmi_capabilities *)v.data.data();
+}
+
+static void measure(const char *name, sim::sensor_config config)
+{
+	bringup cold = {}, warm = {};
+	state cold_state, warm_state;
+
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		sim::registry machine;
+		bringup c = start(config, &machine, &cold_state);
+		CHECK(machine.device.count(L"RmiCapabilities"));
+		bringup w = start(config, &machine, &warm_state);
+
+		if (!run || c.host_ns < cold.host_ns)
+			cold = c;
+		if (!run || w.host_ns < warm.host_ns)
+			warm = w;
+	}
+	compare(cold_state, warm_state);
+
+	printf("%s\n", name);
+	print("  cold", cold);
+	print("  warm", warm);
+	CHECK(warm.transactions < cold.transactions);
+
+	/* the same machine after a firmware update */
+	sim::registry machine;
+	start(config, &machine);
+	sim::sensor_config updated = config;
+	updated.firmware_id = config.firmware_id + 1;
+	bringup other = start(updated, &machine);
+	print("  other firmware", other);
+	CHECK(other.transactions > cold.transactions);
+	CHECK(stored(machine)->firmware_id == updated.firmware_id);
+	CHECK(start(updated, &machine).transactions == warm.transactions);
+
+	/* a bit flipped in the registry */
+	stored(machine)->y_size_mm ^= 0x10;
+	bringup damaged = start(updated, &machine);
+	print("  damaged snapshot", damaged);
+	CHECK(damaged.transactions == cold.transactions);
+
+	/* a checksum that is right over a finger count that is not */
+	syna::rmi_capabilities *caps = stored(machine);
+	caps->max_fingers = F11_DECODE_FINGERS + 1;
+	caps->checksum = syna::rmi_capabilities_checksum(caps);
+	bringup bad = start(updated, &machine);
+	print("  out of range snapshot", bad);
+	CHECK(bad.transactions == cold.transactions);
+	CHECK(stored(machine)->max_fingers == (uint32_t)updated.fingers);
+}
+
+int main()
+{
+	sim::sensor_config config;
+
+	measure("5 fingers, F01 F11 F30", config);
+
+	config.fingers = 10;
+	config.data40 = true;
+	config.dribble = true;
+	config.palm = true;
+	config.f01_ctrl1 = 0;
+	measure("10 fingers, every control fixed up", config);
+
+	config = sim::sensor_config();
+	config.f11_page = 1;
+	config.f30 = false;
+	measure("F11 on page 1, no F30", config);
+	return 0;
+}
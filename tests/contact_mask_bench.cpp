@@ -0,0 +1,98 @@
+//
+// What a frame costs the decoder and the gesture engine with 0 to 10
+// fingers down, on a 10-finger sensor and on a 5-finger one. The
+// gesture stages walk the active, added and released masks, so an
+// empty frame should cost the same whatever the slot capacity, and each
+// finger down should add about the same.
+//
+// The time is the driver's own TrackpadRawInput on ATTN reports from
+// the simulated sensor, decode included, best of a few runs, with the
+// fingers moving so every stage has work.
+//
+// Usage: contact_mask_bench
+//
+
+#include "simdevice.h"
+
+#include <algorithm>
+#include <chrono>
+
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+namespace syna {
+void TrackpadRawInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t *report, int reportSize, uint64_t timestamp);
+}
+
+#define BENCH_FRAMES		2000
+#define BENCH_RUNS		5
+#define FRAME_INTERVAL_US	8000
+
+static sim::frame fingers_down(int fingers, int i)
+{
+	sim::frame f = {};
+
+	for (int n = 0; n < fingers; n++)
+		f.slot[n] = sim::finger((uint16_t)(300 + 500 * (n % 5) + (i % 40) * 6),
+			(uint16_t)(400 + 700 * (n / 5) + (i % 25) * 8));
+	return f;
+}
+
+static uint64_t bench(sim::host &h, int fingers)
+{
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	std::vector<std::vector<uint8_t>> reports;
+	uint64_t best = UINT64_MAX;
+	uint64_t timestamp = h.now();
+
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		reports.push_back(h.device.attn(fingers_down(fingers, i)));
+	reports.push_back(h.device.attn(sim::frame()));
+
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		steady_clock::time_point begin = steady_clock::now();
+
+		for (std::vector<uint8_t> &report : reports) {
+			timestamp += FRAME_INTERVAL_US;
+			syna::TrackpadRawInput(pDevice, &pDevice->sc, report.data(), (int)report.size(), timestamp);
+		}
+		uint64_t elapsed = std::chrono::duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+		best = std::min(best, elapsed / reports.size());
+
+		/* let the class driver catch up between runs */
+		h.reports.clear();
+		h.run_for(100000);
+	}
+	return best;
+}
+
+static std::vector<uint64_t> sensor(int slots)
+{
+	sim::sensor_config config;
+	std::vector<uint64_t> ns;
+
+	config.fingers = slots;
+	sim::host h(config);
+	h.start();
+	CHECK(h.context()->sc.maxcontacts == slots);
+
+	for (int fingers = 0; fingers <= slots; fingers++)
+		ns.push_back(bench(h, fingers));
+	h.stop();
+	return ns;
+}
+
+int main()
+{
+	std::vector<uint64_t> ten = sensor(10);
+	std::vector<uint64_t> five = sensor(5);
+
+	printf("fingers  10 slots  5 slots  (ns/frame)\n");
+	for (size_t fingers = 0; fingers < ten.size(); fingers++) {
+		printf("%7zu  %8llu", fingers, (unsigned long long)ten[fingers]);
+		if (fingers < five.size())
+			printf("  %7llu", (unsigned long long)five[fingers]);
+		printf("\n");
+	}
+	return 0;
+}
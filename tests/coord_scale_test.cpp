@@ -0,0 +1,95 @@
+//
+// Checks the Q32 coordinate transform rmi_f11_process_touch uses against
+// the integer math it replaced, x * resx / max_x and
+// (max_y - y) * resy / max_y, for every 12-bit coordinate the F11
+// finger block can carry, on a spread of pad sizes and at the edges of
+// the range. Raw Y beyond max_y is clamped, where the
+// old code went negative, so the reference clamps it too.
+//
+// Every coordinate goes through the driver as it runs: the sensor is
+// populated from its queries, the scale is set at D0 entry, and the
+// contact is decoded from an ATTN report by TrackpadRawInput.
+//
+
+#include "simdevice.h"
+
+#include <algorithm>
+
+namespace syna {
+void TrackpadRawInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t *report, int reportSize, uint64_t timestamp);
+}
+
+#define COORD_MAX	4095		/* 12-bit F11 positions */
+
+struct geometry {
+	uint16_t max_x;
+	uint16_t max_y;
+	uint16_t x_size;		/* 0.1mm, as F11 query reports it */
+	uint16_t y_size;
+};
+
+static void sweep(const geometry &g)
+{
+	sim::sensor_config config;
+
+	config.max_x = g.max_x;
+	config.max_y = g.max_y;
+	config.x_size = g.x_size;
+	config.y_size = g.y_size;
+	sim::host h(config);
+	h.start();
+
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	syna::csgesture_softc *sc = &pDevice->sc;
+	const int64_t resx = sc->resx;
+	const int64_t resy = sc->resy;
+	const int64_t max_x = pDevice->max_x;
+	const int64_t max_y = pDevice->max_y;
+	uint64_t timestamp = h.now();
+
+	CHECK(max_x == g.max_x && max_y == g.max_y);
+	CHECK(resx == g.x_size / 10 * 10 && resy == g.y_size / 10 * 10);
+
+	for (int v = 0; v <= COORD_MAX; v++) {
+		sim::frame f = {};
+
+		/* the same raw value on both axes, and the reverse on a second finger */
+		f.slot[0] = sim::finger((uint16_t)v, (uint16_t)v);
+		f.slot[1] = sim::finger((uint16_t)(COORD_MAX - v), (uint16_t)(COORD_MAX - v));
+		std::vector<uint8_t> report = h.device.attn(f);
+
+		timestamp += 10000;
+		syna::TrackpadRawInput(pDevice, sc, report.data(), (int)report.size(), timestamp);
+
+		for (int slot = 0; slot < 2; slot++) {
+			int64_t raw = slot ? COORD_MAX - v : v;
+			int64_t x = raw * resx / max_x;
+			int64_t y = (max_y - std::min(raw, max_y)) * resy / max_y;
+
+			CHECK(sc->contact[slot].x == x);
+			CHECK(sc->contact[slot].y == y);
+		}
+	}
+
+	printf("max %4d x %4d, %3d x %3d mm: %d coordinates per axis identical\n",
+		g.max_x, g.max_y, g.x_size / 10, g.y_size / 10, COORD_MAX + 1);
+	h.stop();
+}
+
+int main()
+{
+	static const geometry geometries[] = {
+		{ 3000, 1800, 1000, 600 },	/* pads from 60mm to 105mm wide */
+		{ 2936, 1676, 960, 550 },
+		{ 3678, 2170, 1050, 610 },
+		{ 1939, 1094, 850, 480 },
+		{ 1218, 672, 600, 330 },
+		{ 4095, 4095, 1200, 700 },	/* the edges of the range */
+		{ 4095, 1, 1000, 600 },
+		{ 255, 4095, 600, 990 },
+	};
+
+	for (const geometry &g : geometries)
+		sweep(g);
+	return 0;
+}
@@ -0,0 +1,130 @@
+//
+// What parsing an ATTN report costs per frame through the decode plan,
+// by which functions fired: neither, F30 only, F11 only and both, on a
+// few PDT layouts. A report with no data only pays for the header and
+// the gesture engine on contacts that did not change, so the others
+// over it are what the segments cost, and a segment whose interrupt bit
+// is clear should cost nothing.
+//
+// The time is the driver's own TrackpadRawInput, best of a few runs,
+// with the reports packed the way the device sends them.
+//
+// Usage: decode_plan_bench
+//
+
+#include "simdevice.h"
+
+#include <algorithm>
+#include <chrono>
+
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+namespace syna {
+void TrackpadRawInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t *report, int reportSize, uint64_t timestamp);
+}
+
+#define BENCH_FRAMES		2000
+#define BENCH_RUNS		5
+#define FRAME_INTERVAL_US	8000
+
+/* the full report with the blocks of the functions not in irq taken out */
+static std::vector<uint8_t> packed(const sim::sensor &s, const sim::frame &f, uint8_t irq)
+{
+	std::vector<uint8_t> full = s.attn(f);
+	std::vector<uint8_t> report(full.begin(), full.begin() + RMI_ATTN_HEADER_SIZE);
+	bool f30_first = s.irq_f30 && s.irq_f30 < s.irq_f11;
+	size_t f11 = RMI_ATTN_HEADER_SIZE + (f30_first ? s.f30_size : 0);
+	size_t f30 = f30_first ? RMI_ATTN_HEADER_SIZE : RMI_ATTN_HEADER_SIZE + s.f11_size;
+
+	report[1] = irq;
+	for (int pass = 0; pass < 2; pass++) {
+		bool is_f30 = (pass == 0) == f30_first;
+		uint8_t bit = is_f30 ? s.irq_f30 : s.irq_f11;
+		size_t at = is_f30 ? f30 : f11;
+		size_t length = is_f30 ? s.f30_size : s.f11_size;
+
+		if (bit & irq)
+			report.insert(report.end(), full.begin() + at, full.begin() + at + length);
+	}
+	return report;
+}
+
+/* two fingers resting and the button up, every kind of frame leaves the same state */
+static sim::frame resting()
+{
+	sim::frame f = {};
+
+	f.slot[0] = sim::finger(1000, 800);
+	f.slot[1] = sim::finger(1600, 800);
+	return f;
+}
+
+static uint64_t bench(sim::host &h, uint8_t irq)
+{
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	std::vector<std::vector<uint8_t>> reports;
+	uint64_t best = UINT64_MAX;
+	uint64_t timestamp = h.now();
+
+	/* the contacts and button are down before the timed frames */
+	std::vector<uint8_t> first = h.device.attn(resting());
+	syna::TrackpadRawInput(pDevice, &pDevice->sc, first.data(), (int)first.size(), timestamp);
+
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		reports.push_back(packed(h.device, resting(), irq));
+
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		steady_clock::time_point begin = steady_clock::now();
+
+		for (std::vector<uint8_t> &report : reports) {
+			timestamp += FRAME_INTERVAL_US;
+			syna::TrackpadRawInput(pDevice, &pDevice->sc, report.data(), (int)report.size(), timestamp);
+		}
+		uint64_t elapsed = std::chrono::duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+		best = std::min(best, elapsed / reports.size());
+	}
+
+	/* lift and let the class driver catch up */
+	std::vector<uint8_t> lift = h.device.attn(sim::frame());
+	syna::TrackpadRawInput(pDevice, &pDevice->sc, lift.data(), (int)lift.size(), timestamp + FRAME_INTERVAL_US);
+	h.reports.clear();
+	h.run_for(timestamp + FRAME_INTERVAL_US - h.now() + 1000000);
+	h.reports.clear();
+	return best;
+}
+
+int main()
+{
+	static const struct {
+		const char *name;
+		int fingers;
+		bool data40;
+		int f11_page;
+	} layouts[] = {
+		{ "5 fingers, F11 then F30", 5, false, 0 },
+		{ "5 fingers, F30 then F11", 5, false, 1 },
+		{ "10 fingers with data 40", 10, true, 0 },
+	};
+
+	printf("%-26s  none  F30  F11  both  (ns/frame)\n", "layout");
+	for (const auto &l : layouts) {
+		sim::sensor_config config;
+
+		config.fingers = l.fingers;
+		config.data40 = l.data40;
+		config.f11_page = l.f11_page;
+		sim::host h(config);
+		h.start();
+
+		uint64_t none = bench(h, 0);
+		uint64_t f30 = bench(h, h.device.irq_f30);
+		uint64_t f11 = bench(h, h.device.irq_f11);
+		uint64_t both = bench(h, h.device.irq_f11 | h.device.irq_f30);
+
+		printf("%-26s  %4llu  %3llu  %3llu  %4llu\n", l.name, (unsigned long long)none,
+			(unsigned long long)f30, (unsigned long long)f11, (unsigned long long)both);
+		h.stop();
+	}
+	return 0;
+}
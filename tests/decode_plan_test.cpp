@@ -0,0 +1,164 @@
+//
+// Checks the ATTN decode plan against synthetic PDT layouts: 1 to 10
+// fingers, with and without data 40, with and without F30, and with F11
+// on the first PDT page or on a second one behind F30, which puts F30's
+// interrupt bit, and its data, first. The plan built at populate time
+// must have one segment per function, in interrupt order, with the
+// sensor's lengths, offsets and irq masks, and the F30 button masks.
+//
+// Then reports with every combination of interrupt bits go through the
+// driver's TrackpadRawInput, packed the way the device sends them with
+// only the blocks of the functions that fired. The contacts must be
+// those of the last frame with F11 data and the button that of the last
+// one with F30 data.
+//
+
+#include "simdevice.h"
+
+namespace syna {
+void TrackpadRawInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t *report, int reportSize, uint64_t timestamp);
+}
+
+#define FRAMES		400
+
+static uint32_t seed = 1;
+
+static int pick(int n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (int)((seed >> 16) % n);
+}
+
+/* the full report with the blocks of the functions not in irq taken out */
+static std::vector<uint8_t> packed(const sim::sensor &s, const sim::frame &f, uint8_t irq)
+{
+	std::vector<uint8_t> full = s.attn(f);
+	std::vector<uint8_t> report(full.begin(), full.begin() + RMI_ATTN_HEADER_SIZE);
+	bool f30_first = s.irq_f30 && s.irq_f30 < s.irq_f11;
+	size_t f11 = RMI_ATTN_HEADER_SIZE + (f30_first ? s.f30_size : 0);
+	size_t f30 = f30_first ? RMI_ATTN_HEADER_SIZE : RMI_ATTN_HEADER_SIZE + s.f11_size;
+
+	report[1] = irq;
+	for (int pass = 0; pass < 2; pass++) {
+		bool is_f30 = (pass == 0) == f30_first;
+		uint8_t bit = is_f30 ? s.irq_f30 : s.irq_f11;
+		size_t at = is_f30 ? f30 : f11;
+		size_t length = is_f30 ? s.f30_size : s.f11_size;
+
+		if (bit & irq)
+			report.insert(report.end(), full.begin() + at, full.begin() + at + length);
+	}
+	return report;
+}
+
+static void check_plan(sim::host &h)
+{
+	const sim::sensor &s = h.device;
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	const syna::rmi_decode_plan &plan = pDevice->decode_plan;
+	bool f30_first = s.irq_f30 && s.irq_f30 < s.irq_f11;
+
+	CHECK(plan.count == (s.config.f30 ? 2u : 1u));
+	for (unsigned int i = 0; i < plan.count; i++) {
+		const syna::rmi_decode_segment &seg = plan.segment[i];
+		bool is_f30 = seg.type == syna::RMI_SEGMENT_F30;
+
+		CHECK(i == 0 || plan.segment[i - 1].irq_mask < seg.irq_mask);
+		CHECK(seg.irq_mask == (is_f30 ? s.irq_f30 : s.irq_f11));
+		CHECK(seg.length == (is_f30 ? s.f30_size : s.f11_size));
+		CHECK(seg.offset == RMI_ATTN_HEADER_SIZE +
+			(is_f30 ? (f30_first ? 0 : s.f11_size) : (f30_first ? s.f30_size : 0)));
+	}
+	CHECK(pDevice->attn_report_size == RMI_ATTN_HEADER_SIZE + s.f11_size + s.f30_size);
+	CHECK(syna::rmi_plan_data_size(&plan, s.irq_f11) == s.f11_size);
+	CHECK(syna::rmi_plan_data_size(&plan, s.irq_f30) == s.f30_size);
+
+	/* GPIO 0 is never a button, the button has a pull up and inverts */
+	if (s.config.f30) {
+		CHECK(plan.button_mask & SIM_F30_BUTTON);
+		CHECK(plan.button_invert & SIM_F30_BUTTON);
+		CHECK(!(plan.button_mask & 1));
+	}
+	else {
+		CHECK(plan.button_mask == 0 && plan.button_invert == 0);
+	}
+}
+
+static void check_decode(sim::host &h)
+{
+	const sim::sensor &s = h.device;
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	syna::csgesture_softc *sc = &pDevice->sc;
+	const int fingers = s.config.fingers;
+	sim::frame contacts = {};		/* what the driver should have */
+	bool button = false;
+	uint64_t timestamp = h.now();
+
+	for (int n = 0; n < FRAMES; n++) {
+		sim::frame f = {};
+		uint8_t irq = 0;
+
+		for (int i = 0; i < fingers; i++) {
+			if (pick(3))
+				f.slot[i] = sim::finger((uint16_t)(100 + pick(2800)), (uint16_t)(100 + pick(1600)));
+		}
+		f.button = s.config.f30 && pick(2);
+		if (pick(4))
+			irq |= s.irq_f11;
+		if (pick(4))
+			irq |= s.irq_f30;
+
+		std::vector<uint8_t> report = packed(s, f, irq);
+		timestamp += 10000;
+		syna::TrackpadRawInput(pDevice, sc, report.data(), (int)report.size(), timestamp);
+
+		if (irq & s.irq_f11)
+			contacts = f;
+		if (irq & s.irq_f30)
+			button = f.button;
+
+		for (int i = 0; i < fingers; i++) {
+			const sim::contact &c = contacts.slot[i];
+
+			if (!c.present) {
+				CHECK(sc->contact[i].x == -1);
+				continue;
+			}
+			CHECK(sc->contact[i].x == (int)(c.x * sc->resx / pDevice->max_x));
+			CHECK(sc->contact[i].y == (int)((pDevice->max_y - c.y) * sc->resy / pDevice->max_y));
+		}
+		CHECK(sc->buttondown == button);
+	}
+
+	/* lift everything */
+	std::vector<uint8_t> lift = s.attn(sim::frame());
+	syna::TrackpadRawInput(pDevice, sc, lift.data(), (int)lift.size(), timestamp + 10000);
+	h.run_for(timestamp + 10000 - h.now() + 1000000);
+}
+
+int main()
+{
+	static const int finger_counts[] = { 1, 2, 3, 5, 10 };
+	int layouts = 0;
+
+	for (int fingers : finger_counts)
+		for (int data40 = 0; data40 < 2; data40++)
+			for (int f30 = 0; f30 < 2; f30++)
+				for (int page = 0; page < 2; page++) {
+					sim::sensor_config config;
+
+					config.fingers = fingers;
+					config.data40 = data40;
+					config.f30 = f30;
+					config.f11_page = page;
+					sim::host h(config);
+					h.start();
+					check_plan(h);
+					check_decode(h);
+					h.stop();
+					layouts++;
+				}
+
+	printf("%d PDT layouts: plans match, %d packed reports each decoded\n", layouts, FRAMES);
+	return 0;
+}
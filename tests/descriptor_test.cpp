@@ -0,0 +1,197 @@
+//
+// Parses the report descriptor the driver hands the class driver and
+// checks it against the report structures: 16-bit relative X and Y,
+// a 16-bit wheel and AC Pan, each behind its Resolution Multiplier
+// feature, and every report the same length as the structure the
+// driver fills. The multipliers round trip through SET_FEATURE and
+// GET_FEATURE, and a scroll control write is accepted and ignored.
+//
+// Then the same fast strokes are replayed with the pointer multiplier
+// at 1x and 4x, and a scroll with whole detents and with the high
+// resolution wheel. Every mouse report is read back through the
+// parsed descriptor. At 4x the deltas go well past what 8 bits held,
+// and must sum to exactly four times the 1x motion, nothing wrapped or
+// lost. The high resolution wheel must scroll as far as the detents,
+// in finer steps.
+//
+
+#include "simdevice.h"
+#include "hiddescriptor.h"
+
+using syna::BYTE;
+using syna::NTSTATUS;
+
+#define USAGE_X			0x00010030
+#define USAGE_Y			0x00010031
+#define USAGE_WHEEL		0x00010038
+#define USAGE_MULTIPLIER	0x00010048
+#define USAGE_AC_PAN		0x000c0238
+
+#define FRAME_US		10000
+#define SETTLE_US		2000000
+
+static void check_axis(const hid::descriptor &d, uint32_t usage, size_t offset)
+{
+	const hid::field *f = d.find(hid::INPUT, REPORTID_RELATIVE_MOUSE, usage);
+
+	CHECK(f != nullptr);
+	CHECK(f->size == 16 && (f->flags & hid::RELATIVE) && (f->flags & hid::VARIABLE));
+	CHECK(f->logical_min == -RELATIVE_MOUSE_MAX_COORDINATE && f->logical_max == RELATIVE_MOUSE_MAX_COORDINATE);
+
+	/* X and Y share a field, the element is the usage's place in it */
+	unsigned int element = 0;
+	while (f->usage(element) != usage)
+		element++;
+	CHECK(f->bit + 16 * element == 8 * (offset - 1));
+}
+
+static hid::descriptor check_descriptor(sim::host &h)
+{
+	std::vector<uint8_t> bytes = h.report_descriptor();
+	hid::descriptor d = hid::parse(bytes.data(), bytes.size());
+
+	check_axis(d, USAGE_X, offsetof(syna::SynaRelativeMouseReport, XValue));
+	check_axis(d, USAGE_Y, offsetof(syna::SynaRelativeMouseReport, YValue));
+	check_axis(d, USAGE_WHEEL, offsetof(syna::SynaRelativeMouseReport, WheelPosition));
+	check_axis(d, USAGE_AC_PAN, offsetof(syna::SynaRelativeMouseReport, HWheelPosition));
+
+	/* one multiplier for each wheel, 1 to WHEEL_DETENT steps */
+	int multipliers = 0;
+	for (const hid::field &f : d.fields) {
+		if (f.kind != hid::FEATURE || f.usage(0) != USAGE_MULTIPLIER)
+			continue;
+		CHECK(f.report_id == REPORTID_MULTIPLIER && f.size == 2 && f.count == 1);
+		CHECK(f.logical_min == 0 && f.logical_max == 1);
+		CHECK(f.physical_min == 1 && f.physical_max == WHEEL_DETENT);
+		CHECK(f.bit == (multipliers ? MULTIPLIER_HWHEEL_SHIFT : 0u));
+		multipliers++;
+	}
+	CHECK(multipliers == 2);
+
+	CHECK(d.bytes(hid::INPUT, REPORTID_RELATIVE_MOUSE) == sizeof(syna::SynaRelativeMouseReport));
+	CHECK(d.bytes(hid::INPUT, REPORTID_KEYBOARD) == sizeof(syna::SynaKeyboardReport));
+	CHECK(d.bytes(hid::FEATURE, REPORTID_MULTIPLIER) == sizeof(syna::SynaMultiplierReport));
+	CHECK(d.bytes(hid::OUTPUT, REPORTID_SCROLLCTRL) == sizeof(syna::SynaScrollControlReport));
+	CHECK(d.bytes(hid::OUTPUT, REPORTID_SETTINGS) == sizeof(syna::SynaSettingsReport));
+	return d;
+}
+
+static void check_features(sim::host &h)
+{
+	syna::SynaMultiplierReport report = { REPORTID_MULTIPLIER, 0xff };
+
+	/* feature reads complete right away, they used to be left pending */
+	CHECK(h.get_feature(&report, sizeof(report)) == STATUS_SUCCESS);
+	CHECK(report.ReportID == REPORTID_MULTIPLIER && report.Multipliers == 0);
+
+	report.Multipliers = 1 | 1 << MULTIPLIER_HWHEEL_SHIFT;
+	CHECK(NT_SUCCESS(h.set_feature(&report, sizeof(report))));
+	report.Multipliers = 0;
+	CHECK(h.get_feature(&report, sizeof(report)) == STATUS_SUCCESS);
+	CHECK(report.Multipliers == (1 | 1 << MULTIPLIER_HWHEEL_SHIFT));
+
+	/* and so do the ones that fail */
+	uint8_t wrong[1] = { REPORTID_MULTIPLIER };
+	NTSTATUS status = h.get_feature(wrong, sizeof(wrong));
+	CHECK(!NT_SUCCESS(status) && status != STATUS_PENDING);
+
+	report.Multipliers = 0;
+	CHECK(NT_SUCCESS(h.set_feature(&report, sizeof(report))));
+
+	/* a helper's inertia flag is taken and ignored, the driver coasts itself */
+	syna::SynaScrollControlReport scroll = { REPORTID_SCROLLCTRL, 1 };
+	CHECK(NT_SUCCESS(h.write_report(&scroll, sizeof(scroll))));
+	CHECK(!h.context()->sc.scrollInertiaActive);
+}
+
+struct motion {
+	long x;
+	long y;
+	long wheel;
+	int largest;		/* biggest X or Y in one report */
+	int reports;
+	bool fractions;		/* a wheel step that isn't a whole detent */
+};
+
+static motion replay(const std::vector<sim::frame> &trace, int pointer, int multipliers)
+{
+	sim::sensor_config config;
+	sim::host h(config);
+	motion m = {};
+
+	h.start();
+	hid::descriptor d = check_descriptor(h);
+	const hid::field *xy = d.find(hid::INPUT, REPORTID_RELATIVE_MOUSE, USAGE_X);
+	const hid::field *wheel = d.find(hid::INPUT, REPORTID_RELATIVE_MOUSE, USAGE_WHEEL);
+
+	syna::SynaSettingsReport setting = { REPORTID_SETTINGS, 0, (BYTE)pointer };
+	CHECK(NT_SUCCESS(h.write_report(&setting, sizeof(setting))));
+	syna::SynaMultiplierReport multiplier = { REPORTID_MULTIPLIER, (BYTE)multipliers };
+	CHECK(NT_SUCCESS(h.set_feature(&multiplier, sizeof(multiplier))));
+
+	uint64_t start = h.now() + 100000;
+	for (size_t i = 0; i < trace.size(); i++)
+		h.schedule(start + i * FRAME_US, trace[i]);
+	h.run_until(start + trace.size() * FRAME_US + SETTLE_US);
+	CHECK(h.context()->sc.settings.pointerMultiplier == pointer);
+
+	for (const sim::report &rep : h.reports) {
+		if (rep.id() != REPORTID_RELATIVE_MOUSE)
+			continue;
+		const syna::SynaRelativeMouseReport *r = (const syna::SynaRelativeMouseReport *)rep.data.data();
+		int x = hid::extract(rep.data.data(), *xy, 0);
+		int y = hid::extract(rep.data.data(), *xy, 1);
+		int w = hid::extract(rep.data.data(), *wheel);
+
+		/* what the class driver reads is what the driver wrote */
+		CHECK(rep.data.size() == sizeof(*r));
+		CHECK(x == r->XValue && y == r->YValue && w == r->WheelPosition);
+
+		m.x += x;
+		m.y += y;
+		m.wheel += w;
+		m.largest = std::max(m.largest, std::max(abs(x), abs(y)));
+		m.fractions |= w % WHEEL_DETENT != 0;	/* only means something in 1/120 units */
+		m.reports++;
+	}
+	h.stop();
+	return m;
+}
+
+int main()
+{
+	{
+		sim::sensor_config config;
+		sim::host h(config);
+
+		h.start();
+		check_descriptor(h);
+		check_features(h);
+		h.stop();
+	}
+
+	/* two flicks, at just under the per-frame jump the driver drops */
+	std::vector<sim::frame> flick = sim::swipe(1, 300, 300, 200, 110, 12);
+	std::vector<sim::frame> back = sim::swipe(1, 300, 1600, 200, -60, 12);
+	flick.insert(flick.end(), back.begin(), back.end());
+
+	motion slow = replay(flick, 10, 0);
+	motion fast = replay(flick, 40, 0);
+
+	printf("flick at 1x: %ld,%ld in %d reports, at 4x: %ld,%ld in %d reports, largest delta %d\n",
+		slow.x, slow.y, slow.reports, fast.x, fast.y, fast.reports, fast.largest);
+	CHECK(slow.x != 0 && slow.y != 0);
+	CHECK(fast.x == 4 * slow.x && fast.y == 4 * slow.y);
+	CHECK(fast.largest > 127);
+
+	std::vector<sim::frame> scroll = sim::swipe(2, 1200, 300, 0, 25, 50);
+	motion detents = replay(scroll, 10, 0);
+	motion hires = replay(scroll, 10, 1);
+
+	printf("scroll in detents: %ld in %d reports, high resolution: %ld/%d in %d reports\n",
+		detents.wheel, detents.reports, hires.wheel, WHEEL_DETENT, hires.reports);
+	CHECK(detents.wheel != 0);
+	CHECK(hires.fractions);
+	CHECK(abs(hires.wheel - WHEEL_DETENT * detents.wheel) < WHEEL_DETENT);
+	return 0;
+}
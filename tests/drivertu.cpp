@@ -0,0 +1,17 @@
+//
+// Builds one driver source for the simulated device, the Makefile
+// compiles this once per source with DRIVER_SOURCE naming it. Like the
+// driver headers in the unit tests the source goes into namespace syna,
+// the kernel headers it includes come from wdk/.
+//
+
+#include "hostshim.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <cstdlib>
+
+namespace syna {
+#include DRIVER_SOURCE
+}
@@ -0,0 +1,86 @@
+//
+// Times the F11 finger decode on its own, the SSE shuffle against the
+// scalar unpack, for the finger counts F11 reports, with the report
+// sized as the driver passes it and the fingers all present.
+//
+// Usage: f11decode_bench
+//
+
+#include "hostshim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+/* the x64 build, where the header takes the SSE path */
+#define _M_X64
+#include <tmmintrin.h>
+
+namespace syna {
+#include "../crostrackpad3-synaptics/f11decode.h"
+}
+
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+#define REPORTS		1024
+#define PASSES		2000
+#define RUNS		5
+
+static std::vector<uint8_t> reports(int fingers, int size)
+{
+	std::vector<uint8_t> data(REPORTS * size);
+	uint32_t seed = 1;
+
+	for (int r = 0; r < REPORTS; r++) {
+		uint8_t *report = &data[r * size];
+
+		for (int i = 0; i < size; i++) {
+			seed = seed * 1103515245 + 12345;
+			report[i] = (uint8_t)(seed >> 16);
+		}
+		/* every finger present */
+		for (int i = 0; i < syna::f11_data_offset(fingers); i++)
+			report[i] = 0x55;
+	}
+	return data;
+}
+
+static uint64_t bench(int fingers, int size, bool simd)
+{
+	std::vector<uint8_t> data = reports(fingers, size);
+	syna::f11_fingers out;
+	uint64_t best = UINT64_MAX;
+	uint32_t check = 0;
+
+	for (int run = 0; run < RUNS; run++) {
+		steady_clock::time_point begin = steady_clock::now();
+
+		for (int pass = 0; pass < PASSES; pass++)
+			for (int r = 0; r < REPORTS; r++) {
+				syna::f11_decode(&data[r * size], fingers, size, simd, &out);
+				check += out.x[fingers - 1] + out.z[0] + out.mask;
+			}
+		uint64_t elapsed = std::chrono::duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+		best = std::min(best, elapsed);
+	}
+	/* keep the decode from being thrown away */
+	CHECK(check != 1);
+	return best;
+}
+
+int main()
+{
+	static const int counts[] = { 1, 2, 3, 5, 10 };
+	const double decodes = (double)REPORTS * PASSES;
+
+	printf("fingers  size  scalar  sse  (ns/report)\n");
+	for (int fingers : counts) {
+		int size = fingers * 5 + (fingers + 3) / 4 + fingers * 2;	/* with data 40 */
+		uint64_t scalar = bench(fingers, size, false);
+		uint64_t sse = bench(fingers, size, true);
+
+		printf("%7d  %4d  %6.2f  %4.2f\n", fingers, size, scalar / decodes, sse / decodes);
+	}
+	return 0;
+}
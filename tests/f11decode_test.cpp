@@ -0,0 +1,107 @@
+//
+// Differential test of the two F11 decoders: random finger data for 1
+// to 10 fingers goes through f11_decode_sse and f11_decode_scalar, and
+// every field of every finger, and the mask, must come out byte for
+// byte the same. The report is sized the way the driver sizes it, with
+// and without the data 40 bytes after the blocks, and with the rest of
+// a longer ATTN report behind it, so the SSE path runs with none, some
+// and all of its three-finger groups inside the bound.
+//
+// 4 and 8 fingers are left out. The blocks start (n >> 2) + 1 bytes in
+// but the report size counts DIV_ROUND_UP(n, 4) status bytes, as in
+// Linux, so at a multiple of 4 the last block ends a byte past the
+// report and both decoders read it. F11 only reports 1 to 5 and 10.
+//
+
+#include "hostshim.h"
+
+#include <vector>
+
+/* the x64 build, where the header takes the SSE path */
+#define _M_X64
+#include <tmmintrin.h>
+
+namespace syna {
+#include "../crostrackpad3-synaptics/f11decode.h"
+}
+
+#define ROUNDS		20000
+#define MAX_SLACK	32		/* the rest of a longer ATTN report */
+
+static uint32_t seed = 1;
+
+static int pick(int n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (int)((seed >> 16) % n);
+}
+
+/* what rmi_f11_report_size gives the driver */
+static int report_size(int fingers, bool has_data40)
+{
+	return fingers * 5 + (fingers + 3) / 4 + (has_data40 ? fingers * 2 : 0);
+}
+
+static void compare(const syna::f11_fingers &a, const syna::f11_fingers &b, int fingers)
+{
+	CHECK(memcmp(a.x, b.x, fingers * sizeof(a.x[0])) == 0);
+	CHECK(memcmp(a.y, b.y, fingers * sizeof(a.y[0])) == 0);
+	CHECK(memcmp(a.z, b.z, fingers) == 0);
+	CHECK(memcmp(a.wx, b.wx, fingers) == 0);
+	CHECK(memcmp(a.wy, b.wy, fingers) == 0);
+	CHECK(a.mask == b.mask);
+}
+
+/* how many three-finger groups the SSE path can load inside size */
+static int sse_groups(int fingers, int size)
+{
+	int groups = 0;
+
+	for (int i = 0; i + 3 <= fingers && syna::f11_data_offset(fingers) + 5 * i + 16 <= size; i += 3)
+		groups++;
+	return groups;
+}
+
+int main()
+{
+	for (int fingers = 1; fingers <= F11_DECODE_FINGERS; fingers++) {
+		if ((fingers & 3) == 0)
+			continue;
+
+		int vectorized = 0;
+
+		for (int round = 0; round < ROUNDS; round++) {
+			int size = report_size(fingers, pick(2)) + (pick(4) ? 0 : pick(MAX_SLACK + 1));
+			uint8_t data[128];
+			syna::f11_fingers scalar, sse;
+
+			/* exactly size bytes, so a sanitizer build catches a load past them */
+			for (uint8_t &b : data)
+				b = (uint8_t)pick(256);
+			CHECK(size <= (int)sizeof(data));
+			std::vector<uint8_t> report(data, data + size);
+
+			/* different garbage in each, so a field one of them skips shows */
+			memset(&scalar, 0xAA, sizeof(scalar));
+			memset(&sse, 0x55, sizeof(sse));
+			syna::f11_decode_scalar(report.data(), fingers, &scalar);
+			syna::f11_decode_sse(report.data(), fingers, size, &sse);
+			compare(scalar, sse, fingers);
+
+			/* and the dispatch takes the path it is told to */
+			memset(&sse, 0x55, sizeof(sse));
+			syna::f11_decode(report.data(), fingers, size, true, &sse);
+			compare(scalar, sse, fingers);
+			memset(&sse, 0x55, sizeof(sse));
+			syna::f11_decode(report.data(), fingers, size, false, &sse);
+			compare(scalar, sse, fingers);
+
+			vectorized += sse_groups(fingers, size);
+		}
+
+		/* three fingers and up have to have gone through the shuffle */
+		CHECK(fingers < 3 || vectorized > 0);
+		printf("%2d fingers: %d reports identical, %d SSE groups\n", fingers, ROUNDS, vectorized);
+	}
+	return 0;
+}
@@ -0,0 +1,101 @@
+//
+// Stress test for the ATTN frame ring: one thread plays the ISR and one
+// the gesture consumer, as in the driver. Every frame the producer gets
+// a slot for must come out once, in order and whole; every frame it
+// doesn't must show up as an overrun and as a gap in the sequence
+// numbers the consumer sees.
+//
+
+#include "hostshim.h"
+
+#include <thread>
+
+namespace syna {
+#include "../crostrackpad3-synaptics/framering.h"
+}
+
+#define FRAMES		2000000
+
+/* a frame whose bytes disagree with its id was read while being written */
+static uint8_t pattern(uint32_t id, int i)
+{
+	return (uint8_t)(id * 31 + i);
+}
+
+static std::atomic<bool> done;
+
+static void produce(syna::syna_frame_ring *ring)
+{
+	for (uint32_t id = 0; id < FRAMES; id++) {
+		syna::syna_frame *frame = syna::frame_ring_reserve(ring);
+
+		/* an ISR can't wait, but the next interrupt comes later */
+		if (!frame) {
+			std::this_thread::yield();
+			continue;
+		}
+		for (int i = 0; i < SYNA_FRAME_BUFFER_SIZE; i++)
+			frame->buffer[i] = pattern(id, i);
+		frame->length = (uint16_t)(id % SYNA_FRAME_SIZE);
+		syna::frame_ring_commit(ring, id);
+	}
+	done = true;
+}
+
+int main()
+{
+	static syna::syna_frame_ring ring;
+	uint32_t received = 0;
+	uint32_t skipped = 0;
+	uint32_t lost = 0;
+	uint32_t sequence = 0;
+	int64_t last = -1;
+
+	syna::frame_ring_init(&ring);
+	std::thread producer(produce, &ring);
+
+	for (;;) {
+		bool finished = done;
+		syna::syna_frame *frame = syna::frame_ring_peek(&ring);
+
+		if (!frame) {
+			/* nothing can be queued after the producer finished */
+			if (finished)
+				break;
+			std::this_thread::yield();
+			continue;
+		}
+
+		uint32_t id = (uint32_t)frame->timestamp;
+
+		/* every reserve hands out a sequence number, taken or not */
+		CHECK(frame->sequence == id);
+		CHECK((int64_t)id > last);
+		CHECK(frame->length == id % SYNA_FRAME_SIZE);
+		for (int i = 0; i < SYNA_FRAME_BUFFER_SIZE; i++)
+			CHECK(frame->buffer[i] == pattern(id, i));
+
+		skipped += id - (uint32_t)(last + 1);
+		lost += frame->sequence - sequence;
+		last = id;
+		sequence = frame->sequence + 1;
+		received++;
+
+		/* fall behind now and then so the ring fills up */
+		if ((received & 0xfff) == 0)
+			std::this_thread::yield();
+		syna::frame_ring_pop(&ring);
+	}
+	producer.join();
+
+	/* frames after the last one received can only have been overruns */
+	skipped += FRAMES - 1 - (uint32_t)last;
+
+	printf("frames %u, received %u, overruns %u\n", FRAMES, received, ring.overruns);
+	lost += ring.sequence - sequence;
+	CHECK(skipped == ring.overruns);
+	CHECK(lost == ring.overruns);
+	CHECK(received + ring.overruns == FRAMES);
+	CHECK(syna::frame_ring_count(&ring) == 0);
+	return 0;
+}
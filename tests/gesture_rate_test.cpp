@@ -0,0 +1,210 @@
+//
+// Replays the same touches sampled at different report rates through the
+// whole driver on the simulated device, and checks the gestures come out
+// the same. The script describes each gesture in continuous time, each
+// rate samples it on its own frame grid, so contacts arrive at different
+// points of a gesture and taps last a slightly different number of
+// frames.
+//
+// A gesture's outcome is what the host saw while it ran: the button
+// changes, the key changes, and which way the pointer and the wheels
+// went. Those must be identical at every rate. Distances are only
+// compared within a tolerance, a contact starts pointing on the first
+// frame past the move delay, which is a different point of the stroke
+// at each rate.
+//
+
+#include "simdevice.h"
+
+#include <algorithm>
+
+#define GAP_US			1500000		/* lets coasting and tap drag run out */
+#define DISTANCE_TOLERANCE	20		/* percent */
+
+struct segment {
+	uint64_t start;		/* from the start of the gesture */
+	uint64_t duration;
+	int fingers;
+	int x0;
+	int y0;
+	int vx;			/* sensor units per second */
+	int vy;
+};
+
+struct gesture {
+	const char *name;
+	std::vector<segment> segments;
+};
+
+//
+// Sensor y grows towards the bottom edge of the pad, the driver flips it,
+// so positive vy moves up the screen
+//
+static const gesture script[] = {
+	{ "tap",		{ { 0, 60000, 1, 1500, 900, 0, 0 } } },
+	{ "move right",		{ { 0, 400000, 1, 800, 900, 3000, 0 } } },
+	{ "move up",		{ { 0, 400000, 1, 1500, 500, 0, 2000 } } },
+	{ "two finger tap",	{ { 0, 60000, 2, 1200, 900, 0, 0 } } },
+	{ "scroll up",		{ { 0, 400000, 2, 1200, 500, 0, 2000 } } },
+	{ "scroll left",	{ { 0, 400000, 2, 1800, 900, -2500, 0 } } },
+	{ "three finger tap",	{ { 0, 60000, 3, 1000, 900, 0, 0 } } },
+	{ "swipe up",		{ { 0, 300000, 3, 1000, 400, 0, 3000 } } },
+	{ "swipe down",		{ { 0, 300000, 3, 1000, 1400, 0, -3000 } } },
+	{ "tap drag",		{ { 0, 60000, 1, 1000, 900, 0, 0 },
+				  { 100000, 400000, 1, 1000, 900, 2500, 0 } } },
+};
+
+#define GESTURES	(sizeof(script) / sizeof(script[0]))
+
+/* what the host saw during one gesture */
+struct outcome {
+	std::vector<int> buttons;	/* every change, starting from released */
+	std::vector<int> keys;		/* modifiers << 8 | first key, every change */
+	long x;
+	long y;
+	long wheel;
+	long hwheel;
+};
+
+static int sign(long v)
+{
+	return (v > 0) - (v < 0);
+}
+
+static sim::frame sample(const segment &s, uint64_t t)
+{
+	sim::frame f = {};
+
+	for (int i = 0; i < s.fingers; i++) {
+		int x = s.x0 + 300 * i + (int)((int64_t)s.vx * (int64_t)t / 1000000);
+		int y = s.y0 + (int)((int64_t)s.vy * (int64_t)t / 1000000);
+
+		f.slot[i] = sim::finger((uint16_t)x, (uint16_t)y);
+	}
+	return f;
+}
+
+static std::vector<outcome> replay(int rate)
+{
+	const uint64_t period = 1000000 / rate;
+	sim::sensor_config config;
+	sim::host h(config);
+	std::vector<uint64_t> starts;
+	std::vector<outcome> outcomes(GESTURES);
+
+	h.start();
+
+	//
+	// Every segment is sampled on the rate's grid, the frame after
+	// its last one lifts the fingers
+	//
+	uint64_t start = h.now() + GAP_US;
+	for (size_t g = 0; g < GESTURES; g++) {
+		uint64_t end = 0;
+
+		starts.push_back(start);
+		for (const segment &s : script[g].segments) {
+			uint64_t t;
+
+			for (t = 0; t <= s.duration; t += period)
+				h.schedule(start + s.start + t, sample(s, t));
+			h.schedule(start + s.start + t, sim::frame());
+			end = std::max(end, s.start + t);
+		}
+		start += end + GAP_US;
+	}
+	starts.push_back(start);
+	h.run_until(start);
+
+	size_t g = 0;
+	int button = 0;
+	int key = 0;
+	for (const sim::report &r : h.reports) {
+		while (r.time >= starts[g + 1])
+			g++;
+		CHECK(r.time >= starts[g] && g < GESTURES);
+		outcome &o = outcomes[g];
+
+		if (r.id() == REPORTID_RELATIVE_MOUSE) {
+			const syna::SynaRelativeMouseReport *m = (const syna::SynaRelativeMouseReport *)r.data.data();
+
+			if (m->Button != button) {
+				button = m->Button;
+				o.buttons.push_back(button);
+			}
+			o.x += m->XValue;
+			o.y += m->YValue;
+			o.wheel += m->WheelPosition;
+			o.hwheel += m->HWheelPosition;
+		}
+		else if (r.id() == REPORTID_KEYBOARD) {
+			const syna::SynaKeyboardReport *k = (const syna::SynaKeyboardReport *)r.data.data();
+			int now = k->ShiftKeyFlags << 8 | k->KeyCodes[0];
+
+			if (now != key) {
+				key = now;
+				o.keys.push_back(key);
+			}
+		}
+	}
+
+	/* nothing is left held down between gestures */
+	CHECK(button == 0 && key == 0);
+	h.stop();
+	return outcomes;
+}
+
+static std::string describe(const outcome &o)
+{
+	std::string s;
+	char buf[64];
+
+	for (int b : o.buttons) {
+		snprintf(buf, sizeof(buf), "b%d ", b);
+		s += buf;
+	}
+	for (int k : o.keys) {
+		snprintf(buf, sizeof(buf), "k%04x ", k);
+		s += buf;
+	}
+	snprintf(buf, sizeof(buf), "xy %ld,%ld wheel %ld,%ld", o.x, o.y, o.wheel, o.hwheel);
+	return s + buf;
+}
+
+static bool close_enough(long a, long b)
+{
+	return std::labs(a - b) * 100 <= std::max(std::labs(a), std::labs(b)) * DISTANCE_TOLERANCE;
+}
+
+int main()
+{
+	static const int rates[] = { 80, 100, 125 };
+	std::vector<std::vector<outcome>> results;
+
+	for (int rate : rates)
+		results.push_back(replay(rate));
+
+	for (size_t g = 0; g < GESTURES; g++) {
+		const outcome &ref = results[0][g];
+
+		printf("%-20s", script[g].name);
+		for (size_t r = 0; r < results.size(); r++)
+			printf("  %dHz: %-36s", rates[r], describe(results[r][g]).c_str());
+		printf("\n");
+
+		/* every gesture did something */
+		CHECK(!ref.buttons.empty() || !ref.keys.empty() || ref.x || ref.y || ref.wheel || ref.hwheel);
+
+		for (size_t r = 1; r < results.size(); r++) {
+			const outcome &o = results[r][g];
+
+			CHECK(o.buttons == ref.buttons);
+			CHECK(o.keys == ref.keys);
+			CHECK(sign(o.x) == sign(ref.x) && sign(o.y) == sign(ref.y));
+			CHECK(sign(o.wheel) == sign(ref.wheel) && sign(o.hwheel) == sign(ref.hwheel));
+			CHECK(close_enough(o.x, ref.x) && close_enough(o.y, ref.y));
+			CHECK(close_enough(o.wheel, ref.wheel) && close_enough(o.hwheel, ref.hwheel));
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,158 @@
+//
+// What the gesture engine costs per frame, and how much of the gesture
+// state it touches, for 1 to 5 fingers on a 5-finger sensor.
+//
+// The time is the driver's own TrackpadRawInput on decoded ATTN reports
+// from the simulated sensor, reports to the class driver included but
+// no bus or ISR, best of a few runs.
+//
+// Bytes touched counts the 64-byte lines of per-contact state a frame
+// reaches, from the layout. The engine reads every slot up to the
+// sensor's max fingers and the motion history of the contacts that
+// changed. The layout this replaced kept each field in its own [15]
+// array and touched the history rows of all MAX_FINGERS (5) slots on
+// every frame, its footprint is worked out the same way from a copy of
+// it below; the old engine itself is not in the tree to time.
+//
+// Usage: gesture_state_bench
+//
+
+#include "simdevice.h"
+
+#include <algorithm>
+#include <chrono>
+#include <set>
+
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+namespace syna {
+void TrackpadRawInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t *report, int reportSize, uint64_t timestamp);
+}
+
+#define CACHE_LINE		64
+#define OLD_MAX_FINGERS		5
+#define BENCH_FRAMES		2000
+#define BENCH_RUNS		5
+#define FRAME_INTERVAL_US	8000
+
+/* the per-contact part of the old csgesture_softc, in its order */
+struct old_contacts {
+	int x[15];
+	int y[15];
+	int p[15];
+	int blacklistedids[15];
+	int lastx[15];
+	int lasty[15];
+	int lastp[15];
+	int xhistory[15][10];
+	int yhistory[15][10];
+	int flextotalx[15];
+	int flextotaly[15];
+	int totalx[15];
+	int totaly[15];
+	int totalp[15];
+	int tick[15];
+	int truetick[15];
+};
+
+typedef std::set<size_t> lines;
+
+static void touch(lines &l, size_t offset, size_t size)
+{
+	for (size_t line = offset / CACHE_LINE; line <= (offset + size - 1) / CACHE_LINE; line++)
+		l.insert(line);
+}
+
+static size_t old_bytes_touched()
+{
+	lines l;
+
+	for (int i = 0; i < OLD_MAX_FINGERS; i++) {
+#define FIELD(f)	touch(l, offsetof(old_contacts, f) + i * sizeof(int), sizeof(int))
+		FIELD(x); FIELD(y); FIELD(p); FIELD(blacklistedids);
+		FIELD(lastx); FIELD(lasty); FIELD(lastp);
+		FIELD(flextotalx); FIELD(flextotaly);
+		FIELD(totalx); FIELD(totaly); FIELD(totalp);
+		FIELD(tick); FIELD(truetick);
+#undef FIELD
+		touch(l, offsetof(old_contacts, xhistory) + i * sizeof(int[10]), sizeof(int[10]));
+		touch(l, offsetof(old_contacts, yhistory) + i * sizeof(int[10]), sizeof(int[10]));
+	}
+	return l.size() * CACHE_LINE;
+}
+
+static size_t new_bytes_touched(int maxcontacts, int fingers)
+{
+	lines l;
+
+	touch(l, offsetof(syna::csgesture_softc, contact),
+		maxcontacts * sizeof(syna::csgesture_contact));
+	for (int i = 0; i < fingers; i++)
+		touch(l, offsetof(syna::csgesture_softc, history) + i * sizeof(syna::csgesture_history),
+			sizeof(syna::csgesture_history));
+	return l.size() * CACHE_LINE;
+}
+
+static sim::frame circling(int fingers, int i)
+{
+	sim::frame f = {};
+
+	for (int n = 0; n < fingers; n++)
+		f.slot[n] = sim::finger((uint16_t)(600 + 400 * n + (i % 40) * 8),
+			(uint16_t)(500 + 100 * n + (i % 25) * 12));
+	return f;
+}
+
+static uint64_t bench(sim::host &h, int fingers)
+{
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	std::vector<std::vector<uint8_t>> reports;
+	uint64_t best = UINT64_MAX;
+	uint64_t timestamp = h.now();
+
+	for (int i = 0; i < BENCH_FRAMES; i++)
+		reports.push_back(h.device.attn(circling(fingers, i)));
+	reports.push_back(h.device.attn(sim::frame()));
+
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		steady_clock::time_point begin = steady_clock::now();
+
+		for (std::vector<uint8_t> &report : reports) {
+			timestamp += FRAME_INTERVAL_US;
+			syna::TrackpadRawInput(pDevice, &pDevice->sc, report.data(), (int)report.size(), timestamp);
+		}
+		uint64_t elapsed = std::chrono::duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+		best = std::min(best, elapsed / reports.size());
+
+		/* let the class driver catch up between runs */
+		h.reports.clear();
+		h.run_for(100000);
+	}
+	return best;
+}
+
+int main()
+{
+	sim::sensor_config config;
+	sim::host h(config);
+
+	h.start();
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	CHECK(pDevice->sc.maxcontacts == config.fingers);
+
+	printf("softc %zu bytes, %zu per contact + %zu of history\n",
+		sizeof(syna::csgesture_softc), sizeof(syna::csgesture_contact),
+		sizeof(syna::csgesture_history));
+	printf("old layout: %zu bytes of per-contact state touched per frame\n", old_bytes_touched());
+	for (int fingers = 1; fingers <= config.fingers; fingers++) {
+		uint64_t ns = bench(h, fingers);
+
+		printf("%d finger%s  %4llu ns/frame  %4zu bytes of per-contact state touched per frame\n",
+			fingers, fingers == 1 ? " " : "s", (unsigned long long)ns,
+			new_bytes_touched(pDevice->sc.maxcontacts, fingers));
+	}
+
+	h.stop();
+	return 0;
+}
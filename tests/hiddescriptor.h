@@ -0,0 +1,270 @@
+#if !defined(_HIDDESCRIPTOR_H_)
+#define _HIDDESCRIPTOR_H_
+
+//
+// Just enough of a HID report descriptor parser to check what the
+// driver hands the class driver: every main item becomes a field with
+// its report id, its bit position in the report after the id byte, and
+// the global and local state it was declared with. Values are pulled
+// out of a report the way the class driver would read them.
+//
+
+#include "hostshim.h"
+
+#include <vector>
+
+namespace hid {
+
+/* main item kinds */
+enum {
+	INPUT = 0x80,
+	OUTPUT = 0x90,
+	FEATURE = 0xb0,
+};
+
+/* main item flags */
+enum {
+	CONSTANT = 0x01,
+	VARIABLE = 0x02,
+	RELATIVE = 0x04,
+};
+
+struct field {
+	uint8_t kind;			/* INPUT, OUTPUT or FEATURE */
+	uint8_t report_id;
+	unsigned int bit;		/* after the report id byte */
+	unsigned int size;
+	unsigned int count;
+	uint32_t flags;
+	std::vector<uint32_t> usages;	/* usage page << 16 | usage */
+	int32_t logical_min;
+	int32_t logical_max;
+	int32_t physical_min;
+	int32_t physical_max;
+	uint32_t unit;
+	int exponent;
+	int collection;			/* depth, 1 in an application collection */
+
+	/* the last usage is repeated for the rest of the count, as in the spec */
+	uint32_t usage(unsigned int i) const
+	{
+		if (usages.empty())
+			return 0;
+		return usages[i < usages.size() ? i : usages.size() - 1];
+	}
+};
+
+struct descriptor {
+	std::vector<field> fields;
+
+	/* the field of a report that carries usage, nullptr if there is none */
+	const field *find(uint8_t kind, uint8_t report_id, uint32_t usage) const
+	{
+		for (const field &f : fields)
+			if (f.kind == kind && f.report_id == report_id && !(f.flags & CONSTANT))
+				for (uint32_t u : f.usages)
+					if (u == usage)
+						return &f;
+		return nullptr;
+	}
+
+	/* the report's length in bytes, id included */
+	unsigned int bytes(uint8_t kind, uint8_t report_id) const
+	{
+		unsigned int bits = 0;
+
+		for (const field &f : fields)
+			if (f.kind == kind && f.report_id == report_id)
+				bits = bits > f.bit + f.size * f.count ? bits : f.bit + f.size * f.count;
+		return bits ? 1 + (bits + 7) / 8 : 0;
+	}
+};
+
+static inline uint32_t item_data(const uint8_t *p, int length)
+{
+	uint32_t v = 0;
+
+	for (int i = 0; i < length; i++)
+		v |= (uint32_t)p[i] << (8 * i);
+	return v;
+}
+
+static inline int32_t item_signed(const uint8_t *p, int length)
+{
+	uint32_t v = item_data(p, length);
+
+	if (length == 1)
+		return (int8_t)v;
+	if (length == 2)
+		return (int16_t)v;
+	return (int32_t)v;
+}
+
+static inline descriptor parse(const uint8_t *d, size_t length)
+{
+	struct global {
+		uint16_t usage_page;
+		int32_t logical_min;
+		int32_t logical_max;
+		uint32_t logical_max_bits;	/* as written, for ranges without a sign */
+		int32_t physical_min;
+		int32_t physical_max;
+		uint32_t unit;
+		int exponent;
+		unsigned int size;
+		unsigned int count;
+		uint8_t report_id;
+	};
+	descriptor out;
+	std::vector<global> stack;
+	global g = {};
+	std::vector<uint32_t> usages;
+	uint32_t usage_min = 0;
+	int collection = 0;
+	/* where the next field of each kind and report starts */
+	std::vector<std::pair<uint32_t, unsigned int>> offsets;
+
+	for (size_t i = 0; i < length;) {
+		uint8_t prefix = d[i];
+		int size = prefix & 0x03;
+		int data_length = size == 3 ? 4 : size;
+		const uint8_t *p = &d[i + 1];
+		uint32_t u = item_data(p, data_length);
+
+		CHECK(prefix != 0xfe);		/* no long items */
+		CHECK(i + 1 + data_length <= length);
+		i += 1 + data_length;
+
+		switch (prefix & 0xfc) {
+		/* main */
+		case INPUT:
+		case OUTPUT:
+		case FEATURE: {
+			field f;
+			uint32_t key = (uint32_t)(prefix & 0xfc) << 8 | g.report_id;
+			unsigned int *next = nullptr;
+
+			for (auto &o : offsets)
+				if (o.first == key)
+					next = &o.second;
+			if (!next) {
+				offsets.push_back(std::make_pair(key, 0u));
+				next = &offsets.back().second;
+			}
+
+			f.kind = prefix & 0xfc;
+			f.report_id = g.report_id;
+			f.bit = *next;
+			f.size = g.size;
+			f.count = g.count;
+			f.flags = u;
+			f.usages = usages;
+			f.logical_min = g.logical_min;
+			f.logical_max = g.logical_max;
+			/* a 0..255 or 0..65535 range written without a sign byte */
+			if (g.logical_min >= 0 && g.logical_max < 0)
+				f.logical_max = (int32_t)g.logical_max_bits;
+			f.physical_min = g.physical_min;
+			f.physical_max = g.physical_max;
+			f.unit = g.unit;
+			f.exponent = g.exponent;
+			f.collection = collection;
+			out.fields.push_back(f);
+			*next += g.size * g.count;
+			usages.clear();
+			break;
+		}
+		case 0xa0:			/* collection */
+			collection++;
+			usages.clear();
+			break;
+		case 0xc0:			/* end collection */
+			CHECK(collection > 0);
+			collection--;
+			usages.clear();
+			break;
+
+		/* global */
+		case 0x04:
+			g.usage_page = (uint16_t)u;
+			break;
+		case 0x14:
+			g.logical_min = item_signed(p, data_length);
+			break;
+		case 0x24:
+			g.logical_max = item_signed(p, data_length);
+			g.logical_max_bits = u;
+			break;
+		case 0x34:
+			g.physical_min = item_signed(p, data_length);
+			break;
+		case 0x44:
+			g.physical_max = item_signed(p, data_length);
+			break;
+		case 0x54:
+			g.exponent = (int)(u & 0x08 ? (int32_t)u - 16 : (int32_t)u);
+			break;
+		case 0x64:
+			g.unit = u;
+			break;
+		case 0x74:
+			g.size = u;
+			break;
+		case 0x84:
+			g.report_id = (uint8_t)u;
+			break;
+		case 0x94:
+			g.count = u;
+			break;
+		case 0xa4:
+			stack.push_back(g);
+			break;
+		case 0xb4:
+			CHECK(!stack.empty());
+			g = stack.back();
+			stack.pop_back();
+			break;
+
+		/* local */
+		case 0x08:
+			usages.push_back(data_length == 4 ? u : (uint32_t)g.usage_page << 16 | u);
+			break;
+		case 0x18:
+			usage_min = data_length == 4 ? u : (uint32_t)g.usage_page << 16 | u;
+			break;
+		case 0x28: {
+			uint32_t usage_max = data_length == 4 ? u : (uint32_t)g.usage_page << 16 | u;
+
+			for (uint32_t v = usage_min; v <= usage_max; v++)
+				usages.push_back(v);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	CHECK(collection == 0);
+	CHECK(stack.empty());
+	return out;
+}
+
+/* element index of a field out of a report that starts with its id */
+static inline int32_t extract(const uint8_t *report, const field &f, unsigned int index = 0)
+{
+	unsigned int bit = f.bit + f.size * index;
+	uint32_t v = 0;
+
+	for (unsigned int b = 0; b < f.size; b++) {
+		unsigned int at = bit + b;
+
+		v |= (uint32_t)((report[1 + at / 8] >> (at % 8)) & 1) << b;
+	}
+	/* signed fields are two's complement */
+	if (f.logical_min < 0 && f.size < 32 && (v & (1u << (f.size - 1))))
+		v |= ~0u << f.size;
+	return (int32_t)v;
+}
+
+}
+
+#endif
@@ -0,0 +1,145 @@
+//
+// Times one motion window update per contact, the driver's ring from
+// gesturerec.h against the ten-entry shift it replaced, on the same
+// stream of deltas and with the same running totals and flextotal.
+// The ring is timed on its own and again with what only it provides on
+// top, normalize_delta and the windowed velocity and acceleration. Five
+// contacts are kept down and the window stays full, which is where the
+// shift did all its work.
+//
+// Usage: history_bench
+//
+
+#include "hostshim.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#define DECLSPEC_ALIGN(x)	__attribute__((aligned(x)))
+
+namespace syna {
+#include "../crostrackpad3-synaptics/gesturerec.h"
+}
+
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+#define CONTACTS	5
+#define FRAMES		2000000
+#define RUNS		5
+
+struct old_state {
+	int xhistory[15][10];
+	int yhistory[15][10];
+	int flextotalx[15];
+	int flextotaly[15];
+	int totalx[15];
+	int totaly[15];
+};
+
+/* the old shift to last, once the window is full */
+static void old_update(old_state *s, int i, int absx, int absy)
+{
+	s->totalx[i] += absx;
+	s->totaly[i] += absy;
+
+	s->flextotalx[i] -= s->xhistory[i][0];
+	s->flextotaly[i] -= s->yhistory[i][0];
+	for (int j = 1; j < 10; j++) {
+		s->xhistory[i][j - 1] = s->xhistory[i][j];
+		s->yhistory[i][j - 1] = s->yhistory[i][j];
+	}
+	s->flextotalx[i] += absx;
+	s->flextotaly[i] += absy;
+
+	s->xhistory[i][9] = absx;
+	s->yhistory[i][9] = absy;
+}
+
+/* what ProcessGesture does to the window of a contact whose window is full */
+static void ring_window(syna::csgesture_softc *sc, int i, int dx, int dy)
+{
+	syna::csgesture_history *history = &sc->history[i];
+
+	history->totalx += abs(dx);
+	history->totaly += abs(dy);
+	sc->contact[i].flextotalx += abs(dx) - abs(history->x[history->head]);
+	sc->contact[i].flextotaly += abs(dy) - abs(history->y[history->head]);
+	syna::history_push(history, history->head, dx, dy);
+	if (++history->head == GESTURE_HISTORY)
+		history->head = 0;
+}
+
+/* and all of it, from the raw delta to the velocity */
+static void ring_update(syna::csgesture_softc *sc, int i, int rawx, int rawy)
+{
+	ring_window(sc, i, syna::normalize_delta(sc, rawx), syna::normalize_delta(sc, rawy));
+	syna::history_update_velocity(&sc->history[i]);
+}
+
+static std::vector<int> deltas()
+{
+	std::vector<int> d(FRAMES * CONTACTS * 2);
+	uint32_t seed = 1;
+
+	for (int &v : d) {
+		seed = seed * 1103515245 + 12345;
+		v = (int)((seed >> 16) % 61) - 30;
+	}
+	return d;
+}
+
+template <typename F>
+static uint64_t best_of(F f)
+{
+	uint64_t best = UINT64_MAX;
+
+	for (int run = 0; run < RUNS; run++) {
+		steady_clock::time_point begin = steady_clock::now();
+
+		f();
+		uint64_t elapsed = std::chrono::duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+		best = std::min(best, elapsed);
+	}
+	return best;
+}
+
+int main()
+{
+	static old_state old;
+	static syna::csgesture_softc sc, full;
+	std::vector<int> d = deltas();
+	long check_old = 0, check_ring = 0, check_full = 0;
+
+	/* at the reference interval all of them see the same deltas */
+	full.frameinterval = GESTURE_TICK_US;
+
+	uint64_t old_ns = best_of([&] {
+		for (size_t n = 0; n < d.size(); n += 2 * CONTACTS)
+			for (int i = 0; i < CONTACTS; i++)
+				old_update(&old, i, abs(d[n + 2 * i]), abs(d[n + 2 * i + 1]));
+		check_old += old.flextotalx[0] + old.flextotaly[CONTACTS - 1];
+	});
+	uint64_t ring_ns = best_of([&] {
+		for (size_t n = 0; n < d.size(); n += 2 * CONTACTS)
+			for (int i = 0; i < CONTACTS; i++)
+				ring_window(&sc, i, d[n + 2 * i], d[n + 2 * i + 1]);
+		check_ring += sc.contact[0].flextotalx + sc.contact[CONTACTS - 1].flextotaly;
+	});
+	uint64_t full_ns = best_of([&] {
+		for (size_t n = 0; n < d.size(); n += 2 * CONTACTS)
+			for (int i = 0; i < CONTACTS; i++)
+				ring_update(&full, i, d[n + 2 * i], d[n + 2 * i + 1]);
+		check_full += full.contact[0].flextotalx + full.contact[CONTACTS - 1].flextotaly;
+	});
+
+	/* same deltas, same sliding sums */
+	CHECK(check_old == check_ring && check_old == check_full);
+
+	double updates = (double)FRAMES * CONTACTS;
+	printf("window of %d, %d contacts, ns per contact frame: shift %.2f, ring %.2f, "
+		"ring with normalize_delta and velocity %.2f\n",
+		GESTURE_HISTORY, CONTACTS, old_ns / updates, ring_ns / updates, full_ns / updates);
+	return 0;
+}
@@ -0,0 +1,249 @@
+//
+// Checks the gesture engine's motion window, frame by frame, against
+// the window it replaced: ten per-contact deltas shifted down by one on
+// every frame once full, with flextotal kept as the sum of their sizes.
+// Traces replay through the driver's TrackpadRawInput on reports from
+// the simulated sensor, and after every frame each contact's tick,
+// totals, flextotal, window contents in age order, signed sums and
+// windowed velocity and acceleration must be bit for bit what the old
+// shifting code computes from the same deltas.
+//
+// At the 10ms reference interval normalize_delta leaves a delta alone
+// and the reference is the old code exactly. At other rates, and with
+// jitter, the reference is fed the deltas scaled the way the old code
+// would have had to scale them, delta * 10ms / interval with the
+// interval clamped like TrackpadSetTime does.
+//
+
+#include "simdevice.h"
+
+namespace syna {
+void TrackpadRawInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t *report, int reportSize, uint64_t timestamp);
+}
+
+#define OLD_HISTORY	10
+
+/* one contact under the old code */
+struct old_contact {
+	int lastx;
+	int lasty;
+	int tick;
+	int totalx;
+	int totaly;
+	int flextotalx;
+	int flextotaly;
+	int xhistory[OLD_HISTORY];	/* sizes, as the old code kept them */
+	int yhistory[OLD_HISTORY];
+	int sx[OLD_HISTORY];		/* the signed deltas, shifted the same way */
+	int sy[OLD_HISTORY];
+	int samples;
+	int vx;
+	int vy;
+	int ax;
+	int ay;
+};
+
+/* what a lift left behind, the old code never cleared flextotal */
+static void old_release(old_contact *c)
+{
+	int flextotalx = c->flextotalx;
+	int flextotaly = c->flextotaly;
+
+	memset(c, 0, sizeof(*c));
+	c->lastx = -1;
+	c->lasty = -1;
+	c->flextotalx = flextotalx;
+	c->flextotaly = flextotaly;
+}
+
+/* the old shift to last, for one contact that is down */
+static void old_update(old_contact *c, int x, int y, int interval)
+{
+	if (c->lastx != -1) {
+		int dx = (x - c->lastx) * GESTURE_TICK_US / interval;
+		int dy = (y - c->lasty) * GESTURE_TICK_US / interval;
+		int absx = abs(dx);
+		int absy = abs(dy);
+
+		if (c->tick < OLD_HISTORY) {
+			c->totalx += absx;
+			c->totaly += absy;
+			c->flextotalx = c->totalx;
+			c->flextotaly = c->totaly;
+
+			int j = c->tick;
+			c->xhistory[j] = absx;
+			c->yhistory[j] = absy;
+			c->sx[j] = dx;
+			c->sy[j] = dy;
+		}
+		else {
+			c->totalx += absx;
+			c->totaly += absy;
+
+			c->flextotalx -= c->xhistory[0];
+			c->flextotaly -= c->yhistory[0];
+			for (int j = 1; j < OLD_HISTORY; j++) {
+				c->xhistory[j - 1] = c->xhistory[j];
+				c->yhistory[j - 1] = c->yhistory[j];
+				c->sx[j - 1] = c->sx[j];
+				c->sy[j - 1] = c->sy[j];
+			}
+			c->flextotalx += absx;
+			c->flextotaly += absy;
+
+			int j = OLD_HISTORY - 1;
+			c->xhistory[j] = absx;
+			c->yhistory[j] = absy;
+			c->sx[j] = dx;
+			c->sy[j] = dy;
+		}
+		if (c->samples < OLD_HISTORY)
+			c->samples++;
+	}
+	if (c->tick < OLD_HISTORY)
+		c->tick++;
+
+	int sumx = 0, sumy = 0;
+	for (int j = 0; j < OLD_HISTORY; j++) {
+		sumx += c->sx[j];
+		sumy += c->sy[j];
+	}
+	int vx = c->samples ? sumx / c->samples : 0;
+	int vy = c->samples ? sumy / c->samples : 0;
+	c->ax = vx - c->vx;
+	c->ay = vy - c->vy;
+	c->vx = vx;
+	c->vy = vy;
+
+	c->lastx = x;
+	c->lasty = y;
+}
+
+static void compare(const syna::csgesture_softc &sc, int i, const old_contact &c)
+{
+	const syna::csgesture_contact &contact = sc.contact[i];
+	const syna::csgesture_history &h = sc.history[i];
+	int sumx = 0, sumy = 0;
+
+	CHECK(contact.tick == c.tick);
+	CHECK(h.totalx == c.totalx && h.totaly == c.totaly);
+	CHECK(contact.flextotalx == c.flextotalx && contact.flextotaly == c.flextotaly);
+	CHECK(h.samples == c.samples);
+
+	/* the ring, oldest first, is the shifted window */
+	for (int k = 0; k < OLD_HISTORY; k++) {
+		int slot = (h.head + k) % GESTURE_HISTORY;
+
+		CHECK(h.x[slot] == c.sx[k] && h.y[slot] == c.sy[k]);
+		CHECK(abs(h.x[slot]) == c.xhistory[k] && abs(h.y[slot]) == c.yhistory[k]);
+		sumx += c.sx[k];
+		sumy += c.sy[k];
+	}
+	CHECK(h.sumx == sumx && h.sumy == sumy);
+	CHECK(h.vx == c.vx && h.vy == c.vy && h.ax == c.ax && h.ay == c.ay);
+}
+
+static uint32_t seed = 1;
+
+static int pick(int n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (int)((seed >> 16) % n);
+}
+
+//
+// Contacts come and go on their own schedule and move with a random
+// walk, fast enough to need the full int16 window now and then
+//
+static uint64_t replay(sim::host &h, int interval, int jitter, int frames)
+{
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	syna::csgesture_softc *sc = &pDevice->sc;
+	const int fingers = sc->maxcontacts;
+	old_contact old[SIM_FINGERS];
+	int x[SIM_FINGERS], y[SIM_FINGERS], life[SIM_FINGERS];
+	uint64_t timestamp = h.now() + 1000000;
+	uint64_t checked = 0;
+
+	for (int i = 0; i < fingers; i++) {
+		old[i].flextotalx = sc->contact[i].flextotalx;
+		old[i].flextotaly = sc->contact[i].flextotaly;
+		old_release(&old[i]);
+		life[i] = 0;
+	}
+
+	for (int n = 0; n < frames; n++) {
+		sim::frame f = {};
+
+		for (int i = 0; i < fingers; i++) {
+			if (life[i] == 0) {
+				/* down for a while, then up for a while */
+				life[i] = pick(2) ? 1 + pick(60) : -1 - pick(20);
+				x[i] = 200 + pick(2600);
+				y[i] = 200 + pick(1400);
+			}
+			if (life[i] > 0) {
+				int speed = pick(10) == 0 ? 120 : 25;
+
+				x[i] = std::min(2990, std::max(10, x[i] + pick(2 * speed + 1) - speed));
+				y[i] = std::min(1790, std::max(10, y[i] + pick(2 * speed + 1) - speed));
+				f.slot[i] = sim::finger((uint16_t)x[i], (uint16_t)y[i]);
+				life[i]--;
+			}
+			else {
+				life[i]++;
+			}
+		}
+
+		std::vector<uint8_t> report = h.device.attn(f);
+		timestamp += interval + (jitter ? pick(2 * jitter + 1) - jitter : 0);
+		syna::TrackpadRawInput(pDevice, sc, report.data(), (int)report.size(), timestamp);
+
+		for (int i = 0; i < fingers; i++) {
+			if (sc->contact[i].x == -1) {
+				old_release(&old[i]);
+			}
+			else {
+				old_update(&old[i], sc->contact[i].x, sc->contact[i].y, sc->frameinterval);
+				checked++;
+			}
+			compare(*sc, i, old[i]);
+		}
+	}
+
+	/* lift everything before the next trace */
+	std::vector<uint8_t> lift = h.device.attn(sim::frame());
+	syna::TrackpadRawInput(pDevice, sc, lift.data(), (int)lift.size(), timestamp + interval);
+	h.run_for(timestamp + interval - h.now() + 1000000);
+	return checked;
+}
+
+int main()
+{
+	static const struct {
+		int interval;
+		int jitter;
+	} rates[] = {
+		{ GESTURE_TICK_US, 0 },		/* the old code's own rate */
+		{ 12500, 0 },			/* 80Hz */
+		{ 8000, 0 },			/* 125Hz */
+		{ 8000, 3000 },
+		{ 12500, 6000 },
+	};
+	sim::sensor_config config;
+	sim::host h(config);
+
+	/* the comparison is against the old ten sample window */
+	static_assert(GESTURE_HISTORY == OLD_HISTORY, "the reference window is ten samples");
+
+	h.start();
+	for (const auto &rate : rates) {
+		uint64_t checked = replay(h, rate.interval, rate.jitter, 20000);
+
+		printf("%5d us +/- %4d: %llu contact frames identical\n", rate.interval, rate.jitter,
+			(unsigned long long)checked);
+	}
+	h.stop();
+	return 0;
+}
@@ -0,0 +1,38 @@
+#if !defined(_HOSTSHIM_H_)
+#define _HOSTSHIM_H_
+
+//
+// Lets the WDF-free driver headers build on a Linux host. The driver
+// brings its own stdint.h with MSVC's widths, so the headers go into
+// namespace syna where those typedefs can't clash with the host's; the
+// Windows types and barriers they use come from here.
+//
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define ABS32				/* the host has its own abs() */
+
+#define __packed(decl)			_Pragma("pack(push, 1)") decl; _Pragma("pack(pop)")
+#define FIELD_OFFSET(type, field)	offsetof(type, field)
+
+#define FRAME_RING_BARRIER()	std::atomic_thread_fence(std::memory_order_seq_cst)
+
+namespace syna {
+typedef unsigned char BYTE;
+typedef short SHORT;
+typedef unsigned short USHORT;
+}
+
+#define CHECK(cond) do { \
+	if (!(cond)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		exit(1); \
+	} \
+} while (0)
+
+#endif
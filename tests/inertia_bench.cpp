@@ -0,0 +1,132 @@
+//
+// What coasting costs. The time is the driver's own TrackpadIdleInput
+// stepping a coast from a fling until it stops, one step per reference
+// tick, best of a few runs, reports to the class driver included. The
+// fling itself goes through TrackpadRawInput on ATTN reports from the
+// simulated sensor first, and isn't timed.
+//
+// The wakeups are the timer fires the whole driver takes on the
+// simulated device from the lift to a second after the coast ended,
+// polled and event-driven: the deadline timer should only run while
+// there is a coast to step.
+//
+// Usage: inertia_bench
+//
+
+#include "simdevice.h"
+
+#include <algorithm>
+#include <chrono>
+
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+namespace syna {
+void TrackpadRawInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint8_t *report, int reportSize, uint64_t timestamp);
+void TrackpadIdleInput(PDEVICE_CONTEXT pDevice, struct csgesture_softc *sc, uint64_t timestamp);
+}
+
+#define BENCH_FLINGS		200
+#define BENCH_RUNS		5
+#define FRAME_US		12500
+#define IDLE_US			1000000
+
+struct cost {
+	uint64_t ns_per_step;
+	uint64_t steps;			/* per fling */
+	uint64_t ns_per_fling;
+};
+
+static cost bench(int dy)
+{
+	sim::sensor_config config;
+	sim::host h(config);
+	h.start();
+
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	std::vector<std::vector<uint8_t>> reports;
+	uint64_t timestamp = h.now();
+	cost best = { UINT64_MAX, 0, UINT64_MAX };
+
+	for (const sim::frame &f : sim::swipe(2, 1200, dy < 0 ? 1700 : 100, 0, dy, 20))
+		reports.push_back(h.device.attn(f));
+
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		uint64_t elapsed = 0, steps = 0;
+
+		for (int fling = 0; fling < BENCH_FLINGS; fling++) {
+			for (std::vector<uint8_t> &report : reports) {
+				timestamp += FRAME_US;
+				syna::TrackpadRawInput(pDevice, &pDevice->sc, report.data(), (int)report.size(), timestamp);
+			}
+			CHECK(pDevice->sc.scrollInertiaActive);
+
+			steady_clock::time_point begin = steady_clock::now();
+			while (pDevice->sc.scrollInertiaActive) {
+				timestamp += GESTURE_TICK_US;
+				syna::TrackpadIdleInput(pDevice, &pDevice->sc, timestamp);
+				steps++;
+			}
+			elapsed += std::chrono::duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+
+			/* past the tap and scroll timeouts before the next fling */
+			timestamp += IDLE_US;
+			h.reports.clear();
+		}
+		best.ns_per_step = std::min(best.ns_per_step, elapsed / steps);
+		best.ns_per_fling = std::min(best.ns_per_fling, elapsed / BENCH_FLINGS);
+		best.steps = steps / BENCH_FLINGS;
+
+		/* let the class driver catch up between runs */
+		h.run_for(100000);
+	}
+	h.stop();
+	return best;
+}
+
+static void wakeups(bool event_driven, int dy)
+{
+	sim::sensor_config config;
+	sim::options opts;
+
+	opts.event_driven = event_driven;
+	sim::host h(config, opts);
+	h.start();
+
+	std::vector<sim::frame> trace = sim::swipe(2, 1200, dy < 0 ? 1700 : 100, 0, dy, 20);
+	uint64_t start = h.now();
+	for (size_t i = 0; i < trace.size(); i++)
+		h.schedule(start + i * FRAME_US, trace[i]);
+	uint64_t lift = start + (trace.size() - 1) * FRAME_US;
+	h.run_until(lift);
+
+	uint32_t fires = h.timer_fires;
+	uint64_t end = lift;
+	while (h.context()->sc.scrollInertiaActive) {
+		h.run_for(GESTURE_TICK_US);
+		end = h.now();
+	}
+	uint32_t coasting = h.timer_fires - fires;
+	h.run_until(end + IDLE_US);
+
+	printf("%-12s dy %4d  coast %4llu ms  timer fires coasting %3u, in the second after %3u\n",
+		event_driven ? "event-driven" : "polled", dy, (unsigned long long)((end - lift) / 1000),
+		coasting, h.timer_fires - fires - coasting);
+	h.stop();
+}
+
+int main()
+{
+	printf("fling   steps  ns/step  us/fling\n");
+	for (int dy : { -30, -60, -120 }) {
+		cost c = bench(dy);
+
+		printf("%5d  %6llu  %7llu  %8.1f\n", dy, (unsigned long long)c.steps,
+			(unsigned long long)c.ns_per_step, c.ns_per_fling / 1000.0);
+	}
+	printf("\n");
+	for (int dy : { -30, -60, -120 })
+		for (bool event_driven : { false, true })
+			wakeups(event_driven, dy);
+	return 0;
+}
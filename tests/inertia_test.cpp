@@ -0,0 +1,233 @@
+//
+// Replays fling and catch sequences through the whole driver on the
+// simulated device and checks the coasting the driver produces itself:
+// a fast two-finger scroll keeps going after the lift in the direction
+// of the fingers, slower and slower until it stops, and a slow one
+// doesn't coast at all. A finger put down while it coasts stops it on
+// that frame, without a click. The deadline timer only runs while
+// there is something to coast, and a suspend in the middle of a coast
+// leaves nothing running after resume.
+//
+// The virtual clock makes every run the same, so a replay done twice
+// has to produce the same reports at the same times.
+//
+
+#include "simdevice.h"
+
+#include <vector>
+
+#define FRAME_US	12500		/* 80Hz */
+#define SETTLE_US	3000000		/* longer than any coast */
+
+struct outcome {
+	std::vector<sim::report> reports;
+	uint64_t lift;			/* when the fling's last frame arrived */
+	uint64_t timer_fires;		/* during the settle */
+};
+
+/*
+ * A two-finger scroll from now, one frame period apart, held still for
+ * rest frames before the lift. Returns when the lift arrives.
+ */
+static uint64_t fling(sim::host &h, int dy, int frames, int rest = 0)
+{
+	std::vector<sim::frame> trace = sim::swipe(2, 1200, dy < 0 ? 1700 : 100, 0, dy, frames);
+	uint64_t start = h.now();
+
+	trace.insert(trace.end() - 1, rest, trace[trace.size() - 2]);
+	for (size_t i = 0; i < trace.size(); i++)
+		h.schedule(start + i * FRAME_US, trace[i]);
+	return start + (trace.size() - 1) * FRAME_US;
+}
+
+static int wheel(const sim::report &rep)
+{
+	if (rep.id() != REPORTID_RELATIVE_MOUSE)
+		return 0;
+	return ((const syna::SynaRelativeMouseReport *)rep.data.data())->WheelPosition;
+}
+
+static int buttons(const sim::report &rep)
+{
+	if (rep.id() != REPORTID_RELATIVE_MOUSE)
+		return 0;
+	return ((const syna::SynaRelativeMouseReport *)rep.data.data())->Button;
+}
+
+/* the wheel counts after the lift, and when the last of them was read */
+static int coast(const outcome &o, uint64_t *last)
+{
+	int total = 0;
+
+	*last = 0;
+	for (const sim::report &rep : o.reports)
+		if (rep.time > o.lift && wheel(rep)) {
+			total += wheel(rep);
+			*last = rep.time;
+		}
+	return total;
+}
+
+static outcome run_fling(bool event_driven, int dy, int frames, int rest = 0)
+{
+	sim::sensor_config config;
+	sim::options opts;
+	outcome o;
+
+	opts.event_driven = event_driven;
+	sim::host h(config, opts);
+	h.start();
+	o.lift = fling(h, dy, frames, rest);
+	h.run_until(o.lift);
+	uint32_t fires = h.timer_fires;
+	h.run_until(o.lift + SETTLE_US);
+	o.timer_fires = h.timer_fires - fires;
+	CHECK(!h.context()->sc.scrollInertiaActive);
+	o.reports = h.reports;
+	h.stop();
+	return o;
+}
+
+static void check_fling(bool event_driven)
+{
+	const char *mode = event_driven ? "event-driven" : "polled";
+	uint64_t last;
+
+	/* fingers moving up scroll the page up, the wheel turns away */
+	outcome up = run_fling(event_driven, -60, 20);
+	int total = coast(up, &last);
+	CHECK(total > 0);
+	CHECK(last > up.lift && last < up.lift + SETTLE_US / 2);
+
+	/* every 50ms of the coast moves no more than the 50ms before it, but for a count held in the remainder */
+	std::vector<int> windows;
+	for (uint64_t from = up.lift; from < last; from += 50000) {
+		int window = 0;
+
+		for (const sim::report &rep : up.reports)
+			if (rep.time > from && rep.time <= from + 50000)
+				window += wheel(rep);
+		CHECK(windows.empty() || (window <= windows.back() + 1 && window <= windows[0]));
+		windows.push_back(window);
+	}
+	printf("%-12s fling up: %d wheel counts coasting over %llu us\n", mode, total,
+		(unsigned long long)(last - up.lift));
+
+	outcome down = run_fling(event_driven, 60, 20);
+	CHECK(coast(down, &last) == -total);
+
+	/* a scroll that comes to rest before the lift has no speed to leave behind */
+	outcome rest = run_fling(event_driven, 20, 40, 8);
+	int scrolled = 0;
+	for (const sim::report &rep : rest.reports)
+		if (rep.time <= rest.lift)
+			scrolled += wheel(rep);
+	CHECK(scrolled < 0);
+	CHECK(coast(rest, &last) == 0);
+
+	/* the timer stops with the coast when nothing else is due */
+	if (event_driven) {
+		uint64_t steps = (last - up.lift) / GESTURE_TICK_US;
+
+		CHECK(up.timer_fires <= steps + 4);
+		CHECK(rest.timer_fires <= 4);
+		printf("%-12s timer fires in the %d s after the lift: fling %llu, at rest %llu\n", mode,
+			SETTLE_US / 1000000, (unsigned long long)up.timer_fires,
+			(unsigned long long)rest.timer_fires);
+	}
+
+	/* and the same replay gives the same reports */
+	outcome again = run_fling(event_driven, -60, 20);
+	CHECK(again.reports.size() == up.reports.size());
+	for (size_t i = 0; i < up.reports.size(); i++) {
+		CHECK(again.reports[i].time == up.reports[i].time);
+		CHECK(again.reports[i].data == up.reports[i].data);
+	}
+}
+
+static void check_catch(bool event_driven, int fingers, uint64_t after)
+{
+	sim::sensor_config config;
+	sim::options opts;
+
+	opts.event_driven = event_driven;
+	sim::host h(config, opts);
+	h.start();
+
+	uint64_t lift = fling(h, -60, 20);
+	uint64_t caught = lift + after;
+	std::vector<sim::frame> hold = sim::swipe(fingers, 1500, 900, 0, 0, 6);
+
+	/* a short tap, lifted well inside the tap time */
+	for (size_t i = 0; i < hold.size(); i++)
+		h.schedule(caught + i * FRAME_US, hold[i]);
+	h.run_until(caught + SETTLE_US);
+
+	int before = 0, later = 0, clicks = 0;
+	for (const sim::report &rep : h.reports) {
+		if (rep.time > lift && rep.time < caught)
+			before += wheel(rep);
+		if (rep.time >= caught)
+			later += wheel(rep);
+		clicks |= buttons(rep);
+	}
+
+	/* it was coasting, the touch stopped it at once and didn't click */
+	CHECK(before > 0);
+	CHECK(later == 0);
+	CHECK(clicks == 0);
+	CHECK(!h.context()->sc.scrollInertiaActive);
+	printf("%-12s caught by %d finger%s %3llu ms after the lift: %d wheel counts, none after\n",
+		event_driven ? "event-driven" : "polled", fingers, fingers > 1 ? "s" : " ",
+		(unsigned long long)(after / 1000), before);
+
+	/* the next tap is a tap again */
+	uint64_t tap = h.now();
+	std::vector<sim::frame> again = sim::swipe(1, 1500, 900, 0, 0, 4);
+	for (size_t i = 0; i < again.size(); i++)
+		h.schedule(tap + i * FRAME_US, again[i]);
+	h.run_until(tap + SETTLE_US);
+
+	clicks = 0;
+	for (const sim::report &rep : h.reports)
+		if (rep.time >= tap)
+			clicks |= buttons(rep);
+	CHECK(clicks & MOUSE_BUTTON_1);
+	h.stop();
+}
+
+static void check_suspend(bool event_driven)
+{
+	sim::sensor_config config;
+	sim::options opts;
+
+	opts.event_driven = event_driven;
+	sim::host h(config, opts);
+	h.start();
+
+	uint64_t lift = fling(h, -60, 20);
+	h.run_until(lift + 40000);
+	CHECK(h.context()->sc.scrollInertiaActive);
+	h.suspend();
+	h.resume();
+	uint64_t resumed = h.now();
+	h.run_until(resumed + SETTLE_US);
+
+	for (const sim::report &rep : h.reports)
+		if (rep.time >= resumed)
+			CHECK(wheel(rep) == 0);
+	CHECK(!h.context()->sc.scrollInertiaActive);
+	h.stop();
+}
+
+int main()
+{
+	for (bool event_driven : { true, false }) {
+		check_fling(event_driven);
+		for (int fingers : { 1, 2 })
+			for (uint64_t after : { 20000, 100000, 250000 })
+				check_catch(event_driven, fingers, after);
+		check_suspend(event_driven);
+	}
+	return 0;
+}
@@ -0,0 +1,152 @@
+//
+// Replays a touch trace through the whole driver on the simulated
+// device, once for each way the driver can run the gesture consumer:
+//
+//  polled        the 10ms timer drains whatever the ISR queued
+//  event-driven  the ISR drains the ring right after queueing a frame,
+//                the timer only runs for gesture deadlines
+//
+// Every frame goes through the ISR, the decode plan, the gesture engine
+// and the report FIFO to the simulated class driver. Time is virtual,
+// so the latency is exactly how long each frame sat in the ring before
+// the gesture engine saw it, and the timer wakeups are exactly what the
+// driver asked for. The CPU cost is real: wall clock per frame of the
+// whole replay, simulator included, which is the same for both modes.
+//
+// Arrival times come from a trace file, one time in microseconds per
+// line, or from a synthetic 80Hz stream with jitter when none is given.
+// The contacts follow a fixed script: a one-finger move, a pause with
+// the finger lifted, a two-finger scroll, another pause.
+//
+// Usage: latency_replay [trace]
+//
+
+#include "simdevice.h"
+
+#include <algorithm>
+#include <chrono>
+
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+#define SYNTHETIC_FRAMES	400
+#define SYNTHETIC_INTERVAL_US	12500	/* 80Hz */
+#define SYNTHETIC_JITTER_US	1000
+#define STROKE_FRAMES		40
+#define SETTLE_US		2000000	/* lets coasting and deadlines run out */
+
+/* the contacts of frame i of the script, every other stroke is lifted */
+static sim::frame scripted_frame(size_t i)
+{
+	size_t stroke = i / STROKE_FRAMES;
+	int step = (int)(i % STROKE_FRAMES);
+	sim::frame f = {};
+
+	switch (stroke % 4) {
+	case 0:
+		f.slot[0] = sim::finger(800 + 30 * step, 600 + 10 * step);
+		break;
+	case 2:
+		f.slot[0] = sim::finger(1200, 400 + 25 * step);
+		f.slot[1] = sim::finger(1700, 400 + 25 * step);
+		break;
+	}
+	return f;
+}
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, int p)
+{
+	return sorted[(sorted.size() - 1) * p / 100];
+}
+
+static void run(const char *name, const std::vector<uint64_t> &arrivals, bool event_driven)
+{
+	sim::sensor_config config;
+	sim::options opts;
+
+	opts.event_driven = event_driven;
+	sim::host h(config, opts);
+	h.start();
+
+	//
+	// The sensor only reports while something touches it, plus the
+	// frame that lifts the last finger
+	//
+	uint64_t start = h.now();
+	size_t frames = 0;
+	bool touching = false;
+	for (size_t i = 0; i < arrivals.size(); i++) {
+		sim::frame f = scripted_frame(i);
+		bool touch = f.slot[0].present;
+
+		if (touch || touching) {
+			h.schedule(start + arrivals[i], f);
+			frames++;
+		}
+		touching = touch;
+	}
+
+	steady_clock::time_point begin = steady_clock::now();
+	h.run_until(start + arrivals.back() + SETTLE_US);
+	uint64_t elapsed = std::chrono::duration_cast<nanoseconds>(steady_clock::now() - begin).count();
+
+	std::vector<uint64_t> latency = h.latencies;
+	std::sort(latency.begin(), latency.end());
+	CHECK(latency.size() == frames);
+	printf("%-13s frames %5zu  p50 %6llu us  p95 %6llu us  max %6llu us  "
+		"timer wakeups %5u  reports %5zu  cpu %6llu ns/frame\n",
+		name, latency.size(),
+		(unsigned long long)percentile(latency, 50),
+		(unsigned long long)percentile(latency, 95),
+		(unsigned long long)latency.back(),
+		h.timer_fires, h.reports.size(),
+		(unsigned long long)(elapsed / frames));
+	h.stop();
+}
+
+static std::vector<uint64_t> synthetic_trace()
+{
+	std::vector<uint64_t> arrivals;
+	uint32_t seed = 1;
+	uint64_t t = 0;
+
+	for (int i = 0; i < SYNTHETIC_FRAMES; i++) {
+		seed = seed * 1103515245 + 12345;
+		t += SYNTHETIC_INTERVAL_US - SYNTHETIC_JITTER_US + (seed >> 16) % (2 * SYNTHETIC_JITTER_US);
+		arrivals.push_back(t);
+	}
+	return arrivals;
+}
+
+static std::vector<uint64_t> load_trace(const char *path)
+{
+	std::vector<uint64_t> arrivals;
+	unsigned long long t;
+	FILE *f = fopen(path, "r");
+
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+	while (fscanf(f, "%llu", &t) == 1)
+		arrivals.push_back(t);
+	fclose(f);
+
+	/* replay relative to the first frame */
+	for (size_t i = 1; i < arrivals.size(); i++)
+		arrivals[i] -= arrivals[0];
+	if (!arrivals.empty())
+		arrivals[0] = 0;
+	return arrivals;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<uint64_t> arrivals = argc > 1 ? load_trace(argv[1]) : synthetic_trace();
+
+	CHECK(!arrivals.empty());
+
+	run("polled", arrivals, false);
+	run("event-driven", arrivals, true);
+	return 0;
+}
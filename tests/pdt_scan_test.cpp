@@ -0,0 +1,138 @@
+//
+// Scans the PDT of simulated sensors with their functions on one page
+// and on two, and compares what the chunked scan costs on the bus with
+// what it cost to read one 6-byte entry per round trip. Every function
+// has to be found on the page it sits on with the interrupts it has, the
+// scan has to stop at the first page without a function, and no read
+// may reach the data registers below the PDT, which may clear on read.
+// A read can only pass the entry that ends a page's PDT by less than
+// the chunk it was read in, the scan can't know where the end is before.
+//
+// Bring-up time is the bus time of the whole start at 400kHz, nine
+// clocks to a byte and an address byte to each transaction.
+//
+
+#include "simdevice.h"
+
+#define I2C_HZ		400000
+
+/* a read moves a whole output command and input report, whatever it asks for */
+#define ROUND_TRIP_BYTES	(RMI_OUTPUT_COMMAND_SIZE + RMI_INPUT_HEADER_SIZE + RMI_INPUT_REPORT_SIZE)
+
+struct page_pdt {
+	int functions;
+	uint16_t end;			/* the entry that ends it */
+};
+
+/* what the sensor has on a page, walked down from the top like the driver does */
+static page_pdt pdt_of(const sim::sensor &device, int page)
+{
+	page_pdt p = { 0, 0 };
+	uint16_t addr = (uint16_t)(page * RMI4_PAGE_SIZE + PDT_START_SCAN_LOCATION);
+
+	while (!RMI4_END_OF_PDT(device.registers[addr + 5])) {
+		p.functions++;
+		addr -= sizeof(syna::pdt_entry);
+	}
+	p.end = addr;
+	return p;
+}
+
+static uint64_t bus_us(uint32_t transactions, uint64_t bytes)
+{
+	return (bytes + transactions) * 9 * 1000000 / I2C_HZ;
+}
+
+static void scan(const char *name, const sim::sensor_config &config)
+{
+	sim::host h(config);
+	h.device.reset_counters();
+	h.start();
+
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	std::vector<page_pdt> pages;
+
+	/* the pages with functions, and the empty one after them */
+	for (int page = 0;; page++) {
+		pages.push_back(pdt_of(h.device, page));
+		if (!pages.back().functions)
+			break;
+	}
+
+	/* registers that may clear on read, which no PDT read may reach */
+	struct data_block {
+		uint16_t addr;
+		int size;
+	};
+	const data_block data[] = {
+		{ pDevice->f01.data_base_addr, 2 },
+		{ pDevice->f11.data_base_addr, (int)h.device.f11_size },
+		{ pDevice->f30.data_base_addr, (int)h.device.f30_size },
+	};
+
+	int reads = 0, bytes = 0, entries = 0;
+	for (const std::pair<uint16_t, int> &read : h.device.read_log) {
+		uint16_t addr = read.first;
+		int page = addr / RMI4_PAGE_SIZE;
+		uint16_t top = (uint16_t)(page * RMI4_PAGE_SIZE + PDT_START_SCAN_LOCATION + sizeof(syna::pdt_entry));
+
+		/* not a page the scan should have looked at */
+		CHECK(page < (int)pages.size());
+		if (addr + read.second <= pages[page].end)
+			continue;
+
+		/*
+		 * A PDT read. The chunk that holds the terminator may reach
+		 * past it, by less than the chunk it was read in: the top two
+		 * entries at first, then as many as the functions found above.
+		 */
+		int chunk = std::max(RMI_PDT_FIRST_CHUNK_ENTRIES, pages[page].functions);
+		CHECK(addr + (chunk - 1) * (int)sizeof(syna::pdt_entry) >= pages[page].end);
+		for (const data_block &d : data)
+			CHECK(addr >= d.addr + d.size || addr + read.second <= d.addr);
+		CHECK(addr + read.second <= top);
+		CHECK(read.second % (int)sizeof(syna::pdt_entry) == 0);
+		reads++;
+		bytes += read.second;
+	}
+
+	/* one entry per round trip: the functions and the terminator of each page */
+	for (const page_pdt &p : pages)
+		entries += p.functions + 1;
+	CHECK(bytes >= entries * (int)sizeof(syna::pdt_entry));
+
+	/* found where they are */
+	CHECK(pDevice->f01.page == 0);
+	CHECK((int)pDevice->f11.page == config.f11_page);
+	CHECK(pDevice->f11.irq_mask == h.device.irq_f11);
+	CHECK(pDevice->f30.irq_mask == h.device.irq_f30);
+	CHECK(!config.f30 || pDevice->f30.query_base_addr);
+
+	/* the rest of the start is the same either way */
+	uint32_t transactions = h.device.transactions;
+	uint64_t total = h.device.bytes;
+	uint32_t per_entry = transactions + 2 * (entries - reads);
+	uint64_t per_entry_bytes = total + (uint64_t)(entries - reads) * ROUND_TRIP_BYTES;
+
+	printf("%-16s %zu pages scanned  PDT %2d entries in %d reads, %2d with one per read  "
+		"start %2u transactions %4llu us, %2u %4llu us with one per read\n",
+		name, pages.size(), entries, reads, entries, transactions,
+		(unsigned long long)bus_us(transactions, total), per_entry,
+		(unsigned long long)bus_us(per_entry, per_entry_bytes));
+	CHECK(reads < entries);
+	h.stop();
+}
+
+int main()
+{
+	sim::sensor_config config;
+
+	scan("F01 F11 F30", config);
+	config.f30 = false;
+	scan("F01 F11", config);
+	config.f11_page = 1;
+	scan("F01 / F11", config);
+	config.f30 = true;
+	scan("F01 F30 / F11", config);
+	return 0;
+}
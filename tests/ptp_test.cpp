@@ -0,0 +1,203 @@
+//
+// Parses the Precision Touchpad collections ptp_build_descriptor lays
+// out for a spread of sensors and checks them against what the driver
+// sends: the report ids, the input report the size of struct
+// ptp_report, each of the five contacts where struct ptp_contact has
+// it with the sensor's logical and physical extents, and the feature
+// reports the sizes of their structures. Then reports from
+// ptp_build_report are read back through the parsed descriptor, lifted
+// contacts must come before the ones still down.
+//
+
+#include "hostshim.h"
+#include "hiddescriptor.h"
+
+namespace syna {
+#include "../crostrackpad3-synaptics/ptp.cpp"
+}
+
+#define USAGE_X			0x00010030
+#define USAGE_Y			0x00010031
+#define USAGE_BUTTON_1		0x00090001
+#define USAGE_TIP		0x000d0042
+#define USAGE_CONFIDENCE	0x000d0047
+#define USAGE_CONTACT_ID	0x000d0051
+#define USAGE_CONTACT_COUNT	0x000d0054
+#define USAGE_SCAN_TIME		0x000d0056
+
+#define UNIT_CM			0x11
+
+/* the contact's own fields, in the order its logical collection has them */
+struct contact_fields {
+	const hid::field *flags;
+	const hid::field *id;
+	const hid::field *x;
+	const hid::field *y;
+};
+
+static std::vector<contact_fields> contacts(const hid::descriptor &d)
+{
+	std::vector<contact_fields> out;
+
+	for (const hid::field &f : d.fields) {
+		if (f.kind != hid::INPUT || f.report_id != REPORTID_PTP || (f.flags & hid::CONSTANT))
+			continue;
+		if (f.usage(0) == USAGE_CONFIDENCE) {
+			out.push_back(contact_fields());
+			out.back().flags = &f;
+		}
+		else if (f.usage(0) == USAGE_CONTACT_ID) {
+			out.back().id = &f;
+		}
+		else if (f.usage(0) == USAGE_X) {
+			out.back().x = &f;
+		}
+		else if (f.usage(0) == USAGE_Y) {
+			out.back().y = &f;
+		}
+	}
+	return out;
+}
+
+static void check_extent(const hid::field *f, unsigned int logical, unsigned int physical, size_t offset)
+{
+	CHECK(f && f->size == 16 && f->count == 1 && !(f->flags & hid::RELATIVE));
+	CHECK(f->bit == 8 * (offset - 1));
+	CHECK(f->logical_min == 0 && f->logical_max == (int32_t)logical);
+	CHECK(f->physical_min == 0 && f->physical_max == (int32_t)physical);
+
+	/* 0.1mm, the unit the sensor reports its size in */
+	CHECK(f->unit == UNIT_CM && f->exponent == -2);
+	CHECK(f->collection == 2);
+}
+
+static hid::descriptor check_descriptor(const syna::ptp_geometry &g)
+{
+	uint8_t buffer[PTP_DESCRIPTOR_MAX];
+	unsigned int length = syna::ptp_build_descriptor(&g, buffer, sizeof(buffer));
+	hid::descriptor d = hid::parse(buffer, length);
+
+	CHECK(length > 0);
+
+	/* one byte short of it doesn't fit */
+	uint8_t small[PTP_DESCRIPTOR_MAX];
+	CHECK(syna::ptp_build_descriptor(&g, small, length - 1) == 0);
+	CHECK(syna::ptp_build_descriptor(&g, small, length) == length);
+
+	/* the touchpad input report, the rest are features */
+	for (const hid::field &f : d.fields) {
+		if (f.kind == hid::INPUT)
+			CHECK(f.report_id == REPORTID_PTP);
+		else
+			CHECK(f.kind == hid::FEATURE && f.report_id >= REPORTID_PTP_CAPS &&
+				f.report_id <= REPORTID_PTP_CERTIFICATION);
+	}
+	CHECK(d.bytes(hid::INPUT, REPORTID_PTP) == sizeof(syna::ptp_report));
+	CHECK(d.bytes(hid::FEATURE, REPORTID_PTP_CAPS) == sizeof(syna::ptp_caps_report));
+	CHECK(d.bytes(hid::FEATURE, REPORTID_PTP_INPUT_MODE) == sizeof(syna::ptp_input_mode_report));
+	CHECK(d.bytes(hid::FEATURE, REPORTID_PTP_SWITCHES) == sizeof(syna::ptp_switches_report));
+	CHECK(d.bytes(hid::FEATURE, REPORTID_PTP_CERTIFICATION) == sizeof(syna::ptp_certification_report));
+
+	std::vector<contact_fields> c = contacts(d);
+	CHECK(c.size() == PTP_MAX_CONTACTS);
+	for (unsigned int i = 0; i < c.size(); i++) {
+		size_t contact = offsetof(syna::ptp_report, contact) + i * sizeof(syna::ptp_contact);
+
+		/* confidence and tip in bits 0 and 1, the id above them */
+		CHECK(c[i].flags->size == 1 && c[i].flags->count == 2);
+		CHECK(c[i].flags->usage(0) == USAGE_CONFIDENCE && c[i].flags->usage(1) == USAGE_TIP);
+		CHECK(c[i].flags->bit == 8 * (contact - 1));
+		CHECK(c[i].id && c[i].id->size == 4 && c[i].id->bit == c[i].flags->bit + PTP_CONTACT_ID_SHIFT);
+		CHECK(c[i].id->logical_max == PTP_MAX_SLOTS - 1);
+
+		check_extent(c[i].x, g.logical_x, g.physical_x, contact + offsetof(syna::ptp_contact, x));
+		check_extent(c[i].y, g.logical_y, g.physical_y, contact + offsetof(syna::ptp_contact, y));
+	}
+
+	const hid::field *scan = d.find(hid::INPUT, REPORTID_PTP, USAGE_SCAN_TIME);
+	const hid::field *count = d.find(hid::INPUT, REPORTID_PTP, USAGE_CONTACT_COUNT);
+	const hid::field *button = d.find(hid::INPUT, REPORTID_PTP, USAGE_BUTTON_1);
+	CHECK(scan && scan->size == 16 && scan->bit == 8 * (offsetof(syna::ptp_report, scan_time) - 1));
+	CHECK(scan->logical_max == 0xffff && scan->exponent == -4);
+	CHECK(count && count->size == 8 && count->bit == 8 * (offsetof(syna::ptp_report, contact_count) - 1));
+	CHECK(button && button->size == 1 && button->bit == 8 * (offsetof(syna::ptp_report, buttons) - 1));
+	return d;
+}
+
+/* one lifted contact and the ones still down, read back through the descriptor */
+static void check_report(const hid::descriptor &d)
+{
+	std::vector<contact_fields> c = contacts(d);
+	const hid::field *count = d.find(hid::INPUT, REPORTID_PTP, USAGE_CONTACT_COUNT);
+	const hid::field *button = d.find(hid::INPUT, REPORTID_PTP, USAGE_BUTTON_1);
+	const hid::field *scan = d.find(hid::INPUT, REPORTID_PTP, USAGE_SCAN_TIME);
+	syna::ptp_state state = {};
+	syna::ptp_report report;
+
+	for (int slot = 0; slot < PTP_MAX_SLOTS; slot++)
+		syna::ptp_contact_set(&state, slot, (uint16_t)(100 + slot), (uint16_t)(200 + slot));
+
+	/* slots 2 and 6 down, 4 lifted this frame */
+	const uint32_t active = 1 << 2 | 1 << 6;
+	const uint32_t released = 1 << 4;
+	syna::ptp_build_report(&state, active, released, true, 123456,
+		PTP_SWITCH_SURFACE | PTP_SWITCH_BUTTON, &report);
+	const uint8_t *bytes = (const uint8_t *)&report;
+	static const int order[] = { 4, 2, 6 };
+
+	CHECK(bytes[0] == REPORTID_PTP);
+	CHECK(hid::extract(bytes, *count) == 3);
+	CHECK(hid::extract(bytes, *button) == 1);
+	CHECK(hid::extract(bytes, *scan) == 1234);
+	for (int i = 0; i < 3; i++) {
+		int slot = order[i];
+
+		CHECK(hid::extract(bytes, *c[i].id) == slot);
+		CHECK(hid::extract(bytes, *c[i].flags, 0) == 1);
+		CHECK(hid::extract(bytes, *c[i].flags, 1) == (i == 0 ? 0 : 1));
+		CHECK(hid::extract(bytes, *c[i].x) == 100 + slot);
+		CHECK(hid::extract(bytes, *c[i].y) == 200 + slot);
+	}
+	for (int i = 3; i < PTP_MAX_CONTACTS; i++)
+		CHECK(hid::extract(bytes, *c[i].flags, 1) == 0 && hid::extract(bytes, *c[i].id) == 0);
+
+	/* past five the lifted ones still go first, the newest active ones wait */
+	syna::ptp_build_report(&state, 0x3f0, 0x00f, false, 0, PTP_SWITCH_SURFACE | PTP_SWITCH_BUTTON, &report);
+	CHECK(hid::extract(bytes, *count) == PTP_MAX_CONTACTS);
+	for (int i = 0; i < PTP_MAX_CONTACTS; i++) {
+		CHECK(hid::extract(bytes, *c[i].id) == i);
+		CHECK(hid::extract(bytes, *c[i].flags, 1) == (i < 4 ? 0 : 1));
+	}
+	CHECK(hid::extract(bytes, *button) == 0);
+
+	/* with the surface switched off only the button gets through */
+	syna::ptp_build_report(&state, active, released, true, 0, PTP_SWITCH_BUTTON, &report);
+	CHECK(hid::extract(bytes, *count) == 0 && hid::extract(bytes, *button) == 1);
+	syna::ptp_build_report(&state, active, released, true, 0, PTP_SWITCH_SURFACE, &report);
+	CHECK(hid::extract(bytes, *count) == 3 && hid::extract(bytes, *button) == 0);
+}
+
+int main()
+{
+	static const syna::ptp_geometry geometries[] = {
+		{ 5, 3000, 1800, 1000, 600, true },
+		{ 10, 3678, 2170, 1050, 610, true },
+		{ 3, 1218, 672, 600, 330, false },
+		{ 5, 4095, 4095, 1200, 700, true },
+		{ 2, 255, 127, 60, 30, false },
+	};
+
+	for (const syna::ptp_geometry &g : geometries) {
+		hid::descriptor d = check_descriptor(g);
+
+		/* the most contacts Windows is told about, and the pad type */
+		uint8_t caps = syna::ptp_caps(&g);
+		CHECK((caps & 0x0f) == (g.contacts < PTP_MAX_CONTACTS ? g.contacts : PTP_MAX_CONTACTS));
+		CHECK(caps >> 4 == (g.clickpad ? PTP_PAD_DEPRESSIBLE : PTP_PAD_NON_CLICKABLE));
+
+		check_report(d);
+		printf("%2u contacts, %4u x %4u in %3u x %3u mm: descriptor and reports match\n",
+			g.contacts, g.logical_x, g.logical_y, g.physical_x / 10, g.physical_y / 10);
+	}
+	return 0;
+}
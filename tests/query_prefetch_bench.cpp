@@ -0,0 +1,120 @@
+//
+// What the query prefetch saves at bring-up. Every READ_ADDR the
+// populate sends to the simulated sensor is put down to the PDT, the
+// query registers of F01, F11 or F30, or the control registers, on
+// a spread of sensor layouts.
+//
+// Before the prefetch every read the has_queryN walk made was its own
+// round trip, a write report and an input read. After it those reads
+// are answered from the register cache, and the cache counts them, so
+// the walk would have cost those hits in round trips where it now
+// costs the prefetch reads. F30 isn't prefetched, its reads count the
+// same either way. A resume reads no queries at all.
+//
+// Usage: query_prefetch_bench
+//
+
+#include "simdevice.h"
+
+struct layout {
+	const char *name;
+	sim::sensor_config config;
+};
+
+enum region { PDT, F01_QUERY, F11_QUERY, F30_QUERY, CONTROL, REGIONS };
+
+static const char *const region_names[REGIONS] = { "PDT", "F01 query", "F11 query", "F30 query", "control" };
+
+static bool inside(uint16_t addr, int len, uint16_t base, unsigned int size)
+{
+	return base && addr >= base && addr + len <= base + (int)size;
+}
+
+static region classify(syna::PDEVICE_CONTEXT pDevice, uint16_t addr, int len)
+{
+	if (inside(addr, len, pDevice->f01.query_base_addr, pDevice->f01.query_size))
+		return F01_QUERY;
+	if (inside(addr, len, pDevice->f11.query_base_addr, pDevice->f11.query_size))
+		return F11_QUERY;
+	if (inside(addr, len, pDevice->f30.query_base_addr, pDevice->f30.query_size))
+		return F30_QUERY;
+	if (inside(addr, len, pDevice->f01.control_base_addr, RMI_QUERY_PREFETCH_MAX) ||
+		inside(addr, len, pDevice->f11.control_base_addr, RMI_QUERY_PREFETCH_MAX) ||
+		inside(addr, len, pDevice->f30.control_base_addr, RMI_QUERY_PREFETCH_MAX))
+		return CONTROL;
+
+	/* the PDT sits at the top of each page */
+	CHECK((addr & 0xff) + len - 1 <= PDT_START_SCAN_LOCATION + (int)sizeof(syna::pdt_entry) - 1);
+	CHECK((addr & 0xff) >= PDT_END_SCAN_LOCATION);
+	return PDT;
+}
+
+static void measure(const layout &l)
+{
+	sim::host h(l.config);
+	h.device.reset_counters();
+	h.start();
+
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	int reads[REGIONS] = {};
+	int bytes[REGIONS] = {};
+
+	for (const std::pair<uint16_t, int> &read : h.device.read_log) {
+		region r = classify(pDevice, read.first, read.second);
+
+		reads[r]++;
+		bytes[r] += read.second;
+	}
+	uint32_t transactions = h.device.transactions;
+	uint32_t hits = pDevice->RegisterCache.hits;
+	int query_reads = reads[F01_QUERY] + reads[F11_QUERY] + reads[F30_QUERY];
+	int prefetch = reads[F01_QUERY] + reads[F11_QUERY];
+
+	/* the prefetch takes no more reads than the bytes need */
+	CHECK(reads[F01_QUERY] == (int)(pDevice->f01.query_size + RMI_READ_DATA_MAX - 1) / RMI_READ_DATA_MAX);
+	CHECK(reads[F11_QUERY] == (int)(pDevice->f11.query_size + RMI_READ_DATA_MAX - 1) / RMI_READ_DATA_MAX);
+
+	printf("%s\n", l.name);
+	for (int r = 0; r < REGIONS; r++)
+		printf("  %-10s %2d reads %4d bytes\n", region_names[r], reads[r], bytes[r]);
+	printf("  queries    %2d reads now, %2d with a round trip per walk read\n",
+		query_reads, query_reads - prefetch + (int)hits);
+	printf("  populate   %3u transactions now, %3d with a round trip per walk read\n",
+		transactions, (int)transactions + 2 * ((int)hits - prefetch));
+
+	/* and a resume has the queries already */
+	h.suspend();
+	h.device.reset_counters();
+	h.resume(true);
+	for (const std::pair<uint16_t, int> &read : h.device.read_log) {
+		region r = classify(pDevice, read.first, read.second);
+
+		CHECK(r != F01_QUERY && r != F11_QUERY && r != F30_QUERY);
+	}
+	printf("  resume     %3u transactions, %zu reads\n", h.device.transactions, h.device.read_log.size());
+	h.stop();
+}
+
+static layout with(const char *name, void (*change)(sim::sensor_config &))
+{
+	layout l;
+
+	l.name = name;
+	change(l.config);
+	return l;
+}
+
+int main()
+{
+	const layout layouts[] = {
+		with("5 fingers", [](sim::sensor_config &) {}),
+		with("10 fingers with data 40", [](sim::sensor_config &c) { c.fingers = 10; c.data40 = true; }),
+		with("no build id query", [](sim::sensor_config &c) { c.build_id = false; }),
+		with("no F30", [](sim::sensor_config &c) { c.f30 = false; }),
+		with("F11 on page 1", [](sim::sensor_config &c) { c.f11_page = 1; }),
+	};
+
+	for (const layout &l : layouts)
+		measure(l);
+	return 0;
+}
@@ -0,0 +1,124 @@
+//
+// Counts the bus transactions of a full populate and of the resumes
+// after it, on a simulated sensor that has every control register the
+// driver fixes up set the wrong way: dribble and palm detect on in F11,
+// no interrupt enables in F01.
+//
+// The populate has to read each register once, whatever reads it
+// again is answered from the register cache. A resume reads nothing:
+// it sets the mode and writes back the registers the driver changed,
+// one write per run of them, and the sensor has to come out of it the
+// way populate left it even when it lost power in between.
+//
+
+#include "simdevice.h"
+
+struct counts {
+	uint32_t transactions;
+	uint32_t register_reads;
+	uint32_t register_writes;
+	uint32_t page_switches;
+	uint64_t bytes;
+};
+
+static counts take(sim::sensor &device)
+{
+	counts c = { device.transactions, device.register_reads, device.register_writes,
+		device.page_switches, device.bytes };
+
+	device.reset_counters();
+	return c;
+}
+
+static void print(const char *what, const counts &c)
+{
+	printf("%-28s %3u transactions  %3u register reads  %2u writes  %2u page switches  %5llu bytes\n",
+		what, c.transactions, c.register_reads, c.register_writes, c.page_switches,
+		(unsigned long long)c.bytes);
+}
+
+/* the control registers populate fixes up hold what it wrote */
+static void check_controls(sim::host &h)
+{
+	sim::sensor &device = h.device;
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+
+	CHECK(!(device.registers[device.control_base(0x11)] & 0x40));
+	CHECK(!(device.registers[device.control_base(0x11) + 11] & 0x01));
+	CHECK(device.registers[device.control_base(0x01) + 1] == (uint8_t)pDevice->interrupt_enable_mask);
+}
+
+static void cycle(int page)
+{
+	sim::sensor_config config;
+
+	config.dribble = true;
+	config.palm = true;
+	config.f01_ctrl1 = 0;
+	config.f11_page = page;
+	sim::host h(config);
+	h.device.reset_counters();
+	h.start();
+
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	syna::rmi_register_cache *cache = &pDevice->RegisterCache;
+	char what[64];
+
+	counts populate = take(h.device);
+	snprintf(what, sizeof(what), "populate, F11 on page %d", page);
+	print(what, populate);
+	printf("%-28s %3u registers cached, %u reads answered from the cache, %u writes skipped\n",
+		"", cache->count, cache->hits, cache->writes_skipped);
+
+	/* every register the driver read went over the bus once */
+	CHECK(cache->bus_reads == populate.register_reads);
+	CHECK(cache->bus_writes == populate.register_writes);
+	CHECK(cache->overflows == 0);
+	check_controls(h);
+
+	/* dribble and palm in F11 ctrl 0 and 11, the F01 interrupt enables */
+	const uint32_t dirty_runs = 3;
+	CHECK(populate.register_writes == dirty_runs);
+
+	/* the sensor kept its registers, the resume writes them anyway */
+	h.suspend();
+	h.device.reset_counters();
+	h.resume();
+	counts resume = take(h.device);
+	print("resume", resume);
+	CHECK(resume.register_reads == 0);
+	CHECK(resume.register_writes == dirty_runs);
+	check_controls(h);
+
+	/* the mode, the pages of the dirty runs and the runs, nothing else */
+	CHECK(resume.transactions == 1 + resume.page_switches + dirty_runs);
+
+	/* it lost power and came back with the defaults */
+	h.suspend();
+	h.device.reset_counters();
+	h.resume(true);
+	counts lost = take(h.device);
+	print("resume after a power loss", lost);
+	CHECK(lost.register_reads == 0);
+	CHECK(lost.register_writes == dirty_runs);
+	CHECK(lost.transactions == resume.transactions);
+	check_controls(h);
+
+	/* and still scans */
+	sim::frame f = {};
+	f.slot[0] = sim::finger(1000, 800);
+	h.touch(f);
+	h.run_for(20000);
+	h.touch(sim::frame());
+	h.run_for(200000);
+	CHECK(!h.reports.empty());
+
+	h.stop();
+}
+
+int main()
+{
+	cycle(0);
+	cycle(1);
+	return 0;
+}
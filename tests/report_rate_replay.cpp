@@ -0,0 +1,82 @@
+//
+// Counts the vendor reports the driver hands the HID class driver per
+// second of ordinary use, after the change tracking and before it. The
+// driver counts what it sent and what it held back because it repeated
+// the last report of its type, the old code sent both, so sent plus
+// suppressed is what the class driver had to read before.
+//
+// Each gesture is replayed on its own at 100Hz through the whole driver
+// on the simulated device: pointing, a finger resting, a two-finger
+// scroll, which goes out as wheel motion in mouse reports, and a
+// three-finger swipe that brings up the Alt-Tab switcher and holds it.
+// The reports the class driver read are counted by id, and no two
+// keyboard reports in a row may be the same. The rates are per second
+// of the gesture, what coasting sends after the lift included.
+//
+// Usage: report_rate_replay
+//
+
+#include "simdevice.h"
+
+#define FRAME_US	10000
+#define SETTLE_US	2000000
+
+struct gesture {
+	const char *name;
+	std::vector<sim::frame> trace;
+};
+
+static void replay(const gesture &g)
+{
+	sim::sensor_config config;
+	sim::host h(config);
+	h.start();
+
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+	uint32_t sent = pDevice->LastReport.sent;
+	uint32_t suppressed = pDevice->LastReport.suppressed;
+	uint64_t start = h.now();
+
+	for (size_t i = 0; i < g.trace.size(); i++)
+		h.schedule(start + i * FRAME_US, g.trace[i]);
+	h.run_until(start + g.trace.size() * FRAME_US + SETTLE_US);
+
+	size_t mouse = 0, keyboard = 0;
+	const sim::report *last_keyboard = nullptr;
+	for (const sim::report &rep : h.reports) {
+		switch (rep.id()) {
+		case REPORTID_RELATIVE_MOUSE:
+			mouse++;
+			break;
+		case REPORTID_KEYBOARD:
+			CHECK(!last_keyboard || last_keyboard->data != rep.data);
+			last_keyboard = &rep;
+			keyboard++;
+			break;
+		}
+	}
+
+	sent = pDevice->LastReport.sent - sent;
+	suppressed = pDevice->LastReport.suppressed - suppressed;
+	double seconds = g.trace.size() * FRAME_US / 1e6;
+
+	/* the FIFO may fold mouse reports together, it never adds any */
+	CHECK(mouse + keyboard <= sent);
+	printf("%-22s read: %4zu mouse %3zu keyboard  reports/s: %6.1f after, %6.1f before\n",
+		g.name, mouse, keyboard, sent / seconds, (sent + suppressed) / seconds);
+	h.stop();
+}
+
+int main()
+{
+	std::vector<gesture> gestures = {
+		{ "pointing", sim::swipe(1, 600, 500, 12, 5, 200) },
+		{ "finger resting", sim::swipe(1, 1200, 800, 0, 0, 200) },
+		{ "two-finger scroll", sim::swipe(2, 1200, 300, 0, 25, 50) },
+		{ "three-finger Alt-Tab", sim::swipe(3, 600, 800, 10, 0, 200) },
+	};
+
+	for (const gesture &g : gestures)
+		replay(g);
+	return 0;
+}
@@ -0,0 +1,226 @@
+//
+// Drives the vendor report FIFO the way SynaProcessVendorReport and
+// SynaReadReport do, with a HID class driver that is slow to post its
+// reads. Motion may merge or drop, but the host must see every button
+// and key change the FIFO took, however slow the reader. Changes it had
+// no room for are pushed back, the source keeps its state and reports
+// it again, the way emit_report does.
+//
+
+#include "hostshim.h"
+
+#include <vector>
+
+namespace syna {
+#include "../crostrackpad3-synaptics/hidcommon.h"
+#include "../crostrackpad3-synaptics/reportfifo.h"
+}
+
+using syna::SynaKeyboardReport;
+using syna::SynaRelativeMouseReport;
+
+/* what the class driver has seen so far */
+struct host {
+	uint8_t button;
+	uint8_t modifiers;
+	long x;
+	long y;
+	std::vector<uint8_t> buttons;	/* every button state it was handed */
+	std::vector<uint8_t> keys;
+};
+
+struct source {
+	uint8_t button;
+	uint8_t modifiers;
+	long x;
+	long y;
+	std::vector<uint8_t> buttons;
+	std::vector<uint8_t> keys;
+};
+
+static void deliver(host *h, syna::syna_report_fifo *fifo)
+{
+	syna::syna_report_entry *entry = syna::report_fifo_next(fifo, 0);
+
+	if (!entry)
+		return;
+	syna::report_fifo_hold(fifo, 1);
+	if (entry->data[0] == REPORTID_RELATIVE_MOUSE) {
+		SynaRelativeMouseReport *mouse = (SynaRelativeMouseReport *)entry->data;
+
+		if (h->buttons.empty() || mouse->Button != h->button)
+			h->buttons.push_back(mouse->Button);
+		h->button = mouse->Button;
+		h->x += mouse->XValue;
+		h->y += mouse->YValue;
+	}
+	else if (entry->data[0] == REPORTID_KEYBOARD) {
+		SynaKeyboardReport *keyboard = (SynaKeyboardReport *)entry->data;
+
+		h->modifiers = keyboard->ShiftKeyFlags;
+		h->keys.push_back(keyboard->ShiftKeyFlags);
+	}
+	syna::report_fifo_release(fifo, 1);
+}
+
+static void push_mouse(source *s, syna::syna_report_fifo *fifo, uint8_t button, short dx, short dy)
+{
+	SynaRelativeMouseReport report = {};
+
+	report.ReportID = REPORTID_RELATIVE_MOUSE;
+	report.Button = button;
+	report.XValue = dx;
+	report.YValue = dy;
+	if (!syna::report_fifo_push(fifo, &report, sizeof(report))) {
+		/* only an edge is ever pushed back */
+		CHECK(s->buttons.empty() || button != s->button);
+		return;
+	}
+
+	if (s->buttons.empty() || button != s->button)
+		s->buttons.push_back(button);
+	s->button = button;
+	s->x += dx;
+	s->y += dy;
+}
+
+static void push_keyboard(source *s, syna::syna_report_fifo *fifo, uint8_t modifiers)
+{
+	SynaKeyboardReport report = {};
+
+	/* unchanged state reports are suppressed */
+	if (!s->keys.empty() && modifiers == s->modifiers)
+		return;
+
+	report.ReportID = REPORTID_KEYBOARD;
+	report.ShiftKeyFlags = modifiers;
+	if (!syna::report_fifo_push(fifo, &report, sizeof(report)))
+		return;
+
+	s->modifiers = modifiers;
+	s->keys.push_back(modifiers);
+}
+
+/*
+ * One frame's worth of reports: motion every frame, a click every 7th,
+ * an Alt+Tab style modifier press and release every 23rd.
+ */
+static void frame(source *s, syna::syna_report_fifo *fifo, int n)
+{
+	push_mouse(s, fifo, s->button, (short)(n % 5 - 2), (short)(n % 3 - 1));
+	if (n % 7 == 0) {
+		push_mouse(s, fifo, MOUSE_BUTTON_1, 0, 0);
+		push_mouse(s, fifo, 0, 0, 0);
+	}
+	if (n % 23 == 0) {
+		push_keyboard(s, fifo, KBD_LALT_BIT);
+		push_keyboard(s, fifo, 0);
+	}
+}
+
+/* the reader posts one read every 'period' frames */
+static void run(int frames, int period, bool lossless)
+{
+	static syna::syna_report_fifo fifo;
+	source s = {};
+	host h = {};
+
+	memset(&fifo, 0, sizeof(fifo));
+	syna::report_fifo_init(&fifo);
+
+	for (int n = 0; n < frames; n++) {
+		frame(&s, &fifo, n);
+		if (n % period == 0)
+			deliver(&h, &fifo);
+	}
+	while (syna::report_fifo_count(&fifo))
+		deliver(&h, &fifo);
+
+	/* edges the FIFO took that never reached the host */
+	long edges_dropped = (long)(s.buttons.size() + s.keys.size()) -
+		(long)(h.buttons.size() + h.keys.size());
+
+	printf("period %3d: queued %5u merged %5u dropped %5u refused %4u edges dropped %ld\n",
+		period, fifo.queued, fifo.merged, fifo.dropped, fifo.refused, edges_dropped);
+
+	/* however far behind the reader was, it ends where the source did */
+	CHECK(h.button == s.button);
+	CHECK(h.modifiers == s.modifiers);
+
+	/* and saw every transition in the order it was made */
+	CHECK(edges_dropped == 0);
+	CHECK(h.buttons == s.buttons);
+	CHECK(h.keys == s.keys);
+
+	if (lossless) {
+		CHECK(fifo.dropped == 0);
+		CHECK(fifo.refused == 0);
+		CHECK(h.x == s.x);
+		CHECK(h.y == s.y);
+	}
+	else {
+		CHECK(fifo.dropped > 0);
+		CHECK(fifo.refused > 0);
+	}
+}
+
+/*
+ * Reports held for reads being completed keep their place: nothing
+ * merges into or evicts them, and the ones whose read failed go out
+ * first once they are released.
+ */
+static void held()
+{
+	static syna::syna_report_fifo fifo;
+	source s = {};
+	host h = {};
+
+	memset(&fifo, 0, sizeof(fifo));
+	syna::report_fifo_init(&fifo);
+
+	push_mouse(&s, &fifo, 0, 1, 1);
+	push_mouse(&s, &fifo, MOUSE_BUTTON_1, 0, 0);
+	CHECK(syna::report_fifo_count(&fifo) == 2);
+
+	syna::report_fifo_hold(&fifo, 2);
+	CHECK(syna::report_fifo_next(&fifo, 0) == NULL);
+
+	/* would merge into the pressed report if it were not held */
+	push_mouse(&s, &fifo, MOUSE_BUTTON_1, 5, 0);
+	CHECK(syna::report_fifo_count(&fifo) == 3);
+
+	/* fill up, held motion must not be evicted for room */
+	for (int i = 0; syna::report_fifo_count(&fifo) < SYNA_REPORT_FIFO_SIZE; i++)
+		push_keyboard(&s, &fifo, (i & 1) ? 0 : KBD_LALT_BIT);
+	push_mouse(&s, &fifo, s.button, 2, 0);
+	CHECK(syna::report_fifo_entry(&fifo, 0)->data[0] == REPORTID_RELATIVE_MOUSE);
+	CHECK(((SynaRelativeMouseReport *)syna::report_fifo_entry(&fifo, 0)->data)->XValue == 1);
+
+	/* the first read went through, the second failed */
+	syna::report_fifo_release(&fifo, 1);
+	CHECK(fifo.last_button == 0);
+	CHECK(syna::report_fifo_next(&fifo, 0)->data[1] == MOUSE_BUTTON_1);
+	h.buttons.push_back(0);
+	h.x = 1;
+	h.y = 1;
+
+	while (syna::report_fifo_count(&fifo))
+		deliver(&h, &fifo);
+	CHECK(h.buttons == s.buttons);
+	CHECK(h.keys == s.keys);
+	CHECK(h.modifiers == s.modifiers);
+}
+
+int main()
+{
+	/* a reader that keeps up, and one slow enough to need the merging */
+	run(2000, 1, true);
+	run(2000, 2, true);
+
+	/* one that falls further and further behind */
+	run(2000, 8, false);
+	run(2000, 50, false);
+
+	held();
+	return 0;
+}
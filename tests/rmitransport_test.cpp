@@ -0,0 +1,264 @@
+//
+// Runs the RMI transport against a mock HID-over-I2C sensor. The mock
+// answers READ_ADDR with a READ_DATA input report and keeps ATTN reports
+// coming, and lets an "ISR" read an input report whenever the bus is
+// free between two transactions, the way the driver's interrupt handler
+// could. A read must either hand back the registers it asked for or fail
+// and leave the caller's buffer alone, never return what the ISR left.
+//
+
+#include "hostshim.h"
+
+#include <deque>
+#include <vector>
+
+/* linuxmacros.h has an unused local in set_bit() */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+namespace syna {
+#include "../crostrackpad3-synaptics/rmi.h"
+#include "../crostrackpad3-synaptics/rmitransport.h"
+}
+#pragma GCC diagnostic pop
+
+#define RMI_INPUT_LENGTH	(RMI_INPUT_HEADER_SIZE + RMI_INPUT_REPORT_SIZE)
+
+struct mock_sensor {
+	uint8_t registers[RMI4_PAGE_SIZE * 2];
+	uint8_t page;
+
+	/* input reports waiting for the host, oldest first */
+	std::deque<std::vector<uint8_t>> input;
+
+	/* the ISR gets the bus between transactions, never inside one */
+	bool isr_between;
+	uint32_t isr_reads;
+	uint32_t bus_transactions;
+};
+
+static std::vector<uint8_t> input_report(const uint8_t *report, int length)
+{
+	std::vector<uint8_t> input(RMI_INPUT_LENGTH, 0);
+
+	input[0] = (uint8_t)(length + RMI_INPUT_HEADER_SIZE);
+	input[1] = 0;
+	memcpy(&input[RMI_INPUT_HEADER_SIZE], report, length);
+	return input;
+}
+
+/* what the sensor does with a HID output register write */
+static int sensor_write(mock_sensor *sensor, uint8_t reg, const uint8_t *data, uint32_t length)
+{
+	if (reg == RMI_MODE_REGISTER)
+		return 0;
+	CHECK(reg == RMI_OUTPUT_REGISTER);
+	CHECK(length == RMI_OUTPUT_COMMAND_SIZE);
+	CHECK(data[0] == 0x00 && data[1] == 0x17 && data[2] == 0x00);
+
+	const uint8_t *report = data + 3;
+	uint16_t addr = report[2] | (report[3] << 8);
+
+	if (report[0] == RMI_WRITE_REPORT_ID) {
+		if (addr == 0xff)
+			sensor->page = report[4];
+		else
+			memcpy(&sensor->registers[sensor->page * RMI4_PAGE_SIZE + addr], &report[4], report[1]);
+	}
+	else if (report[0] == RMI_READ_ADDR_REPORT_ID) {
+		uint8_t reply[RMI_INPUT_REPORT_SIZE] = { RMI_READ_DATA_REPORT_ID };
+		int len = report[4] | (report[5] << 8);
+
+		CHECK(len <= RMI_READ_DATA_MAX);
+		memcpy(&reply[2], &sensor->registers[sensor->page * RMI4_PAGE_SIZE + (addr & 0xff)], len);
+		sensor->input.push_back(input_report(reply, len + 2));
+	}
+	return 0;
+}
+
+/* an input register read hands over the oldest report, or nothing */
+static void sensor_read(mock_sensor *sensor, uint8_t *data, uint32_t length)
+{
+	memset(data, 0, length);
+	if (sensor->input.empty())
+		return;
+	memcpy(data, sensor->input.front().data(), std::min<size_t>(length, RMI_INPUT_LENGTH));
+	sensor->input.pop_front();
+}
+
+/* the interrupt handler takes the bus, reading one input report */
+static void isr(mock_sensor *sensor)
+{
+	uint8_t attn[RMI_INPUT_REPORT_SIZE] = { RMI_ATTN_REPORT_ID, 0x04 };
+	uint8_t data[RMI_INPUT_LENGTH];
+
+	if (!sensor->isr_between)
+		return;
+	sensor->input.push_back(input_report(attn, sizeof(attn)));
+	sensor_read(sensor, data, sizeof(data));
+	sensor->isr_reads++;
+}
+
+static int mock_write(void *context, uint8_t reg, const uint8_t *data, uint32_t length)
+{
+	mock_sensor *sensor = (mock_sensor *)context;
+	int ret = sensor_write(sensor, reg, data, length);
+
+	sensor->bus_transactions++;
+	isr(sensor);
+	return ret;
+}
+
+static int mock_read(void *context, uint8_t *data, uint32_t length)
+{
+	mock_sensor *sensor = (mock_sensor *)context;
+
+	sensor_read(sensor, data, length);
+	sensor->bus_transactions++;
+	isr(sensor);
+	return 0;
+}
+
+static int mock_write_read(void *context, uint8_t reg, const uint8_t *data, uint32_t length,
+	uint8_t *reply, uint32_t reply_length)
+{
+	mock_sensor *sensor = (mock_sensor *)context;
+	int ret = sensor_write(sensor, reg, data, length);
+
+	/* repeated start, the bus stays ours until the reply is in */
+	sensor_read(sensor, reply, reply_length);
+	sensor->bus_transactions++;
+	isr(sensor);
+	return ret;
+}
+
+static const syna::rmi_transport_ops split_ops = { mock_write, mock_read, NULL };
+static const syna::rmi_transport_ops atomic_ops = { mock_write, mock_read, mock_write_read };
+
+static void sensor_init(mock_sensor *sensor)
+{
+	for (size_t i = 0; i < sizeof(sensor->registers); i++)
+		sensor->registers[i] = (uint8_t)(i * 7 + 3);
+	sensor->page = 0;
+	sensor->input.clear();
+	sensor->isr_between = false;
+	sensor->isr_reads = 0;
+	sensor->bus_transactions = 0;
+}
+
+static void check_read(syna::rmi_transport *transport, mock_sensor *sensor, uint16_t addr, int len)
+{
+	uint8_t buf[RMI_READ_DATA_MAX];
+
+	CHECK(syna::rmi_transport_read_block(transport, addr, buf, len) == 0);
+	CHECK(memcmp(buf, &sensor->registers[sensor->page * RMI4_PAGE_SIZE + addr], len) == 0);
+}
+
+/* a reply that isn't READ_DATA fails the read and leaves buf as it was */
+static void check_unanswered(syna::rmi_transport *transport, uint16_t addr, int len)
+{
+	uint8_t buf[RMI_READ_DATA_MAX];
+	uint32_t unanswered = transport->unanswered;
+
+	memset(buf, 0xa5, sizeof(buf));
+	CHECK(syna::rmi_transport_read_block(transport, addr, buf, len) == -EIO);
+	CHECK(transport->unanswered == unanswered + 1);
+	for (size_t i = 0; i < sizeof(buf); i++)
+		CHECK(buf[i] == 0xa5);
+}
+
+static void test_split()
+{
+	static mock_sensor sensor;
+	syna::rmi_transport transport;
+
+	sensor_init(&sensor);
+	syna::rmi_transport_init(&transport, &split_ops, &sensor, true);
+	CHECK(!transport.atomic_reads);
+
+	/* a write and a read for every register read */
+	for (int len = 1; len <= RMI_READ_DATA_MAX; len++)
+		check_read(&transport, &sensor, 0x10, len);
+	CHECK(transport.transactions == 2 * RMI_READ_DATA_MAX);
+	CHECK(sensor.bus_transactions == transport.transactions);
+	CHECK(transport.unanswered == 0);
+
+	/* the ISR takes the READ_DATA meant for the read */
+	sensor.isr_between = true;
+	check_unanswered(&transport, 0x20, 8);
+	CHECK(sensor.isr_reads == 2);
+	sensor.isr_between = false;
+
+	/* a register write is one transaction and reads back as written */
+	uint32_t transactions = transport.transactions;
+	uint8_t report[RMI_OUTPUT_REPORT_SIZE] = { RMI_WRITE_REPORT_ID, 1, 0x30, 0x00, 0x5a };
+	sensor.input.clear();
+	CHECK(syna::rmi_transport_write_report(&transport, report) == 0);
+	CHECK(transport.transactions == transactions + 1);
+	check_read(&transport, &sensor, 0x30, 1);
+	CHECK(sensor.registers[0x30] == 0x5a);
+
+	/* a write that got no reply reads nothing at all */
+	report[0] = RMI_WRITE_REPORT_ID;
+	CHECK(syna::rmi_transport_write_report(&transport, report) == 0);
+	CHECK(sensor.input.empty());
+	uint8_t buf[RMI_INPUT_LENGTH];
+	CHECK(mock_read(&sensor, buf, sizeof(buf)) == 0 && buf[RMI_INPUT_HEADER_SIZE] == 0);
+
+	printf("split:  %u transactions, %u unanswered\n", transport.transactions, transport.unanswered);
+}
+
+static void test_atomic()
+{
+	static mock_sensor sensor;
+	syna::rmi_transport transport;
+
+	sensor_init(&sensor);
+	syna::rmi_transport_init(&transport, &atomic_ops, &sensor, true);
+	CHECK(transport.atomic_reads);
+
+	/* one sequence per read, and the ISR can't get inside it */
+	sensor.isr_between = true;
+	for (int len = 1; len <= RMI_READ_DATA_MAX; len++)
+		check_read(&transport, &sensor, 0x40, len);
+	CHECK(transport.transactions == RMI_READ_DATA_MAX);
+	CHECK(sensor.isr_reads == RMI_READ_DATA_MAX);
+	CHECK(transport.unanswered == 0);
+
+	/* registers on another page, selected with a write report */
+	uint8_t report[RMI_OUTPUT_REPORT_SIZE] = { RMI_WRITE_REPORT_ID, 1, 0xff, 0x00, 1 };
+	CHECK(syna::rmi_transport_write_report(&transport, report) == 0);
+	CHECK(sensor.page == 1);
+	check_read(&transport, &sensor, 0x08, 16);
+
+	/* an ATTN report still waiting ahead of the reply is not the reply */
+	uint8_t attn[RMI_INPUT_REPORT_SIZE] = { RMI_ATTN_REPORT_ID };
+	sensor.isr_between = false;
+	sensor.input.push_back(input_report(attn, sizeof(attn)));
+	check_unanswered(&transport, 0x08, 16);
+
+	printf("atomic: %u transactions, %u unanswered\n", transport.transactions, transport.unanswered);
+}
+
+static void test_oversized()
+{
+	static mock_sensor sensor;
+	syna::rmi_transport transport;
+	uint8_t buf[RMI_READ_DATA_MAX + 1];
+
+	sensor_init(&sensor);
+	syna::rmi_transport_init(&transport, &atomic_ops, &sensor, false);
+	CHECK(!transport.atomic_reads);
+
+	/* more than one READ_DATA report holds never reaches the bus */
+	CHECK(syna::rmi_transport_read_block(&transport, 0, buf, sizeof(buf)) == -E2BIG);
+	CHECK(transport.transactions == 0);
+	CHECK(sensor.bus_transactions == 0);
+}
+
+int main()
+{
+	test_split();
+	test_atomic();
+	test_oversized();
+	return 0;
+}
@@ -0,0 +1,120 @@
+//
+// Measures two-finger scrolling as the class driver sees it: how many
+// mouse reports carry wheel or pan motion while the fingers are down
+// and while the scroll coasts after they lift, and how long after the
+// frame that caused it each of them was read. The old path sent a
+// REPORTID_SCROLL report with both finger positions on every
+// two-finger frame and left the scrolling to a user-mode helper, so its
+// count is the number of those frames, before the helper's own hop.
+//
+// Every scroll is replayed through the whole driver on the simulated
+// device, polled and event-driven, at 80Hz and 125Hz. The scroll must
+// stay on the axis it started on, and go as far whichever way the
+// driver is woken: a timer step between frames is not a frame.
+//
+// Usage: scroll_replay
+//
+
+#include "simdevice.h"
+
+#include <algorithm>
+
+#define SETTLE_US	3000000		/* lets the coasting run out */
+
+struct stroke {
+	const char *name;
+	int dx;				/* per frame, sensor units */
+	int dy;
+	int frames;
+};
+
+static uint64_t percentile(const std::vector<uint64_t> &sorted, int p)
+{
+	return sorted.empty() ? 0 : sorted[(sorted.size() - 1) * p / 100];
+}
+
+/* the distance scrolled, in wheel or pan counts */
+static long replay(const stroke &s, bool event_driven, int rate)
+{
+	const uint64_t period = 1000000 / rate;
+	sim::sensor_config config;
+	sim::options opts;
+
+	opts.event_driven = event_driven;
+	sim::host h(config, opts);
+	h.start();
+
+	/* from the side of the pad the stroke moves away from */
+	uint16_t x0 = (uint16_t)(s.dx < 0 ? 2600 : 400);
+	uint16_t y0 = (uint16_t)(s.dy < 0 ? 1700 : 100);
+	std::vector<sim::frame> trace = sim::swipe(2, x0, y0, s.dx, s.dy, s.frames);
+	std::vector<uint64_t> arrivals;
+	uint64_t start = h.now();
+	for (size_t i = 0; i < trace.size(); i++) {
+		arrivals.push_back(start + i * period);
+		h.schedule(arrivals.back(), trace[i]);
+	}
+	uint64_t lift = arrivals.back();
+	h.run_until(lift + SETTLE_US);
+
+	std::vector<uint64_t> latency;
+	size_t touching = 0, coasting = 0;
+	long wheel = 0, pan = 0;
+	uint64_t first = 0;
+	for (const sim::report &rep : h.reports) {
+		if (rep.id() != REPORTID_RELATIVE_MOUSE)
+			continue;
+		const syna::SynaRelativeMouseReport *r = (const syna::SynaRelativeMouseReport *)rep.data.data();
+
+		if (!r->WheelPosition && !r->HWheelPosition)
+			continue;
+		wheel += r->WheelPosition;
+		pan += r->HWheelPosition;
+		if (rep.time > lift) {
+			coasting++;
+			continue;
+		}
+
+		/* the newest frame the sensor had sent when the report was read */
+		uint64_t frame = *(std::upper_bound(arrivals.begin(), arrivals.end(), rep.time) - 1);
+		latency.push_back(rep.time - frame);
+		if (!first)
+			first = rep.time - start;
+		touching++;
+	}
+	std::sort(latency.begin(), latency.end());
+
+	printf("%-10s %-12s %3dHz  frames %3d (old path %3d reports)  scroll reports %3zu + %3zu coasting  "
+		"first %6llu us  p50 %5llu us  max %5llu us  wheel %4ld pan %4ld\n",
+		s.name, event_driven ? "event-driven" : "polled", rate, s.frames, s.frames,
+		touching, coasting, (unsigned long long)first,
+		(unsigned long long)percentile(latency, 50), (unsigned long long)percentile(latency, 100),
+		wheel, pan);
+
+	CHECK(touching > 0);
+	CHECK(s.dy ? (wheel != 0 && pan == 0) : (pan != 0 && wheel == 0));
+
+	/* a report never waits for more than the polling period */
+	CHECK(percentile(latency, 100) <= (event_driven ? 0 : 10000));
+	h.stop();
+	return wheel + pan;
+}
+
+int main()
+{
+	static const stroke strokes[] = {
+		{ "slow down", 0, 20, 60 },
+		{ "fast up", 0, -60, 20 },
+		{ "sideways", 40, 0, 30 },
+		{ "wobbly", 3, 30, 40 },	/* the sideways drift must not steal the axis */
+	};
+
+	for (const stroke &s : strokes)
+		for (int rate : { 80, 125 }) {
+			long polled = replay(s, false, rate);
+			long event_driven = replay(s, true, rate);
+
+			CHECK(labs(polled - event_driven) <= 2);
+		}
+	return 0;
+}
@@ -0,0 +1,137 @@
+//
+// Hammers the settings register with HID writes while a trace replays
+// through the whole driver on the simulated device, in both consumer
+// modes. Writes land between frames, between timer ticks and in bursts
+// to the same register, the way a settings app and the tray helper can
+// race each other.
+//
+// A write must never change the gesture engine's settings by itself,
+// they only change at the next frame boundary the consumer reaches, and
+// then every write made before it is in, last value per register.
+// Nothing a write did may be undone by the consumer storing back an
+// older copy of the state.
+//
+
+#include "simdevice.h"
+
+using syna::BYTE;
+using syna::NTSTATUS;
+
+#define REPLAY_FRAMES		600
+#define FRAME_INTERVAL_US	8000		/* 125Hz */
+#define MAX_WRITES		6		/* per frame interval */
+
+static uint32_t seed = 1;
+
+static uint32_t pick(uint32_t n)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % n;
+}
+
+/* something the register can take without the gestures going wild */
+static int random_value(int reg)
+{
+	switch (reg) {
+	case 0:
+		return 1 + pick(20);		/* pointerMultiplier */
+	case 8:
+	case 13:
+	case 16:
+		return pick(3);			/* the three-way enums */
+	default:
+		return pick(2);
+	}
+}
+
+static bool same_settings(const syna::csgesture_settings &a, const syna::csgesture_settings &b)
+{
+	return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static void stress(bool event_driven)
+{
+	sim::sensor_config config;
+	sim::options opts;
+
+	opts.event_driven = event_driven;
+	sim::host h(config, opts);
+	h.start();
+
+	syna::PDEVICE_CONTEXT pDevice = h.context();
+
+	//
+	// What the settings should be once everything written so far is
+	// applied, built with the driver's own register map
+	//
+	syna::csgesture_softc model = pDevice->sc;
+
+	uint32_t writes = 0;
+	uint32_t checked = 0;
+	uint64_t start = h.now();
+	for (int i = 0; i < REPLAY_FRAMES; i++) {
+		sim::frame f = {};
+
+		/* a finger going round in circles, lifted every 100 frames */
+		if (i % 100 < 90) {
+			f.slot[0] = sim::finger((uint16_t)(1500 + (i % 50) * 12), (uint16_t)(900 + (i % 30) * 10));
+			if (i % 200 < 60)
+				f.slot[1] = sim::finger(800, 1200);
+		}
+		h.schedule(start + (uint64_t)i * FRAME_INTERVAL_US, f);
+	}
+
+	for (int i = 0; i < REPLAY_FRAMES + 50; i++) {
+		uint64_t boundary = start + (uint64_t)i * FRAME_INTERVAL_US;
+		int n = pick(MAX_WRITES + 1);
+
+		h.run_until(boundary);
+		for (int w = 0; w < n; w++) {
+			syna::SynaSettingsReport report;
+			syna::csgesture_settings before = pDevice->sc.settings;
+
+			report.ReportID = REPORTID_SETTINGS;
+			report.SettingsRegister = (BYTE)pick(SYNA_SETTINGS_REGISTERS);
+			report.SettingsValue = (BYTE)random_value(report.SettingsRegister);
+			CHECK(NT_SUCCESS(h.write_report(&report, sizeof(report))));
+			syna::ProcessSetting(pDevice, &model, report.SettingsRegister, report.SettingsValue);
+			writes++;
+
+			/* nothing changes until the consumer reaches a boundary */
+			CHECK(same_settings(pDevice->sc.settings, before));
+
+			/* some writes land in the middle of the interval */
+			if (pick(4) == 0)
+				h.run_for(pick(FRAME_INTERVAL_US / 2));
+		}
+
+		//
+		// Run up to just before the next frame: whatever drained after
+		// the last write applied every write before it
+		//
+		uint32_t frames = pDevice->FrameStats.frames;
+		uint32_t fires = h.timer_fires;
+
+		h.run_until(boundary + FRAME_INTERVAL_US - 1);
+		if (n && (pDevice->FrameStats.frames != frames || h.timer_fires != fires)) {
+			CHECK(same_settings(pDevice->sc.settings, model.settings));
+			checked++;
+		}
+	}
+
+	/* the last writes are in once the consumer ran again */
+	h.run_for(100000);
+	CHECK(same_settings(pDevice->sc.settings, model.settings));
+
+	printf("%-13s %u writes over %u frames, settings checked at %u boundaries, %u timer wakeups\n",
+		event_driven ? "event-driven" : "polled", writes, pDevice->FrameStats.frames,
+		checked, h.timer_fires);
+	h.stop();
+}
+
+int main()
+{
+	stress(false);
+	stress(true);
+	return 0;
+}
@@ -0,0 +1,1177 @@
+//
+// The simulated sensor, and the framework and class driver calls the
+// driver makes, for one host at a time. See simdevice.h.
+//
+
+#include "simdevice.h"
+
+#include <algorithm>
+#include <new>
+
+using namespace syna;
+
+namespace syna {
+
+//
+// Every framework handle is one of these. The typed context sits in its
+// own 64-byte aligned block, the gesture state asks for that alignment.
+//
+
+struct WDFOBJECT__ {
+	enum kind_t {
+		DRIVER, DEVICE, QUEUE, REQUEST, INTERRUPT, TIMER, SPINLOCK, KEY, CMRESLIST,
+	} kind;
+
+	WDFOBJECT parent;
+	const char *context_name;
+	void *context;
+
+	/* queues */
+	WDF_IO_QUEUE_CONFIG queue;
+	std::deque<WDFREQUEST> requests;
+
+	/* requests */
+	ULONG ioctl;
+	size_t input_length;
+	std::vector<uint8_t> output;
+	std::vector<uint8_t> report;		/* what a written report's packet points at */
+	HID_XFER_PACKET packet;
+	IRP irp;
+	PVOID type3;
+	WDFQUEUE owner;				/* manual queue it was forwarded to */
+	ULONG_PTR information;
+	NTSTATUS status;
+	bool completed;
+
+	/* interrupts and timers */
+	PFN_WDF_INTERRUPT_ISR isr;
+	PFN_WDF_TIMER timer;
+	bool queued;
+	uint64_t due;
+
+	/* spin locks and the interrupt lock */
+	bool held;
+
+	/* registry keys */
+	std::map<std::wstring, sim::registry::value> *values;
+
+	/* resource lists */
+	CM_PARTIAL_RESOURCE_DESCRIPTOR descriptor;
+
+	WDFOBJECT__(kind_t k, WDFOBJECT p) :
+		kind(k), parent(p), context_name(nullptr), context(nullptr), queue(), ioctl(0),
+		input_length(0), packet(), irp(), type3(nullptr), owner(nullptr), information(0),
+		status(STATUS_PENDING), completed(false), isr(nullptr), timer(nullptr),
+		queued(false), due(0), held(false), values(nullptr), descriptor()
+	{
+	}
+
+	~WDFOBJECT__()
+	{
+		if (context)
+			::operator delete(context, std::align_val_t(64));
+	}
+
+	void attach(PWDF_OBJECT_ATTRIBUTES attributes)
+	{
+		if (!attributes || !attributes->ContextTypeInfo)
+			return;
+		size_t size = attributes->ContextTypeInfo->ContextSize;
+		context = ::operator new(size, std::align_val_t(64));
+		memset(context, 0, size);
+		context_name = attributes->ContextTypeInfo->ContextName;
+	}
+};
+
+//
+// What the driver hands the framework before its device exists
+//
+
+struct WDFDEVICE_INIT {
+	WDF_PNPPOWER_EVENT_CALLBACKS pnp;
+	WDF_OBJECT_ATTRIBUTES request_attributes;
+	bool filter;
+};
+
+}
+
+namespace sim {
+
+/* the driver's stdint.h has its own of these */
+using ::uint8_t;
+using ::uint16_t;
+using ::uint32_t;
+using ::uint64_t;
+
+bool ssse3 = true;
+
+static host *current;
+
+/* the framework's, the driver's and the class driver's side of a host */
+struct framework {
+	WDFDRIVER driver = nullptr;
+	PFN_WDF_DRIVER_DEVICE_ADD device_add = nullptr;
+	WDF_PNPPOWER_EVENT_CALLBACKS pnp = {};
+	WDF_OBJECT_ATTRIBUTES request_attributes = {};
+	WDFQUEUE default_queue = nullptr;
+	WDFINTERRUPT interrupt = nullptr;
+	WDFTIMER timer = nullptr;
+	WDFCMRESLIST resources = nullptr;
+	int spinlocks_held = 0;
+	std::vector<std::unique_ptr<WDFOBJECT__>> requests;
+};
+
+static framework fx;
+
+static WDFOBJECT create(WDFOBJECT__::kind_t kind, WDFOBJECT parent,
+	PWDF_OBJECT_ATTRIBUTES attributes = nullptr)
+{
+	CHECK(current);
+
+	WDFOBJECT__ *object = new WDFOBJECT__(kind, parent);
+	object->attach(attributes);
+	if (kind == WDFOBJECT__::REQUEST)
+		fx.requests.emplace_back(object);
+	else
+		current->objects.emplace_back(object);
+	return object;
+}
+
+static std::wstring name(PCUNICODE_STRING string)
+{
+	return std::wstring(string->Buffer, string->Length / sizeof(WCHAR));
+}
+
+//
+// The sensor
+//
+
+sensor::sensor(const sensor_config &c) : config(c)
+{
+	CHECK(config.fingers >= 1 && config.fingers <= 10 && config.fingers != 4 &&
+		(config.fingers <= 5 || config.fingers == 10));
+	CHECK(config.firmware_id < 1000);
+
+	memset(registers, 0, sizeof(registers));
+	page = 0;
+	mode = 0;
+	reset_counters();
+
+	/* interrupt sources are numbered in PDT scan order, F01 has the first */
+	if (config.f11_page) {
+		add_function(0xe9, 0x01, 0x80, 0x70, 0x40, 0x06);
+		if (config.f30)
+			add_function(0xe3, 0x30, 0xc0, 0x72, 0x58, 0x30);
+		add_function(0x1e9, 0x11, 0xa0, 0x71, 0x48, 0x08);
+		irq_f30 = config.f30 ? 0x02 : 0;
+		irq_f11 = config.f30 ? 0x04 : 0x02;
+	}
+	else {
+		add_function(0xe9, 0x01, 0x80, 0x70, 0x40, 0x06);
+		add_function(0xe3, 0x11, 0xa0, 0x71, 0x48, 0x08);
+		if (config.f30)
+			add_function(0xdd, 0x30, 0xc0, 0x72, 0x58, 0x30);
+		irq_f11 = 0x02;
+		irq_f30 = config.f30 ? 0x04 : 0;
+	}
+
+	int n = config.fingers;
+	f11_size = 5 * n + (n + 3) / 4 + (config.data40 ? 2 * n : 0);
+	f30_size = config.f30 ? 1 : 0;
+
+	/* F01: query 42, DS4 queries and the build id behind the product info */
+	uint8_t *q = &registers[query_base(0x01)];
+	q[0] = 0x01;
+	if (config.build_id) {
+		q[1] = 0x80;
+		q[17] = config.firmware_id & 0xff;
+		q[18] = (config.firmware_id >> 8) & 0xff;
+		q[19] = 0;
+		q[21] = 0x01;
+		q[22] = 1;
+		q[23] = 0x02;
+	}
+
+	/* F11: queries 0, 1, 5, maybe 7/8, 12 with the sensor size, 28 and 36 */
+	q = &registers[query_base(0x11)];
+	q[0] = 0xa0;
+	q[1] = (n == 10 ? 5 : n - 1) | 0x10 | (config.palm ? 0x20 : 0);
+	q[5] = config.dribble ? 0x10 : 0;
+	int offset = 6;
+	if (config.palm) {
+		q[offset + 1] = 0x01;
+		offset += 2;
+	}
+	q[offset] = 0x20;
+	q[offset + 1] = config.x_size & 0xff;
+	q[offset + 2] = config.x_size >> 8;
+	q[offset + 3] = config.y_size & 0xff;
+	q[offset + 4] = config.y_size >> 8;
+	offset += 13;
+	q[offset] = config.data40 ? 0x40 : 0;
+	q[offset + 2] = 0x20;
+
+	/* F30: GPIOs, no LEDs */
+	if (config.f30) {
+		q = &registers[query_base(0x30)];
+		q[0] = 0x08;
+		q[1] = SIM_F30_GPIOS;
+	}
+
+	reset_controls();
+}
+
+void sensor::add_function(uint16_t pdt, uint8_t function, uint8_t query, uint8_t command,
+	uint8_t control, uint8_t data)
+{
+	registers[pdt] = query;
+	registers[pdt + 1] = command;
+	registers[pdt + 2] = control;
+	registers[pdt + 3] = data;
+	registers[pdt + 4] = 1;
+	registers[pdt + 5] = function;
+}
+
+/* finds a function's PDT entry the way the driver does */
+static uint16_t find_function(const uint8_t *registers, uint8_t function)
+{
+	for (int page = 0; page < 2; page++) {
+		for (int pdt = page * 0x100 + 0xe9; pdt >= page * 0x100 + 0x05; pdt -= 6) {
+			if (registers[pdt + 5] == function)
+				return (uint16_t)pdt;
+			if (registers[pdt + 5] == 0)
+				break;
+		}
+	}
+	CHECK(!"function not in the PDT");
+	return 0;
+}
+
+uint16_t sensor::query_base(uint8_t function) const
+{
+	uint16_t pdt = find_function(registers, function);
+	return (pdt & 0xff00) | registers[pdt];
+}
+
+uint16_t sensor::control_base(uint8_t function) const
+{
+	uint16_t pdt = find_function(registers, function);
+	return (pdt & 0xff00) | registers[pdt + 2];
+}
+
+void sensor::reset_controls()
+{
+	uint8_t *c = &registers[control_base(0x01)];
+	c[0] = 0;
+	c[1] = config.f01_ctrl1;
+
+	c = &registers[control_base(0x11)];
+	memset(c, 0, RMI_F11_CTRL_REG_COUNT);
+	c[0] = config.dribble ? 0x40 : 0;
+	c[6] = config.max_x & 0xff;
+	c[7] = config.max_x >> 8;
+	c[8] = config.max_y & 0xff;
+	c[9] = config.max_y >> 8;
+	c[11] = config.palm ? 0x01 : 0;
+
+	if (config.f30) {
+		c = &registers[control_base(0x30)];
+		c[0] = 0;
+		c[1] = 0;
+		c[2] = SIM_F30_PULLUPS;
+	}
+}
+
+void sensor::power_loss()
+{
+	reset_controls();
+	page = 0;
+	mode = 0;
+	input.clear();
+}
+
+void sensor::reset_counters()
+{
+	transactions = 0;
+	writes = 0;
+	reads = 0;
+	empty_reads = 0;
+	page_switches = 0;
+	register_reads = 0;
+	register_writes = 0;
+	bytes = 0;
+	read_log.clear();
+}
+
+std::vector<uint8_t> sensor::attn(const frame &f) const
+{
+	std::vector<uint8_t> report(RMI_ATTN_HEADER_SIZE + f11_size + f30_size, 0);
+	int n = config.fingers;
+
+	report[0] = RMI_ATTN_REPORT_ID;
+	report[1] = irq_f11 | irq_f30;
+
+	/* the data blocks go in interrupt number order */
+	size_t f11 = RMI_ATTN_HEADER_SIZE;
+	size_t f30 = RMI_ATTN_HEADER_SIZE + f11_size;
+	if (irq_f30 && irq_f30 < irq_f11) {
+		f30 = RMI_ATTN_HEADER_SIZE;
+		f11 = RMI_ATTN_HEADER_SIZE + f30_size;
+	}
+
+	uint8_t *data = &report[f11];
+	for (int i = 0; i < n; i++) {
+		const contact &c = f.slot[i];
+		uint8_t *block = data + (n >> 2) + 1 + 5 * i;
+
+		if (!c.present)
+			continue;
+		data[i >> 2] |= 1 << ((i & 3) * 2);
+		block[0] = c.x >> 4;
+		block[1] = c.y >> 4;
+		block[2] = ((c.y & 0x0f) << 4) | (c.x & 0x0f);
+		block[3] = (c.wy << 4) | (c.wx & 0x0f);
+		block[4] = c.z;
+	}
+
+	if (irq_f30)
+		report[f30] = SIM_F30_PULLUPS & ~(f.button ? SIM_F30_BUTTON : 0);
+	return report;
+}
+
+void sensor::push_attn(const frame &f)
+{
+	std::vector<uint8_t> report = attn(f);
+	queue_input(report.data(), report.size());
+}
+
+void sensor::queue_input(const uint8_t *report, size_t length)
+{
+	std::vector<uint8_t> in(RMI_INPUT_HEADER_SIZE + length);
+
+	in[0] = (in.size()) & 0xff;
+	in[1] = (in.size()) >> 8;
+	memcpy(&in[RMI_INPUT_HEADER_SIZE], report, length);
+	input.push_back(in);
+}
+
+void sensor::output_report(const uint8_t *report)
+{
+	uint16_t addr = report[2] | (report[3] << 8);
+
+	switch (report[0]) {
+	case RMI_WRITE_REPORT_ID: {
+		int len = report[1];
+
+		if ((addr & 0xff) == 0xff) {
+			CHECK(len == 1);
+			page = report[4];
+			page_switches++;
+			break;
+		}
+		CHECK(len >= 1 && len <= RMI_OUTPUT_REPORT_SIZE - 4);
+		CHECK((addr >> 8) == page);
+		memcpy(&registers[addr], &report[4], len);
+		register_writes++;
+		break;
+	}
+	case RMI_READ_ADDR_REPORT_ID: {
+		uint8_t reply[RMI_INPUT_REPORT_SIZE] = { 0 };
+		int len = report[4] | (report[5] << 8);
+
+		CHECK(len >= 1 && len <= RMI_READ_DATA_MAX);
+		CHECK((addr >> 8) == page);
+		reply[0] = RMI_READ_DATA_REPORT_ID;
+		memcpy(&reply[2], &registers[addr], len);
+		queue_input(reply, sizeof(reply));
+		register_reads++;
+		read_log.push_back(std::make_pair(addr, len));
+		break;
+	}
+	default:
+		CHECK(!"unknown RMI output report");
+	}
+}
+
+NTSTATUS sensor::write(uint8_t reg, const uint8_t *data, uint32_t length)
+{
+	transactions++;
+	writes++;
+	bytes += length;
+
+	if (reg == RMI_MODE_REGISTER) {
+		CHECK(length == 10 && data[8] == RMI_SET_RMI_MODE_REPORT_ID);
+		mode = data[9];
+		return STATUS_SUCCESS;
+	}
+
+	CHECK(reg == RMI_OUTPUT_REGISTER && length == RMI_OUTPUT_COMMAND_SIZE);
+	CHECK(data[0] == 0x00 && data[1] == 0x17 && data[2] == 0x00);
+	output_report(&data[3]);
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS sensor::read(uint8_t *data, uint32_t length)
+{
+	transactions++;
+	reads++;
+	bytes += length;
+
+	/* a read always takes a whole report, what doesn't fit is lost */
+	memset(data, 0, length);
+	if (input.empty()) {
+		empty_reads++;
+		return STATUS_SUCCESS;
+	}
+	std::vector<uint8_t> &in = input.front();
+	memcpy(data, in.data(), std::min<size_t>(length, in.size()));
+	input.pop_front();
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS sensor::write_read(uint8_t reg, const uint8_t *data, uint32_t length,
+	uint8_t *reply, uint32_t reply_length)
+{
+	NTSTATUS status = write(reg, data, length);
+
+	if (NT_SUCCESS(status))
+		status = read(reply, reply_length);
+
+	/* one transaction with a repeated start */
+	transactions--;
+	return status;
+}
+
+void registry::set_dword(const wchar_t *name, uint32_t v)
+{
+	value &entry = settings[name];
+
+	entry.type = REG_DWORD;
+	entry.data.assign((uint8_t *)&v, (uint8_t *)&v + sizeof(v));
+}
+
+//
+// The host
+//
+
+host::host(const sensor_config &config, const options &o, registry *reg) :
+	device(config), opts(o), machine(reg ? reg : &local), timer_fires(0), interrupts(0),
+	clock(0), fx_device(nullptr), consumed(0), reads_pending(0), reads_held(false),
+	started(false)
+{
+	CHECK(!current);
+	current = this;
+	fx = framework();
+}
+
+host::~host()
+{
+	if (started)
+		stop();
+	fx.requests.clear();
+	objects.clear();
+	current = nullptr;
+}
+
+PDEVICE_CONTEXT host::context()
+{
+	return GetDeviceContext(fx_device);
+}
+
+void host::start()
+{
+	DRIVER_OBJECT driver = {};
+	UNICODE_STRING path = {};
+	WDFDEVICE_INIT init = {};
+
+	machine->set_dword(L"EventDrivenInput", opts.event_driven);
+	machine->set_dword(L"BatchInput", opts.batch);
+	machine->set_dword(L"AtomicRmiReads", opts.atomic_reads);
+	machine->set_dword(L"PrecisionTouchpad", opts.ptp);
+	if (opts.ptp) {
+		registry::value &blob = machine->settings[L"PtpCertification"];
+		blob.type = REG_BINARY;
+		blob.data.assign(PTP_CERTIFICATION_SIZE, 0x5a);
+	}
+	else {
+		machine->settings.erase(L"PtpCertification");
+	}
+
+	CHECK(NT_SUCCESS(DriverEntry(&driver, &path)));
+	CHECK(fx.device_add);
+
+	CHECK(NT_SUCCESS(fx.device_add(fx.driver, &init)));
+	CHECK(fx_device && fx.default_queue && fx.interrupt && fx.timer);
+
+	fx.resources = create(WDFOBJECT__::CMRESLIST, nullptr);
+	fx.resources->descriptor.Type = CmResourceTypeConnection;
+	fx.resources->descriptor.u.Connection.Class = CM_RESOURCE_CONNECTION_CLASS_SERIAL;
+	fx.resources->descriptor.u.Connection.Type = CM_RESOURCE_CONNECTION_TYPE_SERIAL_I2C;
+	fx.resources->descriptor.u.Connection.IdLowPart = 1;
+
+	CHECK(NT_SUCCESS(fx.pnp.EvtDevicePrepareHardware(fx_device, fx.resources, fx.resources)));
+	CHECK(NT_SUCCESS(fx.pnp.EvtDeviceD0Entry(fx_device, WdfPowerDeviceD3Final)));
+	started = true;
+
+	consumed = context()->FrameStats.frames;
+	arrivals.clear();
+	settle();
+}
+
+void host::stop()
+{
+	CHECK(started);
+	CHECK(NT_SUCCESS(fx.pnp.EvtDeviceD0Exit(fx_device, WdfPowerDeviceD3Final)));
+	CHECK(NT_SUCCESS(fx.pnp.EvtDeviceReleaseHardware(fx_device, fx.resources)));
+	started = false;
+
+	/* the reads still pending are cancelled */
+	for (auto &object : objects) {
+		if (object->kind != WDFOBJECT__::QUEUE)
+			continue;
+		for (WDFREQUEST request : object->requests) {
+			request->completed = true;
+			request->status = STATUS_CANCELLED;
+			reads_pending--;
+		}
+		object->requests.clear();
+	}
+	release_requests();
+}
+
+void host::suspend()
+{
+	CHECK(NT_SUCCESS(fx.pnp.EvtDeviceD0Exit(fx_device, WdfPowerDeviceD3)));
+	settle();
+}
+
+void host::resume(bool power_lost)
+{
+	if (power_lost)
+		device.power_loss();
+	CHECK(NT_SUCCESS(fx.pnp.EvtDeviceD0Entry(fx_device, WdfPowerDeviceD3)));
+	consumed = context()->FrameStats.frames;
+	arrivals.clear();
+	settle();
+}
+
+void host::schedule(uint64_t time, const frame &f)
+{
+	pending.emplace(time * 10, f);
+}
+
+void host::run_until(uint64_t time)
+{
+	const uint64_t end = time * 10;
+
+	CHECK(started);
+	for (;;) {
+		uint64_t next_frame = pending.empty() ? UINT64_MAX : pending.begin()->first;
+		uint64_t next_timer = fx.timer->queued ? fx.timer->due : UINT64_MAX;
+		uint64_t next = std::min(next_frame, next_timer);
+
+		if (next > end)
+			break;
+		clock = std::max(clock, next);
+
+		/* a frame and a timer due together: the frame raised ATTN first */
+		if (next_frame <= next_timer) {
+			device.push_attn(pending.begin()->second);
+			pending.erase(pending.begin());
+			arrivals.push_back(clock);
+			interrupt();
+		}
+		else {
+			fire_timer();
+		}
+		settle();
+	}
+	clock = std::max(clock, end);
+}
+
+void host::raise_attn()
+{
+	CHECK(started);
+	interrupt();
+	settle();
+}
+
+void host::interrupt()
+{
+	WDFINTERRUPT intr = fx.interrupt;
+
+	//
+	// Level triggered: the ISR runs for as long as reports are queued,
+	// or until it says the interrupt was not its own
+	//
+	while (device.attn_pending()) {
+		uint32_t overruns = context()->FrameRing.overruns;
+		BOOLEAN claimed;
+
+		interrupts++;
+		CHECK(!intr->held);
+		intr->held = true;
+		claimed = intr->isr(intr, 0);
+		intr->held = false;
+
+		/* the ISR drops the newest frame when the ring is full */
+		if (context()->FrameRing.overruns != overruns && !arrivals.empty())
+			arrivals.pop_back();
+		account();
+
+		if (!claimed)
+			break;
+	}
+}
+
+void host::fire_timer()
+{
+	fx.timer->queued = false;
+	timer_fires++;
+	fx.timer->timer(fx.timer);
+	account();
+}
+
+void host::account()
+{
+	uint32_t frames = context()->FrameStats.frames;
+
+	while (consumed != frames && !arrivals.empty()) {
+		latencies.push_back((clock - arrivals.front()) / 10);
+		arrivals.pop_front();
+		consumed++;
+	}
+	consumed = frames;
+}
+
+void host::hold_reads(bool hold)
+{
+	reads_held = hold;
+	settle();
+}
+
+void host::settle()
+{
+	while (started && !reads_held && reads_pending < opts.reads) {
+		WDFREQUEST request = make_request(IOCTL_HID_READ_REPORT, 0, 128);
+
+		reads_pending++;
+		send(request);
+	}
+	release_requests();
+}
+
+void host::release_requests()
+{
+	auto done = std::remove_if(fx.requests.begin(), fx.requests.end(),
+		[](const std::unique_ptr<WDFOBJECT__> &request) { return request->completed; });
+	fx.requests.erase(done, fx.requests.end());
+}
+
+WDFREQUEST host::make_request(ULONG ioctl, size_t input, size_t output)
+{
+	PWDF_OBJECT_ATTRIBUTES attributes = fx.request_attributes.ContextTypeInfo ?
+		&fx.request_attributes : nullptr;
+	WDFREQUEST request = create(WDFOBJECT__::REQUEST, nullptr, attributes);
+
+	request->ioctl = ioctl;
+	request->input_length = input;
+	request->output.assign(output, 0);
+	request->irp.UserBuffer = &request->packet;
+	return request;
+}
+
+NTSTATUS host::send(WDFREQUEST request)
+{
+	WDFQUEUE queue = fx.default_queue;
+
+	if (queue->queue.EvtIoDefault)
+		queue->queue.EvtIoDefault(queue, request);
+	else
+		queue->queue.EvtIoInternalDeviceControl(queue, request, request->output.size(),
+			request->input_length, request->ioctl);
+	return request->completed ? request->status : STATUS_PENDING;
+}
+
+NTSTATUS host::transfer(ULONG ioctl, const void *data, ULONG length, void *out)
+{
+	bool input = out == nullptr;
+	WDFREQUEST request = make_request(ioctl, input ? sizeof(HID_XFER_PACKET) : 0,
+		input ? 0 : sizeof(HID_XFER_PACKET));
+	NTSTATUS status;
+
+	if (input) {
+		request->report.assign((const uint8_t *)data, (const uint8_t *)data + length);
+		request->packet.reportBuffer = request->report.data();
+	}
+	else {
+		request->packet.reportBuffer = (PUCHAR)out;
+	}
+	request->packet.reportBufferLen = length;
+	request->packet.reportId = length ? ((const uint8_t *)data)[0] : 0;
+
+	status = send(request);
+	settle();
+	return status;
+}
+
+NTSTATUS host::write_report(const void *data, ULONG length)
+{
+	return transfer(IOCTL_HID_WRITE_REPORT, data, length, nullptr);
+}
+
+NTSTATUS host::set_feature(const void *data, ULONG length)
+{
+	return transfer(IOCTL_HID_SET_FEATURE, data, length, nullptr);
+}
+
+NTSTATUS host::get_feature(void *data, ULONG length)
+{
+	return transfer(IOCTL_HID_GET_FEATURE, data, length, data);
+}
+
+std::vector<uint8_t> host::report_descriptor()
+{
+	WDFREQUEST request = make_request(IOCTL_HID_GET_REPORT_DESCRIPTOR, 0, 4096);
+	std::vector<uint8_t> descriptor;
+
+	if (NT_SUCCESS(send(request)))
+		descriptor.assign(request->output.begin(), request->output.begin() + request->information);
+	settle();
+	return descriptor;
+}
+
+void host::complete(WDFREQUEST request)
+{
+	/* the class driver's completion routine may call right back in */
+	CHECK(fx.spinlocks_held == 0);
+	CHECK(!request->completed);
+
+	request->completed = true;
+	if (request->ioctl == IOCTL_HID_READ_REPORT) {
+		reads_pending--;
+		if (NT_SUCCESS(request->status)) {
+			report r;
+			r.time = now();
+			r.data.assign(request->output.begin(), request->output.begin() + request->information);
+			reports.push_back(r);
+		}
+	}
+}
+
+std::vector<frame> swipe(int fingers, uint16_t x0, uint16_t y0, int dx, int dy, int frames,
+	int spacing)
+{
+	std::vector<frame> trace;
+
+	for (int i = 0; i < frames; i++) {
+		frame f = {};
+
+		for (int j = 0; j < fingers; j++)
+			f.slot[j] = finger(x0 + dx * i + spacing * j, y0 + dy * i);
+		trace.push_back(f);
+	}
+
+	/* and the frame that lifts them */
+	trace.push_back(frame());
+	return trace;
+}
+
+}
+
+//
+// The framework calls the driver makes, against the current host
+//
+
+namespace syna {
+
+using sim::current;
+using sim::fx;
+
+LARGE_INTEGER KeQueryPerformanceCounter(PLARGE_INTEGER frequency)
+{
+	LARGE_INTEGER counter;
+
+	if (frequency)
+		frequency->QuadPart = 10000000;
+	counter.QuadPart = current->clock;
+	return counter;
+}
+
+BOOLEAN ExIsProcessorFeaturePresent(ULONG feature)
+{
+	return feature == PF_SSSE3_INSTRUCTIONS_AVAILABLE && sim::ssse3;
+}
+
+PVOID WdfObjectGetTypedContextWorker(WDFOBJECT Handle, PCWDF_OBJECT_CONTEXT_TYPE_INFO TypeInfo)
+{
+	/* every source has its own copy of the type info, only the name is shared */
+	CHECK(Handle && Handle->context && !strcmp(Handle->context_name, TypeInfo->ContextName));
+	return Handle->context;
+}
+
+VOID WdfObjectDelete(WDFOBJECT Object)
+{
+	UNREFERENCED_PARAMETER(Object);
+}
+
+NTSTATUS WdfDriverCreate(PDRIVER_OBJECT DriverObject, PCUNICODE_STRING RegistryPath,
+	PWDF_OBJECT_ATTRIBUTES DriverAttributes, PWDF_DRIVER_CONFIG DriverConfig, WDFDRIVER *Driver)
+{
+	UNREFERENCED_PARAMETER(DriverObject);
+	UNREFERENCED_PARAMETER(RegistryPath);
+
+	fx.device_add = DriverConfig->EvtDriverDeviceAdd;
+	*Driver = sim::create(WDFOBJECT__::DRIVER, nullptr, DriverAttributes);
+	fx.driver = *Driver;
+	return STATUS_SUCCESS;
+}
+
+VOID WdfFdoInitSetFilter(PWDFDEVICE_INIT DeviceInit)
+{
+	DeviceInit->filter = true;
+}
+
+VOID WdfDeviceInitSetPnpPowerEventCallbacks(PWDFDEVICE_INIT DeviceInit, PWDF_PNPPOWER_EVENT_CALLBACKS PnpPowerEventCallbacks)
+{
+	DeviceInit->pnp = *PnpPowerEventCallbacks;
+}
+
+VOID WdfDeviceInitSetRequestAttributes(PWDFDEVICE_INIT DeviceInit, PWDF_OBJECT_ATTRIBUTES RequestAttributes)
+{
+	DeviceInit->request_attributes = *RequestAttributes;
+}
+
+NTSTATUS WdfDeviceCreate(PWDFDEVICE_INIT *DeviceInit, PWDF_OBJECT_ATTRIBUTES DeviceAttributes, WDFDEVICE *Device)
+{
+	fx.pnp = (*DeviceInit)->pnp;
+	fx.request_attributes = (*DeviceInit)->request_attributes;
+	*Device = sim::create(WDFOBJECT__::DEVICE, nullptr, DeviceAttributes);
+	current->fx_device = *Device;
+	*DeviceInit = nullptr;
+	return STATUS_SUCCESS;
+}
+
+VOID WdfDeviceSetDeviceState(WDFDEVICE Device, PWDF_DEVICE_STATE DeviceState)
+{
+	UNREFERENCED_PARAMETER(Device);
+	UNREFERENCED_PARAMETER(DeviceState);
+}
+
+NTSTATUS WdfIoQueueCreate(WDFDEVICE Device, PWDF_IO_QUEUE_CONFIG Config,
+	PWDF_OBJECT_ATTRIBUTES QueueAttributes, WDFQUEUE *Queue)
+{
+	WDFQUEUE queue = sim::create(WDFOBJECT__::QUEUE, Device, QueueAttributes);
+
+	queue->queue = *Config;
+	if (Config->DefaultQueue)
+		fx.default_queue = queue;
+	if (Queue)
+		*Queue = queue;
+	return STATUS_SUCCESS;
+}
+
+WDFDEVICE WdfIoQueueGetDevice(WDFQUEUE Queue)
+{
+	return Queue->parent;
+}
+
+NTSTATUS WdfIoQueueRetrieveNextRequest(WDFQUEUE Queue, WDFREQUEST *OutRequest)
+{
+	CHECK(Queue->queue.DispatchType == WdfIoQueueDispatchManual);
+	if (Queue->requests.empty())
+		return STATUS_NO_MORE_ENTRIES;
+	*OutRequest = Queue->requests.front();
+	Queue->requests.pop_front();
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfRequestForwardToIoQueue(WDFREQUEST Request, WDFQUEUE DestinationQueue)
+{
+	CHECK(!Request->completed);
+
+	//
+	// Calls are synchronous here, so a sequential queue has always
+	// finished with the last request by the time the next one comes
+	//
+	if (DestinationQueue->queue.DispatchType == WdfIoQueueDispatchManual) {
+		Request->owner = DestinationQueue;
+		DestinationQueue->requests.push_back(Request);
+	}
+	else {
+		DestinationQueue->queue.EvtIoInternalDeviceControl(DestinationQueue, Request,
+			Request->output.size(), Request->input_length, Request->ioctl);
+	}
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfRequestRequeue(WDFREQUEST Request)
+{
+	CHECK(Request->owner && !Request->completed);
+	Request->owner->requests.push_front(Request);
+	return STATUS_SUCCESS;
+}
+
+VOID WdfRequestGetParameters(WDFREQUEST Request, PWDF_REQUEST_PARAMETERS Parameters)
+{
+	Parameters->Parameters.DeviceIoControl.OutputBufferLength = Request->output.size();
+	Parameters->Parameters.DeviceIoControl.InputBufferLength = Request->input_length;
+	Parameters->Parameters.DeviceIoControl.IoControlCode = Request->ioctl;
+	Parameters->Parameters.DeviceIoControl.Type3InputBuffer = Request->type3;
+}
+
+PIRP WdfRequestWdmGetIrp(WDFREQUEST Request)
+{
+	return &Request->irp;
+}
+
+NTSTATUS WdfRequestRetrieveOutputBuffer(WDFREQUEST Request, size_t MinimumRequiredSize,
+	PVOID *Buffer, size_t *Length)
+{
+	if (Request->output.size() < MinimumRequiredSize || Request->output.empty())
+		return STATUS_BUFFER_TOO_SMALL;
+	*Buffer = Request->output.data();
+	if (Length)
+		*Length = Request->output.size();
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfRequestRetrieveOutputMemory(WDFREQUEST Request, WDFMEMORY *Memory)
+{
+	/* the request doubles as the memory object of its output buffer */
+	*Memory = Request;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfMemoryCopyFromBuffer(WDFMEMORY DestinationMemory, size_t DestinationOffset,
+	PVOID Buffer, size_t NumBytesToCopyFrom)
+{
+	std::vector<uint8_t> &output = DestinationMemory->output;
+
+	if (DestinationOffset + NumBytesToCopyFrom > output.size())
+		return STATUS_BUFFER_TOO_SMALL;
+	memcpy(&output[DestinationOffset], Buffer, NumBytesToCopyFrom);
+	return STATUS_SUCCESS;
+}
+
+VOID WdfRequestSetInformation(WDFREQUEST Request, ULONG_PTR Information)
+{
+	Request->information = Information;
+}
+
+VOID WdfRequestComplete(WDFREQUEST Request, NTSTATUS Status)
+{
+	Request->status = Status;
+	current->complete(Request);
+}
+
+VOID WdfRequestCompleteWithInformation(WDFREQUEST Request, NTSTATUS Status, ULONG_PTR Information)
+{
+	Request->information = Information;
+	WdfRequestComplete(Request, Status);
+}
+
+NTSTATUS WdfInterruptCreate(WDFDEVICE Device, PWDF_INTERRUPT_CONFIG Configuration,
+	PWDF_OBJECT_ATTRIBUTES Attributes, WDFINTERRUPT *Interrupt)
+{
+	*Interrupt = sim::create(WDFOBJECT__::INTERRUPT, Device, Attributes);
+	(*Interrupt)->isr = Configuration->EvtInterruptIsr;
+	fx.interrupt = *Interrupt;
+	return STATUS_SUCCESS;
+}
+
+WDFDEVICE WdfInterruptGetDevice(WDFINTERRUPT Interrupt)
+{
+	return Interrupt->parent;
+}
+
+VOID WdfInterruptAcquireLock(WDFINTERRUPT Interrupt)
+{
+	CHECK(!Interrupt->held);
+	Interrupt->held = true;
+}
+
+VOID WdfInterruptReleaseLock(WDFINTERRUPT Interrupt)
+{
+	CHECK(Interrupt->held);
+	Interrupt->held = false;
+}
+
+NTSTATUS WdfTimerCreate(PWDF_TIMER_CONFIG Config, PWDF_OBJECT_ATTRIBUTES Attributes, WDFTIMER *Timer)
+{
+	*Timer = sim::create(WDFOBJECT__::TIMER, Attributes->ParentObject, Attributes);
+	(*Timer)->timer = Config->EvtTimerFunc;
+	fx.timer = *Timer;
+	return STATUS_SUCCESS;
+}
+
+BOOLEAN WdfTimerStart(WDFTIMER Timer, LONGLONG DueTime)
+{
+	BOOLEAN queued = Timer->queued;
+
+	/* only relative due times */
+	CHECK(DueTime <= 0);
+	Timer->due = current->clock + (uint64_t)-DueTime;
+	Timer->queued = true;
+	return queued;
+}
+
+BOOLEAN WdfTimerStop(WDFTIMER Timer, BOOLEAN Wait)
+{
+	BOOLEAN queued = Timer->queued;
+
+	UNREFERENCED_PARAMETER(Wait);
+	Timer->queued = false;
+	return queued;
+}
+
+WDFOBJECT WdfTimerGetParentObject(WDFTIMER Timer)
+{
+	return Timer->parent;
+}
+
+NTSTATUS WdfSpinLockCreate(PWDF_OBJECT_ATTRIBUTES SpinLockAttributes, WDFSPINLOCK *SpinLock)
+{
+	*SpinLock = sim::create(WDFOBJECT__::SPINLOCK, nullptr, SpinLockAttributes);
+	return STATUS_SUCCESS;
+}
+
+VOID WdfSpinLockAcquire(WDFSPINLOCK SpinLock)
+{
+	CHECK(!SpinLock->held);
+	SpinLock->held = true;
+	fx.spinlocks_held++;
+}
+
+VOID WdfSpinLockRelease(WDFSPINLOCK SpinLock)
+{
+	CHECK(SpinLock->held);
+	SpinLock->held = false;
+	fx.spinlocks_held--;
+}
+
+ULONG WdfCmResourceListGetCount(WDFCMRESLIST List)
+{
+	UNREFERENCED_PARAMETER(List);
+	return 1;
+}
+
+PCM_PARTIAL_RESOURCE_DESCRIPTOR WdfCmResourceListGetDescriptor(WDFCMRESLIST List, ULONG Index)
+{
+	CHECK(Index == 0);
+	return &List->descriptor;
+}
+
+NTSTATUS WdfDeviceOpenRegistryKey(WDFDEVICE Device, ULONG DeviceInstanceKeyType,
+	ACCESS_MASK DesiredAccess, PWDF_OBJECT_ATTRIBUTES KeyAttributes, WDFKEY *Key)
+{
+	UNREFERENCED_PARAMETER(DesiredAccess);
+
+	CHECK(DeviceInstanceKeyType == PLUGPLAY_REGKEY_DEVICE);
+	*Key = sim::create(WDFOBJECT__::KEY, Device, KeyAttributes);
+	(*Key)->values = &current->machine->device;
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfRegistryOpenKey(WDFKEY ParentKey, PCUNICODE_STRING KeyName, ACCESS_MASK DesiredAccess,
+	PWDF_OBJECT_ATTRIBUTES KeyAttributes, WDFKEY *Key)
+{
+	UNREFERENCED_PARAMETER(DesiredAccess);
+
+	/* the hardware key has one subkey, there once any setting is */
+	if (ParentKey->values != &current->machine->device || sim::name(KeyName) != L"Settings" ||
+		current->machine->settings.empty())
+		return STATUS_OBJECT_NAME_NOT_FOUND;
+
+	*Key = sim::create(WDFOBJECT__::KEY, ParentKey, KeyAttributes);
+	(*Key)->values = &current->machine->settings;
+	return STATUS_SUCCESS;
+}
+
+VOID WdfRegistryClose(WDFKEY Key)
+{
+	Key->values = nullptr;
+}
+
+NTSTATUS WdfRegistryQueryULong(WDFKEY Key, PCUNICODE_STRING ValueName, PULONG Value)
+{
+	auto value = Key->values->find(sim::name(ValueName));
+
+	if (value == Key->values->end())
+		return STATUS_OBJECT_NAME_NOT_FOUND;
+	if (value->second.type != REG_DWORD || value->second.data.size() != sizeof(ULONG))
+		return STATUS_INVALID_PARAMETER;
+	memcpy(Value, value->second.data.data(), sizeof(ULONG));
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfRegistryQueryValue(WDFKEY Key, PCUNICODE_STRING ValueName, ULONG ValueLength,
+	PVOID Value, PULONG ValueLengthQueried, PULONG ValueType)
+{
+	auto value = Key->values->find(sim::name(ValueName));
+
+	if (value == Key->values->end())
+		return STATUS_OBJECT_NAME_NOT_FOUND;
+	if (ValueLengthQueried)
+		*ValueLengthQueried = (ULONG)value->second.data.size();
+	if (ValueType)
+		*ValueType = value->second.type;
+	if (value->second.data.size() > ValueLength)
+		return STATUS_BUFFER_OVERFLOW;
+	memcpy(Value, value->second.data.data(), value->second.data.size());
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS WdfRegistryAssignValue(WDFKEY Key, PCUNICODE_STRING ValueName, ULONG ValueType,
+	ULONG ValueLength, PVOID Value)
+{
+	sim::registry::value &value = (*Key->values)[sim::name(ValueName)];
+
+	value.type = ValueType;
+	value.data.assign((uint8_t *)Value, (uint8_t *)Value + ValueLength);
+	return STATUS_SUCCESS;
+}
+
+//
+// The SPB target is the simulated sensor
+//
+
+NTSTATUS SpbTargetInitialize(WDFDEVICE FxDevice, SPB_CONTEXT *SpbContext)
+{
+	SpbContext->SpbIoTarget = FxDevice;
+	return STATUS_SUCCESS;
+}
+
+VOID SpbTargetDeinitialize(WDFDEVICE FxDevice, SPB_CONTEXT *SpbContext)
+{
+	UNREFERENCED_PARAMETER(FxDevice);
+	SpbContext->SpbIoTarget = nullptr;
+}
+
+NTSTATUS SpbWriteDataSynchronously(SPB_CONTEXT *SpbContext, UCHAR Address, PVOID Data, ULONG Length)
+{
+	CHECK(SpbContext->SpbIoTarget);
+	return current->device.write(Address, (const uint8_t *)Data, Length);
+}
+
+NTSTATUS SpbOnlyReadDataSynchronously(SPB_CONTEXT *SpbContext, PVOID Data, ULONG Length)
+{
+	CHECK(SpbContext->SpbIoTarget);
+	return current->device.read((uint8_t *)Data, Length);
+}
+
+NTSTATUS SpbOnlyReadIntoBufferSynchronously(SPB_CONTEXT *SpbContext, PVOID Data, ULONG Length)
+{
+	CHECK(SpbContext->SpbIoTarget);
+	return current->device.read((uint8_t *)Data, Length);
+}
+
+NTSTATUS SpbWriteReadSynchronously(SPB_CONTEXT *SpbContext, UCHAR Address, PVOID WriteData,
+	ULONG WriteLength, PVOID ReadData, ULONG ReadLength)
+{
+	CHECK(SpbContext->SpbIoTarget);
+	return current->device.write_read(Address, (const uint8_t *)WriteData, WriteLength,
+		(uint8_t *)ReadData, ReadLength);
+}
+
+}
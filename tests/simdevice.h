@@ -0,0 +1,289 @@
+#if !defined(_SIMDEVICE_H_)
+#define _SIMDEVICE_H_
+
+//
+// A simulated Synaptics RMI4 sensor behind HID-over-I2C, and just enough
+// of WDF and the HID class driver around it to run the whole driver on
+// a Linux host: PnP start, the PDT scan and populate, the ISR, the timer,
+// the gesture engine and the report FIFO, all of it the driver's own
+// code built from its sources (see drivertu.cpp). Time is virtual, it
+// only moves when the test runs the event loop, so traces replay the
+// same way every time and at any speed.
+//
+// The class driver keeps a number of reads pending and sends a new one
+// for each that completes, once the call into the driver that completed
+// it has returned. Every completion checks that the driver holds no
+// spin lock.
+//
+
+#include "hostshim.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* linuxmacros.h has the MSVC values of these */
+#undef EDEADLK
+#undef ENAMETOOLONG
+#undef ENOLCK
+#undef ENOSYS
+#undef ENOTEMPTY
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-variable"
+#pragma GCC diagnostic ignored "-Wunused-function"
+namespace syna {
+#include "../crostrackpad3-synaptics/internal.h"
+#include "../crostrackpad3-synaptics/driver.h"
+#include "../crostrackpad3-synaptics/device.h"
+#include "../crostrackpad3-synaptics/hiddevice.h"
+}
+#pragma GCC diagnostic pop
+
+/* the kernel headers' min and max would break the standard library */
+#undef min
+#undef max
+
+namespace sim {
+
+using syna::NTSTATUS;
+using syna::ULONG;
+
+#define SIM_FINGERS		10
+
+/* GPIO 1 of F30 is the button, it has a pull up and reads 0 when pressed */
+#define SIM_F30_GPIOS		3
+#define SIM_F30_PULLUPS		0x06
+#define SIM_F30_BUTTON		0x02
+
+struct contact {
+	bool present;
+	uint16_t x;
+	uint16_t y;
+	uint8_t z;
+	uint8_t wx;
+	uint8_t wy;
+};
+
+/* what the sensor sees in one scan */
+struct frame {
+	contact slot[SIM_FINGERS];
+	bool button;
+};
+
+static inline contact finger(uint16_t x, uint16_t y, uint8_t z = 60)
+{
+	contact c = { true, x, y, z, 4, 4 };
+	return c;
+}
+
+struct sensor_config {
+	/*
+	 * F11 query 1 only has 1-5 and 10. Not 4: the driver, like
+	 * Linux, puts the finger blocks at fingers / 4 + 1 while the
+	 * report size only has room for DIV_ROUND_UP(fingers, 4) state
+	 * bytes, so the last finger would run past the block.
+	 */
+	int fingers = 5;
+	bool data40 = false;
+	bool f30 = true;
+	bool dribble = false;		/* F11 ctrl 0 bit 6 set, for the driver to clear */
+	bool palm = false;		/* F11 ctrl 11 bit 0 set, likewise */
+	int f11_page = 0;		/* 1 puts F11 on a second PDT page */
+	uint16_t max_x = 3000;
+	uint16_t max_y = 1800;
+	uint16_t x_size = 1000;		/* 0.1mm */
+	uint16_t y_size = 600;
+	uint32_t firmware_id = 123;	/* the driver prints it into 4 chars */
+	bool build_id = true;		/* F01 has the build id query */
+	uint8_t f01_ctrl1 = 0x07;	/* 0 makes the driver write the interrupt enables */
+};
+
+//
+// The sensor end of the bus. Registers live in a flat 64K space,
+// addressed as page << 8 | register like the driver does, and every
+// input report, READ_DATA or ATTN, waits in one FIFO the way the
+// HID-I2C device queues them.
+//
+
+class sensor {
+public:
+	explicit sensor(const sensor_config &config);
+
+	sensor_config config;
+	uint8_t registers[0x10000];
+	uint8_t page;
+	uint8_t mode;
+
+	/* input reports with their length prefix, oldest first */
+	std::deque<std::vector<uint8_t>> input;
+
+	/* interrupt bits and data blocks of the functions */
+	uint8_t irq_f11;
+	uint8_t irq_f30;
+	unsigned int f11_size;
+	unsigned int f30_size;
+
+	uint32_t transactions;
+	uint32_t writes;
+	uint32_t reads;
+	uint32_t empty_reads;
+	uint32_t page_switches;
+	uint32_t register_reads;	/* READ_ADDR reports */
+	uint32_t register_writes;	/* WRITE reports, page switches aside */
+	uint64_t bytes;			/* in both directions */
+
+	/* the address and length of every READ_ADDR, oldest first */
+	std::vector<std::pair<uint16_t, int>> read_log;
+
+	bool attn_pending() const { return !input.empty(); }
+
+	/* the ATTN report of a scan, without the length prefix */
+	std::vector<uint8_t> attn(const frame &f) const;
+	void push_attn(const frame &f);
+
+	/* an input report as the device sends it, length prefix and all */
+	void push_input(const std::vector<uint8_t> &in) { input.push_back(in); }
+
+	/* back from a power loss: control registers at their defaults, page 0 */
+	void power_loss();
+
+	void reset_counters();
+
+	uint16_t control_base(uint8_t function) const;
+	uint16_t query_base(uint8_t function) const;
+
+	NTSTATUS write(uint8_t reg, const uint8_t *data, uint32_t length);
+	NTSTATUS read(uint8_t *data, uint32_t length);
+	NTSTATUS write_read(uint8_t reg, const uint8_t *data, uint32_t length,
+		uint8_t *reply, uint32_t reply_length);
+
+private:
+	void reset_controls();
+	void add_function(uint16_t pdt, uint8_t function, uint8_t query, uint8_t command,
+		uint8_t control, uint8_t data);
+	void output_report(const uint8_t *report);
+	void queue_input(const uint8_t *report, size_t length);
+};
+
+//
+// The registry of the machine the device is plugged into. It outlives
+// the device, so a second start sees what the first one stored.
+//
+
+struct registry {
+	struct value {
+		ULONG type;
+		std::vector<uint8_t> data;
+	};
+
+	std::map<std::wstring, value> device;		/* the device's hardware key */
+	std::map<std::wstring, value> settings;		/* its Settings subkey */
+
+	void set_dword(const wchar_t *name, uint32_t v);
+};
+
+struct options {
+	bool event_driven = true;
+	bool batch = true;
+	bool atomic_reads = false;
+	bool ptp = false;		/* PrecisionTouchpad, with a certification blob */
+	int reads = 2;			/* reads the class driver keeps pending */
+};
+
+/* a report the class driver read, and when */
+struct report {
+	uint64_t time;
+	std::vector<uint8_t> data;
+
+	uint8_t id() const { return data.empty() ? 0 : data[0]; }
+};
+
+class host {
+public:
+	host(const sensor_config &config, const options &opts = options(), registry *reg = nullptr);
+	~host();
+
+	sensor device;
+	options opts;
+	registry *machine;
+
+	/* PnP start up to D0 with reads pending, and all the way back */
+	void start();
+	void stop();
+
+	/* D0 exit and entry, optionally with the sensor losing power */
+	void suspend();
+	void resume(bool power_lost = false);
+
+	/* virtual time in microseconds */
+	uint64_t now() const { return clock / 10; }
+
+	void schedule(uint64_t time, const frame &f);
+	void touch(const frame &f) { schedule(now(), f); }
+	void run_until(uint64_t time);
+	void run_for(uint64_t time) { run_until(now() + time); }
+
+	/* ATTN for whatever push_input queued, without a new scan */
+	void raise_attn();
+
+	/* stops sending new reads, as if the class driver fell behind */
+	void hold_reads(bool hold);
+
+	/* the class driver's IOCTLs, STATUS_PENDING if the driver kept the request */
+	NTSTATUS write_report(const void *data, ULONG length);
+	NTSTATUS get_feature(void *data, ULONG length);
+	NTSTATUS set_feature(const void *data, ULONG length);
+	std::vector<uint8_t> report_descriptor();
+
+	syna::PDEVICE_CONTEXT context();
+
+	std::vector<report> reports;
+
+	/* virtual microseconds from each ATTN frame's arrival to the gesture engine */
+	std::vector<uint64_t> latencies;
+
+	uint32_t timer_fires;
+	uint32_t interrupts;
+
+	/* the driver's internals, for the simulated framework */
+	uint64_t clock;			/* 100ns ticks */
+	syna::WDFDEVICE fx_device;
+	std::vector<std::unique_ptr<syna::WDFOBJECT__>> objects;
+	void complete(syna::WDFREQUEST request);
+
+private:
+	registry local;
+	std::multimap<uint64_t, frame> pending;
+	std::deque<uint64_t> arrivals;		/* of the frames not yet drained */
+	uint32_t consumed;
+	int reads_pending;
+	bool reads_held;
+	bool started;
+
+	void interrupt();
+	void fire_timer();
+	void account();
+	void settle();
+	syna::WDFREQUEST make_request(ULONG ioctl, size_t input, size_t output);
+	NTSTATUS send(syna::WDFREQUEST request);
+	NTSTATUS transfer(ULONG ioctl, const void *data, ULONG length, void *out);
+	void release_requests();
+};
+
+/* the simulated SSSE3 feature bit, on by default */
+extern bool ssse3;
+
+/* a contact moving in a straight line, one point per frame */
+std::vector<frame> swipe(int fingers, uint16_t x0, uint16_t y0, int dx, int dy, int frames,
+	int spacing = 300);
+
+}
+
+#endif
@@ -0,0 +1,11 @@
+#if !defined(_SIM_EVNTRACE_H_)
+#define _SIM_EVNTRACE_H_
+
+#define TRACE_LEVEL_NONE		0
+#define TRACE_LEVEL_CRITICAL		1
+#define TRACE_LEVEL_ERROR		2
+#define TRACE_LEVEL_WARNING		3
+#define TRACE_LEVEL_INFORMATION		4
+#define TRACE_LEVEL_VERBOSE		5
+
+#endif
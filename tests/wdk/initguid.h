@@ -0,0 +1,6 @@
+#if !defined(_SIM_INITGUID_H_)
+#define _SIM_INITGUID_H_
+
+/* nothing the driver uses on the host */
+
+#endif
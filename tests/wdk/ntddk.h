@@ -0,0 +1,6 @@
+#if !defined(_SIM_NTDDK_H_)
+#define _SIM_NTDDK_H_
+
+#include <wdm.h>
+
+#endif
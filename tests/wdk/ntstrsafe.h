@@ -0,0 +1,6 @@
+#if !defined(_SIM_NTSTRSAFE_H_)
+#define _SIM_NTSTRSAFE_H_
+
+/* nothing the driver uses on the host */
+
+#endif
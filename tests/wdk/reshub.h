@@ -0,0 +1,6 @@
+#if !defined(_SIM_RESHUB_H_)
+#define _SIM_RESHUB_H_
+
+/* nothing the driver uses on the host */
+
+#endif
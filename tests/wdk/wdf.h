@@ -0,0 +1,378 @@
+#if !defined(_SIM_WDF_H_)
+#define _SIM_WDF_H_
+
+#include <wdm.h>
+
+//
+// The framework objects and calls the driver uses, implemented by the
+// simulated device in simdevice.cpp. Every handle points at the same
+// object type there, the typedefs only keep the prototypes readable.
+//
+
+struct WDFOBJECT__;
+
+typedef struct WDFOBJECT__ *WDFOBJECT;
+typedef WDFOBJECT WDFDRIVER;
+typedef WDFOBJECT WDFDEVICE;
+typedef WDFOBJECT WDFQUEUE;
+typedef WDFOBJECT WDFREQUEST;
+typedef WDFOBJECT WDFINTERRUPT;
+typedef WDFOBJECT WDFTIMER;
+typedef WDFOBJECT WDFSPINLOCK;
+typedef WDFOBJECT WDFWAITLOCK;
+typedef WDFOBJECT WDFMEMORY;
+typedef WDFOBJECT WDFIOTARGET;
+typedef WDFOBJECT WDFKEY;
+typedef WDFOBJECT WDFCMRESLIST;
+typedef WDFOBJECT WDFFILEOBJECT;
+
+typedef struct WDFDEVICE_INIT *PWDFDEVICE_INIT;
+
+typedef enum _WDF_TRI_STATE {
+	WdfFalse = 0,
+	WdfTrue = 1,
+	WdfUseDefault = 2,
+} WDF_TRI_STATE;
+
+typedef enum _WDF_POWER_DEVICE_STATE {
+	WdfPowerDeviceInvalid = 0,
+	WdfPowerDeviceD0,
+	WdfPowerDeviceD1,
+	WdfPowerDeviceD2,
+	WdfPowerDeviceD3,
+	WdfPowerDeviceD3Final,
+} WDF_POWER_DEVICE_STATE;
+
+typedef enum _WDF_EXECUTION_LEVEL {
+	WdfExecutionLevelInvalid = 0,
+	WdfExecutionLevelInheritFromParent,
+	WdfExecutionLevelPassive,
+	WdfExecutionLevelDispatch,
+} WDF_EXECUTION_LEVEL;
+
+typedef enum _WDF_IO_QUEUE_DISPATCH_TYPE {
+	WdfIoQueueDispatchInvalid = 0,
+	WdfIoQueueDispatchSequential,
+	WdfIoQueueDispatchParallel,
+	WdfIoQueueDispatchManual,
+} WDF_IO_QUEUE_DISPATCH_TYPE;
+
+//
+// Event callbacks
+//
+
+typedef NTSTATUS EVT_WDF_DRIVER_DEVICE_ADD(WDFDRIVER Driver, PWDFDEVICE_INIT DeviceInit);
+typedef VOID EVT_WDF_OBJECT_CONTEXT_CLEANUP(WDFOBJECT Object);
+typedef NTSTATUS EVT_WDF_DEVICE_PREPARE_HARDWARE(WDFDEVICE Device, WDFCMRESLIST ResourcesRaw, WDFCMRESLIST ResourcesTranslated);
+typedef NTSTATUS EVT_WDF_DEVICE_RELEASE_HARDWARE(WDFDEVICE Device, WDFCMRESLIST ResourcesTranslated);
+typedef NTSTATUS EVT_WDF_DEVICE_D0_ENTRY(WDFDEVICE Device, WDF_POWER_DEVICE_STATE PreviousState);
+typedef NTSTATUS EVT_WDF_DEVICE_D0_EXIT(WDFDEVICE Device, WDF_POWER_DEVICE_STATE TargetState);
+typedef VOID EVT_WDF_FILE_CLEANUP(WDFFILEOBJECT FileObject);
+typedef VOID EVT_WDF_IO_QUEUE_IO_DEFAULT(WDFQUEUE Queue, WDFREQUEST Request);
+typedef VOID EVT_WDF_IO_QUEUE_IO_READ(WDFQUEUE Queue, WDFREQUEST Request, size_t Length);
+typedef VOID EVT_WDF_IO_QUEUE_IO_WRITE(WDFQUEUE Queue, WDFREQUEST Request, size_t Length);
+typedef VOID EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL(WDFQUEUE Queue, WDFREQUEST Request,
+	size_t OutputBufferLength, size_t InputBufferLength, ULONG IoControlCode);
+typedef VOID EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL(WDFQUEUE Queue, WDFREQUEST Request,
+	size_t OutputBufferLength, size_t InputBufferLength, ULONG IoControlCode);
+typedef BOOLEAN EVT_WDF_INTERRUPT_ISR(WDFINTERRUPT Interrupt, ULONG MessageID);
+typedef VOID EVT_WDF_INTERRUPT_DPC(WDFINTERRUPT Interrupt, WDFOBJECT AssociatedObject);
+typedef VOID EVT_WDF_TIMER(WDFTIMER Timer);
+
+typedef EVT_WDF_DRIVER_DEVICE_ADD *PFN_WDF_DRIVER_DEVICE_ADD;
+typedef EVT_WDF_OBJECT_CONTEXT_CLEANUP *PFN_WDF_OBJECT_CONTEXT_CLEANUP;
+typedef EVT_WDF_DEVICE_PREPARE_HARDWARE *PFN_WDF_DEVICE_PREPARE_HARDWARE;
+typedef EVT_WDF_DEVICE_RELEASE_HARDWARE *PFN_WDF_DEVICE_RELEASE_HARDWARE;
+typedef EVT_WDF_DEVICE_D0_ENTRY *PFN_WDF_DEVICE_D0_ENTRY;
+typedef EVT_WDF_DEVICE_D0_EXIT *PFN_WDF_DEVICE_D0_EXIT;
+typedef EVT_WDF_IO_QUEUE_IO_DEFAULT *PFN_WDF_IO_QUEUE_IO_DEFAULT;
+typedef EVT_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL *PFN_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL;
+typedef EVT_WDF_INTERRUPT_ISR *PFN_WDF_INTERRUPT_ISR;
+typedef EVT_WDF_INTERRUPT_DPC *PFN_WDF_INTERRUPT_DPC;
+typedef EVT_WDF_TIMER *PFN_WDF_TIMER;
+
+//
+// Object attributes and typed contexts
+//
+
+typedef struct _WDF_OBJECT_CONTEXT_TYPE_INFO {
+	const char *ContextName;
+	size_t ContextSize;
+} WDF_OBJECT_CONTEXT_TYPE_INFO;
+typedef const WDF_OBJECT_CONTEXT_TYPE_INFO *PCWDF_OBJECT_CONTEXT_TYPE_INFO;
+
+typedef struct _WDF_OBJECT_ATTRIBUTES {
+	ULONG Size;
+	PFN_WDF_OBJECT_CONTEXT_CLEANUP EvtCleanupCallback;
+	WDF_EXECUTION_LEVEL ExecutionLevel;
+	WDFOBJECT ParentObject;
+	size_t ContextSizeOverride;
+	PCWDF_OBJECT_CONTEXT_TYPE_INFO ContextTypeInfo;
+} WDF_OBJECT_ATTRIBUTES, *PWDF_OBJECT_ATTRIBUTES;
+
+#define WDF_NO_OBJECT_ATTRIBUTES	((PWDF_OBJECT_ATTRIBUTES)NULL)
+#define WDF_NO_HANDLE			NULL
+
+static inline void WDF_OBJECT_ATTRIBUTES_INIT(PWDF_OBJECT_ATTRIBUTES Attributes)
+{
+	RtlZeroMemory(Attributes, sizeof(*Attributes));
+	Attributes->Size = sizeof(*Attributes);
+	Attributes->ExecutionLevel = WdfExecutionLevelInheritFromParent;
+}
+
+#define WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(type, casting) \
+	static const WDF_OBJECT_CONTEXT_TYPE_INFO WDF_##type##_CONTEXT_TYPE_INFO = { #type, sizeof(type) }; \
+	static inline type *casting(WDFOBJECT Handle) \
+	{ \
+		return (type *)WdfObjectGetTypedContextWorker(Handle, &WDF_##type##_CONTEXT_TYPE_INFO); \
+	}
+
+#define WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(attributes, type) \
+	do { \
+		WDF_OBJECT_ATTRIBUTES_INIT(attributes); \
+		(attributes)->ContextTypeInfo = &WDF_##type##_CONTEXT_TYPE_INFO; \
+	} while (0)
+
+PVOID WdfObjectGetTypedContextWorker(WDFOBJECT Handle, PCWDF_OBJECT_CONTEXT_TYPE_INFO TypeInfo);
+VOID WdfObjectDelete(WDFOBJECT Object);
+
+//
+// Driver and device
+//
+
+typedef struct _WDF_DRIVER_CONFIG {
+	ULONG Size;
+	PFN_WDF_DRIVER_DEVICE_ADD EvtDriverDeviceAdd;
+	ULONG DriverInitFlags;
+	ULONG DriverPoolTag;
+} WDF_DRIVER_CONFIG, *PWDF_DRIVER_CONFIG;
+
+static inline void WDF_DRIVER_CONFIG_INIT(PWDF_DRIVER_CONFIG Config, PFN_WDF_DRIVER_DEVICE_ADD EvtDriverDeviceAdd)
+{
+	RtlZeroMemory(Config, sizeof(*Config));
+	Config->Size = sizeof(*Config);
+	Config->EvtDriverDeviceAdd = EvtDriverDeviceAdd;
+}
+
+typedef struct _WDF_PNPPOWER_EVENT_CALLBACKS {
+	ULONG Size;
+	PFN_WDF_DEVICE_D0_ENTRY EvtDeviceD0Entry;
+	PFN_WDF_DEVICE_D0_EXIT EvtDeviceD0Exit;
+	PFN_WDF_DEVICE_PREPARE_HARDWARE EvtDevicePrepareHardware;
+	PFN_WDF_DEVICE_RELEASE_HARDWARE EvtDeviceReleaseHardware;
+} WDF_PNPPOWER_EVENT_CALLBACKS, *PWDF_PNPPOWER_EVENT_CALLBACKS;
+
+static inline void WDF_PNPPOWER_EVENT_CALLBACKS_INIT(PWDF_PNPPOWER_EVENT_CALLBACKS Callbacks)
+{
+	RtlZeroMemory(Callbacks, sizeof(*Callbacks));
+	Callbacks->Size = sizeof(*Callbacks);
+}
+
+typedef struct _WDF_DEVICE_STATE {
+	ULONG Size;
+	WDF_TRI_STATE Disabled;
+	WDF_TRI_STATE DontDisplayInUI;
+	WDF_TRI_STATE Failed;
+	WDF_TRI_STATE NotDisableable;
+	WDF_TRI_STATE Removed;
+	WDF_TRI_STATE ResourcesChanged;
+} WDF_DEVICE_STATE, *PWDF_DEVICE_STATE;
+
+static inline void WDF_DEVICE_STATE_INIT(PWDF_DEVICE_STATE State)
+{
+	RtlZeroMemory(State, sizeof(*State));
+	State->Size = sizeof(*State);
+	State->Disabled = WdfUseDefault;
+	State->DontDisplayInUI = WdfUseDefault;
+	State->Failed = WdfUseDefault;
+	State->NotDisableable = WdfUseDefault;
+	State->Removed = WdfUseDefault;
+	State->ResourcesChanged = WdfUseDefault;
+}
+
+NTSTATUS WdfDriverCreate(PDRIVER_OBJECT DriverObject, PCUNICODE_STRING RegistryPath,
+	PWDF_OBJECT_ATTRIBUTES DriverAttributes, PWDF_DRIVER_CONFIG DriverConfig, WDFDRIVER *Driver);
+VOID WdfFdoInitSetFilter(PWDFDEVICE_INIT DeviceInit);
+VOID WdfDeviceInitSetPnpPowerEventCallbacks(PWDFDEVICE_INIT DeviceInit, PWDF_PNPPOWER_EVENT_CALLBACKS PnpPowerEventCallbacks);
+VOID WdfDeviceInitSetRequestAttributes(PWDFDEVICE_INIT DeviceInit, PWDF_OBJECT_ATTRIBUTES RequestAttributes);
+NTSTATUS WdfDeviceCreate(PWDFDEVICE_INIT *DeviceInit, PWDF_OBJECT_ATTRIBUTES DeviceAttributes, WDFDEVICE *Device);
+VOID WdfDeviceSetDeviceState(WDFDEVICE Device, PWDF_DEVICE_STATE DeviceState);
+
+//
+// Queues and requests
+//
+
+typedef struct _WDF_IO_QUEUE_CONFIG {
+	ULONG Size;
+	WDF_IO_QUEUE_DISPATCH_TYPE DispatchType;
+	WDF_TRI_STATE PowerManaged;
+	BOOLEAN DefaultQueue;
+	PFN_WDF_IO_QUEUE_IO_DEFAULT EvtIoDefault;
+	PFN_WDF_IO_QUEUE_IO_INTERNAL_DEVICE_CONTROL EvtIoInternalDeviceControl;
+} WDF_IO_QUEUE_CONFIG, *PWDF_IO_QUEUE_CONFIG;
+
+static inline void WDF_IO_QUEUE_CONFIG_INIT(PWDF_IO_QUEUE_CONFIG Config, WDF_IO_QUEUE_DISPATCH_TYPE DispatchType)
+{
+	RtlZeroMemory(Config, sizeof(*Config));
+	Config->Size = sizeof(*Config);
+	Config->PowerManaged = WdfUseDefault;
+	Config->DispatchType = DispatchType;
+}
+
+static inline void WDF_IO_QUEUE_CONFIG_INIT_DEFAULT_QUEUE(PWDF_IO_QUEUE_CONFIG Config, WDF_IO_QUEUE_DISPATCH_TYPE DispatchType)
+{
+	WDF_IO_QUEUE_CONFIG_INIT(Config, DispatchType);
+	Config->DefaultQueue = TRUE;
+}
+
+typedef struct _WDF_REQUEST_PARAMETERS {
+	USHORT Size;
+	UCHAR MinorFunction;
+	union {
+		struct {
+			size_t OutputBufferLength;
+			size_t InputBufferLength;
+			ULONG IoControlCode;
+			PVOID Type3InputBuffer;
+		} DeviceIoControl;
+	} Parameters;
+} WDF_REQUEST_PARAMETERS, *PWDF_REQUEST_PARAMETERS;
+
+static inline void WDF_REQUEST_PARAMETERS_INIT(PWDF_REQUEST_PARAMETERS Parameters)
+{
+	RtlZeroMemory(Parameters, sizeof(*Parameters));
+	Parameters->Size = sizeof(*Parameters);
+}
+
+NTSTATUS WdfIoQueueCreate(WDFDEVICE Device, PWDF_IO_QUEUE_CONFIG Config,
+	PWDF_OBJECT_ATTRIBUTES QueueAttributes, WDFQUEUE *Queue);
+WDFDEVICE WdfIoQueueGetDevice(WDFQUEUE Queue);
+NTSTATUS WdfIoQueueRetrieveNextRequest(WDFQUEUE Queue, WDFREQUEST *OutRequest);
+NTSTATUS WdfRequestForwardToIoQueue(WDFREQUEST Request, WDFQUEUE DestinationQueue);
+NTSTATUS WdfRequestRequeue(WDFREQUEST Request);
+VOID WdfRequestGetParameters(WDFREQUEST Request, PWDF_REQUEST_PARAMETERS Parameters);
+PIRP WdfRequestWdmGetIrp(WDFREQUEST Request);
+NTSTATUS WdfRequestRetrieveOutputBuffer(WDFREQUEST Request, size_t MinimumRequiredSize,
+	PVOID *Buffer, size_t *Length);
+NTSTATUS WdfRequestRetrieveOutputMemory(WDFREQUEST Request, WDFMEMORY *Memory);
+VOID WdfRequestSetInformation(WDFREQUEST Request, ULONG_PTR Information);
+VOID WdfRequestComplete(WDFREQUEST Request, NTSTATUS Status);
+VOID WdfRequestCompleteWithInformation(WDFREQUEST Request, NTSTATUS Status, ULONG_PTR Information);
+
+//
+// Memory
+//
+
+typedef enum _WDF_MEMORY_DESCRIPTOR_TYPE {
+	WdfMemoryDescriptorTypeInvalid = 0,
+	WdfMemoryDescriptorTypeBuffer,
+	WdfMemoryDescriptorTypeMdl,
+	WdfMemoryDescriptorTypeHandle,
+} WDF_MEMORY_DESCRIPTOR_TYPE;
+
+typedef struct _WDF_MEMORY_DESCRIPTOR {
+	WDF_MEMORY_DESCRIPTOR_TYPE Type;
+	union {
+		struct {
+			PVOID Buffer;
+			ULONG Length;
+		} BufferType;
+		struct {
+			WDFMEMORY Memory;
+			PVOID Offsets;
+		} HandleType;
+	} u;
+} WDF_MEMORY_DESCRIPTOR, *PWDF_MEMORY_DESCRIPTOR;
+
+static inline void WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(PWDF_MEMORY_DESCRIPTOR Descriptor, PVOID Buffer, ULONG BufferLength)
+{
+	RtlZeroMemory(Descriptor, sizeof(*Descriptor));
+	Descriptor->Type = WdfMemoryDescriptorTypeBuffer;
+	Descriptor->u.BufferType.Buffer = Buffer;
+	Descriptor->u.BufferType.Length = BufferLength;
+}
+
+static inline void WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(PWDF_MEMORY_DESCRIPTOR Descriptor, WDFMEMORY Memory, PVOID Offsets)
+{
+	RtlZeroMemory(Descriptor, sizeof(*Descriptor));
+	Descriptor->Type = WdfMemoryDescriptorTypeHandle;
+	Descriptor->u.HandleType.Memory = Memory;
+	Descriptor->u.HandleType.Offsets = Offsets;
+}
+
+NTSTATUS WdfMemoryCopyFromBuffer(WDFMEMORY DestinationMemory, size_t DestinationOffset,
+	PVOID Buffer, size_t NumBytesToCopyFrom);
+
+//
+// Interrupts, timers and locks
+//
+
+typedef struct _WDF_INTERRUPT_CONFIG {
+	ULONG Size;
+	PFN_WDF_INTERRUPT_ISR EvtInterruptIsr;
+	PFN_WDF_INTERRUPT_DPC EvtInterruptDpc;
+	BOOLEAN PassiveHandling;
+} WDF_INTERRUPT_CONFIG, *PWDF_INTERRUPT_CONFIG;
+
+static inline void WDF_INTERRUPT_CONFIG_INIT(PWDF_INTERRUPT_CONFIG Configuration,
+	PFN_WDF_INTERRUPT_ISR EvtInterruptIsr, PFN_WDF_INTERRUPT_DPC EvtInterruptDpc)
+{
+	RtlZeroMemory(Configuration, sizeof(*Configuration));
+	Configuration->Size = sizeof(*Configuration);
+	Configuration->EvtInterruptIsr = EvtInterruptIsr;
+	Configuration->EvtInterruptDpc = EvtInterruptDpc;
+}
+
+NTSTATUS WdfInterruptCreate(WDFDEVICE Device, PWDF_INTERRUPT_CONFIG Configuration,
+	PWDF_OBJECT_ATTRIBUTES Attributes, WDFINTERRUPT *Interrupt);
+WDFDEVICE WdfInterruptGetDevice(WDFINTERRUPT Interrupt);
+VOID WdfInterruptAcquireLock(WDFINTERRUPT Interrupt);
+VOID WdfInterruptReleaseLock(WDFINTERRUPT Interrupt);
+
+typedef struct _WDF_TIMER_CONFIG {
+	ULONG Size;
+	PFN_WDF_TIMER EvtTimerFunc;
+	ULONG Period;
+	BOOLEAN AutomaticSerialization;
+} WDF_TIMER_CONFIG, *PWDF_TIMER_CONFIG;
+
+static inline void WDF_TIMER_CONFIG_INIT(PWDF_TIMER_CONFIG Config, PFN_WDF_TIMER EvtTimerFunc)
+{
+	RtlZeroMemory(Config, sizeof(*Config));
+	Config->Size = sizeof(*Config);
+	Config->EvtTimerFunc = EvtTimerFunc;
+	Config->AutomaticSerialization = TRUE;
+}
+
+/* relative due times are negative counts of 100ns */
+#define WDF_REL_TIMEOUT_IN_MS(ms)	(-((LONGLONG)(ms) * 10000))
+#define WDF_REL_TIMEOUT_IN_US(us)	(-((LONGLONG)(us) * 10))
+
+NTSTATUS WdfTimerCreate(PWDF_TIMER_CONFIG Config, PWDF_OBJECT_ATTRIBUTES Attributes, WDFTIMER *Timer);
+BOOLEAN WdfTimerStart(WDFTIMER Timer, LONGLONG DueTime);
+BOOLEAN WdfTimerStop(WDFTIMER Timer, BOOLEAN Wait);
+WDFOBJECT WdfTimerGetParentObject(WDFTIMER Timer);
+
+NTSTATUS WdfSpinLockCreate(PWDF_OBJECT_ATTRIBUTES SpinLockAttributes, WDFSPINLOCK *SpinLock);
+VOID WdfSpinLockAcquire(WDFSPINLOCK SpinLock);
+VOID WdfSpinLockRelease(WDFSPINLOCK SpinLock);
+
+//
+// Resources and registry
+//
+
+ULONG WdfCmResourceListGetCount(WDFCMRESLIST List);
+PCM_PARTIAL_RESOURCE_DESCRIPTOR WdfCmResourceListGetDescriptor(WDFCMRESLIST List, ULONG Index);
+
+NTSTATUS WdfDeviceOpenRegistryKey(WDFDEVICE Device, ULONG DeviceInstanceKeyType,
+	ACCESS_MASK DesiredAccess, PWDF_OBJECT_ATTRIBUTES KeyAttributes, WDFKEY *Key);
+NTSTATUS WdfRegistryOpenKey(WDFKEY ParentKey, PCUNICODE_STRING KeyName, ACCESS_MASK DesiredAccess,
+	PWDF_OBJECT_ATTRIBUTES KeyAttributes, WDFKEY *Key);
+VOID WdfRegistryClose(WDFKEY Key);
+NTSTATUS WdfRegistryQueryULong(WDFKEY Key, PCUNICODE_STRING ValueName, PULONG Value);
+NTSTATUS WdfRegistryQueryValue(WDFKEY Key, PCUNICODE_STRING ValueName, ULONG ValueLength,
+	PVOID Value, PULONG ValueLengthQueried, PULONG ValueType);
+NTSTATUS WdfRegistryAssignValue(WDFKEY Key, PCUNICODE_STRING ValueName, ULONG ValueType,
+	ULONG ValueLength, PVOID Value);
+
+#endif
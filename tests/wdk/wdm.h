@@ -0,0 +1,154 @@
+#if !defined(_SIM_WDM_H_)
+#define _SIM_WDM_H_
+
+//
+// Just enough of the kernel headers for the driver sources to build on
+// a Linux host against the simulated device in simdevice.cpp. Like the
+// driver headers these end up inside namespace syna, so nothing in here
+// may pull in a system header; hostshim.h and the standard headers are
+// included before them.
+//
+
+#define IN
+#define OUT
+#define CONST				const
+#define VOID				void
+
+#define _In_
+#define _Inout_
+#define _Out_
+#define _In_reads_bytes_(size)
+#define _Out_writes_bytes_(size)
+
+#define UNREFERENCED_PARAMETER(p)	((void)(p))
+#define NT_ASSERT(cond)			CHECK(cond)
+#define DECLSPEC_ALIGN(x)		__attribute__((aligned(x)))
+#define ARRAYSIZE(a)			(sizeof(a) / sizeof((a)[0]))
+
+#ifndef min
+#define min(a, b)			(((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b)			(((a) > (b)) ? (a) : (b))
+#endif
+
+#ifndef FALSE
+#define FALSE				0
+#define TRUE				1
+#endif
+
+typedef void *PVOID;
+typedef char CHAR, *PCHAR;
+typedef unsigned char UCHAR, *PUCHAR;
+typedef unsigned char BOOLEAN;
+typedef unsigned short UINT16;
+typedef int LONG;
+typedef unsigned int ULONG, *PULONG;
+typedef long long LONGLONG;
+typedef unsigned long long ULONGLONG;
+typedef unsigned long ULONG_PTR;
+typedef wchar_t WCHAR, *PWSTR;
+typedef ULONG ACCESS_MASK;
+
+typedef LONG NTSTATUS;
+
+#define NT_SUCCESS(status)		((NTSTATUS)(status) >= 0)
+
+#define STATUS_SUCCESS			((NTSTATUS)0x00000000)
+#define STATUS_PENDING			((NTSTATUS)0x00000103)
+#define STATUS_NO_MORE_ENTRIES		((NTSTATUS)0x8000001A)
+#define STATUS_BUFFER_OVERFLOW		((NTSTATUS)0x80000005)
+#define STATUS_INVALID_PARAMETER	((NTSTATUS)0xC000000D)
+#define STATUS_INVALID_DEVICE_REQUEST	((NTSTATUS)0xC0000010)
+#define STATUS_BUFFER_TOO_SMALL		((NTSTATUS)0xC0000023)
+#define STATUS_OBJECT_NAME_NOT_FOUND	((NTSTATUS)0xC0000034)
+#define STATUS_INSUFFICIENT_RESOURCES	((NTSTATUS)0xC000009A)
+#define STATUS_CANCELLED		((NTSTATUS)0xC0000120)
+#define STATUS_NOT_SUPPORTED		((NTSTATUS)0xC00000BB)
+#define STATUS_INVALID_DEVICE_STATE	((NTSTATUS)0xC0000184)
+#define STATUS_DEVICE_PROTOCOL_ERROR	((NTSTATUS)0xC0000186)
+#define STATUS_NOT_FOUND		((NTSTATUS)0xC0000225)
+
+typedef union _LARGE_INTEGER {
+	struct {
+		ULONG LowPart;
+		LONG HighPart;
+	};
+	LONGLONG QuadPart;
+} LARGE_INTEGER, *PLARGE_INTEGER;
+
+typedef struct _UNICODE_STRING {
+	unsigned short Length;
+	unsigned short MaximumLength;
+	PWSTR Buffer;
+} UNICODE_STRING, *PUNICODE_STRING;
+typedef const UNICODE_STRING *PCUNICODE_STRING;
+
+#define UNICODE_NULL			((WCHAR)0)
+#define DECLARE_CONST_UNICODE_STRING(name, text) \
+	const UNICODE_STRING name = { sizeof(text) - sizeof(WCHAR), sizeof(text), (PWSTR)text }
+
+typedef struct _DRIVER_OBJECT {
+	int unused;
+} DRIVER_OBJECT, *PDRIVER_OBJECT;
+
+typedef struct _KEVENT {
+	int unused;
+} KEVENT;
+
+typedef struct _IRP {
+	PVOID UserBuffer;
+} IRP, *PIRP;
+
+#define RtlZeroMemory(dest, length)		memset((dest), 0, (length))
+#define RtlCopyMemory(dest, src, length)	memcpy((dest), (src), (length))
+#define RtlEqualMemory(a, b, length)		(memcmp((a), (b), (length)) == 0)
+
+static inline BOOLEAN BitScanForward(unsigned long *index, unsigned long mask)
+{
+	if (!mask)
+		return FALSE;
+	*index = (unsigned long)__builtin_ctzl(mask);
+	return TRUE;
+}
+
+/* the simulated clock, in 100ns counts at 10MHz */
+LARGE_INTEGER KeQueryPerformanceCounter(PLARGE_INTEGER frequency);
+
+#define PF_SSSE3_INSTRUCTIONS_AVAILABLE	36
+
+BOOLEAN ExIsProcessorFeaturePresent(ULONG feature);
+
+#define METHOD_BUFFERED			0
+#define METHOD_IN_DIRECT		1
+#define METHOD_OUT_DIRECT		2
+#define METHOD_NEITHER			3
+#define FILE_ANY_ACCESS			0
+#define CTL_CODE(type, function, method, access) \
+	(((type) << 16) | ((access) << 14) | ((function) << 2) | (method))
+
+#define KEY_READ			0x20019
+#define KEY_WRITE			0x20006
+
+#define REG_DWORD			4
+#define REG_BINARY			3
+
+#define PLUGPLAY_REGKEY_DEVICE		1
+
+#define CmResourceTypeConnection		0x84
+#define CM_RESOURCE_CONNECTION_CLASS_SERIAL	0x03
+#define CM_RESOURCE_CONNECTION_TYPE_SERIAL_I2C	0x01
+
+typedef struct _CM_PARTIAL_RESOURCE_DESCRIPTOR {
+	UCHAR Type;
+	union {
+		struct {
+			UCHAR Class;
+			UCHAR Type;
+			ULONG IdLowPart;
+			ULONG IdHighPart;
+		} Connection;
+	} u;
+} CM_PARTIAL_RESOURCE_DESCRIPTOR, *PCM_PARTIAL_RESOURCE_DESCRIPTOR;
+
+#endif